@@ -0,0 +1,438 @@
+#include "benchmark.h"
+
+#include "registry/docsetregistry.h"
+#include "registry/listmodel.h"
+#include "registry/searchindex.h"
+#include "registry/searchquery.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+
+using namespace Zeal;
+
+namespace {
+const int QueryLengths[] = {1, 2, 4, 8, 16};
+const int SymbolsPerPage = 64;
+const int MaxListedSymbols = 1000; // Per group, fetched into the model
+const int IndexWaitTimeout = 60000; // ms
+
+const char *const Syllables[] = {
+    "ar", "be", "co", "de", "fi", "ga", "he", "in", "jo", "ka", "lo", "mi", "nu", "or", "pa", "qu",
+    "ri", "st", "tu", "ve", "wa", "xy", "yo", "ze"
+};
+const int SyllableCount = sizeof(Syllables) / sizeof(Syllables[0]);
+
+const char *const SymbolTypes[] = {
+    "Class", "Method", "Function", "Constant", "Variable", "Property", "Enum", "Guide"
+};
+
+const char SearchIndexFileName[] = "docSet.zidx";
+
+quint32 mix(quint32 x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+QString syllables(quint32 seed, int count, bool capitalize)
+{
+    QString word;
+    for (int i = 0; i < count; ++i) {
+        word += QLatin1String(Syllables[seed % SyllableCount]);
+        seed /= SyllableCount;
+    }
+
+    if (capitalize)
+        word[0] = word.at(0).toUpper();
+    return word;
+}
+
+QString docsetName(int number)
+{
+    return QStringLiteral("bench%1").arg(number, 2, 10, QLatin1Char('0'));
+}
+
+QString symbolType(int symbol)
+{
+    return QLatin1String(SymbolTypes[mix(symbol) % (sizeof(SymbolTypes) / sizeof(SymbolTypes[0]))]);
+}
+
+QString pagePath(int symbol)
+{
+    return QStringLiteral("page%1.html").arg(symbol / SymbolsPerPage);
+}
+
+QJsonObject benchmarkResult(const QString &name)
+{
+    QJsonObject result;
+    result.insert(QStringLiteral("name"), name);
+    return result;
+}
+
+/// Waits for the search indexes of all docsets, searches fall back to SQL until then
+bool waitForSearchIndexes(const DocsetRegistry *registry)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    for (const QSharedPointer<Docset> &docset : registry->docsets()) {
+        while (!docset->searchIndex()) {
+            if (timer.hasExpired(IndexWaitTimeout))
+                return false;
+            QThread::msleep(10);
+        }
+    }
+
+    return true;
+}
+}
+
+Benchmark::Benchmark(const Parameters &parameters) :
+    m_parameters(parameters)
+{
+}
+
+QJsonObject Benchmark::run()
+{
+    QTextStream err(stderr);
+
+    QTemporaryDir fixtureDir;
+    if (!fixtureDir.isValid()) {
+        err << QObject::tr("Cannot create a directory for fixture docsets\n");
+        return QJsonObject();
+    }
+
+    err << QObject::tr("Writing %1 docsets of %2 symbols...\n")
+           .arg(m_parameters.docsetCount).arg(m_parameters.symbolCount);
+    err.flush();
+
+    for (int i = 0; i < m_parameters.docsetCount; ++i) {
+        const QString path = fixtureDir.path() + QLatin1Char('/') + docsetName(i) + QLatin1String(".docset");
+        if (!writeDocset(path, i, i % 2)) {
+            err << QObject::tr("Cannot write fixture docset %1\n").arg(path);
+            return QJsonObject();
+        }
+    }
+
+    measureDocsetLoading(fixtureDir.path() + QLatin1Char('/') + docsetName(0) + QLatin1String(".docset"),
+                         QStringLiteral("Dash"));
+    if (m_parameters.docsetCount > 1) {
+        measureDocsetLoading(fixtureDir.path() + QLatin1Char('/') + docsetName(1)
+                             + QLatin1String(".docset"), QStringLiteral("ZDash"));
+    }
+
+    DocsetRegistry registry;
+    QEventLoop loop;
+    QObject::connect(&registry, &DocsetRegistry::docsetsLoaded, &loop, &QEventLoop::quit,
+                     Qt::QueuedConnection);
+    registry.init(fixtureDir.path());
+    loop.exec();
+
+    if (!waitForSearchIndexes(&registry))
+        err << QObject::tr("Search indexes are not ready, searches fall back to SQL\n");
+
+    measureSearch(&registry);
+    measureListModel(&registry);
+    measureResultSorting(&registry);
+
+    QJsonObject report;
+    report.insert(QStringLiteral("version"), QStringLiteral(ZEAL_VERSION));
+    report.insert(QStringLiteral("qtVersion"), QLatin1String(qVersion()));
+    report.insert(QStringLiteral("threads"), QThreadPool::globalInstance()->maxThreadCount());
+    report.insert(QStringLiteral("docsets"), m_parameters.docsetCount);
+    report.insert(QStringLiteral("symbols"), m_parameters.symbolCount);
+    report.insert(QStringLiteral("iterations"), m_parameters.iterations);
+    report.insert(QStringLiteral("results"), m_results);
+    return report;
+}
+
+bool Benchmark::writeDocset(const QString &path, int number, bool isZDash) const
+{
+    QDir dir;
+    if (!dir.mkpath(path + QLatin1String("/Contents/Resources/Documents")))
+        return false;
+
+    QFile plist(path + QLatin1String("/Contents/Info.plist"));
+    if (!plist.open(QIODevice::WriteOnly))
+        return false;
+
+    const QString name = docsetName(number);
+    QTextStream(&plist) << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                           "<plist version=\"1.0\"><dict>\n"
+                           "<key>CFBundleIdentifier</key><string>" << name << "</string>\n"
+                           "<key>CFBundleName</key><string>" << name << "</string>\n"
+                           "<key>DocSetPlatformFamily</key><string>" << name << "</string>\n"
+                           "<key>isDashDocset</key><true/>\n"
+                           "</dict></plist>\n";
+
+    QFile page(path + QLatin1String("/Contents/Resources/Documents/index.html"));
+    if (!page.open(QIODevice::WriteOnly))
+        return false;
+    page.write("<html><head><title>Benchmark</title></head><body></body></html>\n");
+
+    bool ok;
+    const QString connectionName = QStringLiteral("benchmark-%1").arg(number);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+        db.setDatabaseName(path + QLatin1String("/Contents/Resources/docSet.dsidx"));
+        ok = db.open();
+
+        QSqlQuery query(db);
+        if (ok && !isZDash) {
+            ok = query.exec(QStringLiteral("CREATE TABLE searchIndex(id INTEGER PRIMARY KEY, name TEXT,"
+                                           " type TEXT, path TEXT)"));
+            ok = ok && db.transaction()
+                    && query.prepare(QStringLiteral("INSERT INTO searchIndex(name, type, path)"
+                                                    " VALUES (?, ?, ?)"));
+            for (int i = 0; ok && i < m_parameters.symbolCount; ++i) {
+                query.bindValue(0, symbolName(number, i));
+                query.bindValue(1, symbolType(i));
+                query.bindValue(2, pagePath(i) + QLatin1Char('#') + QString::number(i));
+                ok = query.exec();
+            }
+            ok = ok && db.commit();
+        } else if (ok) {
+            ok = query.exec(QStringLiteral("CREATE TABLE ztokentype(z_pk INTEGER PRIMARY KEY, ztypename TEXT)"))
+                    && query.exec(QStringLiteral("CREATE TABLE zfilepath(z_pk INTEGER PRIMARY KEY, zpath TEXT)"))
+                    && query.exec(QStringLiteral("CREATE TABLE ztokenmetainformation(z_pk INTEGER PRIMARY KEY,"
+                                                 " zfile INTEGER, zanchor TEXT)"))
+                    && query.exec(QStringLiteral("CREATE TABLE ztoken(z_pk INTEGER PRIMARY KEY, ztokenname TEXT,"
+                                                 " ztokentype INTEGER, zmetainformation INTEGER)"));
+            ok = ok && db.transaction();
+
+            const int typeCount = sizeof(SymbolTypes) / sizeof(SymbolTypes[0]);
+            ok = ok && query.prepare(QStringLiteral("INSERT INTO ztokentype VALUES (?, ?)"));
+            for (int i = 0; ok && i < typeCount; ++i) {
+                query.bindValue(0, i + 1);
+                query.bindValue(1, QLatin1String(SymbolTypes[i]));
+                ok = query.exec();
+            }
+
+            ok = ok && query.prepare(QStringLiteral("INSERT INTO zfilepath VALUES (?, ?)"));
+            for (int i = 0; ok && i < m_parameters.symbolCount; i += SymbolsPerPage) {
+                query.bindValue(0, i / SymbolsPerPage + 1);
+                query.bindValue(1, pagePath(i));
+                ok = query.exec();
+            }
+
+            ok = ok && query.prepare(QStringLiteral("INSERT INTO ztokenmetainformation VALUES (?, ?, ?)"));
+            for (int i = 0; ok && i < m_parameters.symbolCount; ++i) {
+                query.bindValue(0, i + 1);
+                query.bindValue(1, i / SymbolsPerPage + 1);
+                query.bindValue(2, QString::number(i));
+                ok = query.exec();
+            }
+
+            ok = ok && query.prepare(QStringLiteral("INSERT INTO ztoken VALUES (?, ?, ?, ?)"));
+            for (int i = 0; ok && i < m_parameters.symbolCount; ++i) {
+                query.bindValue(0, i + 1);
+                query.bindValue(1, symbolName(number, i));
+                query.bindValue(2, static_cast<int>(mix(i) % typeCount) + 1);
+                query.bindValue(3, i + 1);
+                ok = query.exec();
+            }
+
+            ok = ok && db.commit();
+        }
+
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return ok;
+}
+
+void Benchmark::measureDocsetLoading(const QString &path, const QString &schema)
+{
+    const QString indexPath = path + QLatin1String("/Contents/Resources/") + QLatin1String(SearchIndexFileName);
+
+    // Without an index file symbols are counted in SQL, the index is built in the background
+    QVector<qint64> sqlSamples;
+    QVector<qint64> indexSamples;
+    QElapsedTimer timer;
+    for (int i = 0; i < m_parameters.iterations; ++i) {
+        QFile::remove(indexPath);
+
+        timer.start();
+        QScopedPointer<Docset> docset(new Docset(path));
+        sqlSamples.append(timer.nsecsElapsed());
+    }
+
+    QJsonObject result = benchmarkResult(QStringLiteral("docset_load"));
+    result.insert(QStringLiteral("schema"), schema);
+    result.insert(QStringLiteral("source"), QStringLiteral("sql"));
+    addResult(result, sqlSamples);
+
+    // Docsets drop their index build when destroyed, so one is kept until it has saved the index
+    {
+        QScopedPointer<Docset> docset(new Docset(path));
+        timer.start();
+        while (!docset->searchIndex() && !timer.hasExpired(IndexWaitTimeout))
+            QThread::msleep(10);
+    }
+
+    if (!QFile::exists(indexPath)) {
+        QTextStream(stderr) << QObject::tr("Search index of %1 was not saved, skipping index loading\n")
+                               .arg(path);
+        return;
+    }
+
+    for (int i = 0; i < m_parameters.iterations; ++i) {
+        timer.start();
+        QScopedPointer<Docset> docset(new Docset(path));
+        indexSamples.append(timer.nsecsElapsed());
+    }
+
+    result.insert(QStringLiteral("source"), QStringLiteral("index"));
+    addResult(result, indexSamples);
+}
+
+void Benchmark::measureSearch(DocsetRegistry *registry)
+{
+    const int limit = registry->resultLimit();
+
+    // Queries of all docsets, and of only one through its keyword
+    for (const bool isFiltered : {false, true}) {
+        for (const int length : QueryLengths) {
+            QVector<qint64> samples;
+            QElapsedTimer timer;
+
+            for (int i = 0; i < m_parameters.iterations; ++i) {
+                const int docsetNumber = i % m_parameters.docsetCount;
+                const int symbol = mix(i + 1) % qMax(m_parameters.symbolCount, 1);
+                QString queryString = symbolName(docsetNumber, symbol).left(length);
+                if (isFiltered)
+                    queryString.prepend(docsetName(docsetNumber) + QLatin1Char(':'));
+
+                const SearchQuery query = SearchQuery::fromString(queryString);
+                timer.start();
+                registry->find(query, limit);
+                samples.append(timer.nsecsElapsed());
+            }
+
+            QJsonObject result = benchmarkResult(QStringLiteral("search"));
+            result.insert(QStringLiteral("docsets"), isFiltered ? 1 : m_parameters.docsetCount);
+            result.insert(QStringLiteral("queryLength"), length);
+            addResult(result, samples);
+        }
+    }
+}
+
+void Benchmark::measureListModel(DocsetRegistry *registry)
+{
+    ListModel model(registry);
+
+    // Symbols are fetched once, the measurement covers navigating the tree
+    qint64 operations = 0;
+    for (int docsetRow = 0; docsetRow < model.rowCount(QModelIndex()); ++docsetRow) {
+        const QModelIndex docsetIndex = model.index(docsetRow, 0, QModelIndex());
+        for (int groupRow = 0; groupRow < model.rowCount(docsetIndex); ++groupRow) {
+            const QModelIndex groupIndex = model.index(groupRow, 0, docsetIndex);
+            while (model.canFetchMore(groupIndex) && model.rowCount(groupIndex) < MaxListedSymbols)
+                model.fetchMore(groupIndex);
+            operations += model.rowCount(groupIndex) + 1;
+        }
+        ++operations;
+    }
+
+    QVector<qint64> samples;
+    QElapsedTimer timer;
+    for (int i = 0; i < m_parameters.iterations; ++i) {
+        timer.start();
+        for (int docsetRow = 0; docsetRow < model.rowCount(QModelIndex()); ++docsetRow) {
+            const QModelIndex docsetIndex = model.index(docsetRow, 0, QModelIndex());
+            for (int groupRow = 0; groupRow < model.rowCount(docsetIndex); ++groupRow) {
+                const QModelIndex groupIndex = model.index(groupRow, 0, docsetIndex);
+                if (model.parent(groupIndex) != docsetIndex)
+                    qWarning("Unexpected parent of a symbol group");
+
+                for (int symbolRow = 0; symbolRow < model.rowCount(groupIndex); ++symbolRow) {
+                    if (model.parent(model.index(symbolRow, 0, groupIndex)) != groupIndex)
+                        qWarning("Unexpected parent of a symbol");
+                }
+            }
+        }
+        samples.append(timer.nsecsElapsed());
+    }
+
+    // Each operation is an index() and a parent() call
+    addResult(benchmarkResult(QStringLiteral("list_model_navigation")), samples, operations);
+}
+
+void Benchmark::measureResultSorting(DocsetRegistry *registry)
+{
+    QVector<SearchResult> results;
+    for (const QSharedPointer<Docset> &docset : registry->docsets()) {
+        const QSharedPointer<const SearchIndex> index = docset->searchIndex();
+        if (!index)
+            continue;
+
+        // Scores are bunched like the ones of a fuzzy search, leaving many ties to names
+        for (int i = 0; i < index->size(); ++i)
+            results.append(SearchResult(index, i, docset, mix(i) % 100));
+    }
+
+    QVector<qint64> samples;
+    QElapsedTimer timer;
+    for (int i = 0; i < m_parameters.iterations; ++i) {
+        QVector<SearchResult> sorted = results;
+        timer.start();
+        std::sort(sorted.begin(), sorted.end());
+        samples.append(timer.nsecsElapsed());
+    }
+
+    QJsonObject result = benchmarkResult(QStringLiteral("result_sort"));
+    result.insert(QStringLiteral("count"), results.size());
+    addResult(result, samples);
+}
+
+void Benchmark::addResult(QJsonObject result, QVector<qint64> samples, qint64 operations)
+{
+    if (samples.isEmpty())
+        return;
+
+    std::sort(samples.begin(), samples.end());
+
+    qint64 total = 0;
+    for (const qint64 sample : samples)
+        total += sample;
+
+    // Microseconds per iteration, and the derived rate of operations
+    const double median = samples.at(samples.size() / 2) / 1000.0;
+    result.insert(QStringLiteral("samples"), samples.size());
+    result.insert(QStringLiteral("medianUs"), median);
+    result.insert(QStringLiteral("meanUs"), total / 1000.0 / samples.size());
+    result.insert(QStringLiteral("minUs"), samples.first() / 1000.0);
+    result.insert(QStringLiteral("maxUs"), samples.last() / 1000.0);
+    if (operations > 1) {
+        result.insert(QStringLiteral("operations"), static_cast<double>(operations));
+        result.insert(QStringLiteral("operationsPerSecond"), median > 0 ? operations / median * 1e6 : 0.0);
+    }
+
+    m_results.append(result);
+}
+
+QString Benchmark::symbolName(int docsetNumber, int symbol) const
+{
+    const quint32 seed = mix(docsetNumber * 1000003u + symbol);
+    const QString module = syllables(seed, 2, false);
+    const QString className = syllables(mix(seed), 2 + seed % 2, true);
+    const QString member = syllables(mix(seed + 1), 2 + (seed >> 8) % 2, false);
+
+    // Distinct symbols may still share a name, like overloads do
+    return module + QLatin1Char('.') + className + QLatin1Char('.') + member;
+}
@@ -0,0 +1,53 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+namespace Zeal {
+
+class DocsetRegistry;
+
+/**
+ * @short Measures the hot paths of the registry on generated docsets.
+ *
+ * Fixture docsets with random symbol names are written to a temporary directory, alternating
+ * between the Dash and the ZDash schema. Each measurement is repeated and summarized by its
+ * median, minimum and maximum, so that runs of different versions can be compared.
+ */
+class Benchmark
+{
+public:
+    struct Parameters {
+        int docsetCount = 4;
+        int symbolCount = 20000; // Per docset
+        int iterations = 20;
+    };
+
+    explicit Benchmark(const Parameters &parameters);
+
+    /// Runs all benchmarks, returns their results or an empty object if fixtures cannot be written
+    QJsonObject run();
+
+private:
+    bool writeDocset(const QString &path, int number, bool isZDash) const;
+
+    void measureDocsetLoading(const QString &path, const QString &schema);
+    void measureSearch(DocsetRegistry *registry);
+    void measureListModel(DocsetRegistry *registry);
+    void measureResultSorting(DocsetRegistry *registry);
+
+    /// Appends the summary of \a samples in ns, each of \a operations calls
+    void addResult(QJsonObject result, QVector<qint64> samples, qint64 operations = 1);
+
+    QString symbolName(int docsetNumber, int symbol) const;
+
+    Parameters m_parameters;
+    QJsonArray m_results;
+};
+
+} // namespace Zeal
+
+#endif // BENCHMARK_H
@@ -0,0 +1,56 @@
+TEMPLATE = app
+
+# Docset icons need QtGui, nothing else of the UI is linked
+QT += concurrent gui sql
+QT -= widgets
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+portable {
+    DEFINES += PORTABLE_BUILD
+}
+
+tracing {
+    DEFINES += USE_TRACING
+}
+
+# TODO: Obtain version number from Git tags
+VERSION = $$(ZEAL_VERSION)
+isEmpty(VERSION) {
+    VERSION = 0.0.0
+}
+DEFINES += ZEAL_VERSION=\\\"$${VERSION}\\\"
+
+INCLUDEPATH += $$SRC_ROOT/src
+
+HEADERS += \
+    benchmark.h \
+    ../core/tracer.h
+
+SOURCES += \
+    benchmark.cpp \
+    main.cpp \
+    ../core/tracer.cpp
+
+include(../registry/registry.pri)
+
+# The search model depends on the application, the list model is kept for --benchmark
+HEADERS -= $$SRC_ROOT/src/registry/searchmodel.h
+SOURCES -= $$SRC_ROOT/src/registry/searchmodel.cpp
+
+!msvc:LIBS += -lz -L/usr/lib
+
+DESTDIR = $$BUILD_ROOT/bin
+
+TARGET = zeal-cli
+
+unix:!macx {
+    isEmpty(PREFIX): PREFIX = /usr
+    target.path = $$PREFIX/bin
+    INSTALLS = target
+}
+
+# Keep build directory organised, apart from the objects of the application
+MOC_DIR = $$BUILD_ROOT/.moc/cli
+OBJECTS_DIR = $$BUILD_ROOT/.obj/cli
+RCC_DIR = $$BUILD_ROOT/.rcc/cli
@@ -0,0 +1,246 @@
+#include "benchmark.h"
+
+#include "registry/docsetregistry.h"
+#include "registry/searchquery.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QEventLoop>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+#include <QtConcurrent/QtConcurrent>
+
+using namespace Zeal;
+
+namespace {
+const int BatchSizePerThread = 16;
+const int DefaultResultLimit = 1;
+
+enum ExitCode {
+    Resolved = 0,
+    Unresolved = 1, // Some queries have no results
+    Error = 2
+};
+
+struct CommandLineParameters
+{
+    QString docsetPath;
+    int limit;
+    int jobs;
+    bool json;
+    bool benchmark;
+    Benchmark::Parameters benchmarkParameters;
+};
+
+struct Lookup
+{
+    typedef QVector<SearchResult> result_type;
+
+    Lookup(const DocsetRegistry *r, int l) :
+        registry(r),
+        limit(l)
+    {
+    }
+
+    QVector<SearchResult> operator()(const QString &line) const
+    {
+        const SearchQuery query = SearchQuery::fromString(line);
+        if (query.query().isEmpty())
+            return QVector<SearchResult>();
+        return registry->find(query, limit);
+    }
+
+    const DocsetRegistry *registry;
+    int limit;
+};
+
+/// Returns the docset directory of Zeal, Core::Settings cannot be used without QtWebKit
+QString defaultDocsetPath()
+{
+#ifndef PORTABLE_BUILD
+    QSettings settings;
+#else
+    QSettings settings(QCoreApplication::applicationDirPath() + QLatin1String("/zeal.ini"),
+                       QSettings::IniFormat);
+#endif
+    settings.beginGroup(QStringLiteral("docsets"));
+    if (settings.contains(QStringLiteral("path")))
+        return settings.value(QStringLiteral("path")).toString();
+
+#ifndef PORTABLE_BUILD
+    return QStandardPaths::writableLocation(QStandardPaths::DataLocation) + QLatin1String("/docsets");
+#else
+    return QCoreApplication::applicationDirPath() + QLatin1String("/docsets");
+#endif
+}
+
+CommandLineParameters parseCommandLine(const QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+                QObject::tr("Resolves search queries against the docsets of Zeal. Queries are read "
+                            "from the standard input, one per line, in the syntax of the search box."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    parser.addOption(QCommandLineOption({QStringLiteral("d"), QStringLiteral("docset-path")},
+                                        QObject::tr("Docset directory, the one of Zeal by default."),
+                                        QStringLiteral("path")));
+    parser.addOption(QCommandLineOption({QStringLiteral("l"), QStringLiteral("limit")},
+                                        QObject::tr("Results per query, %1 by default.")
+                                        .arg(DefaultResultLimit),
+                                        QStringLiteral("count")));
+    parser.addOption(QCommandLineOption({QStringLiteral("j"), QStringLiteral("jobs")},
+                                        QObject::tr("Queries run in parallel, one per core by default."),
+                                        QStringLiteral("count")));
+    parser.addOption(QCommandLineOption({QStringLiteral("json")},
+                                        QObject::tr("Print a JSON object per query instead of "
+                                                    "tab-separated results.")));
+    parser.addOption(QCommandLineOption({QStringLiteral("benchmark")},
+                                        QObject::tr("Measure the search engine on generated docsets "
+                                                    "and print the results as JSON.")));
+    parser.addOption(QCommandLineOption({QStringLiteral("docsets")},
+                                        QObject::tr("Generated docsets for --benchmark."),
+                                        QStringLiteral("count")));
+    parser.addOption(QCommandLineOption({QStringLiteral("symbols")},
+                                        QObject::tr("Symbols per generated docset for --benchmark."),
+                                        QStringLiteral("count")));
+    parser.addOption(QCommandLineOption({QStringLiteral("iterations")},
+                                        QObject::tr("Repetitions of each measurement for --benchmark."),
+                                        QStringLiteral("count")));
+    parser.process(app);
+
+    CommandLineParameters clParams;
+    clParams.docsetPath = parser.isSet(QStringLiteral("docset-path"))
+            ? parser.value(QStringLiteral("docset-path")) : defaultDocsetPath();
+    clParams.limit = parser.isSet(QStringLiteral("limit"))
+            ? qMax(1, parser.value(QStringLiteral("limit")).toInt()) : DefaultResultLimit;
+    clParams.jobs = qMax(1, parser.isSet(QStringLiteral("jobs"))
+                         ? parser.value(QStringLiteral("jobs")).toInt() : QThread::idealThreadCount());
+    clParams.json = parser.isSet(QStringLiteral("json"));
+
+    clParams.benchmark = parser.isSet(QStringLiteral("benchmark"));
+    Benchmark::Parameters &parameters = clParams.benchmarkParameters;
+    if (parser.isSet(QStringLiteral("docsets")))
+        parameters.docsetCount = qBound(1, parser.value(QStringLiteral("docsets")).toInt(), 99);
+    if (parser.isSet(QStringLiteral("symbols")))
+        parameters.symbolCount = qMax(1, parser.value(QStringLiteral("symbols")).toInt());
+    if (parser.isSet(QStringLiteral("iterations")))
+        parameters.iterations = qMax(1, parser.value(QStringLiteral("iterations")).toInt());
+
+    return clParams;
+}
+
+void printResults(QTextStream &out, const QString &line, const QVector<SearchResult> &results, bool json)
+{
+    if (json) {
+        QJsonArray array;
+        for (const SearchResult &result : results)
+            array.append(result.toJson());
+        QJsonObject object;
+        object.insert(QStringLiteral("query"), line);
+        object.insert(QStringLiteral("results"), array);
+        out << QJsonDocument(object).toJson(QJsonDocument::Compact) << '\n';
+        return;
+    }
+
+    // Unresolved queries keep their line, with empty fields
+    if (results.isEmpty()) {
+        out << line << "\t\t\t\n";
+        return;
+    }
+
+    for (const SearchResult &result : results) {
+        out << line << '\t' << result.docset()->name() << '\t' << result.name() << '\t'
+            << result.docset()->documentUrl(result.path()).toString() << '\n';
+    }
+}
+}
+
+int main(int argc, char *argv[])
+{
+    // Same as of the application, for its settings and data location
+    QCoreApplication::setApplicationName(QStringLiteral("Zeal"));
+    QCoreApplication::setApplicationVersion(ZEAL_VERSION);
+    QCoreApplication::setOrganizationDomain(QStringLiteral("zealdocs.org"));
+    QCoreApplication::setOrganizationName(QStringLiteral("Zeal"));
+
+    // Docset icons need a QGuiApplication, but no display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication qapp(argc, argv);
+
+    const CommandLineParameters clParams = parseCommandLine(qapp);
+
+    QThreadPool::globalInstance()->setMaxThreadCount(clParams.jobs);
+
+    if (clParams.benchmark) {
+        const QJsonObject report = Benchmark(clParams.benchmarkParameters).run();
+        if (report.isEmpty())
+            return Error;
+
+        QTextStream(stdout) << QJsonDocument(report).toJson();
+        return Resolved;
+    }
+
+    QTextStream err(stderr);
+    if (!QDir(clParams.docsetPath).exists()) {
+        err << QObject::tr("Docset directory does not exist: %1\n").arg(clParams.docsetPath);
+        return Error;
+    }
+
+    // Docsets are loaded once, before the first query
+    DocsetRegistry registry;
+    QEventLoop loop;
+    QObject::connect(&registry, &DocsetRegistry::docsetsLoaded, &loop, &QEventLoop::quit,
+                     Qt::QueuedConnection);
+    registry.init(clParams.docsetPath);
+    loop.exec();
+
+    if (registry.count() == 0) {
+        err << QObject::tr("No docsets found in %1\n").arg(clParams.docsetPath);
+        return Error;
+    }
+
+    QTextStream in(stdin);
+    QTextStream out(stdout);
+    in.setCodec("UTF-8");
+    out.setCodec("UTF-8");
+
+    // Queries are run in batches, so results stream out in input order as they are found
+    const int batchSize = clParams.jobs * BatchSizePerThread;
+    const Lookup lookup(&registry, clParams.limit);
+    bool isResolved = true;
+    QStringList batch;
+
+    // atEnd() of a stream on stdin reports no data yet as the end, a null line is the end
+    bool isEnd = false;
+    while (!isEnd) {
+        const QString line = in.readLine();
+        isEnd = line.isNull();
+        if (!line.trimmed().isEmpty())
+            batch.append(line.trimmed());
+
+        if (batch.isEmpty() || (batch.size() < batchSize && !isEnd))
+            continue;
+
+        const QList<QVector<SearchResult>> results = QtConcurrent::blockingMapped(batch, lookup);
+        for (int i = 0; i < batch.size(); ++i) {
+            isResolved = isResolved && !results.at(i).isEmpty();
+            printResults(out, batch.at(i), results.at(i), clParams.json);
+        }
+
+        out.flush();
+        batch.clear();
+    }
+
+    return isResolved ? Resolved : Unresolved;
+}
@@ -1,35 +1,49 @@
 #include "application.h"
 
+#include "archivestream.h"
+#include "contentpool.h"
 #include "extractor.h"
+#include "queryserver.h"
+#include "resumablereply.h"
 #include "settings.h"
+#include "tracer.h"
+#include "trashcollector.h"
 #include "registry/docsetregistry.h"
+#include "registry/sharedstore.h"
 #include "registry/searchquery.h"
 #include "ui/mainwindow.h"
 
 #include <QCoreApplication>
-#include <QLocalServer>
-#include <QLocalSocket>
+#include <QDir>
 #include <QMetaObject>
 #include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
 #include <QNetworkProxy>
+#include <QNetworkReply>
+#include <QStandardPaths>
 #include <QSysInfo>
 #include <QThread>
+#include <QTimer>
+
+#include <algorithm>
 
 using namespace Zeal;
 using namespace Zeal::Core;
 
 namespace {
 const char *LocalServerName = "ZealLocalServer";
+const qint64 NetworkCacheSize = 16 * 1024 * 1024;
+const int ProgressInterval = 100; // ms
 }
 
 Application *Application::m_instance = nullptr;
 
 Application::Application(QObject *parent) :
-    Application(SearchQuery(), parent)
+    Application(SearchQuery(), Mode::Interactive, parent)
 {
 }
 
-Application::Application(const SearchQuery &query, QObject *parent) :
+Application::Application(const SearchQuery &query, Mode mode, QObject *parent) :
     QObject(parent)
 {
     // Ensure only one instance of Application
@@ -37,54 +51,111 @@ Application::Application(const SearchQuery &query, QObject *parent) :
     m_instance = this;
 
     m_settings = new Settings(this);
-    m_localServer = new QLocalServer(this);
     m_networkManager = new QNetworkAccessManager(this);
-    m_extractorThread = new QThread(this);
-    m_extractor = new Extractor();
+
+    // Docset lists and feeds are revalidated instead of downloaded again
+    QNetworkDiskCache *networkCache = new QNetworkDiskCache(m_networkManager);
+    networkCache->setCacheDirectory(cacheLocation() + QLatin1String("/http"));
+    networkCache->setMaximumCacheSize(NetworkCacheSize);
+    m_networkManager->setCache(networkCache);
+    // Needed before any docset is loaded, the main window starts loading them
+    applySharedStore();
+
     m_docsetRegistry = new DocsetRegistry();
-    m_mainWindow = new MainWindow(this);
-
-    // Server for detecting already running instances
-    connect(m_localServer, &QLocalServer::newConnection, [this]() {
-        QLocalSocket *connection = m_localServer->nextPendingConnection();
-        // Wait a little while the other side writes the bytes
-        connection->waitForReadyRead();
-        if (connection->bytesAvailable()) {
-            QDataStream in(connection);
-            Zeal::SearchQuery query;
-            in >> query;
-            m_mainWindow->bringToFront(query);
-        } else {
-            m_mainWindow->bringToFront();
-        }
-    });
-    /// TODO: Verify if removeServer() is needed
-    QLocalServer::removeServer(LocalServerName);  // remove in case previous instance crashed
-    m_localServer->listen(LocalServerName);
+    if (mode == Mode::Interactive)
+        m_mainWindow = new MainWindow(this);
+
+    // Serves queries of other processes, and detects already running instances
+    m_queryServer = new QueryServer(m_docsetRegistry, this);
+    if (m_mainWindow) {
+        connect(m_queryServer, &QueryServer::showRequested, m_mainWindow, &MainWindow::bringToFront);
+    } else {
+        m_queryServer->setShowSupported(false);
+    }
+    m_queryServer->listen(LocalServerName);
+
+    // Extractor setup, each thread works on one archive at a time
+    const int extractorCount = m_settings->extractionThreads > 0
+            ? m_settings->extractionThreads : qMax(1, QThread::idealThreadCount());
+    for (int i = 0; i < extractorCount; ++i) {
+        QThread *thread = new QThread(this);
+        Extractor *extractor = new Extractor();
+        extractor->moveToThread(thread);
+        thread->start();
+
+        connect(extractor, &Extractor::completed, this, [this](const QString &filePath) {
+            releaseExtractor(filePath);
+            emit extractionCompleted(filePath);
+        });
+        connect(extractor, &Extractor::error, this,
+                [this](const QString &filePath, const QString &errorString) {
+            releaseExtractor(filePath);
+            emit extractionError(filePath, errorString);
+        });
+        connect(extractor, &Extractor::dataRequested, this, &Application::feedStream);
+
+        m_extractorThreads.append(thread);
+        m_extractors.append(extractor);
+        m_extractorLoad.append(0);
+    }
+
+    // Progress is sampled, extractors would otherwise flood the event loop with updates
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setInterval(ProgressInterval);
+    connect(m_progressTimer, &QTimer::timeout, this, &Application::reportProgress);
 
-    // Extractor setup
-    m_extractor->moveToThread(m_extractorThread);
-    m_extractorThread->start();
-    connect(m_extractor, &Extractor::completed, this, &Application::extractionCompleted);
-    connect(m_extractor, &Extractor::error, this, &Application::extractionError);
-    connect(m_extractor, &Extractor::progress, this, &Application::extractionProgress);
+    // Deleted docsets are collected whenever the disk is otherwise idle
+    m_trashThread = new QThread(this);
+    m_trashCollector = new TrashCollector();
+    m_trashCollector->moveToThread(m_trashThread);
+    m_contentPool = new ContentPool();
+    m_contentPool->moveToThread(m_trashThread);
+    m_trashThread->start(QThread::IdlePriority);
 
     connect(m_settings, &Settings::updated, this, &Application::applySettings);
     applySettings();
 
-    if (!query.isEmpty())
+    // The main window loads docsets itself
+    if (!m_mainWindow) {
+        m_docsetRegistry->init(m_settings->docsetPath);
+        return;
+    }
+
+    // Minimized starts leave the web views to the first time the window is shown
+    if (!query.isEmpty() || !m_settings->startMinimized)
         m_mainWindow->bringToFront(query);
-    else if (!m_settings->startMinimized)
-        m_mainWindow->show();
 }
 
 Application::~Application()
 {
-    m_extractorThread->quit();
-    m_extractorThread->wait();
-    delete m_extractor;
+    // Unblock extractions still waiting for data
+    for (const StreamedDownload &download : m_streamedDownloads)
+        download.stream->close(tr("Download was interrupted"));
+
+    for (QThread *thread : m_extractorThreads) {
+        thread->quit();
+        thread->wait();
+    }
+    qDeleteAll(m_extractors);
+
+    // The rest of the trash is collected on the next start
+    m_trashThread->requestInterruption();
+    m_trashThread->quit();
+    m_trashThread->wait();
+    delete m_trashCollector;
+    delete m_contentPool;
+
+    // Waits for searches still running in the registry
+    delete m_queryServer;
+
     delete m_mainWindow;
     delete m_docsetRegistry;
+
+#ifdef USE_TRACING
+    const QString traceFileName = QString::fromLocal8Bit(qgetenv("ZEAL_TRACE_FILE"));
+    if (!traceFileName.isEmpty() && !Tracer::save(traceFileName))
+        qWarning("Cannot save trace: %s", qPrintable(traceFileName));
+#endif
 }
 
 QString Application::localServerName()
@@ -92,6 +163,15 @@ QString Application::localServerName()
     return LocalServerName;
 }
 
+QString Application::cacheLocation()
+{
+#ifndef PORTABLE_BUILD
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    return QCoreApplication::applicationDirPath() + QLatin1String("/cache");
+#endif
+}
+
 QNetworkAccessManager *Application::networkManager() const
 {
     return m_networkManager;
@@ -109,12 +189,128 @@ DocsetRegistry *Application::docsetRegistry()
 
 void Application::extract(const QString &filePath, const QString &destination, const QString &root)
 {
-    QMetaObject::invokeMethod(m_extractor, "extract", Qt::QueuedConnection,
+    QMetaObject::invokeMethod(acquireExtractor(filePath), "extract", Qt::QueuedConnection,
                               Q_ARG(QString, filePath), Q_ARG(QString, destination),
                               Q_ARG(QString, root));
 }
 
+void Application::extract(QNetworkReply *reply, const QString &destination, const QString &root)
+{
+    const QString source = reply->url().toString();
+
+    StreamedDownload download;
+    download.reply = reply;
+    download.stream = QSharedPointer<ArchiveStream>(new ArchiveStream());
+    m_streamedDownloads.insert(source, download);
+
+    // Without reading, the reply stops receiving once its buffer is full
+    reply->setReadBufferSize(ArchiveStream::Capacity);
+
+    connect(reply, &QNetworkReply::readyRead, this, [this, source]() {
+        feedStream(source);
+    });
+
+    connect(reply, &QNetworkReply::finished, this, [this, source]() {
+        const StreamedDownload download = m_streamedDownloads.take(source);
+        if (!download.reply)
+            return;
+
+        if (download.reply->error() != QNetworkReply::NoError) {
+            download.stream->close(download.reply->errorString());
+            return;
+        }
+
+        // The reply goes away, so the rest is buffered regardless of the capacity
+        download.stream->write(download.reply->readAll());
+        download.stream->close();
+    });
+
+    const qint64 totalBytes = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    QMetaObject::invokeMethod(acquireExtractor(source), "extractStream", Qt::QueuedConnection,
+                              Q_ARG(QSharedPointer<Zeal::Core::ArchiveStream>, download.stream),
+                              Q_ARG(QString, source), Q_ARG(qint64, totalBytes),
+                              Q_ARG(QString, destination), Q_ARG(QString, root));
+
+    feedStream(source);
+}
+
+Extractor *Application::acquireExtractor(const QString &source)
+{
+    // Streamed extractions occupy their thread until the download ends, so the least busy one wins
+    int index = 0;
+    for (int i = 1; i < m_extractorLoad.size(); ++i) {
+        if (m_extractorLoad.at(i) < m_extractorLoad.at(index))
+            index = i;
+    }
+
+    ++m_extractorLoad[index];
+    m_extractionJobs.insert(source, index);
+
+    if (!m_progressTimer->isActive())
+        m_progressTimer->start();
+
+    return m_extractors.at(index);
+}
+
+void Application::releaseExtractor(const QString &source)
+{
+    if (!m_extractionJobs.contains(source))
+        return;
+
+    --m_extractorLoad[m_extractionJobs.take(source)];
+}
+
+void Application::reportProgress()
+{
+    QHash<QString, qint64> reportedProgress;
+
+    for (const Extractor *extractor : m_extractors) {
+        const auto jobs = extractor->progress();
+        for (auto it = jobs.cbegin(); it != jobs.cend(); ++it) {
+            const qint64 value = it.value()->value();
+            if (m_reportedProgress.value(it.key(), -1) != value)
+                emit extractionProgress(it.key(), value, it.value()->total());
+            reportedProgress.insert(it.key(), value);
+        }
+    }
+
+    m_reportedProgress = reportedProgress;
+
+    if (m_extractionJobs.isEmpty())
+        m_progressTimer->stop();
+}
+
+void Application::feedStream(const QString &source)
+{
+    const StreamedDownload download = m_streamedDownloads.value(source);
+    if (!download.reply)
+        return;
+
+    while (download.reply->bytesAvailable() && download.stream->bufferedSize() < ArchiveStream::Capacity)
+        download.stream->write(download.reply->read(ArchiveStream::Capacity / 8));
+}
+
 QNetworkReply *Application::download(const QUrl &url)
+{
+    return m_networkManager->get(request(url));
+}
+
+QNetworkReply *Application::download(const QList<QUrl> &urls)
+{
+    const QList<QUrl> mirrors = sortMirrors(urls);
+
+    ResumableReply *reply = new ResumableReply(m_networkManager, request(mirrors.first()), mirrors,
+                                               m_networkManager);
+    connect(reply, &ResumableReply::throughputMeasured, this, &Application::recordThroughput);
+    return reply;
+}
+
+QNetworkReply *Application::requestHeaders(const QUrl &url)
+{
+    return m_networkManager->head(request(url));
+}
+
+QNetworkRequest Application::request(const QUrl &url)
 {
     const static QString userAgent = QString("Zeal/%1 (%2 %3; Qt/%4)")
             .arg(QCoreApplication::applicationVersion())
@@ -149,11 +345,86 @@ QNetworkReply *Application::download(const QUrl &url)
 
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::UserAgentHeader, userAgent);
-    return m_networkManager->get(request);
+    return request;
+}
+
+QList<QUrl> Application::sortMirrors(const QList<QUrl> &urls) const
+{
+    // Mirrors without measurements come first in random order, so that each gets tried
+    QList<QUrl> unmeasured;
+    QList<QUrl> measured;
+    for (const QUrl &url : urls) {
+        if (m_mirrorThroughput.contains(url.host()))
+            measured.append(url);
+        else
+            unmeasured.insert(qrand() % (unmeasured.size() + 1), url);
+    }
+
+    std::stable_sort(measured.begin(), measured.end(), [this](const QUrl &a, const QUrl &b) {
+        return m_mirrorThroughput.value(a.host()) > m_mirrorThroughput.value(b.host());
+    });
+
+    return unmeasured + measured;
+}
+
+void Application::recordThroughput(const QUrl &url, qint64 bytesPerSecond)
+{
+    // Moving average, single slow transfers should not rule out a mirror
+    const QString host = url.host();
+    if (m_mirrorThroughput.contains(host))
+        m_mirrorThroughput[host] = (m_mirrorThroughput.value(host) + bytesPerSecond) / 2;
+    else
+        m_mirrorThroughput.insert(host, bytesPerSecond);
+}
+
+bool Application::removeDirectory(const QString &path)
+{
+    const QString trashPath = TrashCollector::moveToTrash(path);
+    if (trashPath.isEmpty())
+        return false;
+
+    QMetaObject::invokeMethod(m_trashCollector, "collect", Qt::QueuedConnection,
+                              Q_ARG(QString, trashPath));
+    return true;
+}
+
+void Application::applySharedStore()
+{
+    SharedStore::setPaths(m_settings->sharedStore ? m_settings->docsetPath : QString(),
+                          cacheLocation() + QLatin1String("/docsets"));
 }
 
 void Application::applySettings()
 {
+    m_docsetRegistry->setResultLimit(m_settings->searchResultLimit);
+    m_docsetRegistry->setIdleTimeout(m_settings->docsetIdleTimeout);
+    m_docsetRegistry->setMaxOpenDocsets(m_settings->maxOpenDocsets);
+    m_docsetRegistry->setWarmDocsetCount(m_settings->warmDocsetCount);
+    // QCache counts its cost in int, which limits the cache to under 2 GiB
+    Docset::setSymbolCacheSize(qBound(0, m_settings->symbolCacheSize, 2047) * 1024 * 1024);
+    Docset::setFullTextIndexEnabled(m_settings->fullTextIndex);
+    Docset::setBuildMissingIndexes(m_settings->buildMissingIndexes);
+    applySharedStore();
+
+    // Docsets shared by other machines are never written to
+    const bool deduplicateFiles = m_settings->deduplicateFiles && !m_settings->sharedStore;
+    for (Extractor *extractor : m_extractors) {
+        extractor->setPackDocuments(m_settings->packDocuments);
+        extractor->setDeduplicateFiles(deduplicateFiles);
+    }
+
+    // Resumes deletions interrupted by a crash or exit
+    QMetaObject::invokeMethod(m_trashCollector, "collect", Qt::QueuedConnection,
+                              Q_ARG(QString, QDir(m_settings->docsetPath)
+                                    .absoluteFilePath(QLatin1String(TrashCollector::DirName))));
+
+    // Docsets installed before are linked to the pool once per session, after the trash is gone
+    if (deduplicateFiles && m_deduplicatedPath != m_settings->docsetPath) {
+        m_deduplicatedPath = m_settings->docsetPath;
+        QMetaObject::invokeMethod(m_contentPool, "deduplicate", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_settings->docsetPath));
+    }
+
     // HTTP Proxy Settings
     switch (m_settings->proxyType) {
     case Core::Settings::ProxyType::None:
@@ -1,15 +1,21 @@
 #ifndef APPLICATION_H
 #define APPLICATION_H
 
+#include <QHash>
+#include <QList>
 #include <QObject>
-
-class QLocalServer;
+#include <QPointer>
+#include <QSharedPointer>
+#include <QVector>
 
 class MainWindow;
 
 class QNetworkAccessManager;
 class QNetworkReply;
+class QNetworkRequest;
 class QThread;
+class QTimer;
+class QUrl;
 
 namespace Zeal {
 
@@ -18,18 +24,30 @@ class SearchQuery;
 
 namespace Core {
 
+class ArchiveStream;
 class Extractor;
+class QueryServer;
 class Settings;
+class ContentPool;
+class TrashCollector;
 
 class Application : public QObject
 {
     Q_OBJECT
 public:
+    enum class Mode {
+        Interactive,
+        Headless // Only serves queries, without any windows
+    };
+
     explicit Application(QObject *parent = nullptr);
-    explicit Application(const SearchQuery &query, QObject *parent = nullptr);
+    explicit Application(const SearchQuery &query, Mode mode = Mode::Interactive,
+                         QObject *parent = nullptr);
     ~Application() override;
 
     static QString localServerName();
+    /// Returns the directory for data that can be fetched again, like HTTP responses
+    static QString cacheLocation();
 
     QNetworkAccessManager *networkManager() const;
     Settings *settings() const;
@@ -38,7 +56,19 @@ public:
 
 public slots:
     void extract(const QString &filePath, const QString &destination, const QString &root = QString());
+    /// Extracts the archive received by \a reply while it is being downloaded. Signals
+    /// refer to the archive by the URL of \a reply.
+    void extract(QNetworkReply *reply, const QString &destination, const QString &root = QString());
+    /// Downloads \a url through the HTTP cache, which suits small files like feeds
     QNetworkReply *download(const QUrl &url);
+    /// Downloads from the fastest of the mirrors in \a urls, the others serve as fallbacks.
+    /// Interrupted transfers are resumed, and nothing is cached.
+    QNetworkReply *download(const QList<QUrl> &urls);
+    /// Requests only the headers of \a url, e.g. to learn the size of a download
+    QNetworkReply *requestHeaders(const QUrl &url);
+    /// Deletes the directory \a path in the background. Returns false if it cannot be moved
+    /// out of the way, \a path is gone from its parent directory otherwise.
+    bool removeDirectory(const QString &path);
 
 signals:
     void extractionCompleted(const QString &filePath);
@@ -47,17 +77,42 @@ signals:
 
 private slots:
     void applySettings();
+    void feedStream(const QString &source);
+    void recordThroughput(const QUrl &url, qint64 bytesPerSecond);
+    void reportProgress();
 
 private:
+    void applySharedStore();
+    static QNetworkRequest request(const QUrl &url);
+    QList<QUrl> sortMirrors(const QList<QUrl> &urls) const;
+
+    Extractor *acquireExtractor(const QString &source);
+    void releaseExtractor(const QString &source);
+
+    struct StreamedDownload {
+        QPointer<QNetworkReply> reply;
+        QSharedPointer<ArchiveStream> stream;
+    };
+
     static Application *m_instance;
 
     Settings *m_settings = nullptr;
 
-    QLocalServer *m_localServer = nullptr;
+    QueryServer *m_queryServer = nullptr;
     QNetworkAccessManager *m_networkManager = nullptr;
 
-    QThread *m_extractorThread = nullptr;
-    Extractor *m_extractor = nullptr;
+    QList<QThread *> m_extractorThreads;
+    QList<Extractor *> m_extractors;
+    QVector<int> m_extractorLoad; // Jobs queued per extractor
+    QHash<QString, int> m_extractionJobs; // Extractor index by archive
+    QTimer *m_progressTimer = nullptr;
+    QThread *m_trashThread = nullptr;
+    TrashCollector *m_trashCollector = nullptr;
+    ContentPool *m_contentPool = nullptr;
+    QString m_deduplicatedPath;
+    QHash<QString, qint64> m_reportedProgress;
+    QHash<QString, StreamedDownload> m_streamedDownloads;
+    QHash<QString, qint64> m_mirrorThroughput; // Bytes per second by host
 
     DocsetRegistry *m_docsetRegistry = nullptr;
 
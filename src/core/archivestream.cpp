@@ -0,0 +1,66 @@
+#include "archivestream.h"
+
+using namespace Zeal::Core;
+
+void ArchiveStream::write(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_isClosed)
+        return;
+
+    m_chunks.enqueue(data);
+    m_bufferedSize += data.size();
+    if (m_bufferedSize >= Capacity)
+        m_isFull = true;
+
+    m_dataAvailable.wakeOne();
+}
+
+void ArchiveStream::close(const QString &errorString)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_isClosed)
+        return;
+
+    m_isClosed = true;
+    m_errorString = errorString;
+    m_dataAvailable.wakeOne();
+}
+
+QByteArray ArchiveStream::read(bool *wakeWriter)
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_chunks.isEmpty() && !m_isClosed)
+        m_dataAvailable.wait(&m_mutex);
+
+    *wakeWriter = false;
+
+    // Incomplete data is not handed out, so that the reader fails instead of extracting garbage
+    if (m_chunks.isEmpty() || !m_errorString.isEmpty())
+        return QByteArray();
+
+    const QByteArray data = m_chunks.dequeue();
+    m_bufferedSize -= data.size();
+
+    if (m_isFull && m_bufferedSize < Capacity / 2) {
+        m_isFull = false;
+        *wakeWriter = true;
+    }
+
+    return data;
+}
+
+QString ArchiveStream::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_errorString;
+}
+
+int ArchiveStream::bufferedSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bufferedSize;
+}
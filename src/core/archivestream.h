@@ -0,0 +1,53 @@
+#ifndef ARCHIVESTREAM_H
+#define ARCHIVESTREAM_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QMutex>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QString>
+#include <QWaitCondition>
+
+namespace Zeal {
+namespace Core {
+
+/**
+ * @short Archive data passed from a download to the extractor thread.
+ *
+ * The writer stops once Capacity bytes are buffered, and continues after the reader has
+ * consumed half of them, which keeps memory use bounded when extraction is the slower part.
+ */
+class ArchiveStream
+{
+public:
+    static const int Capacity = 8 * 1024 * 1024;
+
+    /// Appends \a data, which may exceed Capacity
+    void write(const QByteArray &data);
+    /// Ends the stream, a non-empty \a errorString means the data is incomplete
+    void close(const QString &errorString = QString());
+
+    /// Blocks until data is available, returns an empty array at the end of the stream.
+    /// Sets \a wakeWriter to whether the writer has stopped and should continue now.
+    QByteArray read(bool *wakeWriter);
+    QString errorString() const;
+
+    int bufferedSize() const;
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_dataAvailable;
+    QQueue<QByteArray> m_chunks;
+    int m_bufferedSize = 0;
+    bool m_isFull = false;
+    bool m_isClosed = false;
+    QString m_errorString;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+Q_DECLARE_METATYPE(QSharedPointer<Zeal::Core::ArchiveStream>)
+
+#endif // ARCHIVESTREAM_H
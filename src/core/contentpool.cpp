@@ -0,0 +1,223 @@
+#include "contentpool.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QThread>
+
+#ifdef Q_OS_WIN32
+#include <qt_windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Zeal::Core;
+
+const char ContentPool::DirName[] = ".pool";
+const qint64 ContentPool::MinFileSize = 1024;
+const qint64 ContentPool::MaxFileSize = 1024 * 1024;
+
+namespace {
+const char DocumentsPrefix[] = "Contents/Resources/Documents/";
+const char LinkSuffix[] = ".pooled";
+
+// Files hashed between pauses, so that the pass does not saturate the disk
+const int BatchSize = 200;
+const int BatchPause = 20; // ms
+
+QString poolFilePath(const QString &docsetsPath, const QByteArray &data)
+{
+    const QString hash = QString::fromLatin1(
+                QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+    return QDir(docsetsPath).absoluteFilePath(QStringLiteral("%1/%2/%3")
+                                              .arg(QLatin1String(ContentPool::DirName),
+                                                   hash.left(2), hash.mid(2)));
+}
+
+bool createLink(const QString &target, const QString &linkPath)
+{
+#ifdef Q_OS_WIN32
+    const QString nativeTarget = QDir::toNativeSeparators(target);
+    const QString nativeLinkPath = QDir::toNativeSeparators(linkPath);
+    return CreateHardLinkW(reinterpret_cast<const wchar_t *>(nativeLinkPath.utf16()),
+                           reinterpret_cast<const wchar_t *>(nativeTarget.utf16()), nullptr);
+#else
+    return ::link(QFile::encodeName(target).constData(), QFile::encodeName(linkPath).constData()) == 0;
+#endif
+}
+
+// Returns the number of names of the file at \a path, or 0 if it cannot be determined
+int linkCount(const QString &path)
+{
+#ifdef Q_OS_WIN32
+    const QString nativePath = QDir::toNativeSeparators(path);
+    HANDLE handle = CreateFileW(reinterpret_cast<const wchar_t *>(nativePath.utf16()), 0,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                OPEN_EXISTING, 0, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return 0;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    const bool ok = GetFileInformationByHandle(handle, &info);
+    CloseHandle(handle);
+    return ok ? static_cast<int>(info.nNumberOfLinks) : 0;
+#else
+    struct stat info;
+    if (::stat(QFile::encodeName(path).constData(), &info) != 0)
+        return 0;
+    return static_cast<int>(info.st_nlink);
+#endif
+}
+
+// Puts \a data into the pool at \a poolPath, unless it is there already
+bool addToPool(const QString &poolPath, const QByteArray &data)
+{
+    const QFileInfo fileInfo(poolPath);
+    if (fileInfo.exists() && fileInfo.size() == data.size())
+        return true;
+
+    // Concurrent writers of the same content each commit a complete file
+    QDir().mkpath(fileInfo.absolutePath());
+    QSaveFile file(poolPath);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size() && file.commit();
+}
+
+// Replaces \a filePath with a link to \a poolPath, the old file is never written to
+bool replaceWithLink(const QString &poolPath, const QString &filePath)
+{
+    const QString linkPath = filePath + QLatin1String(LinkSuffix);
+    QFile::remove(linkPath);
+    if (!createLink(poolPath, linkPath))
+        return false;
+
+    // QFile::rename() does not overwrite
+    QFile::remove(filePath);
+    if (!QFile::rename(linkPath, filePath)) {
+        QFile::remove(linkPath);
+        return false;
+    }
+
+    return true;
+}
+
+bool pauseBatch(int *count)
+{
+    if (QThread::currentThread()->isInterruptionRequested())
+        return false;
+
+    if (++*count % BatchSize == 0)
+        QThread::msleep(BatchPause);
+    return true;
+}
+}
+
+ContentPool::ContentPool(QObject *parent) :
+    QObject(parent)
+{
+}
+
+bool ContentPool::isSupported(const QString &docsetsPath)
+{
+    QDir dir(docsetsPath);
+    if (!dir.mkpath(QLatin1String(DirName)) || !dir.cd(QLatin1String(DirName)))
+        return false;
+
+    // FAT and some network file systems have no hard links
+    const QString probePath = dir.absoluteFilePath(QStringLiteral("probe"));
+    const QString linkPath = probePath + QLatin1String(LinkSuffix);
+    QFile probe(probePath);
+    if (!probe.open(QIODevice::WriteOnly))
+        return false;
+    probe.close();
+
+    QFile::remove(linkPath);
+    const bool isSupported = createLink(probePath, linkPath);
+    QFile::remove(linkPath);
+    probe.remove();
+    return isSupported;
+}
+
+bool ContentPool::exists(const QString &docsetsPath)
+{
+    return QFileInfo(QDir(docsetsPath).absoluteFilePath(QLatin1String(DirName))).isDir();
+}
+
+bool ContentPool::isPoolable(const QString &relativePath, qint64 size)
+{
+    return size >= MinFileSize && size <= MaxFileSize
+            && relativePath.startsWith(QLatin1String(DocumentsPrefix));
+}
+
+bool ContentPool::write(const QString &docsetsPath, const QString &filePath, const QByteArray &data,
+                        QString *errorString)
+{
+    const QString poolPath = poolFilePath(docsetsPath, data);
+    if (addToPool(poolPath, data) && replaceWithLink(poolPath, filePath))
+        return true;
+
+    // The file may be a link from before, which must not be written through
+    QFile::remove(filePath);
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Unbuffered) || file.write(data) != data.size()) {
+        *errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+void ContentPool::deduplicate(const QString &docsetsPath)
+{
+    if (!isSupported(docsetsPath))
+        return;
+
+    const QString documentsPath = QStringLiteral(".docset/") + QLatin1String(DocumentsPrefix);
+    int count = 0;
+
+    // Only documents of docsets match below, neither the pool nor the trash does
+    QDirIterator it(docsetsPath, QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString filePath = it.next();
+        if (!pauseBatch(&count))
+            return;
+
+        const QFileInfo fileInfo = it.fileInfo();
+        if (fileInfo.isSymLink() || fileInfo.size() < MinFileSize || fileInfo.size() > MaxFileSize
+                || !filePath.contains(documentsPath)) {
+            continue;
+        }
+
+        // Files with more names are pooled already, anything else is not touched
+        if (linkCount(filePath) != 1)
+            continue;
+
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+        const QByteArray data = file.readAll();
+        file.close();
+        if (data.size() != fileInfo.size())
+            continue;
+
+        // Unique files get pooled too, for later docsets to share
+        const QString poolPath = poolFilePath(docsetsPath, data);
+        if (addToPool(poolPath, data))
+            replaceWithLink(poolPath, filePath);
+    }
+
+    // Files only the pool refers to belonged to removed docsets
+    QDirIterator poolIt(QDir(docsetsPath).absoluteFilePath(QLatin1String(DirName)),
+                        QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (poolIt.hasNext()) {
+        const QString poolPath = poolIt.next();
+        if (!pauseBatch(&count))
+            return;
+
+        if (linkCount(poolPath) == 1)
+            QFile::remove(poolPath);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef CONTENTPOOL_H
+#define CONTENTPOOL_H
+
+#include <QByteArray>
+#include <QObject>
+
+namespace Zeal {
+namespace Core {
+
+/**
+ * @short Shares identical documents of docsets through hard links.
+ *
+ * Assets like jQuery, highlight.js, fonts and style sheets come with many docsets, and with
+ * every version of them. The pool keeps a single copy of each file under its SHA-1, and
+ * docsets get hard links to it, so the data is stored once. A pooled file has one name in the
+ * pool and one in every docset using it, files only left in the pool get removed.
+ *
+ * Only documents up to MaxFileSize are pooled, which are written whole. Writers must replace
+ * them instead of writing into them, which would change every docset sharing the file.
+ */
+class ContentPool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ContentPool(QObject *parent = nullptr);
+
+    /// Name of the pool directory next to the docsets, hidden so that it is not scanned for docsets
+    static const char DirName[];
+    /// Smaller files are not worth a link, larger ones are not buffered by the extractor
+    static const qint64 MinFileSize;
+    static const qint64 MaxFileSize;
+
+    /// Returns true if files of docsets in \a docsetsPath can be linked to the pool
+    static bool isSupported(const QString &docsetsPath);
+    /// Returns true if a pool has been set up in \a docsetsPath, so docsets may have linked files
+    static bool exists(const QString &docsetsPath);
+    /// Returns true if the file of a docset at \a relativePath with \a size gets pooled
+    static bool isPoolable(const QString &relativePath, qint64 size);
+
+    /// Writes \a data to \a filePath of a docset in \a docsetsPath as a link to the pooled copy,
+    /// or as a file of its own if linking fails. Returns false if neither works.
+    static bool write(const QString &docsetsPath, const QString &filePath, const QByteArray &data,
+                      QString *errorString);
+
+public slots:
+    /// Links duplicate documents of the docsets in \a docsetsPath to the pool, and removes
+    /// pooled files that no docset uses anymore
+    void deduplicate(const QString &docsetsPath);
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // CONTENTPOOL_H
@@ -1,15 +1,226 @@
 #include "extractor.h"
 
+#include "contentpool.h"
+#include "tracer.h"
+#include "registry/documentarchive.h"
+
 #include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <cerrno>
+
 using namespace Zeal::Core;
 
+namespace {
+// Larger entries are extracted by libarchive itself
+const qint64 MaxBufferedEntrySize = 1024 * 1024;
+// Data read ahead of the writers
+const qint64 MaxPendingWriteSize = 32 * 1024 * 1024;
+const int MaxWriterThreadCount = 4;
+
+class WriteQueue
+{
+public:
+    // Blocks while the writers are too far behind
+    void acquire(qint64 size)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_pendingSize > 0 && m_pendingSize + size > MaxPendingWriteSize)
+            m_released.wait(&m_mutex);
+        m_pendingSize += size;
+    }
+
+    void release(qint64 size)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_pendingSize -= size;
+        m_released.wakeOne();
+    }
+
+    void fail(const QString &errorString)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_errorString.isEmpty())
+            m_errorString = errorString;
+    }
+
+    bool hasFailed() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return !m_errorString.isEmpty();
+    }
+
+    QString errorString() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_errorString;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_released;
+    qint64 m_pendingSize = 0;
+    QString m_errorString;
+};
+
+class WriteJob : public QRunnable
+{
+public:
+    // Files of docsets with linked documents are replaced, and pooled if \a poolPath is set
+    WriteJob(WriteQueue *queue, const QString &filePath, const QByteArray &data,
+             bool replace = false, const QString &poolPath = QString()) :
+        m_queue(queue),
+        m_filePath(filePath),
+        m_poolPath(poolPath),
+        m_data(data),
+        m_replace(replace)
+    {
+    }
+
+    // Adds the file to an archive instead, with \a path relative to the archive
+    WriteJob(WriteQueue *queue, DocumentArchiveWriter *archive, const QString &path,
+             const QByteArray &data) :
+        m_queue(queue),
+        m_archive(archive),
+        m_filePath(path),
+        m_data(data)
+    {
+    }
+
+    void run() override
+    {
+        if (m_archive) {
+            if (!m_archive->add(m_filePath, m_data))
+                m_queue->fail(m_archive->errorString());
+            m_queue->release(m_data.size());
+            return;
+        }
+
+        if (!m_poolPath.isEmpty()) {
+            QString errorString;
+            if (!ContentPool::write(m_poolPath, m_filePath, m_data, &errorString))
+                m_queue->fail(QStringLiteral("%1: %2").arg(m_filePath, errorString));
+            m_queue->release(m_data.size());
+            return;
+        }
+
+        // Truncating a linked file would change it in other docsets as well
+        if (m_replace)
+            QFile::remove(m_filePath);
+
+        // No timestamps or permissions are restored, which saves a few syscalls per file
+        QFile file(m_filePath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)
+                || file.write(m_data) != m_data.size()) {
+            m_queue->fail(QStringLiteral("%1: %2").arg(m_filePath, file.errorString()));
+        }
+
+        m_queue->release(m_data.size());
+    }
+
+private:
+    WriteQueue *m_queue;
+    DocumentArchiveWriter *m_archive = nullptr;
+    QString m_filePath;
+    QString m_poolPath;
+    QByteArray m_data;
+    bool m_replace = false;
+};
+
+// Reads the data of the current entry, \a size is -1 if unknown
+int readEntryData(archive *handle, qint64 size, QByteArray *data)
+{
+    if (size < 0) {
+        const int chunkSize = 64 * 1024;
+        QByteArray chunk(chunkSize, Qt::Uninitialized);
+        forever {
+            const la_ssize_t count = archive_read_data(handle, chunk.data(), chunkSize);
+            if (count < 0)
+                return count == ARCHIVE_FATAL ? ARCHIVE_FATAL : ARCHIVE_WARN;
+            if (count == 0)
+                return ARCHIVE_OK;
+            data->append(chunk.constData(), static_cast<int>(count));
+        }
+    }
+
+    data->resize(static_cast<int>(size));
+
+    qint64 offset = 0;
+    while (offset < size) {
+        const la_ssize_t count = archive_read_data(handle, data->data() + offset, size - offset);
+        if (count < 0)
+            return count == ARCHIVE_FATAL ? ARCHIVE_FATAL : ARCHIVE_WARN;
+        if (count == 0)
+            break;
+        offset += count;
+    }
+
+    data->resize(static_cast<int>(offset));
+    return ARCHIVE_OK;
+}
+
+struct StreamReader
+{
+    Extractor *extractor;
+    QSharedPointer<ArchiveStream> stream;
+    QString source;
+    QByteArray chunk; // Has to stay valid until the next read
+};
+
+la_ssize_t readStream(archive *handle, void *ptr, const void **buffer)
+{
+    StreamReader *reader = reinterpret_cast<StreamReader *>(ptr);
+
+    bool wakeWriter;
+    reader->chunk = reader->stream->read(&wakeWriter);
+    if (wakeWriter)
+        emit reader->extractor->dataRequested(reader->source);
+
+    const QString errorString = reader->stream->errorString();
+    if (reader->chunk.isEmpty() && !errorString.isEmpty()) {
+        archive_set_error(handle, EIO, "%s", qPrintable(errorString));
+        return ARCHIVE_FATAL;
+    }
+
+    *buffer = reader->chunk.constData();
+    return reader->chunk.size();
+}
+}
+
 Extractor::Extractor(QObject *parent) :
     QObject(parent)
 {
+    qRegisterMetaType<QSharedPointer<ArchiveStream>>();
+}
+
+QHash<QString, QSharedPointer<const JobProgress>> Extractor::progress() const
+{
+    QHash<QString, QSharedPointer<const JobProgress>> jobs;
+
+    QMutexLocker locker(&m_jobsMutex);
+    for (auto it = m_jobs.cbegin(); it != m_jobs.cend(); ++it)
+        jobs.insert(it.key(), it.value());
+
+    return jobs;
+}
+
+void Extractor::setPackDocuments(bool enabled)
+{
+    m_packDocuments.store(enabled);
+}
+
+void Extractor::setDeduplicateFiles(bool enabled)
+{
+    m_deduplicateFiles.store(enabled);
 }
 
 void Extractor::extract(const QString &filePath, const QString &destination, const QString &root)
@@ -19,7 +230,7 @@ void Extractor::extract(const QString &filePath, const QString &destination, con
         .archiveHandle = archive_read_new(),
         .filePath = filePath,
         .totalBytes = QFileInfo(filePath).size(),
-        .extractedBytes = 0
+        .progress = QSharedPointer<JobProgress>()
     };
 
     archive_read_support_filter_all(info.archiveHandle);
@@ -28,9 +239,47 @@ void Extractor::extract(const QString &filePath, const QString &destination, con
     int r = archive_read_open_filename(info.archiveHandle, qPrintable(filePath), 10240);
     if (r) {
         emit error(filePath, QString::fromLocal8Bit(archive_error_string(info.archiveHandle)));
+        archive_read_free(info.archiveHandle);
+        return;
+    }
+
+    extractEntries(info, destination, root);
+}
+
+void Extractor::extractStream(const QSharedPointer<ArchiveStream> &stream, const QString &source,
+                              qint64 totalBytes, const QString &destination, const QString &root)
+{
+    ExtractInfo info = {
+        .extractor = this,
+        .archiveHandle = archive_read_new(),
+        .filePath = source,
+        .totalBytes = totalBytes,
+        .progress = QSharedPointer<JobProgress>()
+    };
+
+    archive_read_support_filter_all(info.archiveHandle);
+    archive_read_support_format_all(info.archiveHandle);
+
+    StreamReader reader = {this, stream, source, QByteArray()};
+    int r = archive_read_open(info.archiveHandle, &reader, nullptr, &readStream, nullptr);
+    if (r) {
+        emit error(source, QString::fromLocal8Bit(archive_error_string(info.archiveHandle)));
+        archive_read_free(info.archiveHandle);
         return;
     }
 
+    extractEntries(info, destination, root);
+}
+
+void Extractor::extractEntries(ExtractInfo &info, const QString &destination, const QString &root)
+{
+    ZEAL_TRACE_SCOPE("extraction", QFileInfo(info.filePath).fileName());
+    info.progress = QSharedPointer<JobProgress>(new JobProgress(info.totalBytes));
+    {
+        QMutexLocker locker(&m_jobsMutex);
+        m_jobs.insert(info.filePath, info.progress);
+    }
+
     archive_read_extract_set_progress_callback(info.archiveHandle, &Extractor::progressCallback,
                                                &info);
 
@@ -38,17 +287,108 @@ void Extractor::extract(const QString &filePath, const QString &destination, con
     if (!root.isEmpty())
         destinationDir = destinationDir.absoluteFilePath(root);
 
+    // Small files are read here and written by the pool, to spread the per-file overhead
+    WriteQueue queue;
+    QThreadPool writers;
+    writers.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), MaxWriterThreadCount));
+
+    QSet<QString> createdDirs;
+    auto createDir = [&createdDirs](const QString &path) {
+        if (createdDirs.contains(path))
+            return;
+        QDir().mkpath(path);
+        createdDirs.insert(path);
+    };
+
+    // Documents can go into a single archive, which is served by NetworkAccessManager
+    const QString documentsPrefix = QStringLiteral("Contents/Resources/Documents/");
+    QScopedPointer<DocumentArchiveWriter> documentArchive;
+    if (!root.isEmpty() && m_packDocuments.load()) {
+        const QString resourcesPath = destinationDir.absoluteFilePath(QStringLiteral("Contents/Resources"));
+        createDir(resourcesPath);
+        documentArchive.reset(new DocumentArchiveWriter(
+                                  resourcesPath + QLatin1Char('/') + QLatin1String(DocumentArchive::FileName)));
+    }
+
+    // Documents shared with other docsets are written as links to a ContentPool
+    QString poolPath;
+    if (!root.isEmpty() && !documentArchive && m_deduplicateFiles.load()
+            && ContentPool::isSupported(destination)) {
+        poolPath = destination;
+    }
+    const bool hasLinkedFiles = !root.isEmpty() && ContentPool::exists(destination);
+    const int extractFlags = hasLinkedFiles ? ARCHIVE_EXTRACT_UNLINK : 0;
+
     // TODO: Do not strip root directory in archive if it equals to 'root'
     archive_entry *entry;
-    while (archive_read_next_header(info.archiveHandle, &entry) == ARCHIVE_OK) {
+    int r;
+    while ((r = archive_read_next_header(info.archiveHandle, &entry)) == ARCHIVE_OK) {
         QString pathname = archive_entry_pathname(entry);
         if (!root.isEmpty())
             pathname.remove(0, pathname.indexOf(QLatin1String("/")) + 1);
-        archive_entry_set_pathname(entry, qPrintable(destinationDir.absoluteFilePath(pathname)));
-        archive_read_extract(info.archiveHandle, entry, 0);
+        const QString filePath = destinationDir.absoluteFilePath(pathname);
+
+        const bool isDocument = documentArchive && pathname.startsWith(documentsPrefix);
+        const qint64 size = archive_entry_size_is_set(entry) ? archive_entry_size(entry) : -1;
+
+        const auto fileType = archive_entry_filetype(entry);
+        if (fileType == AE_IFDIR) {
+            if (!isDocument)
+                createDir(filePath);
+        } else if (fileType == AE_IFREG
+                   && (isDocument || (size >= 0 && size <= MaxBufferedEntrySize))) {
+            QByteArray data;
+            r = readEntryData(info.archiveHandle, size, &data);
+            if (r == ARCHIVE_FATAL)
+                break;
+            if (r != ARCHIVE_OK)
+                continue;
+
+            queue.acquire(data.size());
+            if (isDocument) {
+                writers.start(new WriteJob(&queue, documentArchive.data(),
+                                           pathname.mid(documentsPrefix.size()), data));
+            } else {
+                createDir(QFileInfo(filePath).absolutePath());
+                const bool isPooled = !poolPath.isEmpty()
+                        && ContentPool::isPoolable(pathname, data.size());
+                writers.start(new WriteJob(&queue, filePath, data, hasLinkedFiles,
+                                           isPooled ? poolPath : QString()));
+            }
+        } else {
+            // Links may refer to files still being written
+            writers.waitForDone();
+            archive_entry_set_pathname(entry, qPrintable(filePath));
+            r = archive_read_extract(info.archiveHandle, entry, extractFlags);
+            if (r == ARCHIVE_FATAL)
+                break;
+        }
+
+        if (queue.hasFailed())
+            break;
+
+        progressCallback(&info);
+    }
+
+    writers.waitForDone();
+
+    // An incomplete archive is removed along with the writer
+    if (documentArchive && r != ARCHIVE_FATAL && !queue.hasFailed() && !documentArchive->commit())
+        queue.fail(documentArchive->errorString());
+
+    {
+        QMutexLocker locker(&m_jobsMutex);
+        m_jobs.remove(info.filePath);
     }
 
-    emit completed(filePath);
+    // Streamed archives end early when their download fails
+    if (r == ARCHIVE_FATAL)
+        emit error(info.filePath, QString::fromLocal8Bit(archive_error_string(info.archiveHandle)));
+    else if (queue.hasFailed())
+        emit error(info.filePath, queue.errorString());
+    else
+        emit completed(info.filePath);
+
     archive_read_free(info.archiveHandle);
 }
 
@@ -56,12 +396,6 @@ void Extractor::progressCallback(void *ptr)
 {
     ExtractInfo *info = reinterpret_cast<ExtractInfo *>(ptr);
 
-    const qint64 extractedBytes = archive_filter_bytes(info->archiveHandle, -1);
-    if (extractedBytes == info->extractedBytes)
-        return;
-
-    info->extractedBytes = extractedBytes;
-
-    emit info->extractor->progress(info->filePath, extractedBytes, info->totalBytes);
+    // Only published here, the UI samples it with progress()
+    info->progress->setValue(archive_filter_bytes(info->archiveHandle, -1));
 }
-
@@ -1,7 +1,14 @@
 #ifndef EXTRACTOR_H
 #define EXTRACTOR_H
 
+#include "archivestream.h"
+#include "jobprogress.h"
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
 #include <QObject>
+#include <QSharedPointer>
 
 struct archive;
 
@@ -14,13 +21,28 @@ class Extractor : public QObject
 public:
     explicit Extractor(QObject *parent = nullptr);
 
+    /// Sets whether documents of docsets get packed into a DocumentArchive, may be called from
+    /// any thread.
+    void setPackDocuments(bool enabled);
+    /// Sets whether documents of docsets get shared with identical ones of other docsets through
+    /// a ContentPool, may be called from any thread.
+    void setDeduplicateFiles(bool enabled);
+
+    /// Returns the progress of running extractions by archive, may be called from any thread
+    QHash<QString, QSharedPointer<const JobProgress>> progress() const;
+
 public slots:
     void extract(const QString &filePath, const QString &destination, const QString &root = QString());
+    /// Extracts the archive read from \a stream while it is being written, \a source stands for
+    /// the archive in signals, and \a totalBytes is its expected size.
+    void extractStream(const QSharedPointer<Zeal::Core::ArchiveStream> &stream, const QString &source,
+                       qint64 totalBytes, const QString &destination, const QString &root = QString());
 
 signals:
     void error(const QString &filePath, const QString &message);
     void completed(const QString &filePath);
-    void progress(const QString &filePath, qint64 extracted, qint64 total);
+    /// Emitted when the stream of \a source has room for more data
+    void dataRequested(const QString &source);
 
 private:
     struct ExtractInfo {
@@ -28,10 +50,18 @@ private:
         archive *archiveHandle;
         QString filePath;
         qint64 totalBytes;
-        qint64 extractedBytes;
+        QSharedPointer<JobProgress> progress;
     };
 
+    void extractEntries(ExtractInfo &info, const QString &destination, const QString &root);
+
     static void progressCallback(void *ptr);
+
+    QAtomicInt m_packDocuments;
+    QAtomicInt m_deduplicateFiles;
+
+    mutable QMutex m_jobsMutex;
+    QHash<QString, QSharedPointer<JobProgress>> m_jobs;
 };
 
 } // namespace Core
@@ -0,0 +1,41 @@
+#ifndef JOBPROGRESS_H
+#define JOBPROGRESS_H
+
+#include <QtGlobal>
+
+#include <atomic>
+
+namespace Zeal {
+namespace Core {
+
+/**
+ * @short Progress of a long running job.
+ *
+ * The job updates it from its own thread without locking, and the UI samples it at its
+ * own pace, so that frequent updates do not turn into a flood of events.
+ */
+class JobProgress
+{
+public:
+    explicit JobProgress(qint64 total = -1) :
+        m_total(total)
+    {
+    }
+
+    qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+    void setValue(qint64 value) { m_value.store(value, std::memory_order_relaxed); }
+
+    /// Returns the expected final value, or -1 if unknown
+    qint64 total() const { return m_total.load(std::memory_order_relaxed); }
+    void setTotal(qint64 total) { m_total.store(total, std::memory_order_relaxed); }
+
+private:
+    /// TODO: [Qt 5.3] Use QAtomicInteger<qint64>
+    std::atomic<qint64> m_value{0};
+    std::atomic<qint64> m_total;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // JOBPROGRESS_H
@@ -0,0 +1,245 @@
+#include "queryserver.h"
+
+#include "registry/docsetregistry.h"
+#include "registry/searchquery.h"
+
+#include <QDataStream>
+#include <QFutureWatcher>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QtEndian>
+
+#include <QtConcurrent/QtConcurrent>
+
+using namespace Zeal;
+using namespace Zeal::Core;
+
+namespace {
+const char Magic[] = {'Z', 'Q', 'P', '1'};
+const int FrameHeaderSize = 4;
+const quint32 MaxFrameSize = 1024 * 1024;
+const quint32 NullStringSize = 0xffffffff; // QDataStream size of a null QString
+const int DefaultResultLimit = 20;
+}
+
+struct QueryServer::Connection
+{
+    enum class Protocol {
+        Unknown,
+        Legacy,
+        Framed
+    };
+
+    QLocalSocket *socket;
+    QByteArray buffer;
+    Protocol protocol = Protocol::Unknown;
+    CancellationToken token;
+};
+
+QueryServer::QueryServer(DocsetRegistry *registry, QObject *parent) :
+    QObject(parent),
+    m_registry(registry),
+    m_server(new QLocalServer(this))
+{
+    connect(m_server, &QLocalServer::newConnection, this, &QueryServer::acceptConnection);
+}
+
+QueryServer::~QueryServer()
+{
+    for (Connection *connection : m_connections)
+        connection->token.cancel();
+
+    // Searches refer to the registry, which goes away after the server
+    for (QFutureWatcherBase *watcher : findChildren<QFutureWatcherBase *>())
+        watcher->waitForFinished();
+
+    qDeleteAll(m_connections);
+}
+
+bool QueryServer::listen(const QString &name)
+{
+    /// TODO: Verify if removeServer() is needed
+    QLocalServer::removeServer(name);  // remove in case previous instance crashed
+    return m_server->listen(name);
+}
+
+void QueryServer::setShowSupported(bool supported)
+{
+    m_isShowSupported = supported;
+}
+
+void QueryServer::acceptConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        Connection *connection = new Connection();
+        connection->socket = m_server->nextPendingConnection();
+        m_connections.append(connection);
+
+        // Requests are read as they arrive, nothing waits for a slow client
+        connect(connection->socket, &QLocalSocket::readyRead, this, [this, connection]() {
+            readRequests(connection);
+        });
+        connect(connection->socket, &QLocalSocket::disconnected, this, [this, connection]() {
+            closeConnection(connection);
+        });
+
+        readRequests(connection);
+    }
+}
+
+void QueryServer::readRequests(Connection *connection)
+{
+    connection->buffer.append(connection->socket->readAll());
+
+    if (connection->protocol == Connection::Protocol::Unknown) {
+        if (connection->buffer.size() < static_cast<int>(sizeof(Magic)))
+            return;
+
+        if (connection->buffer.startsWith(QByteArray::fromRawData(Magic, sizeof(Magic)))) {
+            connection->protocol = Connection::Protocol::Framed;
+            connection->buffer.remove(0, sizeof(Magic));
+        } else {
+            connection->protocol = Connection::Protocol::Legacy;
+        }
+    }
+
+    if (connection->protocol == Connection::Protocol::Legacy) {
+        readLegacyRequest(connection);
+        return;
+    }
+
+    while (connection->buffer.size() >= FrameHeaderSize) {
+        const quint32 size
+                = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(connection->buffer.constData()));
+        if (size > MaxFrameSize) {
+            connection->socket->abort();
+            return;
+        }
+
+        if (static_cast<quint32>(connection->buffer.size()) < FrameHeaderSize + size)
+            return;
+
+        const QByteArray payload = connection->buffer.mid(FrameHeaderSize, static_cast<int>(size));
+        connection->buffer.remove(0, FrameHeaderSize + static_cast<int>(size));
+
+        const bool isBinary = payload.startsWith("qbjs");
+        const QJsonDocument document = isBinary ? QJsonDocument::fromBinaryData(payload)
+                                                : QJsonDocument::fromJson(payload);
+        if (!document.isObject()) {
+            sendResponse(connection->socket, errorResponse(QJsonObject(), tr("Invalid request")), isBinary);
+            continue;
+        }
+
+        handleRequest(connection, document.object(), isBinary);
+    }
+}
+
+bool QueryServer::readLegacyRequest(Connection *connection)
+{
+    const QByteArray &buffer = connection->buffer;
+    const quint32 stringSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(buffer.constData()));
+    if (stringSize != NullStringSize && static_cast<quint32>(buffer.size()) < FrameHeaderSize + stringSize)
+        return false;
+
+    QDataStream in(buffer);
+    SearchQuery query;
+    in >> query;
+
+    connection->buffer.clear();
+    if (m_isShowSupported)
+        emit showRequested(query);
+
+    return true;
+}
+
+void QueryServer::handleRequest(Connection *connection, const QJsonObject &request, bool isBinary)
+{
+    const QString type = request.value(QStringLiteral("type")).toString();
+
+    if (type == QLatin1String("search")) {
+        search(connection, request, isBinary);
+        return;
+    }
+
+    QJsonObject response;
+    if (type == QLatin1String("show")) {
+        if (m_isShowSupported) {
+            emit showRequested(SearchQuery::fromString(request.value(QStringLiteral("query")).toString()));
+            response.insert(QStringLiteral("id"), request.value(QStringLiteral("id")));
+        } else {
+            response = errorResponse(request, tr("There is no main window to show"));
+        }
+    } else if (type == QLatin1String("ping")) {
+        response.insert(QStringLiteral("id"), request.value(QStringLiteral("id")));
+    } else {
+        response = errorResponse(request, tr("Unknown request type: %1").arg(type));
+    }
+
+    sendResponse(connection->socket, response, isBinary);
+}
+
+void QueryServer::search(Connection *connection, const QJsonObject &request, bool isBinary)
+{
+    const SearchQuery query = SearchQuery::fromString(request.value(QStringLiteral("query")).toString());
+    const int limit = qBound(1, request.value(QStringLiteral("limit")).toInt(DefaultResultLimit),
+                             m_registry->resultLimit());
+    const QJsonValue id = request.value(QStringLiteral("id"));
+    const CancellationToken token = connection->token;
+    const DocsetRegistry *registry = m_registry;
+
+    // Results are encoded by the worker, they keep their docsets alive even if removed meanwhile
+    QFutureWatcher<QJsonObject> *watcher = new QFutureWatcher<QJsonObject>(this);
+    const QPointer<QLocalSocket> socket = connection->socket;
+    connect(watcher, &QFutureWatcher<QJsonObject>::finished, this, [watcher, socket, isBinary]() {
+        if (socket)
+            sendResponse(socket, watcher->result(), isBinary);
+        watcher->deleteLater();
+    });
+
+    watcher->setFuture(QtConcurrent::run([registry, query, limit, token, id]() {
+        QJsonArray results;
+        if (!query.query().isEmpty()) {
+            for (const SearchResult &result : registry->find(query, limit, token))
+                results.append(result.toJson());
+        }
+
+        QJsonObject response;
+        response.insert(QStringLiteral("id"), id);
+        response.insert(QStringLiteral("results"), results);
+        return response;
+    }));
+}
+
+void QueryServer::sendResponse(QLocalSocket *socket, const QJsonObject &response, bool isBinary)
+{
+    const QJsonDocument document(response);
+    const QByteArray payload = isBinary ? document.toBinaryData() : document.toJson(QJsonDocument::Compact);
+
+    uchar header[FrameHeaderSize];
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()), header);
+
+    socket->write(reinterpret_cast<const char *>(header), FrameHeaderSize);
+    socket->write(payload);
+}
+
+void QueryServer::closeConnection(Connection *connection)
+{
+    // Searches still running for the client are of no use anymore
+    connection->token.cancel();
+
+    m_connections.removeOne(connection);
+    connection->socket->disconnect(this);
+    connection->socket->deleteLater();
+    delete connection;
+}
+
+QJsonObject QueryServer::errorResponse(const QJsonObject &request, const QString &message)
+{
+    QJsonObject response;
+    response.insert(QStringLiteral("id"), request.value(QStringLiteral("id")));
+    response.insert(QStringLiteral("error"), message);
+    return response;
+}
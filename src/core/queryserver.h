@@ -0,0 +1,86 @@
+#ifndef QUERYSERVER_H
+#define QUERYSERVER_H
+
+#include "registry/cancellationtoken.h"
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QObject>
+
+class QLocalServer;
+class QLocalSocket;
+
+namespace Zeal {
+
+class DocsetRegistry;
+class SearchQuery;
+
+namespace Core {
+
+/**
+ * @short Answers requests of other processes over a local socket.
+ *
+ * Clients open the server with QLocalSocket (a Unix domain socket or a named pipe), send the
+ * four bytes "ZQP1", and then any number of requests. Each request and each response is a
+ * frame of a 32-bit big-endian payload size followed by the payload. A payload is a JSON
+ * object, either as text or in the binary JSON format of Qt, and is answered in the same
+ * format. Requests may be pipelined, responses carry the "id" of their request and may
+ * arrive out of order.
+ *
+ * Requests:
+ *   {"id": 1, "type": "search", "query": "python:os.path", "limit": 20}
+ *       Answered with {"id": 1, "results": [{"name", "parentName", "docset", "path", "url",
+ *       "score"}, ...]}, best first. The query has the syntax of the search box.
+ *   {"id": 2, "type": "show", "query": "std::vector"}
+ *       Brings the main window to front with the query, answered with {"id": 2}.
+ *   {"id": 3, "type": "ping"}
+ *       Answered with {"id": 3}, e.g. to tell when a started server is ready.
+ *
+ * Failed requests are answered with {"id", "error": "<message>"}. Closing the connection
+ * cancels searches still running for it.
+ *
+ * Clients without the header, like previous versions of Zeal, send a serialized SearchQuery
+ * and close the connection, which shows it in the main window.
+ */
+class QueryServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QueryServer(DocsetRegistry *registry, QObject *parent = nullptr);
+    ~QueryServer() override;
+
+    /// Starts listening on \a name, replacing a server left behind by a crashed instance
+    bool listen(const QString &name);
+
+    /// Sets whether "show" requests are served, which needs a main window
+    void setShowSupported(bool supported);
+
+signals:
+    /// Emitted when a client asks for the main window, with the query to show in it
+    void showRequested(const Zeal::SearchQuery &query);
+
+private slots:
+    void acceptConnection();
+
+private:
+    struct Connection;
+
+    void readRequests(Connection *connection);
+    bool readLegacyRequest(Connection *connection);
+    void handleRequest(Connection *connection, const QJsonObject &request, bool isBinary);
+    void search(Connection *connection, const QJsonObject &request, bool isBinary);
+    static void sendResponse(QLocalSocket *socket, const QJsonObject &response, bool isBinary);
+    void closeConnection(Connection *connection);
+
+    static QJsonObject errorResponse(const QJsonObject &request, const QString &message);
+
+    DocsetRegistry *m_registry = nullptr;
+    QLocalServer *m_server = nullptr;
+    bool m_isShowSupported = true;
+    QList<Connection *> m_connections;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // QUERYSERVER_H
@@ -0,0 +1,349 @@
+#include "resumablereply.h"
+
+#include <QNetworkAccessManager>
+#include <QTimer>
+
+#include <cstring>
+
+using namespace Zeal::Core;
+
+namespace {
+const int MaxRetryCount = 5;
+const int RetryDelay = 1000; // ms, grows with each retry
+const int ChunkSize = 64 * 1024;
+const qint64 MinMeasuredSize = 256 * 1024;
+}
+
+ResumableReply::ResumableReply(QNetworkAccessManager *manager, const QNetworkRequest &request,
+                               const QList<QUrl> &urls, QObject *parent) :
+    QNetworkReply(parent),
+    m_manager(manager),
+    m_request(request),
+    m_urls(urls)
+{
+    Q_ASSERT(!m_urls.isEmpty());
+
+    // The URL stays the same across attempts, other code uses it to identify the download
+    m_request.setUrl(m_urls.first());
+    setRequest(m_request);
+    setUrl(m_urls.first());
+    setOperation(QNetworkAccessManager::GetOperation);
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+    m_retryTimer = new QTimer(this);
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, &ResumableReply::start);
+
+    start();
+}
+
+ResumableReply::~ResumableReply()
+{
+    releaseReply();
+}
+
+void ResumableReply::abort()
+{
+    if (isFinished())
+        return;
+
+    fail(QNetworkReply::OperationCanceledError, tr("Operation canceled"));
+}
+
+qint64 ResumableReply::bytesAvailable() const
+{
+    return m_buffer.size() + QNetworkReply::bytesAvailable();
+}
+
+bool ResumableReply::isSequential() const
+{
+    return true;
+}
+
+void ResumableReply::setReadBufferSize(qint64 size)
+{
+    QNetworkReply::setReadBufferSize(size);
+    if (m_reply)
+        m_reply->setReadBufferSize(size);
+}
+
+qint64 ResumableReply::readData(char *data, qint64 maxSize)
+{
+    if (m_buffer.isEmpty())
+        return isFinished() ? -1 : 0;
+
+    const int size = static_cast<int>(qMin<qint64>(maxSize, m_buffer.size()));
+    std::memcpy(data, m_buffer.constData(), size);
+    m_buffer.remove(0, size);
+
+    // Not fetched right away, readyRead must not be emitted from within read()
+    if (m_reply && m_reply->bytesAvailable())
+        QMetaObject::invokeMethod(this, "fetch", Qt::QueuedConnection);
+
+    return size;
+}
+
+void ResumableReply::start()
+{
+    if (isFinished())
+        return;
+
+    const QUrl url = m_urls.at(m_urlIndex);
+
+    QNetworkRequest request(m_request);
+    request.setUrl(url);
+    // Large archives would only push everything else out of the cache
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+
+    m_isResumed = m_received > 0;
+    if (m_isResumed) {
+        request.setRawHeader(QByteArrayLiteral("Range"),
+                             QByteArrayLiteral("bytes=") + QByteArray::number(m_received) + '-');
+        // Validators are only comparable between responses of the same server
+        if (!m_validator.isEmpty() && url.host() == m_validatorHost)
+            request.setRawHeader(QByteArrayLiteral("If-Range"), m_validator);
+    }
+
+    m_reply = m_manager->get(request);
+    m_reply->setReadBufferSize(readBufferSize());
+
+    m_attemptTimer.start();
+    m_attemptReceived = 0;
+
+    connect(m_reply, &QNetworkReply::metaDataChanged, this, &ResumableReply::onMetaDataChanged);
+    connect(m_reply, &QNetworkReply::readyRead, this, &ResumableReply::fetch);
+    connect(m_reply, &QNetworkReply::finished, this, &ResumableReply::onFinished);
+}
+
+void ResumableReply::fetch()
+{
+    if (!m_reply)
+        return;
+
+    const qint64 limit = readBufferSize();
+    const int previousSize = m_buffer.size();
+
+    while (m_reply->bytesAvailable() && (limit == 0 || m_buffer.size() < limit))
+        append(m_reply->read(ChunkSize));
+
+    if (m_buffer.size() > previousSize) {
+        emit readyRead();
+        emit downloadProgress(m_received, m_total);
+    }
+}
+
+void ResumableReply::fetchAll()
+{
+    const int previousSize = m_buffer.size();
+
+    append(m_reply->readAll());
+
+    if (m_buffer.size() > previousSize) {
+        emit readyRead();
+        emit downloadProgress(m_received, m_total);
+    }
+}
+
+void ResumableReply::append(QByteArray data)
+{
+    m_attemptReceived += data.size();
+
+    if (m_skipped > 0) {
+        const int size = static_cast<int>(qMin<qint64>(m_skipped, data.size()));
+        data.remove(0, size);
+        m_skipped -= size;
+    }
+
+    m_received += data.size();
+    m_buffer.append(data);
+}
+
+void ResumableReply::onMetaDataChanged()
+{
+    if (!m_hasMetaData) {
+        m_hasMetaData = true;
+
+        for (const QNetworkReply::RawHeaderPair &header : m_reply->rawHeaderPairs())
+            setRawHeader(header.first, header.second);
+
+        const QNetworkRequest::Attribute attributes[] = {
+            QNetworkRequest::HttpStatusCodeAttribute,
+            QNetworkRequest::HttpReasonPhraseAttribute,
+            QNetworkRequest::RedirectionTargetAttribute
+        };
+        for (QNetworkRequest::Attribute attribute : attributes)
+            setAttribute(attribute, m_reply->attribute(attribute));
+
+        emit metaDataChanged();
+    }
+
+    const int statusCode = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (!m_isResumed) {
+        // Also for retries from the start, which may come from another mirror
+        if (statusCode == 200) {
+            const QVariant contentLength = m_reply->header(QNetworkRequest::ContentLengthHeader);
+            m_total = contentLength.isValid() ? contentLength.toLongLong() : -1;
+
+            m_acceptsRanges = m_reply->rawHeader(QByteArrayLiteral("Accept-Ranges")).trimmed()
+                    == QByteArrayLiteral("bytes");
+            m_validator = validator(m_reply);
+            m_validatorHost = m_reply->url().host();
+            m_lastModified = m_reply->rawHeader(QByteArrayLiteral("Last-Modified")).trimmed();
+        }
+        return;
+    }
+
+    if (statusCode == 206) {
+        // Content-Range: bytes <first>-<last>/<total>
+        const QByteArray contentRange = m_reply->rawHeader(QByteArrayLiteral("Content-Range"));
+        const int dashIndex = contentRange.indexOf('-');
+        const int slashIndex = contentRange.indexOf('/');
+        const qint64 first = contentRange.mid(6, dashIndex - 6).trimmed().toLongLong();
+        const qint64 total = contentRange.mid(slashIndex + 1).trimmed().toLongLong();
+
+        if (!contentRange.startsWith("bytes ") || dashIndex < 0 || slashIndex < 0
+                || first != m_received || (m_total >= 0 && total != m_total)) {
+            fail(QNetworkReply::UnknownContentError, tr("Download cannot be resumed"));
+            return;
+        }
+
+        // A range of another version of the file would end up in the middle of this one
+        if (!isSameFile(m_reply))
+            restart();
+    } else if (statusCode == 200) {
+        // The server ignored the range, which is fine as long as the file is unchanged
+        if (!isSameFile(m_reply)) {
+            fail(QNetworkReply::UnknownContentError, tr("Download has changed while resuming"));
+            return;
+        }
+        m_skipped = m_received;
+    }
+}
+
+/*!
+  \internal
+  Downloads the file again from the start, as long as nothing has been read yet.
+*/
+void ResumableReply::restart()
+{
+    // Data already read cannot be taken back
+    if (m_buffer.size() != m_received) {
+        fail(QNetworkReply::UnknownContentError, tr("Download has changed while resuming"));
+        return;
+    }
+
+    releaseReply();
+    m_buffer.clear();
+    m_received = 0;
+    m_skipped = 0;
+    start();
+}
+
+void ResumableReply::onFinished()
+{
+    QNetworkReply *reply = m_reply;
+    if (!reply)
+        return;
+
+    // Whatever arrived is kept, the inner reply goes away
+    fetchAll();
+
+    const NetworkError code = reply->error();
+    const QString errorString = reply->errorString();
+    const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const bool isRedirect = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid();
+
+    if (m_attemptReceived >= MinMeasuredSize && m_attemptTimer.elapsed() > 0)
+        emit throughputMeasured(reply->url(), m_attemptReceived * 1000 / m_attemptTimer.elapsed());
+
+    releaseReply();
+
+    if (code == QNetworkReply::NoError) {
+        // Redirects of the first response are for the caller, any other detour ends here
+        if (m_isResumed && (isRedirect || (statusCode != 200 && statusCode != 206))) {
+            fail(QNetworkReply::UnknownContentError, tr("Download cannot be resumed"));
+            return;
+        }
+
+        setFinished(true);
+        emit finished();
+        return;
+    }
+
+    if (!canRetry(code)) {
+        fail(code, errorString);
+        return;
+    }
+
+    ++m_retryCount;
+    m_urlIndex = (m_urlIndex + 1) % m_urls.size();
+    m_retryTimer->start(RetryDelay * m_retryCount);
+}
+
+bool ResumableReply::canRetry(QNetworkReply::NetworkError code) const
+{
+    if (m_retryCount >= MaxRetryCount)
+        return false;
+
+    // Only interrupted connections are worth another attempt, not HTTP or SSL errors
+    switch (code) {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::HostNotFoundError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::UnknownNetworkError:
+        break;
+    default:
+        return false;
+    }
+
+    // Without data there is nothing to resume, any mirror can start over
+    return m_received == 0 || m_acceptsRanges;
+}
+
+void ResumableReply::fail(QNetworkReply::NetworkError code, const QString &errorString)
+{
+    releaseReply();
+
+    setError(code, errorString);
+    emit error(code);
+
+    setFinished(true);
+    emit finished();
+}
+
+void ResumableReply::releaseReply()
+{
+    if (!m_reply)
+        return;
+
+    m_reply->disconnect(this);
+    if (m_reply->isRunning())
+        m_reply->abort();
+    m_reply->deleteLater();
+    m_reply = nullptr;
+}
+
+bool ResumableReply::isSameFile(const QNetworkReply *reply) const
+{
+    // Entity tags are only comparable between responses of the same server,
+    // mirrors are at least expected to agree on the modification time
+    if (reply->url().host() == m_validatorHost)
+        return !m_validator.isEmpty() && validator(reply) == m_validator;
+
+    return !m_lastModified.isEmpty()
+            && reply->rawHeader(QByteArrayLiteral("Last-Modified")).trimmed() == m_lastModified;
+}
+
+QByteArray ResumableReply::validator(const QNetworkReply *reply)
+{
+    // Weak entity tags cannot be used with If-Range
+    const QByteArray entityTag = reply->rawHeader(QByteArrayLiteral("ETag")).trimmed();
+    if (!entityTag.isEmpty() && !entityTag.startsWith("W/"))
+        return entityTag;
+
+    return reply->rawHeader(QByteArrayLiteral("Last-Modified")).trimmed();
+}
@@ -0,0 +1,90 @@
+#ifndef RESUMABLEREPLY_H
+#define RESUMABLEREPLY_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QTimer;
+
+namespace Zeal {
+namespace Core {
+
+/**
+ * @short Network reply, which survives dropped connections.
+ *
+ * When a transfer fails halfway, the rest is requested with an HTTP Range request,
+ * from the next mirror if there are any, and the data continues as if nothing happened.
+ * Transfers are resumed only if the server accepts byte ranges, and if the resumed
+ * response provably continues the same file.
+ */
+class ResumableReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    /// Downloads \a request from the first of \a urls, the others are mirrors to resume from
+    explicit ResumableReply(QNetworkAccessManager *manager, const QNetworkRequest &request,
+                            const QList<QUrl> &urls, QObject *parent = nullptr);
+    ~ResumableReply() override;
+
+    void abort() override;
+    qint64 bytesAvailable() const override;
+    bool isSequential() const override;
+    void setReadBufferSize(qint64 size) override;
+
+signals:
+    /// Emitted after each attempt with the average transfer speed from \a url
+    void throughputMeasured(const QUrl &url, qint64 bytesPerSecond);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+
+private slots:
+    void fetch();
+
+private:
+    void start();
+    void restart();
+    void onMetaDataChanged();
+    void onFinished();
+    void fetchAll();
+    void append(QByteArray data);
+    bool canRetry(QNetworkReply::NetworkError code) const;
+    void fail(QNetworkReply::NetworkError code, const QString &errorString);
+    void releaseReply();
+
+    bool isSameFile(const QNetworkReply *reply) const;
+
+    static QByteArray validator(const QNetworkReply *reply);
+
+    QNetworkAccessManager *m_manager = nullptr;
+    QNetworkRequest m_request;
+    QList<QUrl> m_urls;
+    int m_urlIndex = 0;
+    int m_retryCount = 0;
+    QTimer *m_retryTimer = nullptr;
+
+    QNetworkReply *m_reply = nullptr;
+    bool m_isResumed = false;
+    QElapsedTimer m_attemptTimer;
+    qint64 m_attemptReceived = 0;
+
+    QByteArray m_buffer;
+    qint64 m_received = 0;
+    qint64 m_skipped = 0; // Bytes to drop, when a server resends the whole file
+    qint64 m_total = -1;
+
+    bool m_hasMetaData = false;
+    bool m_acceptsRanges = false;
+    QString m_validatorHost;
+    QByteArray m_validator; // ETag or Last-Modified of the first response
+    QByteArray m_lastModified; // Compared with responses of mirrors
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // RESUMABLEREPLY_H
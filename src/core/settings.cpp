@@ -44,6 +44,12 @@ void Settings::load()
 
     m_settings->beginGroup(QStringLiteral("browser"));
     minimumFontSize = m_settings->value("minimum_font_size", QWebSettings::globalSettings()->fontSize(QWebSettings::MinimumFontSize)).toInt();
+    tabSuspendTimeout = m_settings->value("tab_suspend_timeout", 1800).toInt();
+    maxLiveTabs = m_settings->value("max_live_tabs", 8).toInt();
+    m_settings->endGroup();
+
+    m_settings->beginGroup(QStringLiteral("search"));
+    searchResultLimit = m_settings->value("result_limit", 500).toInt();
     m_settings->endGroup();
 
     m_settings->beginGroup(QStringLiteral("proxy"));
@@ -55,6 +61,11 @@ void Settings::load()
     proxyPassword = m_settings->value("password").toString();
     m_settings->endGroup();
 
+    m_settings->beginGroup(QStringLiteral("downloads"));
+    maxConcurrentDownloads = m_settings->value("max_concurrent", 4).toInt();
+    extractionThreads = m_settings->value("extraction_threads", 0).toInt();
+    m_settings->endGroup();
+
     m_settings->beginGroup(QStringLiteral("docsets"));
     if (m_settings->contains("path")) {
         docsetPath = m_settings->value("path").toString();
@@ -67,6 +78,15 @@ void Settings::load()
 #endif
         QDir().mkpath(docsetPath);
     }
+    docsetIdleTimeout = m_settings->value("idle_timeout", 300).toInt();
+    maxOpenDocsets = m_settings->value("max_open", 32).toInt();
+    symbolCacheSize = m_settings->value("symbol_cache_size", 64).toInt();
+    warmDocsetCount = m_settings->value("warm_docsets", 5).toInt();
+    packDocuments = m_settings->value("pack_documents", false).toBool();
+    deduplicateFiles = m_settings->value("deduplicate_files", false).toBool();
+    fullTextIndex = m_settings->value("full_text_index", false).toBool();
+    buildMissingIndexes = m_settings->value("build_missing_indexes", true).toBool();
+    sharedStore = m_settings->value("shared_store", false).toBool();
     m_settings->endGroup();
 
     m_settings->beginGroup(QStringLiteral("state"));
@@ -90,6 +110,12 @@ void Settings::save()
 
     m_settings->beginGroup(QStringLiteral("browser"));
     m_settings->setValue("minimum_font_size", minimumFontSize);
+    m_settings->setValue("tab_suspend_timeout", tabSuspendTimeout);
+    m_settings->setValue("max_live_tabs", maxLiveTabs);
+    m_settings->endGroup();
+
+    m_settings->beginGroup(QStringLiteral("search"));
+    m_settings->setValue("result_limit", searchResultLimit);
     m_settings->endGroup();
 
     m_settings->beginGroup(QStringLiteral("proxy"));
@@ -101,11 +127,25 @@ void Settings::save()
     m_settings->setValue("password", proxyPassword);
     m_settings->endGroup();
 
-#ifndef PORTABLE_BUILD
+    m_settings->beginGroup(QStringLiteral("downloads"));
+    m_settings->setValue("max_concurrent", maxConcurrentDownloads);
+    m_settings->setValue("extraction_threads", extractionThreads);
+    m_settings->endGroup();
+
     m_settings->beginGroup(QStringLiteral("docsets"));
+#ifndef PORTABLE_BUILD
     m_settings->setValue("path", docsetPath);
-    m_settings->endGroup();
 #endif
+    m_settings->setValue("idle_timeout", docsetIdleTimeout);
+    m_settings->setValue("max_open", maxOpenDocsets);
+    m_settings->setValue("symbol_cache_size", symbolCacheSize);
+    m_settings->setValue("warm_docsets", warmDocsetCount);
+    m_settings->setValue("pack_documents", packDocuments);
+    m_settings->setValue("deduplicate_files", deduplicateFiles);
+    m_settings->setValue("full_text_index", fullTextIndex);
+    m_settings->setValue("build_missing_indexes", buildMissingIndexes);
+    m_settings->setValue("shared_store", sharedStore);
+    m_settings->endGroup();
 
     m_settings->beginGroup(QStringLiteral("state"));
     m_settings->setValue("window_geometry", windowGeometry);
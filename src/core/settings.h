@@ -31,9 +31,17 @@ public:
 
     // Browser
     int minimumFontSize;
+    /// Seconds after which pages of background tabs get unloaded, 0 to keep them loaded
+    int tabSuspendTimeout;
+    /// Tabs allowed to keep their pages loaded at the same time
+    int maxLiveTabs;
     /// TODO: bool askOnExternalLink;
     /// TODO: QString customCss;
 
+    // Search
+    /// Results beyond this many are dropped, only the best ones are kept sorted
+    int searchResultLimit;
+
     // Network
     enum ProxyType {
         None,
@@ -48,8 +56,32 @@ public:
     QString proxyUserName;
     QString proxyPassword;
 
+    // Downloads
+    /// Docset downloads running at the same time, the rest waits in a queue
+    int maxConcurrentDownloads;
+    /// Threads extracting docset archives, 0 for one per core
+    int extractionThreads;
+
     // Other
     QString docsetPath;
+    /// Seconds after which databases of unused docsets get closed, 0 to keep them open
+    int docsetIdleTimeout;
+    /// Docsets allowed to keep their databases open at the same time
+    int maxOpenDocsets;
+    /// Memory in MiB for symbols of browsed docset groups, at least 4 are used
+    int symbolCacheSize;
+    /// Most used docsets read into memory after startup, 0 to leave them on disk
+    int warmDocsetCount;
+    /// Whether installed docsets keep their documents in a single archive
+    bool packDocuments;
+    /// Whether documents identical in several docsets are stored once, see Zeal::Core::ContentPool
+    bool deduplicateFiles;
+    /// Whether the text of pages gets indexed for full-text searches
+    bool fullTextIndex;
+    /// Whether docsets without indexes for their symbol lists get an indexed copy of them
+    bool buildMissingIndexes;
+    /// Whether docsetPath is a read-only store shared by many machines, see Zeal::SharedStore
+    bool sharedStore;
 
     // State
     QByteArray windowGeometry;
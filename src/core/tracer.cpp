@@ -0,0 +1,190 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include <cmath>
+
+using namespace Zeal::Core;
+
+namespace {
+const int MaxEventCount = 200000; // The oldest events are dropped beyond
+
+struct Event
+{
+    char phase;
+    const char *category;
+    QString name;
+    qint64 timestamp;
+    qint64 value; // Duration of spans
+    quintptr id;
+    quintptr threadId;
+};
+
+struct TraceData
+{
+    TraceData()
+    {
+        clock.start();
+    }
+
+    void append(const Event &event)
+    {
+        QMutexLocker locker(&mutex);
+        if (events.size() < MaxEventCount) {
+            events.append(event);
+        } else {
+            events[nextEvent] = event;
+            nextEvent = (nextEvent + 1) % MaxEventCount;
+        }
+    }
+
+    QElapsedTimer clock;
+    QMutex mutex;
+    QVector<Event> events; // A ring buffer once full, nextEvent is the oldest
+    int nextEvent = 0;
+    QMap<QString, LatencyHistogram> latencies;
+};
+
+Q_GLOBAL_STATIC(TraceData, traceData)
+
+quintptr currentThreadId()
+{
+    return reinterpret_cast<quintptr>(QThread::currentThreadId());
+}
+}
+
+void LatencyHistogram::add(qint64 usecs)
+{
+    const int bucket = usecs > 0 ? static_cast<int>(4 * std::log2(static_cast<double>(usecs))) : 0;
+    ++m_buckets[qBound(0, bucket, BucketCount - 1)];
+    ++m_count;
+}
+
+int LatencyHistogram::count() const
+{
+    return m_count;
+}
+
+qint64 LatencyHistogram::percentile(double fraction) const
+{
+    if (!m_count)
+        return 0;
+
+    const qint64 rank = qMax<qint64>(1, static_cast<qint64>(std::ceil(fraction * m_count)));
+    qint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank)
+            return static_cast<qint64>(std::pow(2.0, (i + 1) / 4.0));
+    }
+
+    return static_cast<qint64>(std::pow(2.0, BucketCount / 4.0));
+}
+
+bool Tracer::isEnabled()
+{
+#ifdef USE_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Tracer::addLatency(const QString &key, qint64 usecs)
+{
+    QMutexLocker locker(&traceData->mutex);
+    traceData->latencies[key].add(usecs);
+}
+
+QMap<QString, LatencyHistogram> Tracer::latencies()
+{
+    QMutexLocker locker(&traceData->mutex);
+    return traceData->latencies;
+}
+
+qint64 Tracer::now()
+{
+    return traceData->clock.nsecsElapsed() / 1000;
+}
+
+void Tracer::addSpan(const char *category, const QString &name, qint64 start, qint64 duration)
+{
+    traceData->append({'X', category, name, start, duration, 0, currentThreadId()});
+}
+
+void Tracer::addCounter(const char *category, const char *name, qint64 value)
+{
+    traceData->append({'C', category, QLatin1String(name), now(), value, 0, currentThreadId()});
+}
+
+void Tracer::beginAsync(const char *category, const QString &name, const void *id)
+{
+    traceData->append({'b', category, name, now(), 0, reinterpret_cast<quintptr>(id),
+                       currentThreadId()});
+}
+
+void Tracer::endAsync(const char *category, const QString &name, const void *id)
+{
+    traceData->append({'e', category, name, now(), 0, reinterpret_cast<quintptr>(id),
+                       currentThreadId()});
+}
+
+bool Tracer::save(const QString &fileName)
+{
+    QVector<Event> events;
+    {
+        QMutexLocker locker(&traceData->mutex);
+        events.reserve(traceData->events.size());
+        for (int i = 0; i < traceData->events.size(); ++i)
+            events.append(traceData->events.at((traceData->nextEvent + i) % traceData->events.size()));
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray traceEvents;
+    for (const Event &event : events) {
+        QJsonObject object;
+        object.insert(QStringLiteral("ph"), QString(QLatin1Char(event.phase)));
+        object.insert(QStringLiteral("cat"), QLatin1String(event.category));
+        object.insert(QStringLiteral("name"), event.name);
+        object.insert(QStringLiteral("ts"), static_cast<double>(event.timestamp));
+        object.insert(QStringLiteral("pid"), static_cast<double>(pid));
+        object.insert(QStringLiteral("tid"), static_cast<double>(event.threadId));
+
+        switch (event.phase) {
+        case 'X':
+            object.insert(QStringLiteral("dur"), static_cast<double>(event.value));
+            break;
+        case 'C': {
+            QJsonObject args;
+            args.insert(QStringLiteral("value"), static_cast<double>(event.value));
+            object.insert(QStringLiteral("args"), args);
+            break;
+        }
+        default:
+            // Ids are strings, 64-bit pointers do not fit in a double
+            object.insert(QStringLiteral("id"), QString::number(event.id, 16));
+            break;
+        }
+
+        traceEvents.append(object);
+    }
+
+    QJsonObject trace;
+    trace.insert(QStringLiteral("traceEvents"), traceEvents);
+    trace.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    return file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) != -1;
+}
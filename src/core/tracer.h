@@ -0,0 +1,99 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QMap>
+#include <QString>
+
+#ifdef USE_TRACING
+#define ZEAL_TRACE_CONCAT_(a, b) a##b
+#define ZEAL_TRACE_CONCAT(a, b) ZEAL_TRACE_CONCAT_(a, b)
+/// Records the rest of the enclosing scope as a span \a name of \a category
+#define ZEAL_TRACE_SCOPE(category, name) \
+    const Zeal::Core::TraceSpan ZEAL_TRACE_CONCAT(traceSpan, __LINE__)(category, name)
+#define ZEAL_TRACE_COUNTER(category, name, value) Zeal::Core::Tracer::addCounter(category, name, value)
+/// Spans across callbacks, matched by \a category, \a name and \a id
+#define ZEAL_TRACE_BEGIN(category, name, id) Zeal::Core::Tracer::beginAsync(category, name, id)
+#define ZEAL_TRACE_END(category, name, id) Zeal::Core::Tracer::endAsync(category, name, id)
+#else
+#define ZEAL_TRACE_SCOPE(category, name) do {} while (false)
+#define ZEAL_TRACE_COUNTER(category, name, value) do {} while (false)
+#define ZEAL_TRACE_BEGIN(category, name, id) do {} while (false)
+#define ZEAL_TRACE_END(category, name, id) do {} while (false)
+#endif
+
+namespace Zeal {
+namespace Core {
+
+/// Distribution of durations in buckets a quarter octave wide
+class LatencyHistogram
+{
+public:
+    void add(qint64 usecs);
+
+    int count() const;
+    /// Returns the duration in µs that \a fraction of the samples do not exceed, within a bucket
+    qint64 percentile(double fraction) const;
+
+private:
+    static const int BucketCount = 128;
+
+    quint32 m_buckets[BucketCount] = {};
+    int m_count = 0;
+};
+
+/**
+ * @short Collects timings of the hot paths.
+ *
+ * Search latencies are kept per docset in every build, for finding slow docsets in the field.
+ *
+ * Trace events are only recorded in builds with CONFIG+=tracing, where the ZEAL_TRACE macros
+ * are not empty. The last events are kept in memory, and are written on exit to the file named
+ * by the ZEAL_TRACE_FILE environment variable, in the Chrome trace event format that Perfetto
+ * and chrome://tracing open.
+ */
+class Tracer
+{
+public:
+    /// Returns true if trace events are recorded
+    static bool isEnabled();
+
+    static void addLatency(const QString &key, qint64 usecs);
+    static QMap<QString, LatencyHistogram> latencies();
+
+    /// Returns µs on the clock of trace events
+    static qint64 now();
+    static void addSpan(const char *category, const QString &name, qint64 start, qint64 duration);
+    static void addCounter(const char *category, const char *name, qint64 value);
+    static void beginAsync(const char *category, const QString &name, const void *id);
+    static void endAsync(const char *category, const QString &name, const void *id);
+
+    static bool save(const QString &fileName);
+};
+
+class TraceSpan
+{
+public:
+    TraceSpan(const char *category, const QString &name) :
+        m_category(category),
+        m_name(name),
+        m_start(Tracer::now())
+    {
+    }
+
+    ~TraceSpan()
+    {
+        Tracer::addSpan(m_category, m_name, m_start, Tracer::now() - m_start);
+    }
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+
+    const char *m_category;
+    QString m_name;
+    qint64 m_start;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // TRACER_H
@@ -0,0 +1,65 @@
+#include "trashcollector.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QThread>
+
+using namespace Zeal::Core;
+
+const char TrashCollector::DirName[] = ".trash";
+
+namespace {
+// Files removed between pauses, so that deleting a large docset does not saturate the disk
+const int BatchSize = 500;
+const int BatchPause = 20; // ms
+}
+
+TrashCollector::TrashCollector(QObject *parent) :
+    QObject(parent)
+{
+}
+
+QString TrashCollector::moveToTrash(const QString &path)
+{
+    const QFileInfo fileInfo(path);
+    if (!fileInfo.exists())
+        return QString();
+
+    // The trash is on the same file system, so the rename does not copy anything
+    QDir trashDir = fileInfo.dir();
+    if (!trashDir.mkpath(QLatin1String(DirName)) || !trashDir.cd(QLatin1String(DirName)))
+        return QString();
+
+    const QString trashName = QStringLiteral("%1.%2").arg(fileInfo.fileName())
+            .arg(QDateTime::currentMSecsSinceEpoch());
+    if (!QDir().rename(fileInfo.absoluteFilePath(), trashDir.absoluteFilePath(trashName)))
+        return QString();
+
+    return trashDir.absolutePath();
+}
+
+void TrashCollector::collect(const QString &trashPath)
+{
+    QDir trashDir(trashPath);
+    if (!trashDir.exists())
+        return;
+
+    int removedCount = 0;
+    QDirIterator it(trashPath, QDir::Files | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (QThread::currentThread()->isInterruptionRequested())
+            return;
+
+        // Failures are left to removeRecursively(), which also clears read-only flags
+        QFile::remove(it.next());
+
+        if (++removedCount % BatchSize == 0)
+            QThread::msleep(BatchPause);
+    }
+
+    // Only directories and links are left at this point
+    trashDir.removeRecursively();
+}
@@ -0,0 +1,37 @@
+#ifndef TRASHCOLLECTOR_H
+#define TRASHCOLLECTOR_H
+
+#include <QObject>
+
+namespace Zeal {
+namespace Core {
+
+/**
+ * @short Deletes directories in the background.
+ *
+ * A directory is first renamed into a trash directory next to it, which is instant, and its
+ * files are removed later at a pace that leaves the disk to everything else. Whatever is left
+ * in a trash directory, e.g. after a crash, is collected the next time.
+ */
+class TrashCollector : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TrashCollector(QObject *parent = nullptr);
+
+    /// Name of the trash directory, hidden so that it is not scanned for docsets
+    static const char DirName[];
+
+    /// Moves \a path into the trash of its parent directory, and returns the trash directory,
+    /// or a null string if \a path cannot be moved
+    static QString moveToTrash(const QString &path);
+
+public slots:
+    /// Removes everything in \a trashPath, and then the directory itself
+    void collect(const QString &trashPath);
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // TRASHCOLLECTOR_H
@@ -18,6 +18,7 @@
 struct CommandLineParameters
 {
     bool force;
+    bool headless;
     Zeal::SearchQuery query;
 #ifdef Q_OS_WIN32
     bool registerProtocolHandlers;
@@ -45,6 +46,8 @@ CommandLineParameters parseCommandLine(const QCoreApplication &app)
     /// TODO: [Qt 5.4] parser.addOption({{"f", "force"}, "Force the application run."});
     parser.addOption(QCommandLineOption({QStringLiteral("f"), QStringLiteral("force")},
                                         QObject::tr("Force the application run.")));
+    parser.addOption(QCommandLineOption({QStringLiteral("headless")},
+                                        QObject::tr("Serve queries of other processes without any windows.")));
     /// TODO: [0.2.0] Remove --query support
     parser.addOption(QCommandLineOption({QStringLiteral("q"), QStringLiteral("query")},
                                         QObject::tr("[DEPRECATED] Query <search term>."),
@@ -60,6 +63,7 @@ CommandLineParameters parseCommandLine(const QCoreApplication &app)
 
     CommandLineParameters clParams;
     clParams.force = parser.isSet(QStringLiteral("force"));
+    clParams.headless = parser.isSet(QStringLiteral("headless"));
 
 #ifdef Q_OS_WIN32
     clParams.registerProtocolHandlers = parser.isSet(QStringLiteral("register"));
@@ -160,6 +164,14 @@ int main(int argc, char *argv[])
     QCoreApplication::setOrganizationDomain(QStringLiteral("zealdocs.org"));
     QCoreApplication::setOrganizationName(QStringLiteral("Zeal"));
 
+    // A headless server must start without a display, e.g. on a build machine
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--headless") == 0 && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+            break;
+        }
+    }
+
     QApplication qapp(argc, argv);
 
     const CommandLineParameters clParams = parseCommandLine(qapp);
@@ -189,6 +201,11 @@ int main(int argc, char *argv[])
         socket->connectToServer(Zeal::Core::Application::localServerName());
 
         if (socket->waitForConnected(500)) {
+            if (clParams.headless) {
+                QTextStream(stderr) << QObject::tr("Zeal is already running and serving queries.\n");
+                return EXIT_FAILURE;
+            }
+
             QDataStream out(socket.data());
             out << clParams.query;
             socket->flush();
@@ -199,7 +216,9 @@ int main(int argc, char *argv[])
     QDir::setSearchPaths(QStringLiteral("docsetIcon"), {QStringLiteral(":/icons/docset")});
     QDir::setSearchPaths(QStringLiteral("typeIcon"), {QStringLiteral(":/icons/type")});
 
-    QScopedPointer<Zeal::Core::Application> app(new Zeal::Core::Application(clParams.query));
+    const Zeal::Core::Application::Mode mode = clParams.headless
+            ? Zeal::Core::Application::Mode::Headless : Zeal::Core::Application::Mode::Interactive;
+    QScopedPointer<Zeal::Core::Application> app(new Zeal::Core::Application(clParams.query, mode));
 
     return qapp.exec();
 }
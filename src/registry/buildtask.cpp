@@ -0,0 +1,116 @@
+#include "buildtask.h"
+
+#include <QMutex>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+using namespace Zeal;
+
+struct BuildTask::State
+{
+    enum Status {
+        Queued,
+        Running,
+        Finished
+    };
+
+    std::function<void()> function;
+
+    QMutex mutex;
+    QWaitCondition finished;
+    Status status = Queued;
+};
+
+namespace {
+// Half of the cores at most, searches get the others
+struct BuildPool
+{
+    BuildPool()
+    {
+        threadPool.setMaxThreadCount(qMax(QThread::idealThreadCount() / 2, 1));
+    }
+
+    QThreadPool threadPool;
+};
+
+Q_GLOBAL_STATIC(BuildPool, buildPool)
+
+class BuildJob : public QRunnable
+{
+public:
+    explicit BuildJob(const std::function<void()> &function) :
+        m_function(function)
+    {
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
+}
+
+BuildTask::BuildTask()
+{
+}
+
+BuildTask BuildTask::start(const std::function<void()> &function)
+{
+    BuildTask task;
+    task.d = QSharedPointer<State>(new State());
+    task.d->function = function;
+
+    const QSharedPointer<State> state = task.d;
+    buildPool()->threadPool.start(new BuildJob([state]() { run(state); }));
+    return task;
+}
+
+void BuildTask::run(const QSharedPointer<State> &state)
+{
+    {
+        QMutexLocker locker(&state->mutex);
+        // Dropped by its owner meanwhile
+        if (state->status != State::Queued)
+            return;
+        state->status = State::Running;
+    }
+
+    QThread::currentThread()->setPriority(QThread::LowPriority);
+    state->function();
+
+    QMutexLocker locker(&state->mutex);
+    state->status = State::Finished;
+    state->function = nullptr;
+    state->finished.wakeAll();
+}
+
+bool BuildTask::isFinished() const
+{
+    if (!d)
+        return true;
+
+    QMutexLocker locker(&d->mutex);
+    return d->status == State::Finished;
+}
+
+void BuildTask::stop()
+{
+    if (!d)
+        return;
+
+    QMutexLocker locker(&d->mutex);
+    if (d->status == State::Queued) {
+        // The job finds it finished once it gets a thread
+        d->status = State::Finished;
+        d->function = nullptr;
+        return;
+    }
+
+    while (d->status != State::Finished)
+        d->finished.wait(&d->mutex);
+}
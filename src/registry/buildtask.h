@@ -0,0 +1,40 @@
+#ifndef BUILDTASK_H
+#define BUILDTASK_H
+
+#include <QSharedPointer>
+
+#include <functional>
+
+namespace Zeal {
+
+/**
+ * @short Build of an index file, run on a few threads of low priority.
+ *
+ * Builds kept off the global thread pool cannot hold up searches. Their owner stops them
+ * on destruction: a build that has not started yet is dropped, a running one is waited
+ * for, which it should cut short by checking a CancellationToken.
+ */
+class BuildTask
+{
+public:
+    /// Returns a finished task
+    BuildTask();
+
+    /// Queues \a function to run on a build thread
+    static BuildTask start(const std::function<void()> &function);
+
+    bool isFinished() const;
+    /// Drops the build if it has not started yet, otherwise waits for it to finish
+    void stop();
+
+private:
+    struct State;
+
+    static void run(const QSharedPointer<State> &state);
+
+    QSharedPointer<State> d;
+};
+
+} // namespace Zeal
+
+#endif // BUILDTASK_H
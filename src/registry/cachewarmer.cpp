@@ -0,0 +1,108 @@
+#include "cachewarmer.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+
+using namespace Zeal;
+
+const qint64 CacheWarmer::MaxPassSize = 256 * 1024 * 1024;
+
+namespace {
+const qint64 ChunkSize = 1024 * 1024;
+const int ChunkPause = 10; // ms
+// Reading resumes once nothing has been searched for this long
+const int QuietPeriod = 1000; // ms
+const int PollInterval = 100; // ms
+const int AssetDepth = 2;
+const int MaxAssetCount = 64;
+}
+
+CacheWarmer::CacheWarmer(QObject *parent) :
+    QObject(parent)
+{
+    m_clock.start();
+}
+
+void CacheWarmer::noteActivity()
+{
+    m_lastActivity.store(static_cast<int>(m_clock.elapsed()));
+}
+
+void CacheWarmer::warm(const QStringList &paths)
+{
+    QStringList filePaths;
+    for (const QString &path : paths) {
+        if (QFileInfo(path).isDir())
+            filePaths += findAssets(path);
+        else
+            filePaths.append(path);
+    }
+
+    QByteArray buffer(static_cast<int>(ChunkSize), Qt::Uninitialized);
+    qint64 budget = MaxPassSize;
+    for (const QString &filePath : filePaths) {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+            continue;
+
+        // Reading the data is what fills the cache on every platform
+        while (budget > 0) {
+            if (!waitForQuiet())
+                return;
+
+            const qint64 count = file.read(buffer.data(), qMin(ChunkSize, budget));
+            if (count <= 0)
+                break;
+            budget -= count;
+
+            QThread::msleep(ChunkPause);
+        }
+
+        if (budget <= 0)
+            return;
+    }
+}
+
+QStringList CacheWarmer::findAssets(const QString &path) const
+{
+    static const QStringList nameFilters = {QStringLiteral("*.css"), QStringLiteral("*.js")};
+
+    QStringList assets;
+    QStringList dirPaths = {path};
+    for (int depth = 0; depth <= AssetDepth && !dirPaths.isEmpty(); ++depth) {
+        QStringList subdirPaths;
+        for (const QString &dirPath : dirPaths) {
+            const QDir dir(dirPath);
+            for (const QFileInfo &fileInfo : dir.entryInfoList(nameFilters, QDir::Files)) {
+                assets.append(fileInfo.absoluteFilePath());
+                if (assets.size() == MaxAssetCount)
+                    return assets;
+            }
+
+            for (const QFileInfo &fileInfo : dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot))
+                subdirPaths.append(fileInfo.absoluteFilePath());
+        }
+
+        dirPaths = subdirPaths;
+    }
+
+    return assets;
+}
+
+bool CacheWarmer::waitForQuiet() const
+{
+    forever {
+        if (QThread::currentThread()->isInterruptionRequested())
+            return false;
+
+        // Unsigned, so that the difference survives the clock wrapping around
+        const quint32 quietFor = static_cast<quint32>(m_clock.elapsed())
+                - static_cast<quint32>(m_lastActivity.load());
+        if (quietFor >= static_cast<quint32>(QuietPeriod))
+            return true;
+
+        QThread::msleep(qMin(QuietPeriod - static_cast<int>(quietFor), PollInterval));
+    }
+}
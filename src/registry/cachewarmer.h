@@ -0,0 +1,47 @@
+#ifndef CACHEWARMER_H
+#define CACHEWARMER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+
+namespace Zeal {
+
+/**
+ * @short Reads files into the page cache of the operating system ahead of their use.
+ *
+ * The first search after login would otherwise wait for docset databases and indexes to come
+ * from the disk, which takes long on hard disks and network home directories. Files are read
+ * in chunks with pauses in between, on a thread of idle priority, and reading stops while
+ * searches are running, so that foreground work does not queue behind it. Each pass reads at
+ * most MaxPassSize bytes.
+ */
+class CacheWarmer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CacheWarmer(QObject *parent = nullptr);
+
+    static const qint64 MaxPassSize;
+
+    /// Pauses reading for a while, may be called from any thread
+    void noteActivity();
+
+public slots:
+    /// Reads \a paths in order. Directories are searched two levels deep for style sheets and
+    /// scripts, which take part in rendering every page.
+    void warm(const QStringList &paths);
+
+private:
+    QStringList findAssets(const QString &path) const;
+    // Returns false if the thread is asked to stop
+    bool waitForQuiet() const;
+
+    QElapsedTimer m_clock;
+    QAtomicInt m_lastActivity; // ms on m_clock, truncated to 32 bits
+};
+
+} // namespace Zeal
+
+#endif // CACHEWARMER_H
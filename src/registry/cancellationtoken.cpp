@@ -0,0 +1,74 @@
+#include "cancellationtoken.h"
+#include "sqlitehandle.h"
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+
+#ifdef USE_SQLITE_INTERRUPT
+#include <sqlite3.h>
+#endif
+
+using namespace Zeal;
+
+struct CancellationToken::State
+{
+    QAtomicInt isCanceled;
+
+    QMutex mutex;
+    QList<void *> handles;
+};
+
+namespace {
+void interrupt(void *handle)
+{
+#ifdef USE_SQLITE_INTERRUPT
+    sqlite3_interrupt(static_cast<sqlite3 *>(handle));
+#else
+    Q_UNUSED(handle)
+#endif
+}
+}
+
+CancellationToken::CancellationToken() :
+    d(new State())
+{
+}
+
+void CancellationToken::cancel()
+{
+    QMutexLocker locker(&d->mutex);
+    d->isCanceled.storeRelease(1);
+
+    for (void *handle : d->handles)
+        interrupt(handle);
+}
+
+bool CancellationToken::isCanceled() const
+{
+    return d->isCanceled.loadAcquire();
+}
+
+void CancellationToken::watch(const QSqlDatabase &db) const
+{
+    void *handle = SqliteHandle::get(db);
+    if (!handle)
+        return;
+
+    QMutexLocker locker(&d->mutex);
+    d->handles.append(handle);
+
+    if (d->isCanceled.loadAcquire())
+        interrupt(handle);
+}
+
+void CancellationToken::unwatch(const QSqlDatabase &db) const
+{
+    void *handle = SqliteHandle::get(db);
+    if (!handle)
+        return;
+
+    // Once the handle is removed no interrupt can reach statements executed later
+    QMutexLocker locker(&d->mutex);
+    d->handles.removeOne(handle);
+}
@@ -0,0 +1,39 @@
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <QMetaType>
+#include <QSharedPointer>
+
+class QSqlDatabase;
+
+namespace Zeal {
+
+/**
+ * @short Cancellation flag shared between a job and its owner.
+ *
+ * Copies refer to the same state, so a token can be handed over to worker threads
+ * while the owner keeps one for calling cancel().
+ */
+class CancellationToken
+{
+public:
+    CancellationToken();
+
+    void cancel();
+    bool isCanceled() const;
+
+    /// Interrupts a statement running on \a db if the token is canceled
+    /// before unwatch() is called.
+    void watch(const QSqlDatabase &db) const;
+    void unwatch(const QSqlDatabase &db) const;
+
+private:
+    struct State;
+    QSharedPointer<State> d;
+};
+
+} // namespace Zeal
+
+Q_DECLARE_METATYPE(Zeal::CancellationToken)
+
+#endif // CANCELLATIONTOKEN_H
@@ -0,0 +1,140 @@
+#include "completiontrie.h"
+
+#include "searchindex.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace Zeal;
+
+namespace {
+// Labels count bytes in 16 bits, such names are far too long for completing anyway
+const uint MaxNameSize = 0xffff;
+
+inline uchar fold(char c)
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+int compareFolded(const char *lhs, const char *rhs)
+{
+    while (*lhs && fold(*lhs) == fold(*rhs)) {
+        ++lhs;
+        ++rhs;
+    }
+
+    return fold(*lhs) - fold(*rhs);
+}
+}
+
+CompletionTrie::CompletionTrie(const QSharedPointer<const SearchIndex> &index) :
+    m_searchIndex(index)
+{
+    QVector<quint32> ids;
+    ids.reserve(index->size());
+    for (int id = 0; id < index->size(); ++id) {
+        const char *name = index->nameData(id);
+        if (*name && qstrlen(name) <= MaxNameSize)
+            ids.append(id);
+    }
+
+    if (ids.isEmpty())
+        return;
+
+    // Names sharing a prefix end up next to each other, of equal names the best symbol is kept
+    std::sort(ids.begin(), ids.end(), [&index](quint32 lhs, quint32 rhs) {
+        const int cmp = compareFolded(index->nameData(lhs), index->nameData(rhs));
+        return cmp < 0 || (cmp == 0 && lhs < rhs);
+    });
+    ids.erase(std::unique(ids.begin(), ids.end(), [&index](quint32 lhs, quint32 rhs) {
+        return compareFolded(index->nameData(lhs), index->nameData(rhs)) == 0;
+    }), ids.end());
+
+    m_nodes.resize(1);
+    build(0, ids.constBegin(), ids.constEnd(), 0);
+    m_nodes.squeeze();
+}
+
+QSharedPointer<const SearchIndex> CompletionTrie::searchIndex() const
+{
+    return m_searchIndex;
+}
+
+int CompletionTrie::complete(const QByteArray &prefix) const
+{
+    if (m_nodes.isEmpty())
+        return -1;
+
+    const Node *node = &m_nodes.at(0);
+    int pos = 0;
+    for (;;) {
+        const char *nodeLabel = label(*node);
+        for (int i = 0; i < node->labelSize && pos < prefix.size(); ++i, ++pos) {
+            if (fold(nodeLabel[i]) != fold(prefix.at(pos)))
+                return -1;
+        }
+
+        if (pos == prefix.size())
+            return node->symbolId;
+
+        // Labels of children are never empty, they start with distinct bytes
+        const uchar c = fold(prefix.at(pos));
+        const Node *children = m_nodes.constData() + node->firstChild;
+        const Node *childrenEnd = children + node->childCount;
+        const Node *child = std::lower_bound(children, childrenEnd, c, [this](const Node &other, uchar c) {
+            return fold(*label(other)) < c;
+        });
+
+        if (child == childrenEnd || fold(*label(*child)) != c)
+            return -1;
+
+        node = child;
+    }
+}
+
+// Builds the node for the sorted names of symbols in [begin, end), which share depth bytes
+void CompletionTrie::build(int node, const quint32 *begin, const quint32 *end, int depth)
+{
+    // A range of sorted names shares the prefix of its first and its last name
+    const char *first = m_searchIndex->nameData(*begin);
+    const char *last = m_searchIndex->nameData(*(end - 1));
+    int prefixSize = depth;
+    while (first[prefixSize] && fold(first[prefixSize]) == fold(last[prefixSize]))
+        ++prefixSize;
+
+    // A name ending at this node sorts before those continuing
+    quint32 best = std::numeric_limits<quint32>::max();
+    const quint32 *childBegin = begin;
+    if (!first[prefixSize]) {
+        best = *begin;
+        ++childBegin;
+    }
+
+    QVector<const quint32 *> childStarts;
+    for (const quint32 *it = childBegin; it != end; ++it) {
+        const uchar c = fold(m_searchIndex->nameData(*it)[prefixSize]);
+        if (childStarts.isEmpty() || fold(m_searchIndex->nameData(*childStarts.last())[prefixSize]) != c)
+            childStarts.append(it);
+    }
+
+    // Nodes are only referred to by index while children get appended
+    const int firstChild = m_nodes.size();
+    m_nodes.resize(firstChild + childStarts.size());
+    for (int i = 0; i < childStarts.size(); ++i) {
+        const quint32 *childEnd = i + 1 < childStarts.size() ? childStarts.at(i + 1) : end;
+        build(firstChild + i, childStarts.at(i), childEnd, prefixSize);
+        best = qMin(best, m_nodes.at(firstChild + i).symbolId);
+    }
+
+    Node &current = m_nodes[node];
+    current.symbolId = best;
+    current.labelStart = depth;
+    current.labelSize = prefixSize - depth;
+    current.firstChild = firstChild;
+    current.childCount = childStarts.size();
+}
+
+const char *CompletionTrie::label(const Node &node) const
+{
+    return m_searchIndex->nameData(node.symbolId) + node.labelStart;
+}
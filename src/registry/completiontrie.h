@@ -0,0 +1,48 @@
+#ifndef COMPLETIONTRIE_H
+#define COMPLETIONTRIE_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QVector>
+
+namespace Zeal {
+
+class SearchIndex;
+
+/**
+ * @short Compressed trie over the symbol names of a SearchIndex, for completing queries.
+ *
+ * Edge labels point into the names held by the index, so the trie only adds its nodes. Every node
+ * refers to the best symbol below it, which is the one with the lowest id, and therefore with the
+ * shortest raw name. Names are compared with ASCII letters folded to lower case, the same as
+ * searches do.
+ */
+class CompletionTrie
+{
+public:
+    explicit CompletionTrie(const QSharedPointer<const SearchIndex> &index);
+
+    QSharedPointer<const SearchIndex> searchIndex() const;
+
+    /// Returns the id of the best symbol with a name starting with UTF-8 \a prefix, or -1
+    int complete(const QByteArray &prefix) const;
+
+private:
+    struct Node {
+        quint32 symbolId; // Best symbol, which name holds the label
+        quint16 labelStart; // Bytes of the name from the parent node on
+        quint16 labelSize;
+        quint32 firstChild; // Children follow each other, ordered by their first byte
+        quint16 childCount;
+    };
+
+    void build(int node, const quint32 *begin, const quint32 *end, int depth);
+    const char *label(const Node &node) const;
+
+    QSharedPointer<const SearchIndex> m_searchIndex;
+    QVector<Node> m_nodes; // The first node is the root
+};
+
+} // namespace Zeal
+
+#endif // COMPLETIONTRIE_H
@@ -1,19 +1,363 @@
 #include "docset.h"
 
+#include "cancellationtoken.h"
+#include "completiontrie.h"
+#include "docsetmanifest.h"
+#include "documentarchive.h"
+#include "fulltextindex.h"
+#include "fuzzymatcher.h"
+#include "iconcache.h"
+#include "resultarena.h"
+#include "searchindex.h"
+#include "searchquery.h"
+#include "sharedstore.h"
+#include "sqlitehandle.h"
+#include "symboltype.h"
+#include "core/tracer.h"
+
+#include <QCache>
+#include <QDateTime>
 #include <QDir>
+#include <QJsonArray>
+#include <QJsonObject>
 #include <QMetaEnum>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QThread>
+#include <QThreadStorage>
 #include <QVariant>
 
+
+#include <algorithm>
+
+#ifdef USE_SQLITE_API
+#include <sqlite3.h>
+#endif
+
 using namespace Zeal;
 
-Docset::Docset(const QString &path) :
-    m_path(path)
+namespace {
+const char SearchIndexFileName[] = "docSet.zidx";
+const char FullTextIndexFileName[] = "docSet.zfts";
+const char SymbolListFileName[] = "docSet.zsym";
+
+const int SearchRowLimit = 100;
+// Pages of the rows on screen have to stay, ListModel::data() reads them on every repaint
+const int MinSymbolCacheSize = 4 * 1024 * 1024;
+
+QAtomicInt fullTextIndexEnabled;
+QAtomicInt buildMissingIndexes(1);
+
+// Keyset pagination: names equal to the last one continue after its row id
+QString symbolsQuery(Docset::Type type)
+{
+    switch (type) {
+    case Docset::Type::Dash:
+        return QStringLiteral("SELECT name, path, rowid FROM searchIndex WHERE type = ?"
+                              " AND (name > ? OR (name = ? AND rowid > ?))"
+                              " ORDER BY name ASC, rowid ASC LIMIT ?");
+    case Docset::Type::ZDash:
+        return QStringLiteral("SELECT ztokenname AS name, "
+                              "CASE WHEN (zanchor IS NULL) THEN zpath "
+                              "ELSE (zpath || '#' || zanchor) "
+                              "END AS path, ztoken.z_pk FROM ztoken "
+                              "JOIN ztokenmetainformation ON ztoken.zmetainformation = ztokenmetainformation.z_pk "
+                              "JOIN zfilepath ON ztokenmetainformation.zfile = zfilepath.z_pk "
+                              "JOIN ztokentype ON ztoken.ztokentype = ztokentype.z_pk WHERE ztypename = ? "
+                              "AND (ztokenname > ? OR (ztokenname = ? AND ztoken.z_pk > ?)) "
+                              "ORDER BY ztokenname ASC, ztoken.z_pk ASC LIMIT ?");
+    }
+
+    return QString();
+}
+
+QString relatedLinksQuery(Docset::Type type)
+{
+    switch (type) {
+    case Docset::Type::Dash:
+        return QStringLiteral("SELECT name, type, path FROM searchIndex WHERE path LIKE ? ESCAPE '\\'");
+    case Docset::Type::ZDash:
+        return QStringLiteral("SELECT ztoken.ztokenname, ztokentype.ztypename, zfilepath.zpath, ztokenmetainformation.zanchor "
+                              "FROM ztoken "
+                              "JOIN ztokenmetainformation ON ztoken.zmetainformation = ztokenmetainformation.z_pk "
+                              "JOIN zfilepath ON ztokenmetainformation.zfile = zfilepath.z_pk "
+                              "JOIN ztokentype ON ztoken.ztokentype = ztokentype.z_pk "
+                              "WHERE zfilepath.zpath = ?");
+    }
+
+    return QString();
+}
+
+// Decodes into the buffer string already has, ASCII needs no QString::fromUtf8().
+// A negative size means data is zero terminated.
+void assignUtf8(QString &string, const char *data, int size = -1)
+{
+    if (size < 0)
+        size = qstrlen(data);
+
+    for (int i = 0; i < size; ++i) {
+        if (static_cast<uchar>(data[i]) >= 0x80) {
+            string = QString::fromUtf8(data, size);
+            return;
+        }
+    }
+
+    string.resize(size);
+    QChar *chars = string.data();
+    for (int i = 0; i < size; ++i)
+        chars[i] = QLatin1Char(data[i]);
+}
+
+// Returns true if SQLite plans to read all rows of one of largeTables, or to sort the rows itself
+bool isSlowPlan(const QSqlDatabase &db, const QString &queryStr, const QStringList &largeTables)
+{
+    QSqlQuery query(db);
+    if (!query.prepare(QLatin1String("EXPLAIN QUERY PLAN ") + queryStr))
+        return false;
+
+    // Plans do not depend on the values, but all parameters have to be bound
+    for (int i = queryStr.count(QLatin1Char('?')); i > 0; --i)
+        query.addBindValue(QVariant());
+
+    if (!query.exec()) {
+        qWarning("SQL Error: %s", qPrintable(query.lastError().text()));
+        return false;
+    }
+
+    while (query.next()) {
+        // Like "SCAN TABLE searchIndex", or "SCAN searchIndex" since SQLite 3.36
+        const QString detail = query.value(3).toString();
+        if (detail.contains(QLatin1String("TEMP B-TREE FOR ORDER BY")))
+            return true;
+        if (!detail.startsWith(QLatin1String("SCAN ")) || detail.contains(QLatin1String("INDEX")))
+            continue;
+
+        QStringList words = detail.split(QLatin1Char(' '), QString::SkipEmptyParts);
+        words.removeAll(QStringLiteral("TABLE"));
+        if (words.size() > 1 && largeTables.contains(words.at(1), Qt::CaseInsensitive))
+            return true;
+    }
+
+    return false;
+}
+
+// Connection generations of live docsets, by docset serial. Closing the connections of
+// a docset bumps its generation, which retires the ones opened before on every thread.
+struct ConnectionGenerations
+{
+    QMutex mutex;
+    QHash<int, int> generations;
+    QAtomicInt epoch; // Bumped with any generation, saves threads looking them up
+    QAtomicInt nextSerial;
+};
+
+Q_GLOBAL_STATIC(ConnectionGenerations, connectionGenerations)
+
+// Connections opened by one thread. QSqlDatabase connections have to be closed by the thread
+// that opened them, which does so when it finishes, or on its next use of any docset once
+// they are retired. Threads are numbered, their addresses get reused.
+struct ThreadConnections
+{
+    struct Connection
+    {
+        QString name;
+        int generation = 0;
+        QHash<int, QSqlQuery> statements;
+        QHash<int, void *> rowStatements; // sqlite3_stmt, see Docset::rowStatement()
+        bool hasSymbolList = false;
+    };
+
+    ~ThreadConnections()
+    {
+        for (Connection &connection : connections)
+            close(connection);
+    }
+
+    static ThreadConnections *current();
+
+    static void close(Connection &connection)
+    {
+        // Statements have to go before their connection
+        connection.statements.clear();
+#ifdef USE_SQLITE_API
+        for (void *stmt : connection.rowStatements)
+            sqlite3_finalize(static_cast<sqlite3_stmt *>(stmt));
+#endif
+        connection.rowStatements.clear();
+        QSqlDatabase::removeDatabase(connection.name);
+    }
+
+    void closeRetired()
+    {
+        ConnectionGenerations *state = connectionGenerations();
+        const int currentEpoch = state->epoch.load();
+        if (currentEpoch == epoch)
+            return;
+        epoch = currentEpoch;
+
+        QList<int> retired;
+        {
+            QMutexLocker locker(&state->mutex);
+            for (auto it = connections.cbegin(); it != connections.cend(); ++it) {
+                if (state->generations.value(it.key(), -1) != it->generation)
+                    retired.append(it.key());
+            }
+        }
+
+        for (int serial : retired) {
+            close(connections[serial]);
+            connections.remove(serial);
+        }
+    }
+
+    int serial = 0;
+    int epoch = 0;
+    QHash<int, Connection> connections; // By docset serial
+};
+
+QAtomicInt nextThreadSerial;
+QThreadStorage<ThreadConnections *> threadConnections;
+
+ThreadConnections *ThreadConnections::current()
+{
+    if (!threadConnections.hasLocalData()) {
+        ThreadConnections *connections = new ThreadConnections();
+        connections->serial = nextThreadSerial.fetchAndAddRelaxed(1);
+        connections->epoch = connectionGenerations()->epoch.load();
+        threadConnections.setLocalData(connections);
+    }
+
+    return threadConnections.localData();
+}
+
+ThreadConnections::Connection *currentConnection(int docsetSerial)
+{
+    ThreadConnections *connections = ThreadConnections::current();
+    const auto it = connections->connections.find(docsetSerial);
+    return it != connections->connections.end() ? &it.value() : nullptr;
+}
+
+// Symbol pages are identified by the symbol they follow, row ids are unique within a docset
+struct SymbolPageKey
+{
+    const Docset *docset;
+    QString symbolType;
+    qint64 afterId;
+    int limit;
+
+    bool operator==(const SymbolPageKey &other) const
+    {
+        return docset == other.docset && afterId == other.afterId && limit == other.limit
+                && symbolType == other.symbolType;
+    }
+};
+
+uint qHash(const SymbolPageKey &key, uint seed = 0)
+{
+    return ::qHash(key.docset, seed) ^ ::qHash(key.symbolType, seed) ^ ::qHash(key.afterId, seed)
+            ^ ::qHash(key.limit, seed);
+}
+
+// Pages of all docsets, cost is their approximate size in bytes
+struct SymbolCache
+{
+    QMutex mutex;
+    QCache<SymbolPageKey, QVector<Docset::Symbol>> pages{64 * 1024 * 1024};
+};
+
+Q_GLOBAL_STATIC(SymbolCache, symbolCache)
+
+int symbolPageCost(const QVector<Docset::Symbol> &symbols)
+{
+    int cost = sizeof(QVector<Docset::Symbol>) + symbols.size() * sizeof(Docset::Symbol);
+    for (const Docset::Symbol &symbol : symbols)
+        cost += (symbol.name.size() + symbol.path.size()) * sizeof(QChar);
+    return cost;
+}
+
+// Sorts symbols the same way as symbol pages are selected, keeping the first limit ones
+void sortSymbols(QVector<Docset::Symbol> &symbols, int limit)
+{
+    const auto lessThan = [](const Docset::Symbol &lhs, const Docset::Symbol &rhs) {
+        const int cmp = QString::compare(lhs.name, rhs.name);
+        return cmp < 0 || (cmp == 0 && lhs.id < rhs.id);
+    };
+
+    std::sort(symbols.begin(), symbols.end(), lessThan);
+    if (symbols.size() > limit)
+        symbols.erase(symbols.begin() + limit, symbols.end());
+}
+
+// Sorts the best limit results, the rest is dropped unsorted
+void sortResults(QVector<SearchResult> &results, int limit)
+{
+    if (results.size() <= limit) {
+        std::sort(results.begin(), results.end());
+        return;
+    }
+
+    std::partial_sort(results.begin(), results.begin() + limit, results.end());
+    results.erase(results.begin() + limit, results.end());
+}
+}
+
+Docset::Docset(const QString &path, const QJsonObject &manifestEntry) :
+    m_path(path),
+    m_documentPath(QDir(path).absoluteFilePath(QStringLiteral("Contents/Resources/Documents")))
+{
+    {
+        ConnectionGenerations *state = connectionGenerations();
+        m_serial = state->nextSerial.fetchAndAddRelaxed(1);
+        QMutexLocker locker(&state->mutex);
+        state->generations.insert(m_serial, 0);
+    }
+
+    // Pages copied from a shared store are only good for the version they came from
+    if (SharedStore::contains(m_path))
+        SharedStore::validate(m_path, DocsetManifest::stamp(m_path));
+
+    // A manifest entry saves parsing metadata and querying the database on warm starts
+    if (!readManifestEntry(manifestEntry) && !load())
+        return;
+
+    // Until the index is ready searches fall back to SQL
+    if (!m_searchIndex)
+        m_searchIndexBuild = BuildTask::start([this]() { buildSearchIndex(); });
+
+    // Symbol lists of databases without fitting indexes are read from an indexed copy
+    if (m_slowQueries.contains(QLatin1String("symbols"))) {
+        if (isSymbolListUpToDate())
+            m_hasSymbolList.store(1);
+        else if (buildMissingIndexes.load())
+            m_symbolListBuild = BuildTask::start([this]() { buildSymbolList(); });
+    } else if (QFile::exists(m_symbolListPath)) {
+        // Left from before an update that brought the indexes
+        QFile::remove(m_symbolListPath);
+    }
+
+    // Packed documents are served from the archive in place of the Documents directory
+    const QString archivePath = QDir(m_path).absoluteFilePath(QStringLiteral("Contents/Resources/")
+                                                              + QLatin1String(DocumentArchive::FileName));
+    if (QFile::exists(archivePath)) {
+        m_documentArchive = QSharedPointer<const DocumentArchive>(DocumentArchive::open(archivePath));
+        if (m_documentArchive)
+            DocumentArchive::mount(m_documentPath, m_documentArchive);
+    }
+
+    // Installed and updated docsets get indexed once they are loaded
+    if (fullTextIndexEnabled.load()
+            && !FullTextIndex::isUpToDate(m_fullTextIndexPath, QFileInfo(m_databasePath))) {
+        buildFullTextIndex();
+    }
+
+    m_isValid = true;
+}
+
+bool Docset::load()
 {
     QDir dir(m_path);
     if (!dir.exists())
-        return;
+        return false;
 
     // Read metadata
     if (dir.exists(QStringLiteral("meta.json"))) {
@@ -29,45 +373,161 @@ Docset::Docset(const QString &path) :
 
     /// TODO: Report errors here and below
     if (!dir.cd(QStringLiteral("Contents")))
-        return;
+        return false;
 
     if (dir.exists(QStringLiteral("Info.plist")))
         info = DocsetInfo::fromPlist(dir.absoluteFilePath(QStringLiteral("Info.plist")));
     else if (dir.exists(QStringLiteral("info.plist")))
         info = DocsetInfo::fromPlist(dir.absoluteFilePath(QStringLiteral("info.plist")));
     else
-        return;
+        return false;
 
     if (info.family == QStringLiteral("cheatsheet"))
         m_name = QString(QStringLiteral("%1_cheats")).arg(m_name);
 
     if (!dir.cd(QStringLiteral("Resources")))
-        return;
+        return false;
 
-    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_name);
-    db.setDatabaseName(dir.absoluteFilePath(QStringLiteral("docSet.dsidx")));
+    m_databasePath = dir.absoluteFilePath(QStringLiteral("docSet.dsidx"));
+    setIndexPaths();
 
-    if (!db.open()) {
-        qWarning("SQL Error: %s", qPrintable(db.lastError().text()));
-        return;
-    }
+    // An up-to-date index file makes opening the database at startup unnecessary
+    m_searchIndex = QSharedPointer<const SearchIndex>(
+                SearchIndex::fromFile(m_searchIndexPath, QFileInfo(m_databasePath)));
 
-    m_type = db.tables().contains(QStringLiteral("searchIndex")) ? Type::Dash : Type::ZDash;
+    if (m_searchIndex) {
+        m_type = m_searchIndex->docsetType();
+    } else {
+        QReadLocker databaseLocker(&m_databaseLock);
+        QSqlDatabase db = database();
+        if (!db.isOpen())
+            return false;
 
-    if (!dir.cd(QStringLiteral("Documents")))
-        return;
+        m_type = db.tables().contains(QStringLiteral("searchIndex")) ? Type::Dash : Type::ZDash;
+    }
+
+    if (!dir.exists(QStringLiteral("Documents")) && !dir.exists(QLatin1String(DocumentArchive::FileName)))
+        return false;
 
     prefix = info.bundleName.isEmpty() ? m_name : info.bundleName;
 
     findIcon();
     countSymbols();
+    checkQueryPlans();
 
-    m_isValid = true;
+    return true;
+}
+
+// Files built from the database go next to it, or into the local cache of a shared store
+void Docset::setIndexPaths()
+{
+    const QDir dir(SharedStore::contains(m_path) ? SharedStore::docsetCachePath(m_path)
+                                                 : QFileInfo(m_databasePath).absolutePath());
+    m_searchIndexPath = dir.absoluteFilePath(QLatin1String(SearchIndexFileName));
+    m_fullTextIndexPath = dir.absoluteFilePath(QLatin1String(FullTextIndexFileName));
+    m_symbolListPath = dir.absoluteFilePath(QLatin1String(SymbolListFileName));
+}
+
+bool Docset::readManifestEntry(const QJsonObject &entry)
+{
+    if (entry.isEmpty())
+        return false;
+
+    m_databasePath = QDir(m_path).absoluteFilePath(QStringLiteral("Contents/Resources/docSet.dsidx"));
+    setIndexPaths();
+
+    m_name = entry[QStringLiteral("name")].toString();
+    m_title = entry[QStringLiteral("title")].toString();
+    m_hasMetadata = entry[QStringLiteral("hasMetadata")].toBool();
+    if (m_hasMetadata)
+        metadata = DocsetMetadata(entry[QStringLiteral("metadata")].toObject());
+    info = DocsetInfo::fromJson(entry[QStringLiteral("info")].toObject());
+    m_type = entry[QStringLiteral("type")].toString() == QLatin1String("ZDash") ? Type::ZDash : Type::Dash;
+    prefix = info.bundleName.isEmpty() ? m_name : info.bundleName;
+
+    m_iconPath = entry[QStringLiteral("icon")].toString();
+    if (!m_iconPath.isEmpty())
+        m_icon = IconCache::icon(m_iconPath);
+
+    const QJsonObject symbols = entry[QStringLiteral("symbols")].toObject();
+    for (auto it = symbols.constBegin(); it != symbols.constEnd(); ++it) {
+        const QJsonObject group = it.value().toObject();
+        m_symbolCounts[it.key()] = group[QStringLiteral("count")].toInt();
+        for (const QJsonValue &symbolString : group[QStringLiteral("types")].toArray())
+            m_symbolStrings.insertMulti(it.key(), symbolString.toString());
+    }
+
+    for (const QJsonValue &slowQuery : entry[QStringLiteral("slowQueries")].toArray())
+        m_slowQueries.append(slowQuery.toString());
+
+    // Mapping the index file is cheap, and the database is only needed without it
+    m_searchIndex = QSharedPointer<const SearchIndex>(
+                SearchIndex::fromFile(m_searchIndexPath, QFileInfo(m_databasePath)));
+
+    return true;
+}
+
+QJsonObject Docset::manifestEntry() const
+{
+    if (!m_isValid)
+        return QJsonObject();
+
+    QJsonObject entry;
+    entry[QStringLiteral("name")] = m_name;
+    entry[QStringLiteral("title")] = m_title;
+    entry[QStringLiteral("hasMetadata")] = m_hasMetadata;
+    if (m_hasMetadata)
+        entry[QStringLiteral("metadata")] = metadata.toJsonObject();
+    entry[QStringLiteral("info")] = info.toJson();
+    entry[QStringLiteral("type")] = m_type == Type::ZDash ? QStringLiteral("ZDash") : QStringLiteral("Dash");
+    entry[QStringLiteral("icon")] = m_iconPath;
+
+    QJsonObject symbols;
+    for (auto it = m_symbolCounts.cbegin(); it != m_symbolCounts.cend(); ++it) {
+        QJsonObject group;
+        group[QStringLiteral("count")] = it.value();
+        QJsonArray symbolStrings;
+        for (const QString &symbolString : m_symbolStrings.values(it.key()))
+            symbolStrings.append(symbolString);
+        group[QStringLiteral("types")] = symbolStrings;
+        symbols[it.key()] = group;
+    }
+    entry[QStringLiteral("symbols")] = symbols;
+    entry[QStringLiteral("slowQueries")] = QJsonArray::fromStringList(m_slowQueries);
+
+    return entry;
 }
 
 Docset::~Docset()
 {
-    QSqlDatabase::removeDatabase(m_name);
+    // Queued builds are dropped, running ones stop at the next row
+    m_buildToken.cancel();
+    m_searchIndexBuild.stop();
+    m_symbolListBuild.stop();
+    m_completionTrieBuild.stop();
+    // The build does not refer to this docset, there is no need to wait for it
+    m_fullTextIndexToken.cancel();
+
+    if (!symbolCache.isDestroyed()) {
+        QMutexLocker locker(&symbolCache->mutex);
+        for (const SymbolPageKey &key : symbolCache->pages.keys()) {
+            if (key.docset == this)
+                symbolCache->pages.remove(key);
+        }
+    }
+
+    if (m_documentArchive)
+        DocumentArchive::unmount(m_documentPath, m_documentArchive.data());
+
+    QWriteLocker databaseLocker(&m_databaseLock);
+    removeConnections(true);
+}
+
+QSharedPointer<Docset> Docset::share(Docset *docset)
+{
+    const QSharedPointer<Docset> sharedDocset(docset);
+    docset->m_self = sharedDocset;
+    return sharedDocset;
 }
 
 bool Docset::isValid() const
@@ -102,7 +562,18 @@ QString Docset::path() const
 
 QString Docset::documentPath() const
 {
-    return QDir(m_path).absoluteFilePath(QStringLiteral("Contents/Resources/Documents"));
+    return m_documentPath;
+}
+
+QUrl Docset::documentUrl(const QString &path) const
+{
+    /// TODO: Keep anchor separately from file address
+    const int anchorPosition = path.indexOf(QLatin1Char('#'));
+    QUrl url = QUrl::fromLocalFile(m_documentPath + QLatin1Char('/') + path.left(anchorPosition));
+    if (anchorPosition != -1)
+        /// NOTE: QUrl::DecodedMode is a fix for #121. Let's hope it doesn't break anything.
+        url.setFragment(path.mid(anchorPosition + 1), QUrl::DecodedMode);
+    return url;
 }
 
 QIcon Docset::icon() const
@@ -113,8 +584,7 @@ QIcon Docset::icon() const
 QString Docset::indexFilePath() const
 {
     /// TODO: Check if file exists
-    const QDir dir(documentPath());
-    return dir.absoluteFilePath(info.indexPath.isEmpty() ? QStringLiteral("index.html") : info.indexPath);
+    return info.indexPath.isEmpty() ? QStringLiteral("index.html") : info.indexPath;
 }
 
 QMap<QString, int> Docset::symbolCounts() const
@@ -127,19 +597,268 @@ int Docset::symbolCount(const QString &symbolType) const
     return m_symbolCounts.value(symbolType);
 }
 
-const QMap<QString, QString> &Docset::symbols(const QString &symbolType) const
+QVector<Docset::Symbol> Docset::symbols(const QString &symbolType, const Symbol &after, int limit) const
+{
+    QVector<Symbol> symbols;
+    if (limit <= 0)
+        return symbols;
+
+    const SymbolPageKey key = {this, symbolType, after.id, limit};
+    {
+        QMutexLocker locker(&symbolCache->mutex);
+        if (const QVector<Symbol> *page = symbolCache->pages.object(key))
+            return *page;
+    }
+
+    // Each alias of the type gives its own page, the best of them are merged
+    for (const QString &symbolString : m_symbolStrings.values(symbolType))
+        loadSymbols(symbols, symbolString, after, limit);
+
+    sortSymbols(symbols, limit);
+
+    QMutexLocker locker(&symbolCache->mutex);
+    symbolCache->pages.insert(key, new QVector<Symbol>(symbols), symbolPageCost(symbols));
+    return symbols;
+}
+
+void Docset::setSymbolCacheSize(int bytes)
+{
+    QMutexLocker locker(&symbolCache->mutex);
+    symbolCache->pages.setMaxCost(qMax(bytes, MinSymbolCacheSize));
+}
+
+QStringList Docset::slowQueries() const
+{
+    return m_slowQueries;
+}
+
+void Docset::setBuildMissingIndexes(bool enabled)
+{
+    buildMissingIndexes.store(enabled);
+}
+
+QSharedPointer<const SearchIndex> Docset::searchIndex() const
+{
+    QMutexLocker locker(&m_searchIndexMutex);
+    return m_searchIndex;
+}
+
+QSharedPointer<const CompletionTrie> Docset::completionTrie() const
+{
+    QMutexLocker locker(&m_completionTrieMutex);
+    if (m_completionTrie || !m_completionTrieBuild.isFinished())
+        return m_completionTrie;
+
+    const QSharedPointer<const SearchIndex> index = searchIndex();
+    if (index)
+        m_completionTrieBuild = BuildTask::start([this, index]() { buildCompletionTrie(index); });
+
+    return m_completionTrie;
+}
+
+QVector<SearchResult> Docset::search(const SearchQuery &query, int limit, SearchCandidates *candidates,
+                                   const CancellationToken &token) const
+{
+    QVector<SearchResult> results;
+    if (token.isCanceled())
+        return results;
+
+    const QString preparedQuery = query.sanitizedQuery();
+
+    const QSharedPointer<const SearchIndex> index = searchIndex();
+    if (index) {
+        QVector<int> ids;
+        bool isComplete = false;
+
+        if (candidates && candidates->isComplete && candidates->searchIndex == index
+                && SearchIndex::narrows(query.query(), candidates->query)) {
+            // Nothing was left out by the previous search, so its results contain all matches
+            ids = index->refine(candidates->symbolIds, query.query());
+            isComplete = true;
+        } else {
+            ids = index->find(query.query(), qMax(limit, 100), &isComplete);
+        }
+
+        if (candidates) {
+            candidates->searchIndex = index;
+            candidates->query = query.query();
+            candidates->symbolIds = ids;
+            candidates->isComplete = isComplete;
+        }
+
+        const QSharedPointer<Docset> self = m_self.toStrongRef();
+        const FuzzyMatcher matcher(query.query());
+        QString name;
+        QString parentName;
+        QString type;
+        for (int id : ids) {
+            assignUtf8(name, index->nameData(id));
+            assignUtf8(parentName, index->parentNameData(id));
+            assignUtf8(type, index->typeData(id));
+            results.append(SearchResult(index, id, self, score(matcher, name, parentName, type)));
+        }
+
+        sortResults(results, limit);
+        return results;
+    }
+
+    if (candidates)
+        *candidates = SearchCandidates();
+
+    ZEAL_TRACE_SCOPE("sql", m_name);
+    QReadLocker databaseLocker(&m_databaseLock);
+
+    // Symbols with a name or a sub-name starting with the query come first:
+    // %.%1% for long Django docset values like django.utils.http
+    // %::%1% for long C++ docset values like std::set
+    // %/%1% for long Go docset values like archive/tar
+    QString nameColumn;
+    QString selectStr;
+    QString orderStr;
+    if (m_type == Docset::Type::Dash) {
+        nameColumn = QStringLiteral("t.name");
+        selectStr = QStringLiteral("SELECT t.name, t.type, t.path FROM searchIndex t ");
+        orderStr = QStringLiteral(" ORDER BY length(t.name), lower(t.name) ASC, t.path ASC LIMIT %1")
+                .arg(SearchRowLimit);
+    } else {
+        nameColumn = QStringLiteral("ztokenname");
+        selectStr = QStringLiteral("SELECT ztokenname, ztypename, zpath, zanchor FROM ztoken "
+                                   "JOIN ztokenmetainformation on ztoken.zmetainformation = ztokenmetainformation.z_pk "
+                                   "JOIN zfilepath on ztokenmetainformation.zfile = zfilepath.z_pk "
+                                   "JOIN ztokentype on ztoken.ztokentype = ztokentype.z_pk ");
+        orderStr = QStringLiteral(" ORDER BY length(ztokenname), lower(ztokenname) ASC, zpath ASC, "
+                                  "zanchor ASC LIMIT %1").arg(SearchRowLimit);
+    }
+
+    const QString prefixCondition = QStringLiteral("(%1 LIKE ? ESCAPE '\\' OR %1 LIKE ? ESCAPE '\\' "
+                                                   "OR %1 LIKE ? ESCAPE '\\' OR %1 LIKE ? ESCAPE '\\')")
+            .arg(nameColumn);
+    const QStringList prefixPatterns = {
+        preparedQuery + QLatin1Char('%'),
+        QLatin1String("%.") + preparedQuery + QLatin1Char('%'),
+        QLatin1String("%::") + preparedQuery + QLatin1Char('%'),
+        QLatin1String("%/") + preparedQuery + QLatin1Char('%')
+    };
+
+    // Rows of both passes go into one arena, shared by the results
+    const QExplicitlySharedDataPointer<ResultArena> arena(new ResultArena(SearchRowLimit));
+
+    for (int pass = 0; pass < 2 && arena->size() < SearchRowLimit; ++pass) {
+        if (pass == 0) {
+            fetchSearchRows(arena.data(), SearchPrefixStatement,
+                            selectStr + QLatin1String("WHERE ") + prefixCondition + orderStr,
+                            prefixPatterns, token);
+        } else {
+            // If less than SearchRowLimit found starting with query, search all substrings,
+            // but don't return 'starting with' results twice.
+            const QStringList values = QStringList(QLatin1Char('%') + preparedQuery + QLatin1Char('%'))
+                    + prefixPatterns;
+            fetchSearchRows(arena.data(), SearchSubstringStatement, selectStr
+                            + QStringLiteral("WHERE %1 LIKE ? ESCAPE '\\' AND NOT ").arg(nameColumn)
+                            + prefixCondition + orderStr, values, token);
+        }
+
+        if (token.isCanceled())
+            return results;
+    }
+
+    const QSharedPointer<Docset> self = m_self.toStrongRef();
+    const FuzzyMatcher matcher(query.query());
+    QString name;
+    QString parentName;
+    QString type;
+    for (int row = 0; row < arena->size(); ++row) {
+        assignUtf8(name, arena->nameData(row), arena->nameSize(row));
+        assignUtf8(parentName, arena->parentNameData(row), arena->parentNameSize(row));
+        assignUtf8(type, arena->typeData(row), arena->typeSize(row));
+        results.append(SearchResult(arena, row, self, score(matcher, name, parentName, type)));
+    }
+
+    sortResults(results, limit);
+    return results;
+}
+
+QVector<SearchResult> Docset::fullTextSearch(const SearchQuery &query, int limit,
+                                             const CancellationToken &token) const
+{
+    QVector<SearchResult> results;
+
+    const QSharedPointer<const FullTextIndex> index = fullTextIndex();
+    if (!index)
+        return results;
+
+    const QSharedPointer<Docset> self = m_self.toStrongRef();
+    const QStringList terms = FullTextIndex::tokenize(query.query());
+    for (const FullTextIndex::Hit &hit : index->find(query.query(), limit, token)) {
+        const QString path = index->path(hit.document);
+        const QString title = index->title(hit.document);
+        SearchResult result(title.isEmpty() ? path : title, QString(), self, path,
+                            qRound(hit.score * 1000));
+        result.setSnippetTerms(terms);
+        results.append(result);
+    }
+
+    return results;
+}
+
+QString Docset::fullTextSnippet(const QString &path, const QStringList &terms) const
 {
-    if (!m_symbols.contains(symbolType))
-        loadSymbols(symbolType);
-    return m_symbols[symbolType];
+    QByteArray html;
+    if (m_documentArchive) {
+        html = m_documentArchive->read(path);
+    } else {
+        QFile file(m_documentPath + QLatin1Char('/') + path);
+        if (file.open(QIODevice::ReadOnly))
+            html = file.readAll();
+    }
+
+    return FullTextIndex::snippet(FullTextIndex::documentText(html), terms);
 }
 
-QList<SearchResult> Docset::relatedLinks(const QUrl &url) const
+void Docset::setFullTextIndexEnabled(bool enabled)
 {
-    QList<SearchResult> results;
+    fullTextIndexEnabled.store(enabled);
+}
 
+QSharedPointer<const FullTextIndex> Docset::fullTextIndex() const
+{
+    QMutexLocker locker(&m_fullTextIndexMutex);
+    if (m_fullTextIndex)
+        return m_fullTextIndex;
+
+    // Loaded on first use, or once a build has saved it
+    m_fullTextIndex = QSharedPointer<const FullTextIndex>(
+                FullTextIndex::fromFile(m_fullTextIndexPath, QFileInfo(m_databasePath)));
+
+    if (!m_fullTextIndex && fullTextIndexEnabled.load())
+        buildFullTextIndex();
+
+    return m_fullTextIndex;
+}
+
+void Docset::buildCompletionTrie(const QSharedPointer<const SearchIndex> &index) const
+{
+    QSharedPointer<const CompletionTrie> trie(new CompletionTrie(index));
+
+    QMutexLocker locker(&m_completionTrieMutex);
+    m_completionTrie = trie;
+}
+
+void Docset::buildFullTextIndex() const
+{
+    // Called with m_fullTextIndexMutex locked, or from the constructor
+    if (m_isFullTextIndexQueued)
+        return;
+
+    m_isFullTextIndexQueued = true;
+    FullTextIndex::buildLater(m_fullTextIndexPath, m_documentPath, m_documentArchive,
+                              QFileInfo(m_databasePath), m_fullTextIndexToken);
+}
+
+QVector<SearchResult> Docset::relatedLinks(const QUrl &url) const
+{
     // Strip docset path and anchor from url
-    const QString dir = documentPath();
+    const QString &dir = m_documentPath;
     QString urlPath = url.path();
     int dirPosition = urlPath.indexOf(dir);
     QString path = url.path().mid(dirPosition + dir.size() + 1);
@@ -147,21 +866,77 @@ QList<SearchResult> Docset::relatedLinks(const QUrl &url) const
     // Get the url without the #anchor.
     QUrl cleanUrl(path);
     cleanUrl.setFragment(QString());
+    const QString pagePath = cleanUrl.toString();
+
+    QVector<RelatedLink> links;
+    bool isCached = false;
+    {
+        QMutexLocker locker(&m_relatedLinksMutex);
+        if (const QVector<RelatedLink> *cachedLinks = m_relatedLinks.object(pagePath)) {
+            links = *cachedLinks;
+            isCached = true;
+        }
+    }
+
+    if (!isCached) {
+        links = findRelatedLinks(pagePath);
+
+        QMutexLocker locker(&m_relatedLinksMutex);
+        m_relatedLinks.insert(pagePath, new QVector<RelatedLink>(links));
+    }
+
+    const QSharedPointer<Docset> self = m_self.toStrongRef();
+    QVector<SearchResult> results;
+    results.reserve(links.size());
+    for (const RelatedLink &link : links)
+        results.append(SearchResult(link.name, QString(), self, link.path));
+    return results;
+}
+
+QVector<Docset::RelatedLink> Docset::findRelatedLinks(const QString &pagePath) const
+{
+    QVector<RelatedLink> links;
+    if (const QSharedPointer<const SearchIndex> index = searchIndex()) {
+        const QString anchorPrefix = pagePath + QLatin1Char('#');
+        for (int id : index->findPath(pagePath)) {
+            const QString sectionPath = index->path(id);
+            // Dash matches paths starting with the page path, ZDash the page path itself
+            if (m_type == Docset::Type::ZDash && sectionPath != pagePath
+                    && !sectionPath.startsWith(anchorPrefix)) {
+                continue;
+            }
+
+            RelatedLink link;
+            link.name = index->name(id);
+            link.path = sectionPath;
+            links.append(link);
+        }
+    } else {
+        links = queryRelatedLinks(pagePath);
+    }
+
+    return links;
+}
+
+QVector<Docset::RelatedLink> Docset::queryRelatedLinks(const QString &pagePath) const
+{
+    ZEAL_TRACE_SCOPE("sql", m_name);
+    QVector<RelatedLink> links;
 
     // Prepare the query to look up all pages with the same url.
-    QString queryStr;
+    QString pathValue = pagePath;
     if (m_type == Docset::Type::Dash) {
-        queryStr = QStringLiteral("SELECT name, type, path FROM searchIndex WHERE path LIKE \"%1%%\"");
-    } else if (m_type == Docset::Type::ZDash) {
-        queryStr = QStringLiteral("SELECT ztoken.ztokenname, ztokentype.ztypename, zfilepath.zpath, ztokenmetainformation.zanchor "
-                                  "FROM ztoken "
-                                  "JOIN ztokenmetainformation ON ztoken.zmetainformation = ztokenmetainformation.z_pk "
-                                  "JOIN zfilepath ON ztokenmetainformation.zfile = zfilepath.z_pk "
-                                  "JOIN ztokentype ON ztoken.ztokentype = ztokentype.z_pk "
-                                  "WHERE zfilepath.zpath = \"%1\"");
+        pathValue.replace(QStringLiteral("\\"), QStringLiteral("\\\\"));
+        pathValue.replace(QStringLiteral("_"), QStringLiteral("\\_"));
+        pathValue.replace(QStringLiteral("%"), QStringLiteral("\\%"));
+        pathValue.append(QLatin1Char('%'));
     }
 
-    QSqlQuery query(queryStr.arg(cleanUrl.toString()), database());
+    QReadLocker databaseLocker(&m_databaseLock);
+    QSqlQuery query = statement(RelatedLinksStatement, relatedLinksQuery(m_type));
+    query.bindValue(0, pathValue);
+    if (!query.exec())
+        qWarning("SQL Error: %s", qPrintable(query.lastError().text()));
 
     while (query.next()) {
         QString sectionName = query.value(0).toString();
@@ -174,60 +949,341 @@ QList<SearchResult> Docset::relatedLinks(const QUrl &url) const
 
         normalizeName(sectionName, parentName);
 
-        results.append(SearchResult(sectionName, QString(), const_cast<Docset *>(this), sectionPath, QString()));
+        RelatedLink link;
+        link.name = sectionName;
+        link.path = sectionPath;
+        links.append(link);
     }
 
-    return results;
+    query.finish();
+
+    return links;
 }
 
 QSqlDatabase Docset::database() const
 {
-    return QSqlDatabase::database(m_name, true);
+    // QSqlDatabase connections cannot be shared between threads, so every thread
+    // working with this docset (GUI, registry, search workers) gets its own one.
+    ThreadConnections *connections = ThreadConnections::current();
+    // Left by docsets closed or gone meanwhile
+    connections->closeRetired();
+
+    {
+        QMutexLocker locker(&m_connectionMutex);
+        m_lastUsed = QDateTime::currentMSecsSinceEpoch();
+        m_hasConnections = true;
+    }
+
+    ThreadConnections::Connection *connection = currentConnection(m_serial);
+    if (!connection) {
+        ThreadConnections::Connection newConnection;
+        // Docsets of the same name live side by side while one gets replaced
+        newConnection.name = QStringLiteral("%1_%2_%3").arg(m_name).arg(m_serial).arg(connections->serial);
+        {
+            ConnectionGenerations *state = connectionGenerations();
+            QMutexLocker locker(&state->mutex);
+            newConnection.generation = state->generations.value(m_serial);
+        }
+        connection = &connections->connections.insert(m_serial, newConnection).value();
+    }
+
+    QSqlDatabase db = QSqlDatabase::database(connection->name, false);
+    if (!db.isValid()) {
+        db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection->name);
+        // Docsets are never written to, which lets SQLite skip locking work
+        if (SharedStore::contains(m_databasePath)) {
+            db.setDatabaseName(SharedStore::databaseUri(m_databasePath));
+            db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY;QSQLITE_OPEN_URI"));
+        } else {
+            db.setDatabaseName(m_databasePath);
+            db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+        }
+    }
+
+    if (!db.isOpen()) {
+        if (!db.open()) {
+            qWarning("SQL Error: %s", qPrintable(db.lastError().text()));
+            return db;
+        }
+
+        QSqlQuery pragma(db);
+        pragma.exec(QStringLiteral("PRAGMA query_only = 1"));
+        // Reads come straight from the page cache of the OS instead of being copied
+        pragma.exec(QStringLiteral("PRAGMA mmap_size = 268435456"));
+    }
+
+    // Attached once it is built, connections opened before pick it up on their next use
+    if (m_hasSymbolList.load() && !connection->hasSymbolList) {
+        QSqlQuery attach(db);
+        attach.prepare(QStringLiteral("ATTACH DATABASE ? AS symbolList"));
+        attach.addBindValue(m_symbolListPath);
+        if (attach.exec()) {
+            connection->hasSymbolList = true;
+        } else {
+            // Symbols keep coming from the docset database
+            qWarning("SQL Error: %s", qPrintable(attach.lastError().text()));
+            m_hasSymbolList.store(0);
+        }
+    }
+
+    return db;
+}
+
+QSqlQuery Docset::statement(Statement id, const QString &queryStr) const
+{
+    QSqlDatabase db = database();
+
+    // Statements are prepared once per connection, copies share the prepared one
+    ThreadConnections::Connection *connection = currentConnection(m_serial);
+    if (!connection)
+        return QSqlQuery(db);
+
+    QHash<int, QSqlQuery> &statements = connection->statements;
+    if (statements.contains(id))
+        return statements.value(id);
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.prepare(queryStr)) {
+        qWarning("SQL Error: %s", qPrintable(query.lastError().text()));
+        return query;
+    }
+
+    statements.insert(id, query);
+    return query;
+}
+
+void Docset::fetchSearchRows(ResultArena *arena, Statement id, const QString &queryStr,
+                             const QStringList &values, const CancellationToken &token) const
+{
+    QSqlDatabase db = database();
+    token.watch(db);
+
+#ifdef USE_SQLITE_API
+    // Columns are copied from SQLite's own buffers, without a QVariant and a QString each
+    if (sqlite3_stmt *stmt = static_cast<sqlite3_stmt *>(rowStatement(db, id, queryStr))) {
+        QList<QByteArray> boundValues;
+        for (int i = 0; i < values.size(); ++i) {
+            boundValues.append(values.at(i).toUtf8());
+            sqlite3_bind_text(stmt, i + 1, boundValues.last().constData(),
+                              boundValues.last().size(), SQLITE_STATIC);
+        }
+
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW && !token.isCanceled()) {
+            // NULL reads as an empty string, as through QSqlQuery
+            const auto text = [stmt](int column) {
+                const char *value = reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+                return value ? value : "";
+            };
+            // sqlite3_column_bytes() has to follow sqlite3_column_text(), not precede it
+            const char *name = text(0);
+            const int nameSize = sqlite3_column_bytes(stmt, 0);
+            const char *type = text(1);
+            const int typeSize = sqlite3_column_bytes(stmt, 1);
+            const char *path = text(2);
+            const int pathSize = sqlite3_column_bytes(stmt, 2);
+            // FIXME: refactoring to use common code in ZealListModel and DocsetRegistry
+            if (m_type == Docset::Type::ZDash) {
+                const char *anchor = text(3);
+                arena->append(name, nameSize, type, typeSize, path, pathSize,
+                              anchor, sqlite3_column_bytes(stmt, 3));
+            } else {
+                arena->append(name, nameSize, type, typeSize, path, pathSize);
+            }
+        }
+
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE && !token.isCanceled())
+            qWarning("SQL Error: %s", sqlite3_errmsg(sqlite3_db_handle(stmt)));
+
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        token.unwatch(db);
+        return;
+    }
+#endif
+
+    QSqlQuery query = statement(id, queryStr);
+    for (int i = 0; i < values.size(); ++i)
+        query.bindValue(i, values.at(i));
+
+    if (!query.exec())
+        qWarning("SQL Error: %s", qPrintable(query.lastError().text()));
+    while (query.next() && !token.isCanceled()) {
+        const QByteArray name = query.value(0).toString().toUtf8();
+        const QByteArray type = query.value(1).toString().toUtf8();
+        const QByteArray path = query.value(2).toString().toUtf8();
+        // FIXME: refactoring to use common code in ZealListModel and DocsetRegistry
+        if (m_type == Docset::Type::ZDash) {
+            const QByteArray anchor = query.value(3).toString().toUtf8();
+            arena->append(name.constData(), name.size(), type.constData(), type.size(),
+                          path.constData(), path.size(), anchor.constData(), anchor.size());
+        } else {
+            arena->append(name.constData(), name.size(), type.constData(), type.size(),
+                          path.constData(), path.size());
+        }
+    }
+    token.unwatch(db);
+    query.finish();
+}
+
+#ifdef USE_SQLITE_API
+void *Docset::rowStatement(const QSqlDatabase &db, Statement id, const QString &queryStr) const
+{
+    ThreadConnections::Connection *connection = currentConnection(m_serial);
+    if (!connection)
+        return nullptr;
+
+    QHash<int, void *> &statements = connection->rowStatements;
+    if (void *stmt = statements.value(id))
+        return stmt;
+
+    sqlite3 *handle = static_cast<sqlite3 *>(SqliteHandle::get(db));
+    if (!handle)
+        return nullptr;
+
+    const QByteArray sql = queryStr.toUtf8();
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(handle, sql.constData(), sql.size(), &stmt, nullptr) != SQLITE_OK) {
+        qWarning("SQL Error: %s", sqlite3_errmsg(handle));
+        return nullptr;
+    }
+
+    statements.insert(id, stmt);
+    return stmt;
+}
+#endif
+
+QStringList Docset::databaseFiles() const
+{
+    return {m_searchIndexPath, m_symbolListPath, m_databasePath, m_fullTextIndexPath};
+}
+
+bool Docset::hasOpenConnections() const
+{
+    QMutexLocker locker(&m_connectionMutex);
+    return m_hasConnections;
+}
+
+qint64 Docset::lastUsed() const
+{
+    QMutexLocker locker(&m_connectionMutex);
+    return m_lastUsed;
+}
+
+bool Docset::closeConnections()
+{
+    if (!m_databaseLock.tryLockForWrite())
+        return false;
+
+    removeConnections();
+    m_databaseLock.unlock();
+    return true;
+}
+
+void Docset::removeConnections(bool isFinal)
+{
+    {
+        QMutexLocker locker(&m_connectionMutex);
+        m_hasConnections = false;
+    }
+
+    // Other threads close theirs on their next use of a docset, or when they finish
+    ConnectionGenerations *state = connectionGenerations();
+    {
+        QMutexLocker locker(&state->mutex);
+        if (isFinal)
+            state->generations.remove(m_serial);
+        else
+            ++state->generations[m_serial];
+        state->epoch.ref();
+    }
+
+    ThreadConnections::current()->closeRetired();
+}
+
+int Docset::score(const FuzzyMatcher &matcher, const QString &name, const QString &parentName,
+                  const QString &symbolType)
+{
+    int score = matcher.score(name, parentName);
+    // Found by a plain substring match deeper in the qualified name
+    if (score == FuzzyMatcher::NoMatch)
+        score = 0;
+    return score + FuzzyMatcher::typeBonus(symbolType);
 }
 
 void Docset::normalizeName(QString &name, QString &parentName)
 {
-    QRegExp matchMethodName("^([^\\(]+)(?:\\(.*\\))?$");
-    if (matchMethodName.indexIn(name) != -1)
-        name = matchMethodName.cap(1);
+    // Strip arguments of method names, like in "push_back(T)"
+    const int parenthesis = name.indexOf(QLatin1Char('('));
+    if (parenthesis > 0 && name.endsWith(QLatin1Char(')')))
+        name.truncate(parenthesis);
 
-    const QStringList separators = {QStringLiteral("."), QStringLiteral("::"), QStringLiteral("/")};
-    for (const QString &sep : separators) {
-        if (name.indexOf(sep) != -1 && name.indexOf(sep) != 0) {
-            const QStringList splitted = name.split(sep);
-            name = splitted.at(splitted.size()-1);
-            parentName = splitted.at(splitted.size()-2);
+    static const QLatin1String separators[] = {
+        QLatin1String("."), QLatin1String("::"), QLatin1String("/")
+    };
+
+    for (const QLatin1String &separator : separators) {
+        int pos = name.indexOf(separator);
+        if (pos <= 0)
+            continue;
+
+        // Find the last two parts, the same as splitting at every separator would
+        int parentStart = 0;
+        int nameStart = pos + separator.size();
+        while ((pos = name.indexOf(separator, nameStart)) != -1) {
+            parentStart = nameStart;
+            nameStart = pos + separator.size();
         }
+
+        parentName = name.mid(parentStart, nameStart - separator.size() - parentStart);
+        name.remove(0, nameStart);
     }
 }
 
 void Docset::findIcon()
 {
+    QStringList iconPaths;
+
     const QDir dir(m_path);
-    for (const QString &iconFile : dir.entryList({QStringLiteral("icon.*")}, QDir::Files)) {
-        m_icon = QIcon(dir.absoluteFilePath(iconFile));
-        if (!m_icon.availableSizes().isEmpty())
-            return;
-    }
+    for (const QString &iconFile : dir.entryList({QStringLiteral("icon.*")}, QDir::Files))
+        iconPaths.append(dir.absoluteFilePath(iconFile));
 
-    m_icon = QIcon(QString(QStringLiteral("docsetIcon:%1.png")).arg(m_name));
-    if (!m_icon.availableSizes().isEmpty())
-        return;
+    iconPaths.append(QString(QStringLiteral("docsetIcon:%1.png")).arg(m_name));
 
     QString bundleName = info.bundleName;
     bundleName.replace(QLatin1String(" "), QLatin1String("_"));
-    m_icon = QIcon(QString(QStringLiteral("docsetIcon:%1.png")).arg(bundleName));
-    if (!m_icon.availableSizes().isEmpty())
-        return;
+    iconPaths.append(QString(QStringLiteral("docsetIcon:%1.png")).arg(bundleName));
 
     // Fallback to identifier and docset file name.
-    m_icon = QIcon(QString(QStringLiteral("docsetIcon:%1.png")).arg(info.bundleIdentifier));
-    if (!m_icon.availableSizes().isEmpty())
-        return;
+    iconPaths.append(QString(QStringLiteral("docsetIcon:%1.png")).arg(info.bundleIdentifier));
+
+    for (const QString &iconPath : iconPaths) {
+        if (IconCache::isIconFile(iconPath)) {
+            // Remembered for the manifest, which saves probing on the next start
+            m_iconPath = iconPath;
+            m_icon = IconCache::icon(iconPath);
+            return;
+        }
+    }
 }
 
 void Docset::countSymbols()
 {
+    if (m_searchIndex) {
+        const QMap<QString, int> counts = m_searchIndex->typeCounts();
+        for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+            // Tokens without a type are found by searches, but have no symbol list
+            if (it.key().isEmpty())
+                continue;
+
+            const QString symbolType = parseSymbolType(it.key());
+            m_symbolStrings.insertMulti(symbolType, it.key());
+            m_symbolCounts[symbolType] += it.value();
+        }
+        return;
+    }
+
     QString queryStr;
     if (m_type == Docset::Type::Dash) {
         queryStr = QStringLiteral("SELECT type, COUNT(*) FROM searchIndex GROUP BY type");
@@ -236,6 +1292,8 @@ void Docset::countSymbols()
                                   " ON ztoken.ztokentype = ztokentype.z_pk GROUP BY ztypename");
     }
 
+    ZEAL_TRACE_SCOPE("sql", m_name);
+    QReadLocker databaseLocker(&m_databaseLock);
     QSqlQuery query(queryStr, database());
     if (query.lastError().type() != QSqlError::NoError) {
         qWarning("SQL Error: %s", qPrintable(query.lastError().text()));
@@ -250,157 +1308,204 @@ void Docset::countSymbols()
     }
 }
 
-/// TODO: Fetch and cache only portions of symbols
-void Docset::loadSymbols(const QString &symbolType) const
-{
-    for (const QString &symbol : m_symbolStrings.values(symbolType))
-        loadSymbols(symbolType, symbol);
-}
-
-void Docset::loadSymbols(const QString &symbolType, const QString &symbolString) const
+void Docset::loadSymbols(QVector<Symbol> &symbols, const QString &symbolString, const Symbol &after,
+                         int limit) const
 {
+    ZEAL_TRACE_SCOPE("sql", m_name);
+    QReadLocker databaseLocker(&m_databaseLock);
     QSqlDatabase db = database();
     if (!db.isOpen())
         return;
 
+    const ThreadConnections::Connection *connection = currentConnection(m_serial);
+    const bool hasSymbolList = connection && connection->hasSymbolList;
+
+    // A null string would bind as NULL, which is neither less nor greater than any name
+    const QString afterName = after.name.isNull() ? QStringLiteral("") : after.name;
+
+    // The copy has the same row ids, so pages are the same as from the docset database
+    QSqlQuery query = hasSymbolList
+            ? statement(SymbolListStatement,
+                        QStringLiteral("SELECT name, path, id FROM symbolList.symbols WHERE type = ?"
+                                       " AND (name > ? OR (name = ? AND id > ?))"
+                                       " ORDER BY name ASC, id ASC LIMIT ?"))
+            : statement(SymbolsStatement, symbolsQuery(m_type));
+    query.bindValue(0, symbolString);
+    query.bindValue(1, afterName);
+    query.bindValue(2, afterName);
+    query.bindValue(3, after.id);
+    query.bindValue(4, limit);
+    if (!query.exec()) {
+        qWarning("SQL Error: %s", qPrintable(query.lastError().text()));
+        return;
+    }
+
+    while (query.next()) {
+        Symbol symbol;
+        symbol.name = query.value(0).toString();
+        symbol.path = query.value(1).toString();
+        symbol.id = query.value(2).toLongLong();
+        symbols.append(symbol);
+    }
+
+    query.finish();
+}
+
+void Docset::buildSearchIndex()
+{
+    ZEAL_TRACE_SCOPE("index", m_name);
     QString queryStr;
     switch (m_type) {
     case Docset::Type::Dash:
-        queryStr = QStringLiteral("SELECT name, path FROM searchIndex WHERE type='%1' ORDER BY name ASC");
+        queryStr = QStringLiteral("SELECT name, type, path FROM searchIndex");
         break;
     case Docset::Type::ZDash:
-        queryStr = QStringLiteral("SELECT ztokenname AS name, "
+        queryStr = QStringLiteral("SELECT ztokenname, ztypename, "
                                   "CASE WHEN (zanchor IS NULL) THEN zpath "
-                                  "ELSE (zpath || '#' || zanchor) "
-                                  "END AS path FROM ztoken "
+                                  "ELSE (zpath || '#' || zanchor) END "
+                                  "FROM ztoken "
                                   "JOIN ztokenmetainformation ON ztoken.zmetainformation = ztokenmetainformation.z_pk "
                                   "JOIN zfilepath ON ztokenmetainformation.zfile = zfilepath.z_pk "
-                                  "JOIN ztokentype ON ztoken.ztokentype = ztokentype.z_pk WHERE ztypename='%1' "
-                                  "ORDER BY ztokenname ASC");
+                                  // Tokens without a type are still searchable
+                                  "LEFT JOIN ztokentype ON ztoken.ztokentype = ztokentype.z_pk");
         break;
     }
 
-    QSqlQuery query(queryStr.arg(symbolString), database());
+    QReadLocker databaseLocker(&m_databaseLock);
+    const QSqlDatabase db = database();
+    m_buildToken.watch(db);
+    QSqlQuery query(queryStr, db);
     if (query.lastError().type() != QSqlError::NoError) {
-        qWarning("SQL Error: %s", qPrintable(query.lastError().text()));
+        m_buildToken.unwatch(db);
+        if (!m_buildToken.isCanceled())
+            qWarning("SQL Error: %s", qPrintable(query.lastError().text()));
         return;
     }
 
-    QMap<QString, QString> &symbols = m_symbols[symbolType];
-    while (query.next())
-        symbols.insertMulti(query.value(0).toString(), QDir(documentPath()).absoluteFilePath(query.value(1).toString()));
+    SearchIndex::Builder builder;
+    while (!m_buildToken.isCanceled() && query.next())
+        builder.addSymbol(query.value(0).toString(), query.value(1).toString(), query.value(2).toString());
+    query.finish();
+    m_buildToken.unwatch(db);
+
+    if (m_buildToken.isCanceled())
+        return;
+
+    SearchIndex *index = SearchIndex::fromData(builder.build(m_type, QFileInfo(m_databasePath)));
+    if (!index)
+        return;
+
+    // Not fatal, the index is going to be rebuilt on the next start
+    if (!index->save(m_searchIndexPath))
+        qWarning("Cannot save search index: %s", qPrintable(m_searchIndexPath));
+
+    QMutexLocker locker(&m_searchIndexMutex);
+    m_searchIndex = QSharedPointer<const SearchIndex>(index);
 }
 
-QString Docset::parseSymbolType(const QString &str)
+void Docset::checkQueryPlans()
 {
-    /// Dash symbol aliases
-    const static QHash<QString, QString> aliases = {
-        // Attribute
-        {QStringLiteral("Package Attributes"), QStringLiteral("Attribute")},
-        {QStringLiteral("Private Attributes"), QStringLiteral("Attribute")},
-        {QStringLiteral("Protected Attributes"), QStringLiteral("Attribute")},
-        {QStringLiteral("Public Attributes"), QStringLiteral("Attribute")},
-        {QStringLiteral("Static Package Attributes"), QStringLiteral("Attribute")},
-        {QStringLiteral("Static Private Attributes"), QStringLiteral("Attribute")},
-        {QStringLiteral("Static Protected Attributes"), QStringLiteral("Attribute")},
-        {QStringLiteral("Static Public Attributes"), QStringLiteral("Attribute")},
-        {QStringLiteral("XML Attributes"), QStringLiteral("Attribute")},
-        // Binding
-        {QStringLiteral("binding"), QStringLiteral("Binding")},
-        // Category
-        {QStringLiteral("cat"), QStringLiteral("Category")},
-        {QStringLiteral("Groups"), QStringLiteral("Category")},
-        {QStringLiteral("Pages"), QStringLiteral("Category")},
-        // Class
-        {QStringLiteral("cl"), QStringLiteral("Class")},
-        {QStringLiteral("specialization"), QStringLiteral("Class")},
-        {QStringLiteral("tmplt"), QStringLiteral("Class")},
-        // Constant
-        {QStringLiteral("data"), QStringLiteral("Constant")},
-        {QStringLiteral("econst"), QStringLiteral("Constant")},
-        {QStringLiteral("enumelt"), QStringLiteral("Constant")},
-        {QStringLiteral("clconst"), QStringLiteral("Constant")},
-        {QStringLiteral("structdata"), QStringLiteral("Constant")},
-        {QStringLiteral("Notifications"), QStringLiteral("Constant")},
-        // Constructor
-        {QStringLiteral("Public Constructors"), QStringLiteral("Constructor")},
-        // Enumeration
-        {QStringLiteral("enum"), QStringLiteral("Enumeration")},
-        {QStringLiteral("Enum"), QStringLiteral("Enumeration")},
-        {QStringLiteral("Enumerations"), QStringLiteral("Enumeration")},
-        // Event
-        {QStringLiteral("event"), QStringLiteral("Event")},
-        {QStringLiteral("Public Events"), QStringLiteral("Event")},
-        {QStringLiteral("Inherited Events"), QStringLiteral("Event")},
-        {QStringLiteral("Private Events"), QStringLiteral("Event")},
-        // Field
-        {QStringLiteral("Data Fields"), QStringLiteral("Field")},
-        // Function
-        {QStringLiteral("dcop"), QStringLiteral("Function")},
-        {QStringLiteral("func"), QStringLiteral("Function")},
-        {QStringLiteral("ffunc"), QStringLiteral("Function")},
-        {QStringLiteral("signal"), QStringLiteral("Function")},
-        {QStringLiteral("slot"), QStringLiteral("Function")},
-        {QStringLiteral("grammar"), QStringLiteral("Function")},
-        {QStringLiteral("Function Prototypes"), QStringLiteral("Function")},
-        {QStringLiteral("Functions/Subroutines"), QStringLiteral("Function")},
-        {QStringLiteral("Members"), QStringLiteral("Function")},
-        {QStringLiteral("Package Functions"), QStringLiteral("Function")},
-        {QStringLiteral("Private Member Functions"), QStringLiteral("Function")},
-        {QStringLiteral("Private Slots"), QStringLiteral("Function")},
-        {QStringLiteral("Protected Member Functions"), QStringLiteral("Function")},
-        {QStringLiteral("Protected Slots"), QStringLiteral("Function")},
-        {QStringLiteral("Public Member Functions"), QStringLiteral("Function")},
-        {QStringLiteral("Public Slots"), QStringLiteral("Function")},
-        {QStringLiteral("Signals"), QStringLiteral("Function")},
-        {QStringLiteral("Static Package Functions"), QStringLiteral("Function")},
-        {QStringLiteral("Static Private Member Functions"), QStringLiteral("Function")},
-        {QStringLiteral("Static Protected Member Functions"), QStringLiteral("Function")},
-        {QStringLiteral("Static Public Member Functions"), QStringLiteral("Function")},
-        // Guide
-        {QStringLiteral("doc"), QStringLiteral("Guide")},
-        // Namespace
-        {QStringLiteral("ns"), QStringLiteral("Namespace")},
-        // Macro
-        {QStringLiteral("macro"), QStringLiteral("Macro")},
-        // Method
-        {QStringLiteral("clm"), QStringLiteral("Method")},
-        {QStringLiteral("intfctr"), QStringLiteral("Method")},
-        {QStringLiteral("intfcm"), QStringLiteral("Method")},
-        {QStringLiteral("intfm"), QStringLiteral("Method")},
-        {QStringLiteral("instctr"), QStringLiteral("Method")},
-        {QStringLiteral("instm"), QStringLiteral("Method")},
-        {QStringLiteral("Class Methods"), QStringLiteral("Method")},
-        {QStringLiteral("Inherited Methods"), QStringLiteral("Method")},
-        {QStringLiteral("Instance Methods"), QStringLiteral("Method")},
-        {QStringLiteral("Private Methods"), QStringLiteral("Method")},
-        {QStringLiteral("Protected Methods"), QStringLiteral("Method")},
-        {QStringLiteral("Public Methods"), QStringLiteral("Method")},
-        // Property
-        {QStringLiteral("intfp"), QStringLiteral("Property")},
-        {QStringLiteral("instp"), QStringLiteral("Property")},
-        {QStringLiteral("Inherited Properties"), QStringLiteral("Property")},
-        {QStringLiteral("Private Properties"), QStringLiteral("Property")},
-        {QStringLiteral("Protected Properties"), QStringLiteral("Property")},
-        {QStringLiteral("Public Properties"), QStringLiteral("Property")},
-        // Protocol
-        {QStringLiteral("intf"), QStringLiteral("Protocol")},
-        // Structure
-        {QStringLiteral("struct"), QStringLiteral("Structure")},
-        {QStringLiteral("Data Structures"), QStringLiteral("Structure")},
-        {QStringLiteral("Struct"), QStringLiteral("Structure")},
-        // Type
-        {QStringLiteral("tag"), QStringLiteral("Type")},
-        {QStringLiteral("tdef"), QStringLiteral("Type")},
-        {QStringLiteral("Data Types"), QStringLiteral("Type")},
-        {QStringLiteral("Package Types"), QStringLiteral("Type")},
-        {QStringLiteral("Private Types"), QStringLiteral("Type")},
-        {QStringLiteral("Protected Types"), QStringLiteral("Type")},
-        {QStringLiteral("Public Types"), QStringLiteral("Type")},
-        {QStringLiteral("Typedefs"), QStringLiteral("Type")},
-        // Variable
-        {QStringLiteral("var"), QStringLiteral("Variable")}
-    };
+    QReadLocker databaseLocker(&m_databaseLock);
+    QSqlDatabase db = database();
+    if (!db.isOpen())
+        return;
+
+    m_slowQueries.clear();
+
+    if (isSlowPlan(db, symbolsQuery(m_type), {QStringLiteral("searchIndex"), QStringLiteral("ztoken")}))
+        m_slowQueries.append(QStringLiteral("symbols"));
+
+    // Dash docsets match pages with LIKE, which no index helps with
+    if (m_type == Docset::Type::ZDash
+            && isSlowPlan(db, relatedLinksQuery(m_type),
+                          {QStringLiteral("zfilepath"), QStringLiteral("ztokenmetainformation")})) {
+        m_slowQueries.append(QStringLiteral("relatedLinks"));
+    }
+
+    if (!m_slowQueries.isEmpty()) {
+        qWarning("Docset %s lacks indexes for queries: %s", qPrintable(m_name),
+                 qPrintable(m_slowQueries.join(QStringLiteral(", "))));
+    }
+}
+
+bool Docset::isSymbolListUpToDate() const
+{
+    const QFileInfo fileInfo(m_symbolListPath);
+    return fileInfo.exists() && fileInfo.lastModified() >= QFileInfo(m_databasePath).lastModified();
+}
+
+void Docset::buildSymbolList()
+{
+    ZEAL_TRACE_SCOPE("index", m_name);
+    QString selectStr;
+    switch (m_type) {
+    case Docset::Type::Dash:
+        selectStr = QStringLiteral("SELECT type, name, path, rowid FROM source.searchIndex");
+        break;
+    case Docset::Type::ZDash:
+        selectStr = QStringLiteral("SELECT ztypename, ztokenname, "
+                                   "CASE WHEN (zanchor IS NULL) THEN zpath "
+                                   "ELSE (zpath || '#' || zanchor) END, ztoken.z_pk "
+                                   "FROM source.ztoken "
+                                   "JOIN source.ztokenmetainformation ON ztoken.zmetainformation = ztokenmetainformation.z_pk "
+                                   "JOIN source.zfilepath ON ztokenmetainformation.zfile = zfilepath.z_pk "
+                                   "LEFT JOIN source.ztokentype ON ztoken.ztokentype = ztokentype.z_pk");
+        break;
+    }
 
-    return aliases.value(str, str);
+    // SQLite keeps indexes in the file of their table, so the symbol list gets copied along.
+    // It is written under another name, and only renamed once complete.
+    const QString partPath = m_symbolListPath + QLatin1String(".part");
+    const QString connectionName = m_name + QLatin1String("_symbolList");
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+        db.setDatabaseName(partPath);
+        // The source of a shared store gets attached by URI
+        if (SharedStore::contains(m_databasePath))
+            db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_URI"));
+        QFile::remove(partPath);
+        if (db.open()) {
+            QSqlQuery query(db);
+            // An interrupted build leaves nothing to recover
+            query.exec(QStringLiteral("PRAGMA journal_mode = OFF"));
+            query.exec(QStringLiteral("PRAGMA synchronous = OFF"));
+            query.prepare(QStringLiteral("ATTACH DATABASE ? AS source"));
+            query.addBindValue(SharedStore::contains(m_databasePath)
+                               ? SharedStore::databaseUri(m_databasePath) : m_databasePath);
+            // Copying is a single statement, an interrupt is the only way to cut it short
+            m_buildToken.watch(db);
+            ok = query.exec()
+                    && query.exec(QStringLiteral("CREATE TABLE symbols(type TEXT, name TEXT, path TEXT, id INTEGER)"))
+                    && query.exec(QStringLiteral("INSERT INTO symbols ") + selectStr)
+                    && query.exec(QStringLiteral("CREATE INDEX symbols_type_name ON symbols(type, name, id)"));
+            m_buildToken.unwatch(db);
+            if (!ok && !m_buildToken.isCanceled())
+                qWarning("SQL Error: %s", qPrintable(query.lastError().text()));
+            query.exec(QStringLiteral("DETACH DATABASE source"));
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    if (m_buildToken.isCanceled()) {
+        QFile::remove(partPath);
+        return;
+    }
+
+    QFile::remove(m_symbolListPath);
+    if (!ok || !QFile::rename(partPath, m_symbolListPath)) {
+        // Not fatal, symbols keep coming from the docset database
+        QFile::remove(partPath);
+        qWarning("Cannot save symbol list: %s", qPrintable(m_symbolListPath));
+        return;
+    }
+
+    m_hasSymbolList.store(1);
+}
+
+QString Docset::parseSymbolType(const QString &str)
+{
+    const SymbolType::Id type = SymbolType::fromString(str);
+    return type == SymbolType::Other ? str : SymbolType::name(type);
 }
@@ -1,17 +1,36 @@
 #ifndef DOCSET_H
 #define DOCSET_H
 
+#include "buildtask.h"
+#include "cancellationtoken.h"
 #include "docsetinfo.h"
 #include "docsetmetadata.h"
 #include "searchresult.h"
 
+#include <QAtomicInt>
+#include <QCache>
 #include <QIcon>
+#include <QJsonObject>
 #include <QMap>
 #include <QMetaObject>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSharedPointer>
 #include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QUrl>
+#include <QVector>
 
 namespace Zeal {
 
+class CompletionTrie;
+class DocumentArchive;
+class FullTextIndex;
+class FuzzyMatcher;
+class ResultArena;
+class SearchIndex;
+class SearchQuery;
+
 class Docset : public QObject
 {
     Q_OBJECT
@@ -21,10 +40,17 @@ public:
         ZDash
     };
 
-    explicit Docset(const QString &path);
+    /// Loads the docset at \a path, or takes its properties from \a manifestEntry if given.
+    explicit Docset(const QString &path, const QJsonObject &manifestEntry = QJsonObject());
     ~Docset() override;
 
+    /// Takes ownership of \a docset. Search results of a shared docset keep it alive, so
+    /// that it can be removed while they are still shown or being searched for.
+    static QSharedPointer<Docset> share(Docset *docset);
+
     bool isValid() const;
+    /// Returns the properties of this docset for storing in a DocsetManifest
+    QJsonObject manifestEntry() const;
     bool hasMetadata() const;
 
     QString name() const;
@@ -32,17 +58,81 @@ public:
     Docset::Type type() const;
     QString path() const;
     QString documentPath() const;
+    /// Returns the URL of \a path relative to documentPath(), which may include an anchor
+    QUrl documentUrl(const QString &path) const;
     QIcon icon() const;
+    /// Returns the path of the start page relative to documentPath()
     QString indexFilePath() const;
 
     QMap<QString, int> symbolCounts() const;
     int symbolCount(const QString &symbolType) const;
 
-    const QMap<QString, QString> &symbols(const QString &symbolType) const;
+    /// Symbol listed in a group of symbols of the same type
+    struct Symbol {
+        QString name;
+        QString path; // Relative to documentPath()
+        qint64 id = 0; // Row id, which orders symbols of the same name
+    };
 
-    QList<SearchResult> relatedLinks(const QUrl &url) const;
+    /// Returns up to \a limit symbols of \a symbolType ordered by name, which follow \a after.
+    /// A default constructed \a after gives the first symbols.
+    QVector<Symbol> symbols(const QString &symbolType, const Symbol &after, int limit) const;
+    /// Limits the least recently used symbol pages kept for all docsets to about \a bytes,
+    /// but no less than a few pages which are read from the GUI thread otherwise
+    static void setSymbolCacheSize(int bytes);
+
+    /// Returns the standard queries, like "symbols", that the database has no indexes for.
+    /// They are checked when the docset is loaded for the first time or after an update.
+    QStringList slowQueries() const;
+    /// Sets whether docsets with slow symbol lists get an indexed copy of them
+    static void setBuildMissingIndexes(bool enabled);
+
+    /// Returns the in-memory search index, or null if it is not built yet
+    QSharedPointer<const SearchIndex> searchIndex() const;
+    /// Returns the trie for completing symbol names, or null until it is built in the
+    /// background, which the first call starts once the search index is there
+    QSharedPointer<const CompletionTrie> completionTrie() const;
+
+    /// Symbols matched by a previous search, used to narrow down extended queries
+    struct SearchCandidates {
+        QSharedPointer<const SearchIndex> searchIndex;
+        QString query;
+        QVector<int> symbolIds;
+        bool isComplete = false;
+    };
 
+    /// Returns up to \a limit best symbols matching \a query. If \a candidates hold a complete
+    /// result of a query that \a query extends, only these are checked. On return \a candidates
+    /// are updated with the result of this search. Returns early when \a token gets canceled.
+    QVector<SearchResult> search(const SearchQuery &query, int limit,
+                               SearchCandidates *candidates = nullptr,
+                               const CancellationToken &token = CancellationToken()) const;
+    /// Returns up to \a limit pages best matching the words of \a query, see FullTextIndex.
+    /// Returns nothing until the full-text index is built.
+    QVector<SearchResult> fullTextSearch(const SearchQuery &query, int limit,
+                                         const CancellationToken &token = CancellationToken()) const;
+    /// Returns an excerpt of the page \a path around the first of \a terms
+    QString fullTextSnippet(const QString &path, const QStringList &terms) const;
+    /// Sets whether full-text indexes get built, for docsets loaded from now on and for
+    /// the first full-text search of the others
+    static void setFullTextIndexEnabled(bool enabled);
+
+    /// Returns symbols of the page \a url, the last looked up pages are cached.
+    QVector<SearchResult> relatedLinks(const QUrl &url) const;
+
+    /// Returns a read-only database connection owned by the calling thread
     QSqlDatabase database() const;
+    /// Returns the index files and the database they are built from, the most read first.
+    /// Not all of them may exist.
+    QStringList databaseFiles() const;
+
+    bool hasOpenConnections() const;
+    /// Returns when a database connection was last requested, in ms since the epoch
+    qint64 lastUsed() const;
+    /// Closes the database connections of all threads, they get reopened on next use. Other
+    /// threads close theirs on their next database use, or when they finish.
+    /// Returns false if a connection is in use at the moment.
+    bool closeConnections();
 
     QString prefix;
     DocsetMetadata metadata;
@@ -50,15 +140,59 @@ public:
 
     /// FIXME: Get rid of it
     static void normalizeName(QString &name, QString &parentName);
+    /// Maps Dash symbol type aliases to their common name
+    static QString parseSymbolType(const QString &str);
 
 private:
-    void findIcon();
-    void countSymbols();
-    void loadSymbols(const QString &symbolType) const;
-    void loadSymbols(const QString &symbolType, const QString &symbolString) const;
+    enum Statement {
+        SearchPrefixStatement,
+        SearchSubstringStatement,
+        RelatedLinksStatement,
+        SymbolsStatement,
+        SymbolListStatement
+    };
 
-    static QString parseSymbolType(const QString &str);
+    /// Returns statement \a id prepared from \a queryStr on the calling thread's connection
+    QSqlQuery statement(Statement id, const QString &queryStr) const;
+    /// Appends rows of statement \a id with \a values bound to \a arena. Rows are read
+    /// straight from SQLite when it is linked, or through QSqlQuery otherwise.
+    void fetchSearchRows(ResultArena *arena, Statement id, const QString &queryStr,
+                         const QStringList &values, const CancellationToken &token) const;
+#ifdef USE_SQLITE_API
+    /// Returns the sqlite3_stmt like statement() does, or null without a usable SqliteHandle
+    void *rowStatement(const QSqlDatabase &db, Statement id, const QString &queryStr) const;
+#endif
+    /// Closes the connections of the calling thread and retires those of other threads,
+    /// for good if \a isFinal. The caller holds m_databaseLock for writing.
+    void removeConnections(bool isFinal = false);
+
+    struct RelatedLink {
+        QString name;
+        QString path;
+    };
+
+    QVector<RelatedLink> findRelatedLinks(const QString &pagePath) const;
+    QVector<RelatedLink> queryRelatedLinks(const QString &pagePath) const;
 
+    static int score(const FuzzyMatcher &matcher, const QString &name, const QString &parentName,
+                     const QString &symbolType);
+
+    bool load();
+    void setIndexPaths();
+    bool readManifestEntry(const QJsonObject &entry);
+    void findIcon();
+    void countSymbols();
+    void loadSymbols(QVector<Symbol> &symbols, const QString &symbolString, const Symbol &after,
+                     int limit) const;
+    void checkQueryPlans();
+    bool isSymbolListUpToDate() const;
+    void buildSymbolList();
+    void buildSearchIndex();
+    void buildCompletionTrie(const QSharedPointer<const SearchIndex> &index) const;
+    QSharedPointer<const FullTextIndex> fullTextIndex() const;
+    void buildFullTextIndex() const;
+
+    QWeakPointer<Docset> m_self; // Set by share(), results hold it
     bool m_isValid = false;
     bool m_hasMetadata = false;
 
@@ -66,11 +200,47 @@ private:
     QString m_title;
     Docset::Type m_type;
     QString m_path;
+    QString m_documentPath;
+    QString m_databasePath;
+    QString m_searchIndexPath;
+    QSharedPointer<const DocumentArchive> m_documentArchive;
     QIcon m_icon;
+    QString m_iconPath;
+
+    // Held for reading while connections are used, and for writing while they get closed
+    mutable QReadWriteLock m_databaseLock;
+    // Connections and their statements are kept per thread, see database()
+    int m_serial = 0;
+    mutable QMutex m_connectionMutex;
+    mutable qint64 m_lastUsed = 0;
+    mutable bool m_hasConnections = false; // Since the last removeConnections()
+
+    mutable QMutex m_relatedLinksMutex;
+    // By page path, results would keep the docset alive
+    mutable QCache<QString, QVector<RelatedLink>> m_relatedLinks{32};
+
+    mutable QMutex m_searchIndexMutex;
+    QSharedPointer<const SearchIndex> m_searchIndex;
+    BuildTask m_searchIndexBuild;
+
+    mutable QMutex m_completionTrieMutex;
+    mutable QSharedPointer<const CompletionTrie> m_completionTrie;
+    mutable BuildTask m_completionTrieBuild;
+
+    QString m_fullTextIndexPath;
+    mutable QMutex m_fullTextIndexMutex;
+    mutable QSharedPointer<const FullTextIndex> m_fullTextIndex;
+    mutable bool m_isFullTextIndexQueued = false;
+    CancellationToken m_fullTextIndexToken; // Canceled when the docset goes away
+    CancellationToken m_buildToken; // Stops the index and symbol list builds
+
+    QStringList m_slowQueries;
+    QString m_symbolListPath;
+    QAtomicInt m_hasSymbolList;
+    BuildTask m_symbolListBuild;
 
     QMap<QString, QString> m_symbolStrings;
     QMap<QString, int> m_symbolCounts;
-    mutable QMap<QString, QMap<QString, QString>> m_symbols;
 };
 
 } // namespace Zeal
@@ -1,6 +1,7 @@
 #include "docsetinfo.h"
 
 #include <QFile>
+#include <QJsonObject>
 #include <QVariant>
 #include <QXmlStreamReader>
 
@@ -60,3 +61,29 @@ DocsetInfo DocsetInfo::fromPlist(const QString &filePath)
 
     return docsetInfo;
 }
+
+DocsetInfo DocsetInfo::fromJson(const QJsonObject &jsonObject)
+{
+    DocsetInfo docsetInfo;
+    docsetInfo.bundleName = jsonObject[QStringLiteral("bundleName")].toString();
+    docsetInfo.bundleIdentifier = jsonObject[QStringLiteral("bundleIdentifier")].toString();
+    docsetInfo.indexPath = jsonObject[QStringLiteral("indexPath")].toString();
+    docsetInfo.family = jsonObject[QStringLiteral("family")].toString();
+    docsetInfo.keyword = jsonObject[QStringLiteral("keyword")].toString();
+    docsetInfo.isDashDocset = jsonObject[QStringLiteral("isDashDocset")].toBool();
+    docsetInfo.isJavaScriptEnabled = jsonObject[QStringLiteral("isJavaScriptEnabled")].toBool();
+    return docsetInfo;
+}
+
+QJsonObject DocsetInfo::toJson() const
+{
+    QJsonObject jsonObject;
+    jsonObject[QStringLiteral("bundleName")] = bundleName;
+    jsonObject[QStringLiteral("bundleIdentifier")] = bundleIdentifier;
+    jsonObject[QStringLiteral("indexPath")] = indexPath;
+    jsonObject[QStringLiteral("family")] = family;
+    jsonObject[QStringLiteral("keyword")] = keyword;
+    jsonObject[QStringLiteral("isDashDocset")] = isDashDocset;
+    jsonObject[QStringLiteral("isJavaScriptEnabled")] = isJavaScriptEnabled;
+    return jsonObject;
+}
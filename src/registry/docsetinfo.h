@@ -3,11 +3,16 @@
 
 #include <QString>
 
+class QJsonObject;
+
 namespace Zeal {
 
 struct DocsetInfo
 {
     static DocsetInfo fromPlist(const QString &filePath);
+    static DocsetInfo fromJson(const QJsonObject &jsonObject);
+
+    QJsonObject toJson() const;
 
     QString bundleName;
     QString bundleIdentifier;
@@ -0,0 +1,100 @@
+#include "docsetmanifest.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+using namespace Zeal;
+
+namespace {
+/// Increase whenever the content of entries changes
+const int ManifestVersion = 2;
+}
+
+DocsetManifest DocsetManifest::fromFile(const QString &fileName)
+{
+    DocsetManifest manifest;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return manifest;
+
+    const QJsonObject jsonObject = QJsonDocument::fromJson(file.readAll()).object();
+    if (jsonObject[QStringLiteral("version")].toInt() != ManifestVersion)
+        return manifest;
+
+    manifest.m_entries = jsonObject[QStringLiteral("docsets")].toObject();
+    return manifest;
+}
+
+bool DocsetManifest::save(const QString &fileName) const
+{
+    QJsonObject jsonObject;
+    jsonObject[QStringLiteral("version")] = ManifestVersion;
+    jsonObject[QStringLiteral("docsets")] = m_entries;
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(QJsonDocument(jsonObject).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+bool DocsetManifest::isModified() const
+{
+    return m_isModified;
+}
+
+QJsonObject DocsetManifest::entry(const QString &path) const
+{
+    const QJsonObject record = m_entries[path].toObject();
+    if (record[QStringLiteral("stamp")].toString() != stamp(path))
+        return QJsonObject();
+    return record[QStringLiteral("docset")].toObject();
+}
+
+void DocsetManifest::setEntry(const QString &path, const QJsonObject &entry)
+{
+    QJsonObject record;
+    record[QStringLiteral("stamp")] = stamp(path);
+    record[QStringLiteral("docset")] = entry;
+
+    if (m_entries[path].toObject() == record)
+        return;
+
+    m_entries[path] = record;
+    m_isModified = true;
+}
+
+void DocsetManifest::removeEntry(const QString &path)
+{
+    if (!m_entries.contains(path))
+        return;
+
+    m_entries.remove(path);
+    m_isModified = true;
+}
+
+void DocsetManifest::retainEntries(const QStringList &paths)
+{
+    for (const QString &path : m_entries.keys()) {
+        if (!paths.contains(path))
+            removeEntry(path);
+    }
+}
+
+QString DocsetManifest::stamp(const QString &path)
+{
+    // The database changes on docset updates, the directory when files are replaced
+    const QFileInfo dirInfo(path);
+    const QFileInfo databaseInfo(QDir(path).absoluteFilePath(QStringLiteral("Contents/Resources/docSet.dsidx")));
+    if (!dirInfo.exists() || !databaseInfo.exists())
+        return QString();
+
+    // A string, as JSON numbers cannot hold all 64-bit values
+    return QStringLiteral("%1-%2-%3").arg(dirInfo.lastModified().toMSecsSinceEpoch())
+            .arg(databaseInfo.lastModified().toMSecsSinceEpoch()).arg(databaseInfo.size());
+}
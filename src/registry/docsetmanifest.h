@@ -0,0 +1,43 @@
+#ifndef DOCSETMANIFEST_H
+#define DOCSETMANIFEST_H
+
+#include <QJsonObject>
+#include <QStringList>
+
+namespace Zeal {
+
+/**
+ * @short Cache of loaded docset properties.
+ *
+ * Stores what loading a docset yields (parsed metadata, Info.plist, type, icon and
+ * symbol counts) for all docsets in a single file, so that warm starts don't need
+ * to parse and query every docset again. Entries are keyed by the docset path and
+ * only returned while the modification times of the docset directory and its
+ * database are unchanged.
+ */
+class DocsetManifest
+{
+public:
+    static DocsetManifest fromFile(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    bool isModified() const;
+
+    /// Returns the entry of the docset at \a path, or an empty object if it is outdated.
+    QJsonObject entry(const QString &path) const;
+    void setEntry(const QString &path, const QJsonObject &entry);
+    void removeEntry(const QString &path);
+    /// Removes entries of docsets, which are not in \a paths.
+    void retainEntries(const QStringList &paths);
+
+    /// Returns a string that changes whenever the docset at \a path gets updated
+    static QString stamp(const QString &path);
+
+private:
+    QJsonObject m_entries;
+    bool m_isModified = false;
+};
+
+} // namespace Zeal
+
+#endif // DOCSETMANIFEST_H
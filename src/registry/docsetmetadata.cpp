@@ -32,6 +32,12 @@ DocsetMetadata::DocsetMetadata(const QJsonObject &jsonObject)
     const QJsonArray urlArray = jsonObject[QStringLiteral("urls")].toArray();
     for (QJsonValue url : urlArray)
         m_urls.append(url.toString());
+
+    const QJsonObject deltas = jsonObject[QStringLiteral("deltas")].toObject();
+    for (auto it = deltas.constBegin(); it != deltas.constEnd(); ++it) {
+        for (const QJsonValue &url : it.value().toArray())
+            m_deltaUrls[it.key()].append(url.toString());
+    }
 }
 
 QString DocsetMetadata::source() const
@@ -49,6 +55,11 @@ void DocsetMetadata::toFile(const QString &fileName) const
 }
 
 QByteArray DocsetMetadata::toJson() const
+{
+    return QJsonDocument(toJsonObject()).toJson();
+}
+
+QJsonObject DocsetMetadata::toJsonObject() const
 {
     QJsonObject jsonObject;
 
@@ -78,7 +89,7 @@ QByteArray DocsetMetadata::toJson() const
         urls.append(url.toString());
     jsonObject[QStringLiteral("urls")] = urls;
 
-    return QJsonDocument(jsonObject).toJson();
+    return jsonObject;
 }
 
 QString DocsetMetadata::name() const
@@ -121,14 +132,18 @@ QUrl DocsetMetadata::feedUrl() const
     return m_feedUrl;
 }
 
-QUrl DocsetMetadata::url() const
+QList<QUrl> DocsetMetadata::urls() const
 {
-    return m_urls.at(qrand() % m_urls.size());
+    return m_urls;
 }
 
-QList<QUrl> DocsetMetadata::urls() const
+QList<QUrl> DocsetMetadata::deltaUrls(const DocsetMetadata &installed) const
 {
-    return m_urls;
+    const QString base = installed.revision().isEmpty() ? installed.version() : installed.revision();
+    if (base.isEmpty())
+        return QList<QUrl>();
+
+    return m_deltaUrls.value(base);
 }
 
 DocsetMetadata DocsetMetadata::fromFile(const QString &fileName)
@@ -169,6 +184,12 @@ DocsetMetadata DocsetMetadata::fromDashFeed(const QUrl &feedUrl, const QByteArra
             if (xml.readNext() != QXmlStreamReader::Characters)
                 continue;
             metadata.m_urls.append(xml.text().toString());
+        } else if (xml.name() == QStringLiteral("delta")) {
+            // <delta from="version">URL</delta>
+            const QString base = xml.attributes().value(QStringLiteral("from")).toString();
+            if (xml.readNext() != QXmlStreamReader::Characters || base.isEmpty())
+                continue;
+            metadata.m_deltaUrls[base].append(xml.text().toString());
         }
     }
 
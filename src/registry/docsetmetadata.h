@@ -1,6 +1,7 @@
 #ifndef DOCSETMETADATA_H
 #define DOCSETMETADATA_H
 
+#include <QHash>
 #include <QStringList>
 #include <QUrl>
 
@@ -20,6 +21,7 @@ public:
 
     void toFile(const QString &fileName) const;
     QByteArray toJson() const;
+    QJsonObject toJsonObject() const;
 
     QString name() const;
     QString icon() const;
@@ -30,8 +32,10 @@ public:
     QStringList oldVersions() const;
 
     QUrl feedUrl() const;
-    QUrl url() const;
     QList<QUrl> urls() const;
+    /// Returns URLs of a delta package, which updates the docset \a installed to this one,
+    /// or an empty list if there is none.
+    QList<QUrl> deltaUrls(const DocsetMetadata &installed) const;
 
     static DocsetMetadata fromFile(const QString &fileName);
     static DocsetMetadata fromDashFeed(const QUrl &feedUrl, const QByteArray &data);
@@ -49,6 +53,7 @@ private:
 
     QUrl m_feedUrl;
     QList<QUrl> m_urls;
+    QHash<QString, QList<QUrl>> m_deltaUrls; // By revision, or version if there are no revisions
 };
 
 } // namespace Zeal
@@ -1,20 +1,176 @@
 #include "docsetregistry.h"
 
+#include "cachewarmer.h"
+#include "completiontrie.h"
+#include "searchindex.h"
+#include "sharedstore.h"
 #include "searchquery.h"
 #include "searchresult.h"
+#include "core/tracer.h"
 
+#include <QDateTime>
 #include <QDir>
-#include <QSqlQuery>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
 #include <QThread>
-#include <QUrl>
-#include <QVariant>
+#include <QTimer>
+
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
 
 using namespace Zeal;
 
+namespace Zeal {
+struct DocsetSearchJob
+{
+    // Keeps the docset alive until the job is done, even if it has been abandoned
+    QSharedPointer<Docset> docset;
+    Docset::SearchCandidates candidates;
+    QVector<SearchResult> results;
+};
+} // namespace Zeal
+
+namespace {
+const char ManifestFileName[] = ".manifest.json";
+const char QueryCacheFileName[] = ".querycache";
+const char UsageFileName[] = ".usage.json";
+const char DatabaseFileName[] = "Contents/Resources/docSet.dsidx";
+
+// Changes on disk are applied once nothing has changed for this long, in ms
+const int RescanDelay = 2000;
+
+// Pending results are published at most once per frame, except for the first batch
+const int PublishInterval = 16;
+
+// How often docsets are checked for databases that can be closed, in ms
+const int IdleCheckInterval = 30000;
+
+// Caches are warmed once startup has settled, in ms after the docsets are loaded
+const int WarmDelay = 10000;
+
+struct DocsetSearch
+{
+    typedef DocsetSearchJob result_type;
+
+    DocsetSearch(const SearchQuery &q, int l, const CancellationToken &t) :
+        query(q),
+        limit(l),
+        token(t)
+    {
+    }
+
+    result_type operator()(const result_type &job) const
+    {
+        result_type result = job;
+        if (token.isCanceled())
+            return result;
+
+        const QString name = job.docset->name();
+        ZEAL_TRACE_SCOPE("search", name);
+        QElapsedTimer timer;
+        timer.start();
+
+        // Candidates only narrow down symbol searches
+        if (query.isFullText()) {
+            result.candidates = Docset::SearchCandidates();
+            result.results = job.docset->fullTextSearch(query, limit, token);
+        } else {
+            result.results = job.docset->search(query, limit, &result.candidates, token);
+        }
+
+        // Canceled searches return early, and would make the docset look fast
+        if (!token.isCanceled())
+            Core::Tracer::addLatency(name, timer.nsecsElapsed() / 1000);
+
+        return result;
+    }
+
+    SearchQuery query;
+    int limit;
+    CancellationToken token;
+};
+
+// Merges already sorted per-docset result lists preserving SearchResult ordering,
+// stopping after the best limit results.
+QVector<SearchResult> mergeResults(const QList<QVector<SearchResult>> &lists, int limit)
+{
+    ZEAL_TRACE_SCOPE("search", QStringLiteral("merge"));
+    typedef QPair<int, int> Cursor; // (list, position)
+
+    const auto greater = [&lists](const Cursor &lhs, const Cursor &rhs) {
+        return lists.at(rhs.first).at(rhs.second) < lists.at(lhs.first).at(lhs.second);
+    };
+
+    std::priority_queue<Cursor, std::vector<Cursor>, std::function<bool(const Cursor &, const Cursor &)>>
+            heap(greater);
+
+    int total = 0;
+    for (int i = 0; i < lists.size(); ++i) {
+        if (lists.at(i).isEmpty())
+            continue;
+        heap.push(Cursor(i, 0));
+        total += lists.at(i).size();
+    }
+
+    QVector<SearchResult> results;
+    results.reserve(qMin(total, limit));
+
+    while (!heap.empty() && results.size() < limit) {
+        const Cursor cursor = heap.top();
+        heap.pop();
+
+        const QVector<SearchResult> &list = lists.at(cursor.first);
+        results.append(list.at(cursor.second));
+
+        if (cursor.second + 1 < list.size())
+            heap.push(Cursor(cursor.first, cursor.second + 1));
+    }
+
+    return results;
+}
+}
+
 DocsetRegistry::DocsetRegistry(QObject *parent) :
     QObject(parent),
-    m_thread(new QThread(this))
+    m_thread(new QThread(this)),
+    m_resultLimit(500),
+    m_warmerThread(new QThread(this)),
+    m_warmer(new CacheWarmer()),
+    m_warmTimer(new QTimer(this)),
+    m_warmDocsetCount(5),
+    m_idleTimer(new QTimer(this)),
+    m_idleTimeout(300),
+    m_maxOpenDocsets(32),
+    m_watcher(new QFileSystemWatcher(this)),
+    m_rescanTimer(new QTimer(this))
 {
+    qRegisterMetaType<CancellationToken>();
+    qRegisterMetaType<QVector<SearchResult>>();
+
+    // The timer has to be started from the registry thread
+    m_idleTimer->setInterval(IdleCheckInterval);
+    connect(m_idleTimer, &QTimer::timeout, this, &DocsetRegistry::closeIdleDocsets);
+    connect(m_thread, &QThread::started, m_idleTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+
+    // Bursts of changes, like a docset being copied, result in a single rescan
+    m_rescanTimer->setInterval(RescanDelay);
+    m_rescanTimer->setSingleShot(true);
+    connect(m_rescanTimer, &QTimer::timeout, this, &DocsetRegistry::rescan);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged,
+            m_rescanTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(m_watcher, &QFileSystemWatcher::fileChanged,
+            m_rescanTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+
+    // Reads from the disk only when nothing else does
+    m_warmTimer->setInterval(WarmDelay);
+    m_warmTimer->setSingleShot(true);
+    connect(m_warmTimer, &QTimer::timeout, this, &DocsetRegistry::warmCaches);
+    m_warmer->moveToThread(m_warmerThread);
+    m_warmerThread->start(QThread::IdlePriority);
+
     /// FIXME: Only search should be performed in a separate thread
     moveToThread(m_thread);
     m_thread->start();
@@ -22,57 +178,277 @@ DocsetRegistry::DocsetRegistry(QObject *parent) :
 
 DocsetRegistry::~DocsetRegistry()
 {
+    m_loadFutures.waitForFinished();
+
+    m_warmerThread->requestInterruption();
+    m_warmerThread->quit();
+    m_warmerThread->wait();
+    delete m_warmer;
+
     m_thread->exit();
     m_thread->wait();
+
+    saveQueryCache();
+    saveUsage();
 }
 
 void DocsetRegistry::init(const QString &path)
 {
-    for (const QString &name : m_docsets.keys())
-        remove(name);
+    // The directory is watched from the registry thread
+    QMetaObject::invokeMethod(this, "_init", Qt::QueuedConnection, Q_ARG(QString, path));
+}
+
+void DocsetRegistry::_init(const QString &path)
+{
+    if (path != m_docsetPath) {
+        saveQueryCache();
+        saveUsage();
+
+        // Docsets still being loaded from the previous path are dropped once ready
+        m_loadGeneration.fetchAndAddOrdered(1);
+
+        // Nothing is written to a shared store, its files are kept on this machine
+        const QDir dir(SharedStore::contains(path) ? SharedStore::cachePath() : path);
+        QMutexLocker locker(&m_docsetsMutex);
+        m_docsetPath = path;
+        m_manifestPath = dir.absoluteFilePath(QLatin1String(ManifestFileName));
+        m_manifest = DocsetManifest::fromFile(m_manifestPath);
+        m_queryCachePath = dir.absoluteFilePath(QLatin1String(QueryCacheFileName));
+        m_queryCache = QueryCache::fromFile(m_queryCachePath);
+        m_usagePath = dir.absoluteFilePath(QLatin1String(UsageFileName));
+        m_usage = DocsetUsage::fromFile(m_usagePath);
+        m_pendingLoads = 0;
+        m_isWarmed = false;
+
+        // Docsets found in the new directory as well are kept, the others go with the rescan.
+        // Loads still running are not, their docsets get loaded again.
+        QHash<QString, QString> stamps;
+        for (const QSharedPointer<Docset> &docset : m_sortedDocsets) {
+            const QString stamp = m_docsetStamps.value(docset->path());
+            stamps.insert(docset->path(), stamp);
+            m_manifest.setEntry(docset->path(), docset->manifestEntry());
+            m_queryCache.addDocset(docset->name(), stamp);
+        }
+
+        m_docsetStamps = stamps;
+    }
+
+    rescan();
 
-    addDocsetsFromFolder(path);
+    {
+        QMutexLocker locker(&m_docsetsMutex);
+        if (m_pendingLoads > 0)
+            return;
+    }
+
+    emit docsetsLoaded();
+    scheduleWarming();
+}
+
+void DocsetRegistry::rescan()
+{
+    QStringList directories;
+    const QStringList docsetPaths = findDocsets(m_docsetPath, &directories);
+    const QSet<QString> foundPaths = docsetPaths.toSet();
+
+    QStringList removedNames;
+    {
+        QMutexLocker locker(&m_docsetsMutex);
+        for (const QSharedPointer<Docset> &docset : m_sortedDocsets) {
+            if (!foundPaths.contains(docset->path()))
+                removedNames.append(docset->name());
+        }
+
+        for (auto it = m_docsetStamps.begin(); it != m_docsetStamps.end();) {
+            if (foundPaths.contains(it.key()))
+                ++it;
+            else
+                it = m_docsetStamps.erase(it);
+        }
+
+        m_manifest.retainEntries(docsetPaths);
+    }
+
+    for (const QString &name : removedNames)
+        _remove(name);
+
+    QStringList watchedPaths = directories;
+    QHash<QString, QString> loadStamps; // Of docsets to load, by path
+    bool isSettling = false;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const QString &docsetPath : docsetPaths) {
+        const QDir docsetDir(docsetPath);
+        const QFileInfo databaseInfo(docsetDir.absoluteFilePath(QLatin1String(DatabaseFileName)));
+        if (!databaseInfo.exists()) {
+            // Still being copied, the database shows up in the deepest directory there is
+            QString watchedPath = docsetDir.absoluteFilePath(QStringLiteral("Contents/Resources"));
+            if (!QFileInfo(watchedPath).isDir())
+                watchedPath = docsetDir.absoluteFilePath(QStringLiteral("Contents"));
+            if (!QFileInfo(watchedPath).isDir())
+                watchedPath = docsetPath;
+            watchedPaths.append(watchedPath);
+            continue;
+        }
+
+        watchedPaths.append(databaseInfo.absoluteFilePath());
+
+        // Loaded, being loaded or failed to load as it is now
+        const QString stamp = DocsetManifest::stamp(docsetPath);
+        if (stamp == docsetStamp(docsetPath))
+            continue;
+
+        // Databases still being written are picked up once they settle
+        if (now - databaseInfo.lastModified().toMSecsSinceEpoch() < RescanDelay) {
+            isSettling = true;
+            continue;
+        }
+
+        loadStamps.insert(docsetPath, stamp);
+    }
+
+    updateWatchedPaths(watchedPaths);
+    if (isSettling)
+        m_rescanTimer->start();
+
+    const int generation = m_loadGeneration.load();
+    {
+        QMutexLocker locker(&m_docsetsMutex);
+        for (auto it = loadStamps.cbegin(); it != loadStamps.cend(); ++it)
+            m_docsetStamps.insert(it.key(), it.value());
+
+        // Otherwise written once the loads are done, see _addLoadedDocset()
+        m_pendingLoads += loadStamps.size();
+        if (m_pendingLoads == 0 && m_manifest.isModified() && !m_manifest.save(m_manifestPath))
+            qWarning("Cannot save docset manifest: %s", qPrintable(m_manifestPath));
+    }
+
+    // Docsets are constructed in parallel, each one is added as soon as it is ready,
+    // so the UI can be used with the ones already loaded.
+    for (auto it = loadStamps.cbegin(); it != loadStamps.cend(); ++it)
+        m_loadFutures.addFuture(QtConcurrent::run(this, &DocsetRegistry::loadDocset, it.key(), generation));
+}
+
+QString DocsetRegistry::docsetStamp(const QString &path) const
+{
+    QMutexLocker locker(&m_docsetsMutex);
+    return m_docsetStamps.value(path);
+}
+
+void DocsetRegistry::updateWatchedPaths(const QStringList &paths)
+{
+    // Replaced files drop out of the watcher, unchanged paths are left alone
+    const QSet<QString> wantedPaths = paths.toSet();
+    QSet<QString> watchedPaths = (m_watcher->files() + m_watcher->directories()).toSet();
+
+    const QStringList stalePaths = (watchedPaths - wantedPaths).toList();
+    if (!stalePaths.isEmpty())
+        m_watcher->removePaths(stalePaths);
+
+    const QStringList newPaths = (wantedPaths - watchedPaths).toList();
+    if (!newPaths.isEmpty())
+        m_watcher->addPaths(newPaths);
 }
 
 int DocsetRegistry::count() const
 {
+    QMutexLocker locker(&m_docsetsMutex);
     return m_docsets.count();
 }
 
 bool DocsetRegistry::contains(const QString &name) const
 {
+    QMutexLocker locker(&m_docsetsMutex);
     return m_docsets.contains(name);
 }
 
 QStringList DocsetRegistry::names() const
 {
+    QMutexLocker locker(&m_docsetsMutex);
     return m_docsets.keys();
 }
 
 void DocsetRegistry::remove(const QString &name)
+{
+    QMetaObject::invokeMethod(this, "_remove", Qt::BlockingQueuedConnection, Q_ARG(QString, name));
+}
+
+void DocsetRegistry::_remove(const QString &name)
 {
     emit docsetAboutToBeRemoved(name);
-    delete m_docsets.take(name);
+
+    QSharedPointer<Docset> docset;
+    {
+        QMutexLocker locker(&m_docsetsMutex);
+        docset = m_docsets.take(name);
+        m_sortedDocsets.removeOne(docset);
+
+        // Dropping the docset from every node it reached costs about the same as a rebuild
+        m_keywordTrie.clear();
+        for (const QSharedPointer<Docset> &otherDocset : m_sortedDocsets)
+            m_keywordTrie.insert(otherDocset.data());
+
+        const QStringList terms = docset ? KeywordTrie::terms(docset.data()) : QStringList();
+        for (const QString &term : terms) {
+            auto it = m_keywordTerms.find(term);
+            if (it != m_keywordTerms.end() && --it.value() == 0)
+                m_keywordTerms.erase(it);
+        }
+
+        m_queryCache.removeDocset(name);
+    }
+
+    m_candidates.remove(docset.data());
+    m_nextCandidates.remove(docset.data());
+
+    // Searches and results still holding the docset keep it open meanwhile
+    if (docset)
+        docset->closeConnections();
+
     emit docsetRemoved(name);
 }
 
-Docset *DocsetRegistry::docset(const QString &name) const
+QSharedPointer<Docset> DocsetRegistry::docset(const QString &name) const
 {
-    return m_docsets[name];
+    QMutexLocker locker(&m_docsetsMutex);
+    return m_docsets.value(name);
 }
 
-Docset *DocsetRegistry::docset(int index) const
+QSharedPointer<Docset> DocsetRegistry::docset(int index) const
 {
-    if (index < 0 || index >= m_docsets.size())
-        return nullptr;
-    return (m_docsets.cbegin() + index).value();
+    QMutexLocker locker(&m_docsetsMutex);
+    return m_sortedDocsets.value(index);
 }
 
-QList<Docset *> DocsetRegistry::docsets() const
+QList<QSharedPointer<Docset>> DocsetRegistry::docsets() const
 {
+    QMutexLocker locker(&m_docsetsMutex);
     return m_docsets.values();
 }
 
+QList<QSharedPointer<Docset>> DocsetRegistry::docsets(const SearchQuery &query) const
+{
+    if (!query.hasKeywords())
+        return docsets();
+
+    QList<QSharedPointer<Docset>> docsets;
+    {
+        // The trie holds the docsets of m_docsets, which are found again by name
+        QMutexLocker locker(&m_docsetsMutex);
+        for (const QString &keyword : query.keywords()) {
+            for (const Docset *docset : m_keywordTrie.find(keyword))
+                docsets.append(m_docsets.value(docset->name()));
+        }
+    }
+
+    // Same order as without keywords, docsets selected by several keywords are searched once
+    std::sort(docsets.begin(), docsets.end(),
+              [](const QSharedPointer<Docset> &lhs, const QSharedPointer<Docset> &rhs) {
+        return lhs->name() < rhs->name();
+    });
+    docsets.erase(std::unique(docsets.begin(), docsets.end()), docsets.end());
+    return docsets;
+}
+
 void DocsetRegistry::addDocset(const QString &path)
 {
     QMetaObject::invokeMethod(this, "_addDocset", Qt::BlockingQueuedConnection,
@@ -81,137 +457,480 @@ void DocsetRegistry::addDocset(const QString &path)
 
 void DocsetRegistry::_addDocset(const QString &path)
 {
-    Docset *docset = new Docset(path);
+    insertDocset(Docset::share(new Docset(path)));
+}
 
-    /// TODO: Emit error
-    if (!docset->isValid()) {
-        delete docset;
+void DocsetRegistry::_addLoadedDocset(Docset *loadedDocset, int generation)
+{
+    const QSharedPointer<Docset> docset = Docset::share(loadedDocset);
+    if (generation != m_loadGeneration.load())
         return;
+
+    bool isLastLoad;
+    {
+        QMutexLocker locker(&m_docsetsMutex);
+        const QJsonObject entry = docset->manifestEntry();
+        if (entry.isEmpty())
+            m_manifest.removeEntry(docset->path());
+        else
+            m_manifest.setEntry(docset->path(), entry);
+
+        // Written once all docsets are in, and only if anything has changed
+        isLastLoad = --m_pendingLoads == 0;
+        if (isLastLoad && m_manifest.isModified()) {
+            if (!m_manifest.save(m_manifestPath))
+                qWarning("Cannot save docset manifest: %s", qPrintable(m_manifestPath));
+        }
     }
 
+    insertDocset(docset);
+
+    if (isLastLoad) {
+        emit docsetsLoaded();
+        scheduleWarming();
+    }
+}
+
+QJsonObject DocsetRegistry::manifestEntry(const QString &path) const
+{
+    QMutexLocker locker(&m_docsetsMutex);
+    return m_manifest.entry(path);
+}
+
+void DocsetRegistry::loadDocset(const QString &path, int generation)
+{
+    Docset *docset = new Docset(path, manifestEntry(path));
+    docset->moveToThread(m_thread);
+
+    QMetaObject::invokeMethod(this, "_addLoadedDocset", Qt::QueuedConnection,
+                              Q_ARG(Zeal::Docset *, docset), Q_ARG(int, generation));
+}
+
+void DocsetRegistry::insertDocset(const QSharedPointer<Docset> &docset)
+{
+    /// TODO: Emit error
+    if (!docset->isValid())
+        return;
+
     const QString name = docset->name();
 
-    if (m_docsets.contains(name))
-        remove(name);
+    // A reloaded docset may come with another name
+    for (const QSharedPointer<Docset> &otherDocset : docsets()) {
+        if (otherDocset->path() == docset->path() && otherDocset->name() != name)
+            _remove(otherDocset->name());
+    }
+
+    if (contains(name))
+        _remove(name);
+
+    const QString stamp = DocsetManifest::stamp(docset->path());
+
+    {
+        QMutexLocker locker(&m_docsetsMutex);
+        m_docsets.insert(name, docset);
+        const auto it = std::lower_bound(m_sortedDocsets.begin(), m_sortedDocsets.end(), name,
+                                         [](const QSharedPointer<Docset> &docset, const QString &name) {
+            return docset->name() < name;
+        });
+        m_sortedDocsets.insert(it, docset);
+        m_keywordTrie.insert(docset.data());
+
+        for (const QString &term : KeywordTrie::terms(docset.data()))
+            ++m_keywordTerms[term];
+
+        m_docsetStamps.insert(docset->path(), stamp);
+        m_queryCache.addDocset(name, stamp);
+    }
 
-    m_docsets[name] = docset;
     emit docsetAdded(name);
 }
 
+int DocsetRegistry::resultLimit() const
+{
+    return m_resultLimit.load();
+}
+
+void DocsetRegistry::setResultLimit(int limit)
+{
+    m_resultLimit.store(qMax(limit, 1));
+}
+
+void DocsetRegistry::setIdleTimeout(int seconds)
+{
+    m_idleTimeout.store(qMax(seconds, 0));
+}
+
+void DocsetRegistry::setMaxOpenDocsets(int count)
+{
+    m_maxOpenDocsets.store(qMax(count, 1));
+}
+
+void DocsetRegistry::setWarmDocsetCount(int count)
+{
+    m_warmDocsetCount.store(qMax(count, 0));
+}
+
+void DocsetRegistry::scheduleWarming()
+{
+    if (m_isWarmed || m_warmDocsetCount.load() == 0)
+        return;
+
+    m_isWarmed = true;
+    m_warmTimer->start();
+}
+
+void DocsetRegistry::warmCaches()
+{
+    // Most used first, what does not fit into the budget of a pass is left out
+    QStringList paths;
+    {
+        QMutexLocker locker(&m_docsetsMutex);
+        for (const QString &name : m_usage.mostUsed(m_docsets.keys(), m_warmDocsetCount.load())) {
+            const QSharedPointer<Docset> docset = m_docsets.value(name);
+            paths += docset->databaseFiles();
+            paths.append(docset->documentPath());
+        }
+    }
+
+    if (paths.isEmpty())
+        return;
+
+    QMetaObject::invokeMethod(m_warmer, "warm", Qt::QueuedConnection, Q_ARG(QStringList, paths));
+}
+
+void DocsetRegistry::closeIdleDocsets()
+{
+    // Keeps docsets from being deleted meanwhile, closing does not block
+    QMutexLocker locker(&m_docsetsMutex);
+
+    QList<Docset *> openDocsets;
+    for (const QSharedPointer<Docset> &docset : m_docsets) {
+        if (docset->hasOpenConnections())
+            openDocsets.append(docset.data());
+    }
+
+    // Most recently used first
+    std::sort(openDocsets.begin(), openDocsets.end(), [](Docset *lhs, Docset *rhs) {
+        return lhs->lastUsed() > rhs->lastUsed();
+    });
+
+    const qint64 timeout = m_idleTimeout.load() * qint64(1000);
+    const qint64 idleSince = QDateTime::currentMSecsSinceEpoch() - timeout;
+    const int maxOpen = m_maxOpenDocsets.load();
+
+    for (int i = 0; i < openDocsets.size(); ++i) {
+        Docset *docset = openDocsets.at(i);
+        if (i < maxOpen && (timeout == 0 || docset->lastUsed() > idleSince))
+            continue;
+
+        // Docsets in use are retried on the next check
+        docset->closeConnections();
+    }
+}
+
 void DocsetRegistry::search(const QString &query)
 {
-    m_lastQuery += 1;
+    m_warmer->noteActivity();
+
+    // Stop the running query, its results are not needed anymore
+    m_queryToken.cancel();
+    m_queryToken = CancellationToken();
 
     // Only invalidate queries
     if (query.isEmpty())
         return;
 
     QMetaObject::invokeMethod(this, "_runQuery", Qt::QueuedConnection, Q_ARG(QString, query),
-                              Q_ARG(int, m_lastQuery));
+                              Q_ARG(Zeal::CancellationToken, m_queryToken));
 }
 
-void DocsetRegistry::_runQuery(const QString &rawQuery, int queryNum)
+QVector<SearchResult> DocsetRegistry::find(const SearchQuery &query, int limit,
+                                           const CancellationToken &token) const
 {
-    // If some other queries pending, ignore this one.
-    if (queryNum != m_lastQuery)
+    m_warmer->noteActivity();
+
+    QList<DocsetSearchJob> jobs;
+    for (const QSharedPointer<Docset> &docset : docsets(query)) {
+        DocsetSearchJob job;
+        job.docset = docset;
+        jobs.append(job);
+    }
+
+    QList<QVector<SearchResult>> results;
+    for (const DocsetSearchJob &job : QtConcurrent::blockingMapped(jobs, DocsetSearch(query, limit, token)))
+        results.append(job.results);
+
+    return token.isCanceled() ? QVector<SearchResult>() : mergeResults(results, limit);
+}
+
+QString DocsetRegistry::completion(const QString &text) const
+{
+    const SearchQuery query = SearchQuery::fromString(text);
+    if (text.isEmpty() || query.isFullText())
+        return QString();
+
+    // Nothing typed yet but a keyword
+    if (!query.hasKeywords() && !text.contains(QLatin1Char(':'))) {
+        const QString foldedText = text.toCaseFolded();
+
+        QMutexLocker locker(&m_docsetsMutex);
+        const auto it = m_keywordTerms.lowerBound(foldedText);
+        if (it != m_keywordTerms.constEnd() && it.key().startsWith(foldedText))
+            return text + it.key().mid(foldedText.size()) + QLatin1Char(':');
+    }
+
+    const QString prefix = query.query();
+    if (prefix.isEmpty() || !text.endsWith(prefix))
+        return QString();
+
+    const QByteArray prefixData = prefix.toUtf8();
+    QString best;
+    for (const QSharedPointer<Docset> &docset : docsets(query)) {
+        // Docsets without a trie yet are skipped, it gets built in the background
+        const QSharedPointer<const CompletionTrie> trie = docset->completionTrie();
+        if (!trie)
+            continue;
+
+        const int id = trie->complete(prefixData);
+        if (id == -1)
+            continue;
+
+        const QString name = trie->searchIndex()->name(id);
+        if (best.isEmpty() || name.size() < best.size() || (name.size() == best.size() && name < best))
+            best = name;
+    }
+
+    if (best.isEmpty())
+        return QString();
+
+    // Typed characters are kept as they are
+    return text + best.mid(prefix.size());
+}
+
+void DocsetRegistry::findRelatedLinks(const QString &name, const QUrl &url)
+{
+    QMetaObject::invokeMethod(this, "_findRelatedLinks", Qt::QueuedConnection, Q_ARG(QString, name),
+                              Q_ARG(QUrl, url));
+}
+
+void DocsetRegistry::recordUsage(const QString &name)
+{
+    QMutexLocker locker(&m_docsetsMutex);
+    m_usage.record(name);
+}
+
+void DocsetRegistry::_findRelatedLinks(const QString &name, const QUrl &url)
+{
+    const QSharedPointer<const Docset> docset = this->docset(name);
+    emit relatedLinksReady(url, docset ? docset->relatedLinks(url) : QVector<SearchResult>());
+}
+
+void DocsetRegistry::_runQuery(const QString &rawQuery, const CancellationToken &token)
+{
+    // Some other query has been issued meanwhile, ignore this one.
+    if (token.isCanceled())
         return;
 
-    QList<SearchResult> results;
     const SearchQuery query = SearchQuery::fromString(rawQuery);
 
-    const QString preparedQuery = query.sanitizedQuery();
+    // Candidates of the previous query are only reused within the same docset filter
+    if (query.keywords() != m_candidateKeywords) {
+        m_candidates.clear();
+        m_candidateKeywords = query.keywords();
+    }
+
+    // Stop listening to the previous query, its workers drop out on the canceled token
+    if (m_searchWatcher) {
+        m_searchWatcher->disconnect(this);
+        m_searchWatcher->deleteLater();
+    }
 
-    for (Docset *docset : docsets()) {
-        // Filter out this docset as the names don't match the docset prefix
-        if (query.hasKeywords() && !query.hasKeyword(docset->prefix))
+    m_pendingResults.clear();
+    m_resultsPublished = false;
+    m_nextCandidates.clear();
+
+    // Docsets with cached results for the query are not searched again
+    const int limit = resultLimit();
+    QList<DocsetSearchJob> jobs;
+    for (const QSharedPointer<Docset> &docset : docsets(query)) {
+        QVector<SearchResult> results;
+        Docset::SearchCandidates candidates;
+        if (findCachedResults(docset, query, limit, &results, &candidates)) {
+            // The next query narrows down these as it would after a search
+            m_nextCandidates.insert(docset.data(), candidates);
+            if (!results.isEmpty())
+                m_pendingResults.append(results);
             continue;
-
-        QString queryStr;
-        QList<QList<QVariant>> found;
-        bool withSubStrings = false;
-        // %.%1% for long Django docset values like django.utils.http
-        // %::%1% for long C++ docset values like std::set
-        // %/%1% for long Go docset values like archive/tar
-        QString subNames = QStringLiteral(" or %1 like '%.%2%' escape '\\'");
-        subNames += QStringLiteral(" or %1 like '%::%2%' escape '\\'");
-        subNames += QStringLiteral(" or %1 like '%/%2%' escape '\\'");
-        while (found.size() < 100) {
-            QString curQuery = preparedQuery;
-            QString notQuery; // don't return the same result twice
-            if (withSubStrings) {
-                // if less than 100 found starting with query, search all substrings
-                curQuery = "%" + preparedQuery;
-                // don't return 'starting with' results twice
-                if (docset->type() == Docset::Type::ZDash)
-                    notQuery = QString(" and not (ztokenname like '%1%' escape '\\' %2) ").arg(preparedQuery, subNames.arg("ztokenname", preparedQuery));
-                else
-                    notQuery = QString(" and not (t.name like '%1%' escape '\\' %2) ").arg(preparedQuery, subNames.arg("t.name", preparedQuery));
-            }
-            int cols = 3;
-            if (docset->type() == Docset::Type::Dash) {
-                queryStr = QString("SELECT t.name, null, t.path FROM searchIndex t WHERE (t.name "
-                                   "LIKE '%1%' escape '\\' %3)  %2 ORDER BY length(t.name), lower(t.name) ASC, t.path ASC LIMIT 100")
-                        .arg(curQuery, notQuery, subNames.arg("t.name", curQuery));
-            } else if (docset->type() == Docset::Type::ZDash) {
-                cols = 4;
-                queryStr = QString("SELECT ztokenname, null, zpath, zanchor FROM ztoken "
-                                   "JOIN ztokenmetainformation on ztoken.zmetainformation = ztokenmetainformation.z_pk "
-                                   "JOIN zfilepath on ztokenmetainformation.zfile = zfilepath.z_pk WHERE (ztokenname "
-                                   "LIKE '%1%' escape '\\' %3) %2 ORDER BY length(ztokenname), lower(ztokenname) ASC, zpath ASC, "
-                                   "zanchor ASC LIMIT 100").arg(curQuery, notQuery,
-                                                                subNames.arg("ztokenname", curQuery));
-            }
-
-            QSqlQuery query(queryStr, docset->database());
-            while (query.next()) {
-                QList<QVariant> values;
-                for (int i = 0; i < cols; ++i)
-                    values.append(query.value(i));
-                found.append(values);
-            }
-
-            if (withSubStrings)
-                break;
-            withSubStrings = true;  // try again searching for substrings
         }
 
-        for (const QList<QVariant> &row : found) {
-            QString parentName;
-            if (!row[1].isNull())
-                parentName = row[1].toString();
+        DocsetSearchJob job;
+        job.docset = docset;
+        job.candidates = m_candidates.value(docset.data());
+        jobs.append(job);
+    }
+
+    if (!m_pendingResults.isEmpty())
+        publishResults();
+
+    // Docsets are searched concurrently on the global thread pool, and results of
+    // each one are published as soon as it finishes instead of waiting for the slowest.
+    QFutureWatcher<DocsetSearchJob> *watcher = new QFutureWatcher<DocsetSearchJob>(this);
+    m_searchWatcher = watcher;
+
+    connect(watcher, &QFutureWatcher<DocsetSearchJob>::resultReadyAt, this,
+            [this, watcher, query, limit, token](int index) {
+        if (token.isCanceled())
+            return;
+
+        const DocsetSearchJob job = watcher->resultAt(index);
+        cacheResults(job.docset.data(), query, limit, job.results);
+        m_nextCandidates.insert(job.docset.data(), job.candidates);
+        if (!job.results.isEmpty())
+            m_pendingResults.append(job.results);
 
-            QString path = row[2].toString();
-            // FIXME: refactoring to use common code in ZealListModel and DocsetRegistry
-            if (docset->type() == Docset::Type::ZDash)
-                path += "#" + row[3].toString();
+        if (!m_resultsPublished || m_publishTimer.elapsed() >= PublishInterval)
+            publishResults();
+    });
 
-            QString itemName = row[0].toString();
-            Docset::normalizeName(itemName, parentName);
-            results.append(SearchResult(itemName, parentName, docset, path,
-                                        preparedQuery));
+    connect(watcher, &QFutureWatcher<DocsetSearchJob>::finished, this, [this, watcher, token]() {
+        watcher->deleteLater();
+        m_searchWatcher = nullptr;
+
+        // Keep the previous candidates, partial results of a canceled query are of no use
+        if (token.isCanceled())
+            return;
+
+        m_candidates = m_nextCandidates;
+        m_nextCandidates.clear();
+
+        publishResults();
+        emit queryCompleted();
+    });
+
+    watcher->setFuture(QtConcurrent::mapped(jobs, DocsetSearch(query, limit, token)));
+}
+
+bool DocsetRegistry::findCachedResults(const QSharedPointer<Docset> &docset, const SearchQuery &query, int limit,
+                                       QVector<SearchResult> *results, Docset::SearchCandidates *candidates)
+{
+    // Full-text results carry their own strings, they are not worth keeping
+    if (query.isFullText())
+        return false;
+
+    const QSharedPointer<const SearchIndex> index = docset->searchIndex();
+    if (!index)
+        return false;
+
+    QVector<QueryCache::Result> cachedResults;
+    {
+        QMutexLocker locker(&m_docsetsMutex);
+        if (!m_queryCache.find(docset->name(), query.query(), limit, &cachedResults))
+            return false;
+    }
+
+    results->reserve(cachedResults.size());
+    QVector<int> symbolIds;
+    symbolIds.reserve(cachedResults.size());
+    for (const QueryCache::Result &result : cachedResults) {
+        if (result.symbolId >= static_cast<quint32>(index->size())) {
+            results->clear();
+            return false;
         }
+
+        results->append(SearchResult(index, result.symbolId, docset, result.score));
+        symbolIds.append(static_cast<int>(result.symbolId));
     }
-    std::sort(results.begin(), results.end());
-    if (queryNum != m_lastQuery)
-        return; // some other queries pending - ignore this one
 
-    m_queryResults = results;
-    emit queryCompleted();
+    // Fewer results than the limit are all the matches, as they were for the search
+    candidates->searchIndex = index;
+    candidates->query = query.query();
+    candidates->symbolIds = symbolIds;
+    candidates->isComplete = cachedResults.size() < limit;
+
+    return true;
 }
 
-const QList<SearchResult> &DocsetRegistry::queryResults()
+void DocsetRegistry::cacheResults(const Docset *docset, const SearchQuery &query, int limit,
+                                  const QVector<SearchResult> &results)
 {
-    return m_queryResults;
+    if (query.isFullText())
+        return;
+
+    // Results from the database before the search index is built cannot be stored as ids
+    QVector<QueryCache::Result> cachedResults;
+    cachedResults.reserve(results.size());
+    for (const SearchResult &result : results) {
+        if (result.symbolId() == -1)
+            return;
+
+        QueryCache::Result cachedResult;
+        cachedResult.symbolId = static_cast<quint32>(result.symbolId());
+        cachedResult.score = result.score();
+        cachedResults.append(cachedResult);
+    }
+
+    QMutexLocker locker(&m_docsetsMutex);
+    m_queryCache.insert(docset->name(), query.query(), limit, cachedResults);
 }
 
-// Recursively finds and adds all docsets in a given directory.
-void DocsetRegistry::addDocsetsFromFolder(const QString &path)
+void DocsetRegistry::saveQueryCache()
 {
+    QMutexLocker locker(&m_docsetsMutex);
+    if (m_queryCachePath.isEmpty())
+        return;
+
+    if (!m_queryCache.save(m_queryCachePath))
+        qWarning("Cannot save query cache: %s", qPrintable(m_queryCachePath));
+}
+
+void DocsetRegistry::saveUsage()
+{
+    QMutexLocker locker(&m_docsetsMutex);
+    if (m_usagePath.isEmpty() || !m_usage.isModified())
+        return;
+
+    if (!m_usage.save(m_usagePath))
+        qWarning("Cannot save docset usage: %s", qPrintable(m_usagePath));
+}
+
+void DocsetRegistry::publishResults()
+{
+    const QVector<SearchResult> results = mergeResults(m_pendingResults, resultLimit());
+    m_pendingResults.clear();
+    ZEAL_TRACE_COUNTER("search", "results", results.size());
+
+    if (!m_resultsPublished) {
+        m_resultsPublished = true;
+        emit queryResultsReset(results);
+    } else if (!results.isEmpty()) {
+        emit queryResultsAdded(results);
+    }
+
+    m_publishTimer.start();
+}
+
+// Recursively finds all docsets in a given directory, and the directories looked into.
+QStringList DocsetRegistry::findDocsets(const QString &path, QStringList *directories)
+{
+    QStringList paths;
+
     const QDir dir(path);
+    if (!dir.exists())
+        return paths;
+
+    if (directories)
+        directories->append(dir.absolutePath());
+
     for (const QFileInfo &subdir : dir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllDirs)) {
+        // Skips the trash of deleted docsets, which is not hidden on Windows
+        if (subdir.fileName().startsWith(QLatin1Char('.')))
+            continue;
+
         if (subdir.suffix() == "docset")
-            addDocset(subdir.absoluteFilePath());
+            paths.append(subdir.absoluteFilePath());
         else
-            addDocsetsFromFolder(subdir.absoluteFilePath());
+            paths += findDocsets(subdir.absoluteFilePath(), directories);
     }
+
+    return paths;
 }
@@ -1,15 +1,33 @@
 #ifndef DOCSETREGISTRY_H
 #define DOCSETREGISTRY_H
 
+#include "cancellationtoken.h"
 #include "docset.h"
+#include "docsetmanifest.h"
+#include "docsetusage.h"
+#include "keywordtrie.h"
+#include "querycache.h"
 #include "searchresult.h"
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFutureSynchronizer>
+#include <QHash>
 #include <QMap>
+#include <QMutex>
+#include <QVector>
 
+class QFileSystemWatcher;
+template<typename T> class QFutureWatcher;
 class QThread;
+class QTimer;
 
 namespace Zeal {
 
+class CacheWarmer;
+struct DocsetSearchJob;
+class SearchQuery;
+
 class DocsetRegistry : public QObject
 {
     Q_OBJECT
@@ -17,20 +35,47 @@ public:
     explicit DocsetRegistry(QObject *parent = nullptr);
     ~DocsetRegistry() override;
 
+    /// Loads the docsets found in \a path, and keeps following changes to them on disk.
+    /// Docsets already loaded from elsewhere in \a path are kept.
     void init(const QString &path);
 
     int count() const;
     bool contains(const QString &name) const;
     QStringList names() const;
+    /// Removes the docset \a name on the registry thread, and returns once it is gone.
+    /// The docset itself lives on as long as its search results.
     void remove(const QString &name);
 
-    Docset *docset(const QString &name) const;
-    Docset *docset(int index) const;
+    QSharedPointer<Docset> docset(const QString &name) const;
+    QSharedPointer<Docset> docset(int index) const;
 
     QString prepareQuery(const QString &rawQuery);
     void search(const QString &query);
-    const QList<SearchResult> &queryResults();
-    QList<Docset *> docsets() const;
+    /// Returns the best \a limit results of \a query, ranked the same as by search(). Unlike
+    /// search(), this blocks and leaves the running query alone, and can be called from any
+    /// thread. The searched docsets and the results share ownership of their docsets, which
+    /// may be removed on the registry thread meanwhile.
+    QVector<SearchResult> find(const SearchQuery &query, int limit,
+                               const CancellationToken &token = CancellationToken()) const;
+    /// Returns \a text completed to the first docset keyword, or to the shortest symbol name
+    /// starting with its query, or nothing. Takes microseconds, so it can run on each keystroke.
+    QString completion(const QString &text) const;
+    /// Looks up symbols of the page \a url of docset \a name, see relatedLinksReady()
+    void findRelatedLinks(const QString &name, const QUrl &url);
+    /// Counts a page of docset \a name being opened, see DocsetUsage
+    void recordUsage(const QString &name);
+
+    int resultLimit() const;
+    void setResultLimit(int limit);
+
+    /// Databases of docsets unused for \a seconds get closed, 0 keeps them open
+    void setIdleTimeout(int seconds);
+    /// Databases of least recently used docsets get closed beyond \a count open ones
+    void setMaxOpenDocsets(int count);
+    /// Files of the \a count most used docsets are read into memory at idle time after
+    /// startup, see CacheWarmer. 0 turns it off.
+    void setWarmDocsetCount(int count);
+    QList<QSharedPointer<Docset>> docsets() const;
 
 public slots:
     void addDocset(const QString &path);
@@ -39,19 +84,92 @@ signals:
     void docsetAdded(const QString &name);
     void docsetAboutToBeRemoved(const QString &name);
     void docsetRemoved(const QString &name);
+    /// Emitted once all docsets found by init(), or later on by watching the directory, are loaded
+    void docsetsLoaded();
+    /// Emitted with the first batch of results of a new query, which replaces the previous results.
+    void queryResultsReset(const QVector<Zeal::SearchResult> &results);
+    /// Emitted with further results of the running query, each batch is sorted on its own.
+    void queryResultsAdded(const QVector<Zeal::SearchResult> &results);
     void queryCompleted();
+    void relatedLinksReady(const QUrl &url, const QVector<Zeal::SearchResult> &results);
 
 private slots:
+    void _init(const QString &path);
+    void rescan();
     void _addDocset(const QString &path);
-    void _runQuery(const QString &rawQuery, int queryNum);
+    void _addLoadedDocset(Zeal::Docset *docset, int generation);
+    void _remove(const QString &name);
+    void _runQuery(const QString &rawQuery, const Zeal::CancellationToken &token);
+    void _findRelatedLinks(const QString &name, const QUrl &url);
+    void closeIdleDocsets();
+    void warmCaches();
 
 private:
-    void addDocsetsFromFolder(const QString &path);
+    static QStringList findDocsets(const QString &path, QStringList *directories = nullptr);
+    QString docsetStamp(const QString &path) const;
+    void updateWatchedPaths(const QStringList &paths);
+    QJsonObject manifestEntry(const QString &path) const;
+    void loadDocset(const QString &path, int generation);
+    void insertDocset(const QSharedPointer<Docset> &docset);
+    /// Returns the docsets selected by the keywords of \a query, or all without keywords
+    QList<QSharedPointer<Docset>> docsets(const SearchQuery &query) const;
+    void publishResults();
+    bool findCachedResults(const QSharedPointer<Docset> &docset, const SearchQuery &query, int limit,
+                           QVector<SearchResult> *results, Docset::SearchCandidates *candidates);
+    void cacheResults(const Docset *docset, const SearchQuery &query, int limit,
+                      const QVector<SearchResult> &results);
+    void saveQueryCache();
+    void saveUsage();
+    void scheduleWarming();
 
     QThread *m_thread = nullptr;
-    QMap<QString, Docset *> m_docsets;
-    QList<SearchResult> m_queryResults;
-    int m_lastQuery = -1;
+    mutable QMutex m_docsetsMutex;
+    // Changed on the registry thread only
+    QMap<QString, QSharedPointer<Docset>> m_docsets;
+    QVector<QSharedPointer<Docset>> m_sortedDocsets; // Same order as m_docsets, for access by index
+    KeywordTrie m_keywordTrie; // Updated along with m_docsets
+    QMap<QString, int> m_keywordTerms; // Case folded, by the number of docsets they select
+
+    QString m_docsetPath;
+    QHash<QString, QString> m_docsetStamps; // Of loaded and loading docsets, by path
+    QAtomicInt m_loadGeneration;
+    DocsetManifest m_manifest;
+    QString m_manifestPath;
+    QueryCache m_queryCache; // Guarded by m_docsetsMutex
+    QString m_queryCachePath;
+    int m_pendingLoads = 0;
+    QFutureSynchronizer<void> m_loadFutures;
+    CancellationToken m_queryToken;
+    QAtomicInt m_resultLimit;
+
+    DocsetUsage m_usage; // Guarded by m_docsetsMutex
+    QString m_usagePath;
+
+    // Files of often used docsets are read once per docset directory
+    QThread *m_warmerThread = nullptr;
+    CacheWarmer *m_warmer = nullptr;
+    QTimer *m_warmTimer = nullptr;
+    QAtomicInt m_warmDocsetCount;
+    bool m_isWarmed = false;
+
+    QTimer *m_idleTimer = nullptr;
+    QAtomicInt m_idleTimeout; // in seconds
+    QAtomicInt m_maxOpenDocsets;
+
+    // Changes to the docset directory trigger a rescan, which only applies the differences
+    QFileSystemWatcher *m_watcher = nullptr;
+    QTimer *m_rescanTimer = nullptr;
+
+    // Running query, results are published in batches as docsets finish
+    QFutureWatcher<DocsetSearchJob> *m_searchWatcher = nullptr;
+    QList<QVector<SearchResult>> m_pendingResults;
+    bool m_resultsPublished = false;
+    QElapsedTimer m_publishTimer;
+    QHash<Docset *, Docset::SearchCandidates> m_nextCandidates;
+
+    // Results of the last query for narrowing down the next one
+    QStringList m_candidateKeywords;
+    QHash<Docset *, Docset::SearchCandidates> m_candidates;
 };
 
 } // namespace Zeal
@@ -0,0 +1,103 @@
+#include "docsetusage.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Zeal;
+
+namespace {
+const int UsageVersion = 1;
+const double HalfLife = 14 * 24 * 3600 * 1000.0; // ms
+// Scores below are dropped on save, about five months after a single use
+const double MinScore = 0.001;
+}
+
+DocsetUsage DocsetUsage::fromFile(const QString &fileName)
+{
+    DocsetUsage usage;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return usage;
+
+    const QJsonObject jsonObject = QJsonDocument::fromJson(file.readAll()).object();
+    if (jsonObject[QStringLiteral("version")].toInt() != UsageVersion)
+        return usage;
+
+    usage.m_docsets = jsonObject[QStringLiteral("docsets")].toObject();
+    return usage;
+}
+
+bool DocsetUsage::save(const QString &fileName) const
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QJsonObject docsets;
+    for (auto it = m_docsets.constBegin(); it != m_docsets.constEnd(); ++it) {
+        if (score(it.key(), now) >= MinScore)
+            docsets.insert(it.key(), it.value());
+    }
+
+    QJsonObject jsonObject;
+    jsonObject[QStringLiteral("version")] = UsageVersion;
+    jsonObject[QStringLiteral("docsets")] = docsets;
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(QJsonDocument(jsonObject).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+bool DocsetUsage::isModified() const
+{
+    return m_isModified;
+}
+
+void DocsetUsage::record(const QString &name)
+{
+    // The decayed score is stored along with the time it was computed at
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QJsonObject entry;
+    entry[QStringLiteral("score")] = score(name, now) + 1;
+    entry[QStringLiteral("time")] = static_cast<double>(now);
+
+    m_docsets[name] = entry;
+    m_isModified = true;
+}
+
+QStringList DocsetUsage::mostUsed(const QStringList &names, int count) const
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QList<QPair<double, QString>> scores;
+    for (const QString &name : names) {
+        const double value = score(name, now);
+        if (value > 0)
+            scores.append(qMakePair(value, name));
+    }
+
+    std::sort(scores.begin(), scores.end(), [](const QPair<double, QString> &lhs,
+                                               const QPair<double, QString> &rhs) {
+        return lhs.first > rhs.first;
+    });
+
+    QStringList result;
+    for (int i = 0; i < qMin(count, scores.size()); ++i)
+        result.append(scores.at(i).second);
+    return result;
+}
+
+double DocsetUsage::score(const QString &name, qint64 now) const
+{
+    const QJsonObject entry = m_docsets[name].toObject();
+    if (entry.isEmpty())
+        return 0;
+
+    const double elapsed = qMax(0.0, now - entry[QStringLiteral("time")].toDouble());
+    return entry[QStringLiteral("score")].toDouble() * std::pow(0.5, elapsed / HalfLife);
+}
@@ -0,0 +1,38 @@
+#ifndef DOCSETUSAGE_H
+#define DOCSETUSAGE_H
+
+#include <QJsonObject>
+#include <QStringList>
+
+namespace Zeal {
+
+/**
+ * @short How often docsets are used, with recent use weighing more.
+ *
+ * Each docset has a score, which grows by one whenever a page of it is opened and halves
+ * every two weeks, so that docsets of a finished project make room for the current ones.
+ * Scores are kept by docset name, and survive updates of the docset.
+ */
+class DocsetUsage
+{
+public:
+    static DocsetUsage fromFile(const QString &fileName);
+    /// Saves the scores, leaving out those that have decayed to nothing
+    bool save(const QString &fileName) const;
+
+    bool isModified() const;
+
+    void record(const QString &name);
+    /// Returns the names of up to \a count docsets with the highest scores, out of \a names
+    QStringList mostUsed(const QStringList &names, int count) const;
+
+private:
+    double score(const QString &name, qint64 now) const;
+
+    QJsonObject m_docsets;
+    bool m_isModified = false;
+};
+
+} // namespace Zeal
+
+#endif // DOCSETUSAGE_H
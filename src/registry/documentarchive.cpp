@@ -0,0 +1,285 @@
+#include "documentarchive.h"
+
+#include <QCache>
+#include <QDataStream>
+#include <QDir>
+#include <QPair>
+#include <QReadWriteLock>
+#include <QtEndian>
+
+#include <cstring>
+
+using namespace Zeal;
+
+const char DocumentArchive::FileName[] = "Documents.pack";
+
+namespace {
+// Layout: header, compressed documents, index, footer
+const char Magic[] = {'Z', 'P', 'A', 'K'};
+const quint32 Version = 1;
+const int HeaderSize = 8; // Magic, version
+const int FooterSize = 12; // Index offset, magic
+
+const int PageCacheSize = 16 * 1024 * 1024;
+
+const char DocumentsDir[] = "/Contents/Resources/Documents";
+
+typedef QPair<const DocumentArchive *, QString> PageKey;
+
+struct PageCache
+{
+    QMutex mutex;
+    QCache<PageKey, QByteArray> pages{PageCacheSize};
+};
+
+Q_GLOBAL_STATIC(PageCache, pageCache)
+
+struct MountTable
+{
+    QReadWriteLock lock;
+    QHash<QString, QSharedPointer<const DocumentArchive>> archives;
+};
+
+Q_GLOBAL_STATIC(MountTable, mountTable)
+}
+
+DocumentArchive *DocumentArchive::open(const QString &fileName)
+{
+    QScopedPointer<DocumentArchive> archive(new DocumentArchive());
+    archive->m_file.setFileName(fileName);
+    if (!archive->m_file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    const qint64 size = archive->m_file.size();
+    if (size < HeaderSize + FooterSize)
+        return nullptr;
+
+    const uchar *data = archive->m_file.map(0, size);
+    if (!data || std::memcmp(data, Magic, sizeof(Magic)) != 0
+            || qFromBigEndian<quint32>(data + sizeof(Magic)) != Version) {
+        return nullptr;
+    }
+
+    const uchar *footer = data + size - FooterSize;
+    const qint64 indexOffset = static_cast<qint64>(qFromBigEndian<quint64>(footer));
+    if (std::memcmp(footer + 8, Magic, sizeof(Magic)) != 0
+            || indexOffset < HeaderSize || indexOffset > size - FooterSize) {
+        return nullptr;
+    }
+
+    QDataStream in(QByteArray::fromRawData(reinterpret_cast<const char *>(data + indexOffset),
+                                           static_cast<int>(size - FooterSize - indexOffset)));
+    quint32 count;
+    in >> count;
+
+    archive->m_entries.reserve(static_cast<int>(qMin<quint32>(count, 1 << 20)));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString path;
+        Entry entry;
+        in >> path >> entry.offset >> entry.size;
+        if (entry.offset < HeaderSize || entry.offset + entry.size > indexOffset)
+            return nullptr;
+        archive->m_entries.insert(path, entry);
+    }
+
+    if (in.status() != QDataStream::Ok)
+        return nullptr;
+
+    archive->m_data = data;
+    return archive.take();
+}
+
+DocumentArchive::~DocumentArchive()
+{
+    if (pageCache.isDestroyed())
+        return;
+
+    QMutexLocker locker(&pageCache->mutex);
+    for (const PageKey &key : pageCache->pages.keys()) {
+        if (key.first == this)
+            pageCache->pages.remove(key);
+    }
+}
+
+bool DocumentArchive::contains(const QString &path) const
+{
+    return m_entries.contains(path);
+}
+
+QStringList DocumentArchive::paths() const
+{
+    return m_entries.keys();
+}
+
+QByteArray DocumentArchive::read(const QString &path) const
+{
+    const auto it = m_entries.constFind(path);
+    if (it == m_entries.cend())
+        return QByteArray();
+
+    const PageKey key(this, path);
+    {
+        QMutexLocker locker(&pageCache->mutex);
+        if (const QByteArray *page = pageCache->pages.object(key))
+            return *page;
+    }
+
+    const QByteArray page = qUncompress(m_data + it->offset, static_cast<int>(it->size));
+
+    QMutexLocker locker(&pageCache->mutex);
+    if (page.size() < PageCacheSize)
+        pageCache->pages.insert(key, new QByteArray(page), qMax(page.size(), 1));
+
+    return page;
+}
+
+QByteArray DocumentArchive::readUncached(const QString &path) const
+{
+    const auto it = m_entries.constFind(path);
+    if (it == m_entries.cend())
+        return QByteArray();
+
+    return qUncompress(m_data + it->offset, static_cast<int>(it->size));
+}
+
+void DocumentArchive::mount(const QString &documentPath,
+                            const QSharedPointer<const DocumentArchive> &archive)
+{
+    QWriteLocker locker(&mountTable->lock);
+    mountTable->archives.insert(QDir::cleanPath(documentPath), archive);
+}
+
+void DocumentArchive::unmount(const QString &documentPath, const DocumentArchive *archive)
+{
+    if (mountTable.isDestroyed())
+        return;
+
+    // A reloaded docset may have mounted its new archive already
+    QWriteLocker locker(&mountTable->lock);
+    const QString path = QDir::cleanPath(documentPath);
+    if (mountTable->archives.value(path).data() == archive)
+        mountTable->archives.remove(path);
+}
+
+QSharedPointer<const DocumentArchive> DocumentArchive::find(const QString &filePath, QString *path)
+{
+    // Only files of docsets can be in archives, which saves the lookup for everything else
+    const QLatin1String documentsDir(DocumentsDir);
+    const int index = filePath.indexOf(documentsDir + QLatin1Char('/'));
+    if (index == -1)
+        return QSharedPointer<const DocumentArchive>();
+
+    const int prefixSize = index + documentsDir.size();
+
+    QSharedPointer<const DocumentArchive> archive;
+    {
+        QReadLocker locker(&mountTable->lock);
+        archive = mountTable->archives.value(filePath.left(prefixSize));
+    }
+
+    if (!archive)
+        return archive;
+
+    *path = QDir::cleanPath(filePath.mid(prefixSize + 1));
+    if (!archive->contains(*path))
+        return QSharedPointer<const DocumentArchive>();
+
+    return archive;
+}
+
+DocumentArchiveWriter::DocumentArchiveWriter(const QString &fileName) :
+    m_fileName(fileName),
+    m_file(fileName + QLatin1String(".part"))
+{
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_errorString = m_file.errorString();
+        return;
+    }
+
+    uchar header[HeaderSize];
+    std::memcpy(header, Magic, sizeof(Magic));
+    qToBigEndian<quint32>(Version, header + sizeof(Magic));
+
+    if (m_file.write(reinterpret_cast<const char *>(header), HeaderSize) != HeaderSize) {
+        m_errorString = m_file.errorString();
+        m_file.close();
+        return;
+    }
+
+    m_offset = HeaderSize;
+}
+
+DocumentArchiveWriter::~DocumentArchiveWriter()
+{
+    if (m_file.isOpen())
+        discard();
+}
+
+bool DocumentArchiveWriter::add(const QString &path, const QByteArray &data)
+{
+    const QByteArray compressedData = qCompress(data);
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen())
+        return false;
+
+    if (m_file.write(compressedData) != compressedData.size()) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    const Entry entry = {QDir::cleanPath(path), m_offset, static_cast<quint32>(compressedData.size())};
+    m_entries.append(entry);
+    m_offset += compressedData.size();
+
+    return true;
+}
+
+bool DocumentArchiveWriter::commit()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen())
+        return false;
+
+    QByteArray index;
+    QDataStream out(&index, QIODevice::WriteOnly);
+    out << static_cast<quint32>(m_entries.size());
+    for (const Entry &entry : m_entries)
+        out << entry.path << entry.offset << entry.size;
+
+    uchar footer[FooterSize];
+    qToBigEndian<quint64>(static_cast<quint64>(m_offset), footer);
+    std::memcpy(footer + 8, Magic, sizeof(Magic));
+
+    if (m_file.write(index) != index.size()
+            || m_file.write(reinterpret_cast<const char *>(footer), FooterSize) != FooterSize) {
+        m_errorString = m_file.errorString();
+        m_file.close();
+        m_file.remove();
+        return false;
+    }
+
+    m_file.close();
+
+    QFile::remove(m_fileName);
+    if (!m_file.rename(m_fileName)) {
+        m_errorString = m_file.errorString();
+        m_file.remove();
+        return false;
+    }
+
+    return true;
+}
+
+void DocumentArchiveWriter::discard()
+{
+    QMutexLocker locker(&m_mutex);
+    m_file.close();
+    m_file.remove();
+}
+
+QString DocumentArchiveWriter::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_errorString;
+}
@@ -0,0 +1,98 @@
+#ifndef DOCUMENTARCHIVE_H
+#define DOCUMENTARCHIVE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace Zeal {
+
+/**
+ * @short Documents of a docset packed into a single file.
+ *
+ * Every file is compressed on its own, and an index at the end of the archive maps paths to
+ * their data, so that a document is read without unpacking any other. Decompressed documents
+ * are kept in a cache shared by all archives.
+ */
+class DocumentArchive
+{
+public:
+    /// Name of the archive in the Contents/Resources directory of a docset
+    static const char FileName[];
+
+    /// Returns the archive \a fileName, or null if it cannot be read
+    static DocumentArchive *open(const QString &fileName);
+    ~DocumentArchive();
+
+    bool contains(const QString &path) const;
+    /// Returns paths of all documents, relative to the Documents directory
+    QStringList paths() const;
+    /// Returns the document at \a path relative to the Documents directory, or a null array
+    QByteArray read(const QString &path) const;
+    /// Same as read(), but leaves the page cache alone, for reading through all documents
+    QByteArray readUncached(const QString &path) const;
+
+    /// Serves the files under \a documentPath from \a archive
+    static void mount(const QString &documentPath, const QSharedPointer<const DocumentArchive> &archive);
+    /// Stops serving files under \a documentPath, if they are served from \a archive
+    static void unmount(const QString &documentPath, const DocumentArchive *archive);
+    /// Returns the archive mounted for the local file \a filePath, and sets \a path to the path
+    /// of the file within it. Returns null if \a filePath is not in an archive.
+    static QSharedPointer<const DocumentArchive> find(const QString &filePath, QString *path);
+
+private:
+    struct Entry {
+        qint64 offset;
+        quint32 size;
+    };
+
+    DocumentArchive() = default;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    QHash<QString, Entry> m_entries;
+};
+
+/**
+ * @short Creates a DocumentArchive.
+ *
+ * Documents can be added from several threads, they are compressed by the calling thread.
+ * The archive is written under a temporary name until it is committed.
+ */
+class DocumentArchiveWriter
+{
+public:
+    explicit DocumentArchiveWriter(const QString &fileName);
+    ~DocumentArchiveWriter();
+
+    bool add(const QString &path, const QByteArray &data);
+    /// Writes the index and moves the archive into place
+    bool commit();
+    /// Removes the incomplete archive
+    void discard();
+
+    QString errorString() const;
+
+private:
+    struct Entry {
+        QString path;
+        qint64 offset;
+        quint32 size;
+    };
+
+    mutable QMutex m_mutex;
+    QString m_fileName;
+    QFile m_file;
+    qint64 m_offset = 0;
+    QVector<Entry> m_entries;
+    QString m_errorString;
+};
+
+} // namespace Zeal
+
+#endif // DOCUMENTARCHIVE_H
@@ -0,0 +1,599 @@
+#include "fulltextindex.h"
+
+#include "documentarchive.h"
+
+#include <QAtomicInt>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Zeal;
+
+namespace {
+const char IndexMagic[8] = {'Z', 'E', 'A', 'L', 'F', 'T', 'I', 'X'};
+/// Increase whenever the layout or the content of the index changes
+const quint32 IndexVersion = 1;
+
+const int MinWordLength = 2;
+const int MaxWordLength = 64;
+// Words shorter than this are not expanded as prefixes, they would match most of the index
+const int MinPrefixLength = 3;
+const int MaxPrefixExpansions = 64;
+
+// BM25 parameters
+const double K1 = 1.2;
+const double B = 0.75;
+
+const int SnippetContext = 60; // Characters before the match
+const int SnippetLength = 160;
+
+bool isDocument(const QString &path)
+{
+    return path.endsWith(QLatin1String(".html"), Qt::CaseInsensitive)
+            || path.endsWith(QLatin1String(".htm"), Qt::CaseInsensitive);
+}
+
+void appendNumber(QByteArray &data, quint32 value)
+{
+    while (value >= 0x80) {
+        data.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.append(static_cast<char>(value));
+}
+
+bool readNumber(const char *&pos, const char *end, quint32 &value)
+{
+    value = 0;
+    for (int shift = 0; pos < end && shift < 32; shift += 7) {
+        const uchar byte = static_cast<uchar>(*pos++);
+        value |= static_cast<quint32>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+bool decodeEntity(const QString &entity, QString &decoded)
+{
+    if (entity.startsWith(QLatin1Char('#'))) {
+        bool ok;
+        const uint code = entity.startsWith(QLatin1String("#x"), Qt::CaseInsensitive)
+                ? entity.mid(2).toUInt(&ok, 16) : entity.mid(1).toUInt(&ok);
+        if (!ok || code == 0 || code > 0x10ffff)
+            return false;
+        decoded = QString::fromUcs4(&code, 1);
+        return true;
+    }
+
+    static const struct {
+        const char *name;
+        char character;
+    } entities[] = {
+        {"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''}, {"nbsp", ' '}
+    };
+
+    for (const auto &namedEntity : entities) {
+        if (entity == QLatin1String(namedEntity.name)) {
+            decoded = QLatin1Char(namedEntity.character);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Indexes are built one at a time at a low priority, so that searches keep their threads
+struct BuildQueue
+{
+    BuildQueue()
+    {
+        threadPool.setMaxThreadCount(1);
+    }
+
+    ~BuildQueue()
+    {
+        isStopped.store(1);
+        threadPool.waitForDone();
+    }
+
+    QThreadPool threadPool;
+    QAtomicInt isStopped;
+};
+
+Q_GLOBAL_STATIC(BuildQueue, buildQueue)
+
+class BuildJob : public QRunnable
+{
+public:
+    BuildJob(const QString &fileName, const QString &documentPath,
+             const QSharedPointer<const DocumentArchive> &archive, const QFileInfo &source,
+             const CancellationToken &token, const QAtomicInt *isStopped) :
+        m_fileName(fileName),
+        m_documentPath(documentPath),
+        m_archive(archive),
+        m_source(source),
+        m_token(token),
+        m_isStopped(isStopped)
+    {
+    }
+
+    void run() override
+    {
+        if (isCanceled())
+            return;
+
+        QThread::currentThread()->setPriority(QThread::LowPriority);
+
+        QStringList paths;
+        if (m_archive) {
+            for (const QString &path : m_archive->paths()) {
+                if (isDocument(path))
+                    paths.append(path);
+            }
+        } else {
+            const QDir documentDir(m_documentPath);
+            QDirIterator it(m_documentPath, {QStringLiteral("*.html"), QStringLiteral("*.htm")},
+                            QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext())
+                paths.append(documentDir.relativeFilePath(it.next()));
+        }
+
+        // Stable document ids, regardless of the order files are listed in
+        std::sort(paths.begin(), paths.end());
+
+        FullTextIndex::Builder builder;
+        for (const QString &path : paths) {
+            if (isCanceled())
+                return;
+
+            // Reading every page would only push the pages being browsed out of the cache
+            if (m_archive) {
+                builder.addDocument(path, m_archive->readUncached(path));
+            } else {
+                QFile file(m_documentPath + QLatin1Char('/') + path);
+                if (file.open(QIODevice::ReadOnly))
+                    builder.addDocument(path, file.readAll());
+            }
+        }
+
+        QScopedPointer<FullTextIndex> index(FullTextIndex::fromData(builder.build(m_source)));
+        if (!index || !index->save(m_fileName))
+            qWarning("Cannot save full-text index: %s", qPrintable(m_fileName));
+    }
+
+private:
+    bool isCanceled() const
+    {
+        return m_token.isCanceled() || m_isStopped->load();
+    }
+
+    QString m_fileName;
+    QString m_documentPath;
+    QSharedPointer<const DocumentArchive> m_archive;
+    QFileInfo m_source;
+    CancellationToken m_token;
+    const QAtomicInt *m_isStopped;
+};
+}
+
+void FullTextIndex::Builder::addDocument(const QString &path, const QByteArray &html)
+{
+    Document document;
+    document.path = path;
+
+    const QStringList words = tokenize(documentText(html, &document.title));
+    document.length = static_cast<quint32>(words.size());
+
+    QHash<QString, quint32> frequencies;
+    for (const QString &word : words)
+        ++frequencies[word];
+
+    const quint32 id = static_cast<quint32>(m_documents.size());
+    for (auto it = frequencies.cbegin(); it != frequencies.cend(); ++it)
+        m_postings[it.key()].append({id, it.value()});
+
+    m_documents.append(document);
+}
+
+QByteArray FullTextIndex::Builder::build(const QFileInfo &source) const
+{
+    QVector<QByteArray> terms;
+    terms.reserve(m_postings.size());
+    for (auto it = m_postings.cbegin(); it != m_postings.cend(); ++it)
+        terms.append(it.key().toUtf8());
+
+    std::sort(terms.begin(), terms.end(), [](const QByteArray &lhs, const QByteArray &rhs) {
+        return qstrcmp(lhs, rhs) < 0;
+    });
+
+    QByteArray body;
+    QDataStream out(&body, QIODevice::WriteOnly);
+
+    out << static_cast<quint32>(m_documents.size());
+    for (const Document &document : m_documents)
+        out << document.path << document.title << document.length;
+
+    QVector<quint32> offsets;
+    offsets.reserve(terms.size() + 1);
+    QByteArray postings;
+
+    out << static_cast<quint32>(terms.size());
+    for (const QByteArray &term : terms) {
+        const QVector<Posting> &termPostings = m_postings.value(QString::fromUtf8(term));
+        out << term << static_cast<quint32>(termPostings.size());
+
+        // Documents were added in order, so ids only grow
+        offsets.append(static_cast<quint32>(postings.size()));
+        quint32 previous = 0;
+        for (const Posting &posting : termPostings) {
+            appendNumber(postings, posting.document - previous);
+            appendNumber(postings, posting.frequency);
+            previous = posting.document;
+        }
+    }
+    offsets.append(static_cast<quint32>(postings.size()));
+
+    out << offsets << postings;
+
+    QByteArray data(IndexMagic, sizeof(IndexMagic));
+    QDataStream header(&data, QIODevice::WriteOnly | QIODevice::Append);
+    header << IndexVersion << source.size() << source.lastModified().toMSecsSinceEpoch()
+           << qCompress(body);
+
+    return data;
+}
+
+FullTextIndex *FullTextIndex::fromData(const QByteArray &data)
+{
+    if (!data.startsWith(QByteArray::fromRawData(IndexMagic, sizeof(IndexMagic))))
+        return nullptr;
+
+    QDataStream header(data.mid(sizeof(IndexMagic)));
+    quint32 version;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    QByteArray compressedBody;
+    header >> version >> sourceSize >> sourceModified >> compressedBody;
+    if (header.status() != QDataStream::Ok || version != IndexVersion)
+        return nullptr;
+
+    QScopedPointer<FullTextIndex> index(new FullTextIndex());
+    index->m_data = data;
+
+    QDataStream in(qUncompress(compressedBody));
+
+    quint32 documentCount;
+    in >> documentCount;
+    if (in.status() != QDataStream::Ok)
+        return nullptr;
+
+    quint64 totalLength = 0;
+    index->m_documents.reserve(static_cast<int>(qMin<quint32>(documentCount, 1 << 20)));
+    for (quint32 i = 0; i < documentCount && in.status() == QDataStream::Ok; ++i) {
+        Document document;
+        in >> document.path >> document.title >> document.length;
+        totalLength += document.length;
+        index->m_documents.append(document);
+    }
+
+    quint32 termCount;
+    in >> termCount;
+    if (in.status() != QDataStream::Ok)
+        return nullptr;
+
+    index->m_terms.reserve(static_cast<int>(qMin<quint32>(termCount, 1 << 22)));
+    index->m_documentFrequencies.reserve(index->m_terms.capacity());
+    for (quint32 i = 0; i < termCount && in.status() == QDataStream::Ok; ++i) {
+        QByteArray term;
+        quint32 documentFrequency;
+        in >> term >> documentFrequency;
+        index->m_terms.append(term);
+        index->m_documentFrequencies.append(documentFrequency);
+    }
+
+    in >> index->m_postingOffsets >> index->m_postings;
+    if (in.status() != QDataStream::Ok
+            || index->m_postingOffsets.size() != index->m_terms.size() + 1
+            || !std::is_sorted(index->m_postingOffsets.cbegin(), index->m_postingOffsets.cend())
+            || index->m_postingOffsets.last() > static_cast<quint32>(index->m_postings.size())) {
+        return nullptr;
+    }
+
+    if (!index->m_documents.isEmpty())
+        index->m_averageLength = static_cast<double>(totalLength) / index->m_documents.size();
+
+    return index.take();
+}
+
+FullTextIndex *FullTextIndex::fromFile(const QString &fileName, const QFileInfo &source)
+{
+    if (!isUpToDate(fileName, source))
+        return nullptr;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    return fromData(file.readAll());
+}
+
+bool FullTextIndex::isUpToDate(const QString &fileName, const QFileInfo &source)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    // Only the header is read, the rest may be large
+    char magic[sizeof(IndexMagic)];
+    if (file.read(magic, sizeof(magic)) != sizeof(magic)
+            || !std::equal(magic, magic + sizeof(magic), IndexMagic)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 version;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    in >> version >> sourceSize >> sourceModified;
+
+    return in.status() == QDataStream::Ok && version == IndexVersion && sourceSize == source.size()
+            && sourceModified == source.lastModified().toMSecsSinceEpoch();
+}
+
+void FullTextIndex::buildLater(const QString &fileName, const QString &documentPath,
+                               const QSharedPointer<const DocumentArchive> &archive,
+                               const QFileInfo &source, const CancellationToken &token)
+{
+    buildQueue->threadPool.start(new BuildJob(fileName, documentPath, archive, source, token,
+                                              &buildQueue->isStopped));
+}
+
+bool FullTextIndex::save(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(m_data);
+    return file.commit();
+}
+
+int FullTextIndex::documentCount() const
+{
+    return m_documents.size();
+}
+
+QString FullTextIndex::path(int document) const
+{
+    return m_documents.at(document).path;
+}
+
+QString FullTextIndex::title(int document) const
+{
+    return m_documents.at(document).title;
+}
+
+QVector<FullTextIndex::Hit> FullTextIndex::find(const QString &query, int limit,
+                                                const CancellationToken &token) const
+{
+    QVector<Hit> hits;
+
+    const QStringList words = tokenize(query);
+    if (words.isEmpty() || m_documents.isEmpty())
+        return hits;
+
+    const auto lessThan = [](const QByteArray &lhs, const QByteArray &rhs) {
+        return qstrcmp(lhs, rhs) < 0;
+    };
+
+    QList<QHash<int, double>> wordScores;
+    for (int i = 0; i < words.size(); ++i) {
+        const QByteArray word = words.at(i).toUtf8();
+        // The last word may not be typed completely yet
+        const bool isPrefix = i == words.size() - 1 && word.size() >= MinPrefixLength;
+
+        QHash<int, double> scores;
+        int expansionCount = 0;
+        for (auto it = std::lower_bound(m_terms.cbegin(), m_terms.cend(), word, lessThan);
+             it != m_terms.cend() && expansionCount < MaxPrefixExpansions; ++it, ++expansionCount) {
+            if (isPrefix ? !it->startsWith(word) : *it != word)
+                break;
+
+            if (token.isCanceled())
+                return hits;
+
+            scoreTerm(static_cast<int>(it - m_terms.cbegin()), scores);
+        }
+
+        // Pages have to contain all words
+        if (scores.isEmpty())
+            return hits;
+
+        wordScores.append(scores);
+    }
+
+    // Intersecting is cheapest starting from the rarest word
+    std::sort(wordScores.begin(), wordScores.end(),
+              [](const QHash<int, double> &lhs, const QHash<int, double> &rhs) {
+        return lhs.size() < rhs.size();
+    });
+
+    const QHash<int, double> &rarest = wordScores.first();
+    for (auto it = rarest.cbegin(); it != rarest.cend(); ++it) {
+        double score = it.value();
+        bool isMatch = true;
+        for (int i = 1; i < wordScores.size() && isMatch; ++i) {
+            const auto match = wordScores.at(i).constFind(it.key());
+            isMatch = match != wordScores.at(i).cend();
+            if (isMatch)
+                score += match.value();
+        }
+
+        if (isMatch)
+            hits.append({it.key(), score});
+    }
+
+    const auto greater = [](const Hit &lhs, const Hit &rhs) {
+        return lhs.score > rhs.score;
+    };
+
+    if (hits.size() > limit) {
+        std::partial_sort(hits.begin(), hits.begin() + limit, hits.end(), greater);
+        hits.erase(hits.begin() + limit, hits.end());
+    } else {
+        std::sort(hits.begin(), hits.end(), greater);
+    }
+
+    return hits;
+}
+
+void FullTextIndex::scoreTerm(int termIndex, QHash<int, double> &scores) const
+{
+    const double documentCount = m_documents.size();
+    const double documentFrequency = m_documentFrequencies.at(termIndex);
+    const double idf = std::log(1 + (documentCount - documentFrequency + 0.5) / (documentFrequency + 0.5));
+    const double averageLength = qMax(m_averageLength, 1.0);
+
+    const char *pos = m_postings.constData() + m_postingOffsets.at(termIndex);
+    const char *end = m_postings.constData() + m_postingOffsets.at(termIndex + 1);
+
+    quint32 document = 0;
+    while (pos < end) {
+        quint32 delta;
+        quint32 frequency;
+        if (!readNumber(pos, end, delta) || !readNumber(pos, end, frequency))
+            return;
+
+        document += delta;
+        if (document >= static_cast<quint32>(m_documents.size()))
+            return;
+
+        const double length = m_documents.at(static_cast<int>(document)).length;
+        scores[static_cast<int>(document)] += idf * frequency * (K1 + 1)
+                / (frequency + K1 * (1 - B + B * length / averageLength));
+    }
+}
+
+QStringList FullTextIndex::tokenize(const QString &text)
+{
+    QStringList words;
+    QString word;
+
+    const auto appendWord = [&words, &word]() {
+        if (word.size() >= MinWordLength && word.size() <= MaxWordLength)
+            words.append(word);
+        word.clear();
+    };
+
+    for (const QChar c : text) {
+        if (c.isLetterOrNumber() || c == QLatin1Char('_'))
+            word.append(c.toLower());
+        else if (!word.isEmpty())
+            appendWord();
+    }
+    appendWord();
+
+    return words;
+}
+
+QString FullTextIndex::documentText(const QByteArray &html, QString *title)
+{
+    const QString source = QString::fromUtf8(html);
+    const int size = source.size();
+
+    QString text;
+    text.reserve(size);
+
+    int i = 0;
+    while (i < size) {
+        const QChar c = source.at(i);
+
+        if (c == QLatin1Char('<')) {
+            if (source.midRef(i, 4) == QLatin1String("<!--")) {
+                const int commentEnd = source.indexOf(QLatin1String("-->"), i + 4);
+                i = commentEnd == -1 ? size : commentEnd + 3;
+                continue;
+            }
+
+            const int tagEnd = source.indexOf(QLatin1Char('>'), i);
+            if (tagEnd == -1)
+                break;
+
+            int nameEnd = i + 1;
+            while (nameEnd < tagEnd && source.at(nameEnd).isLetterOrNumber())
+                ++nameEnd;
+            const QString name = source.mid(i + 1, nameEnd - i - 1).toLower();
+
+            i = tagEnd + 1;
+
+            // Neither scripts nor style sheets are text, and the title is kept apart
+            if (name == QLatin1String("script") || name == QLatin1String("style")
+                    || name == QLatin1String("title")) {
+                const int contentEnd = source.indexOf(QLatin1String("</") + name, i, Qt::CaseInsensitive);
+                if (name == QLatin1String("title") && title)
+                    *title = documentText(source.mid(i, contentEnd - i).toUtf8()).simplified();
+                i = contentEnd == -1 ? size : contentEnd;
+            }
+
+            // Tags separate words, e.g. cells of a table
+            text.append(QLatin1Char(' '));
+            continue;
+        }
+
+        if (c == QLatin1Char('&')) {
+            const int entityEnd = source.indexOf(QLatin1Char(';'), i + 1);
+            QString decoded;
+            if (entityEnd != -1 && entityEnd - i <= 10
+                    && decodeEntity(source.mid(i + 1, entityEnd - i - 1), decoded)) {
+                text.append(decoded);
+                i = entityEnd + 1;
+                continue;
+            }
+        }
+
+        text.append(c);
+        ++i;
+    }
+
+    return text;
+}
+
+QString FullTextIndex::snippet(const QString &text, const QStringList &terms)
+{
+    const QString simplifiedText = text.simplified();
+
+    int matchIndex = -1;
+    for (const QString &term : terms) {
+        const int index = simplifiedText.indexOf(term, 0, Qt::CaseInsensitive);
+        if (index != -1 && (matchIndex == -1 || index < matchIndex))
+            matchIndex = index;
+    }
+
+    int start = qMax(0, matchIndex - SnippetContext);
+    // Starts at a word boundary, unless the word is very long
+    if (start > 0) {
+        const int spaceIndex = simplifiedText.indexOf(QLatin1Char(' '), start);
+        if (spaceIndex != -1 && spaceIndex < matchIndex)
+            start = spaceIndex + 1;
+    }
+
+    QString snippet = simplifiedText.mid(start, SnippetLength);
+    if (start > 0)
+        snippet.prepend(QStringLiteral("..."));
+    if (start + SnippetLength < simplifiedText.size())
+        snippet.append(QStringLiteral("..."));
+
+    return snippet;
+}
@@ -0,0 +1,113 @@
+#ifndef FULLTEXTINDEX_H
+#define FULLTEXTINDEX_H
+
+#include "cancellationtoken.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QFileInfo;
+
+namespace Zeal {
+
+class DocumentArchive;
+
+/**
+ * @short Full-text index of the pages of a single docset.
+ *
+ * Page text is split into lower case words, and each word maps to the pages containing it,
+ * with their ids delta-encoded as variable length integers. Queries match pages containing
+ * all of their words, the last one also as a prefix, and rank them with BM25.
+ *
+ * Indexes are built in the background, one docset at a time, and stored compressed next to
+ * the docset database. Like a SearchIndex, an index is outdated once the database changes.
+ */
+class FullTextIndex
+{
+public:
+    class Builder
+    {
+    public:
+        void addDocument(const QString &path, const QByteArray &html);
+        /// Returns index data for the database \a source
+        QByteArray build(const QFileInfo &source) const;
+
+    private:
+        struct Document {
+            QString path;
+            QString title;
+            quint32 length; // In words
+        };
+
+        struct Posting {
+            quint32 document;
+            quint32 frequency;
+        };
+
+        QVector<Document> m_documents;
+        QHash<QString, QVector<Posting>> m_postings;
+    };
+
+    struct Hit {
+        int document;
+        double score;
+    };
+
+    static FullTextIndex *fromData(const QByteArray &data);
+    /// Reads index file \a fileName, returns null if it is invalid or outdated compared to the
+    /// database \a source
+    static FullTextIndex *fromFile(const QString &fileName, const QFileInfo &source);
+    /// Returns true if \a fileName holds an index of the current database \a source
+    static bool isUpToDate(const QString &fileName, const QFileInfo &source);
+
+    /// Builds the index \a fileName in the background from the pages under \a documentPath,
+    /// or from \a archive if it is not null. Stops when \a token gets canceled.
+    static void buildLater(const QString &fileName, const QString &documentPath,
+                           const QSharedPointer<const DocumentArchive> &archive,
+                           const QFileInfo &source, const CancellationToken &token);
+
+    bool save(const QString &fileName) const;
+
+    int documentCount() const;
+    QString path(int document) const;
+    QString title(int document) const;
+
+    /// Returns up to \a limit best pages matching \a query
+    QVector<Hit> find(const QString &query, int limit,
+                      const CancellationToken &token = CancellationToken()) const;
+
+    /// Returns lower case words of \a text
+    static QStringList tokenize(const QString &text);
+    /// Returns the text of \a html without markup, and sets \a title to its title
+    static QString documentText(const QByteArray &html, QString *title = nullptr);
+    /// Returns a short excerpt of \a text around the first of \a terms
+    static QString snippet(const QString &text, const QStringList &terms);
+
+private:
+    struct Document {
+        QString path;
+        QString title;
+        quint32 length;
+    };
+
+    FullTextIndex() = default;
+
+    /// Adds the scores of the pages containing term \a termIndex to \a scores
+    void scoreTerm(int termIndex, QHash<int, double> &scores) const;
+
+    QByteArray m_data;
+    QVector<Document> m_documents;
+    double m_averageLength = 0;
+    QVector<QByteArray> m_terms; // Sorted UTF-8
+    QVector<quint32> m_documentFrequencies;
+    QVector<quint32> m_postingOffsets; // Into m_postings, with a trailing one
+    QByteArray m_postings;
+};
+
+} // namespace Zeal
+
+#endif // FULLTEXTINDEX_H
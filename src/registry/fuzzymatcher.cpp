@@ -0,0 +1,267 @@
+#include "fuzzymatcher.h"
+
+#include "symboltype.h"
+
+#include <QVarLengthArray>
+
+#include <utility>
+
+using namespace Zeal;
+
+namespace {
+const int ScoreMatch = 16;
+const int ScoreGapStart = -3;
+const int ScoreGapExtension = -1;
+const int ScoreExactMatch = 32;
+
+const int BonusStart = 10;
+const int BonusBoundary = 8;
+const int BonusCamelCase = 7;
+const int BonusConsecutive = 4;
+// The first query character weighs more, so that matches on a word start win
+const int BonusFirstCharMultiplier = 2;
+
+// Qualified matches rank after matches of the plain name
+const int PenaltyQualified = 8;
+
+const int Unreachable = -(1 << 20);
+
+bool isSeparator(QChar c)
+{
+    switch (c.unicode()) {
+    case '.':
+    case ':':
+    case '/':
+    case '_':
+    case '-':
+    case ' ':
+    case '(':
+    case '$':
+        return true;
+    default:
+        return false;
+    }
+}
+
+int positionBonus(const QString &name, int i)
+{
+    if (i == 0)
+        return BonusStart;
+
+    const QChar prev = name.at(i - 1);
+    const QChar cur = name.at(i);
+
+    if (isSeparator(prev))
+        return BonusBoundary;
+    if ((prev.isLower() && cur.isUpper()) || (!prev.isDigit() && cur.isDigit()))
+        return BonusCamelCase;
+    return 0;
+}
+}
+
+FuzzyMatcher::FuzzyMatcher(const QString &query) :
+    m_query(query.toLower())
+{
+    if (query.contains(QLatin1String("::")))
+        m_separator = QStringLiteral("::");
+    else if (query.contains(QLatin1Char('/')))
+        m_separator = QStringLiteral("/");
+    else
+        m_separator = QStringLiteral(".");
+}
+
+int FuzzyMatcher::score(const QString &name) const
+{
+    const int m = m_query.size();
+    const int n = name.size();
+
+    if (m == 0)
+        return 0;
+    if (m > n)
+        return NoMatch;
+
+    // Quick rejection before the quadratic part
+    for (int i = 0, j = 0; j < m; ++i) {
+        if (i == n)
+            return NoMatch;
+        if (name.at(i).toLower() == m_query.at(j))
+            ++j;
+    }
+
+    // Best score of the query prefix ending with a match at each name position,
+    // kept for the previous and the current query character only.
+    QVarLengthArray<int, 128> previous(n);
+    QVarLengthArray<int, 128> current(n);
+    QVarLengthArray<int, 128> bonus(n);
+
+    for (int i = 0; i < n; ++i) {
+        bonus[i] = positionBonus(name, i);
+        previous[i] = name.at(i).toLower() == m_query.at(0)
+                ? ScoreMatch + bonus[i] * BonusFirstCharMultiplier : Unreachable;
+    }
+
+    for (int j = 1; j < m; ++j) {
+        const QChar c = m_query.at(j);
+        int gapped = Unreachable; // Best previous match ending before i - 1, with gap penalty
+
+        for (int i = 0; i < n; ++i) {
+            if (i >= 2)
+                gapped = qMax(gapped + ScoreGapExtension, previous[i - 2] + ScoreGapStart);
+
+            current[i] = Unreachable;
+            if (i < j || name.at(i).toLower() != c)
+                continue;
+
+            const int consecutive = previous[i - 1] + ScoreMatch + qMax(bonus[i], BonusConsecutive);
+            const int scattered = gapped + ScoreMatch + bonus[i];
+            current[i] = qMax(consecutive, scattered);
+        }
+
+        std::swap(previous, current);
+    }
+
+    int best = Unreachable;
+    for (int i = m - 1; i < n; ++i)
+        best = qMax(best, previous[i]);
+
+    if (best <= Unreachable / 2)
+        return NoMatch;
+
+    if (n == m)
+        best += ScoreExactMatch;
+
+    return qMax(best, 0);
+}
+
+int FuzzyMatcher::score(const QString &name, const QString &parentName) const
+{
+    const int nameScore = score(name);
+    if (nameScore != NoMatch || parentName.isEmpty())
+        return nameScore;
+
+    // The query refers to a qualified name, like "vector::push"
+    const int qualifiedScore = score(parentName + m_separator + name);
+    if (qualifiedScore == NoMatch)
+        return NoMatch;
+    return qMax(qualifiedScore - PenaltyQualified, 0);
+}
+
+QVector<int> FuzzyMatcher::matchPositions(const QString &name) const
+{
+    const int m = m_query.size();
+    const int n = name.size();
+
+    if (m == 0 || m > n)
+        return QVector<int>();
+
+    // Same recurrence as score(), with all rows kept for tracing back the best alignment.
+    // Each match records the position of the previous one.
+    QVector<int> scores(m * n, Unreachable);
+    QVector<int> previousPositions(m * n, -1);
+    QVarLengthArray<int, 128> bonus(n);
+
+    for (int i = 0; i < n; ++i) {
+        bonus[i] = positionBonus(name, i);
+        if (name.at(i).toLower() == m_query.at(0))
+            scores[i] = ScoreMatch + bonus[i] * BonusFirstCharMultiplier;
+    }
+
+    for (int j = 1; j < m; ++j) {
+        const QChar c = m_query.at(j);
+        const int *previous = scores.constData() + (j - 1) * n;
+        int *current = scores.data() + j * n;
+        int *currentPrevious = previousPositions.data() + j * n;
+        int gapped = Unreachable;
+        int gappedFrom = -1;
+
+        for (int i = 0; i < n; ++i) {
+            if (i >= 2) {
+                const int started = previous[i - 2] + ScoreGapStart;
+                if (started >= gapped + ScoreGapExtension) {
+                    gapped = started;
+                    gappedFrom = i - 2;
+                } else {
+                    gapped += ScoreGapExtension;
+                }
+            }
+
+            if (i < j || name.at(i).toLower() != c)
+                continue;
+
+            const int consecutive = previous[i - 1] + ScoreMatch + qMax(bonus[i], BonusConsecutive);
+            const int scattered = gapped + ScoreMatch + bonus[i];
+            if (consecutive >= scattered) {
+                current[i] = consecutive;
+                currentPrevious[i] = i - 1;
+            } else {
+                current[i] = scattered;
+                currentPrevious[i] = gappedFrom;
+            }
+        }
+    }
+
+    int last = -1;
+    int best = Unreachable;
+    for (int i = m - 1; i < n; ++i) {
+        if (scores.at((m - 1) * n + i) > best) {
+            best = scores.at((m - 1) * n + i);
+            last = i;
+        }
+    }
+
+    if (best <= Unreachable / 2)
+        return QVector<int>();
+
+    QVector<int> positions(m);
+    for (int j = m - 1; j >= 0; --j) {
+        positions[j] = last;
+        last = previousPositions.at(j * n + last);
+    }
+
+    return positions;
+}
+
+QVector<int> FuzzyMatcher::matchPositions(const QString &name, const QString &parentName,
+                                          int parentOffset) const
+{
+    const QVector<int> positions = matchPositions(name);
+    if (!positions.isEmpty() || parentName.isEmpty())
+        return positions;
+
+    // Mapped back from the qualified name that score() falls back to, separators are dropped
+    QVector<int> namePositions;
+    QVector<int> parentPositions;
+    const int nameStart = parentName.size() + m_separator.size();
+    for (int position : matchPositions(parentName + m_separator + name)) {
+        if (position < parentName.size())
+            parentPositions.append(position + parentOffset);
+        else if (position >= nameStart)
+            namePositions.append(position - nameStart);
+    }
+
+    return namePositions + parentPositions;
+}
+
+int FuzzyMatcher::typeBonus(const QString &symbolType)
+{
+    switch (SymbolType::fromString(symbolType)) {
+    case SymbolType::Class:
+    case SymbolType::Module:
+    case SymbolType::Namespace:
+    case SymbolType::Protocol:
+    case SymbolType::Structure:
+        return 6;
+    case SymbolType::Enumeration:
+    case SymbolType::Type:
+        return 4;
+    case SymbolType::Constructor:
+    case SymbolType::Function:
+    case SymbolType::Macro:
+    case SymbolType::Method:
+        return 3;
+    case SymbolType::Guide:
+        return -2;
+    default:
+        return 0;
+    }
+}
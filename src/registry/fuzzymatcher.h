@@ -0,0 +1,45 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <QString>
+#include <QVector>
+
+namespace Zeal {
+
+/**
+ * @short Scores symbol names against a search query.
+ *
+ * A name matches if it contains the query characters in order, ignoring case.
+ * Matched characters score more at the start of the name, after separators and on
+ * camelCase humps, and consecutive matches score more than scattered ones, so that
+ * "qsm" ranks QSortFilterModel before QStyleOptionMenuItem.
+ */
+class FuzzyMatcher
+{
+public:
+    explicit FuzzyMatcher(const QString &query);
+
+    /// Returns the score of \a name, or NoMatch if the query is not a subsequence of it.
+    int score(const QString &name) const;
+    /// Scores \a name, falling back to the name qualified with \a parentName.
+    int score(const QString &name, const QString &parentName) const;
+
+    /// Returns the positions of the characters in \a name that score() matches, in order.
+    QVector<int> matchPositions(const QString &name) const;
+    /// Returns the positions matched by score(\a name, \a parentName), those in \a parentName
+    /// offset by \a parentOffset, like for displaying the parent name after the name.
+    QVector<int> matchPositions(const QString &name, const QString &parentName, int parentOffset) const;
+
+    /// Returns a small bonus favouring declarations over members and guides.
+    static int typeBonus(const QString &symbolType);
+
+    static const int NoMatch = -1;
+
+private:
+    QString m_query;
+    QString m_separator;
+};
+
+} // namespace Zeal
+
+#endif // FUZZYMATCHER_H
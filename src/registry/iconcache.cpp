@@ -0,0 +1,52 @@
+#include "iconcache.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QHash>
+#include <QImageReader>
+#include <QMutex>
+
+using namespace Zeal;
+
+namespace {
+struct Icons
+{
+    QMutex mutex;
+    QHash<QString, QIcon> icons; // By file name
+    bool isCleanupRegistered = false;
+};
+
+Q_GLOBAL_STATIC(Icons, icons)
+
+// Decoded pixmaps have to go while the GUI application is still there
+void clearIcons()
+{
+    QMutexLocker locker(&icons->mutex);
+    icons->icons.clear();
+}
+}
+
+QIcon IconCache::icon(const QString &fileName)
+{
+    QMutexLocker locker(&icons->mutex);
+    auto it = icons->icons.constFind(fileName);
+    if (it != icons->icons.constEnd())
+        return it.value();
+
+    if (!icons->isCleanupRegistered && QCoreApplication::instance()) {
+        qAddPostRoutine(clearIcons);
+        icons->isCleanupRegistered = true;
+    }
+
+    return icons->icons.insert(fileName, QIcon(fileName)).value();
+}
+
+bool IconCache::isIconFile(const QString &fileName)
+{
+    const QFileInfo fileInfo(fileName);
+    if (!fileInfo.isFile())
+        return false;
+
+    // Only the header is read, which is enough for telling the format
+    return QImageReader(fileName).canRead();
+}
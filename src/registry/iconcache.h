@@ -0,0 +1,27 @@
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <QIcon>
+#include <QString>
+
+namespace Zeal {
+
+/**
+ * @short Shares the icons of docsets and symbol types.
+ *
+ * Everyone asking for the same file gets a copy of the same QIcon, so its pixmaps are decoded
+ * once for each size they are painted at, and are kept by QPixmapCache under that icon. Nothing
+ * is decoded before an icon gets painted, entries scrolled out of sight cost only the lookup.
+ */
+class IconCache
+{
+public:
+    /// Returns the icon of \a fileName, which can use search paths like "docsetIcon:"
+    static QIcon icon(const QString &fileName);
+    /// Returns true if \a fileName is an image that icons can be loaded from, without decoding it
+    static bool isIconFile(const QString &fileName);
+};
+
+} // namespace Zeal
+
+#endif // ICONCACHE_H
@@ -0,0 +1,70 @@
+#include "keywordtrie.h"
+
+#include "docset.h"
+
+using namespace Zeal;
+
+KeywordTrie::KeywordTrie()
+{
+    clear();
+}
+
+void KeywordTrie::insert(Docset *docset)
+{
+    // An empty keyword is contained in every term
+    m_nodes[0].docsets.append(docset);
+
+    for (const QString &term : terms(docset)) {
+        for (int start = 0; start < term.size(); ++start) {
+            int node = 0;
+            for (int i = start; i < term.size(); ++i) {
+                int child = m_nodes.at(node).children.value(term.at(i), -1);
+                if (child == -1) {
+                    child = m_nodes.size();
+                    m_nodes[node].children.insert(term.at(i), child);
+                    m_nodes.append(Node());
+                }
+
+                node = child;
+
+                // Substrings repeat across suffixes and terms, the docset is only added once
+                QVector<Docset *> &docsets = m_nodes[node].docsets;
+                if (docsets.isEmpty() || docsets.last() != docset)
+                    docsets.append(docset);
+            }
+        }
+    }
+}
+
+void KeywordTrie::clear()
+{
+    m_nodes.clear();
+    m_nodes.append(Node());
+}
+
+QVector<Docset *> KeywordTrie::find(const QString &keyword) const
+{
+    const QString foldedKeyword = keyword.toCaseFolded();
+
+    int node = 0;
+    for (const QChar &ch : foldedKeyword) {
+        node = m_nodes.at(node).children.value(ch, -1);
+        if (node == -1)
+            return QVector<Docset *>();
+    }
+
+    return m_nodes.at(node).docsets;
+}
+
+QStringList KeywordTrie::terms(const Docset *docset)
+{
+    QStringList terms = {docset->prefix, docset->info.keyword};
+    terms.append(docset->metadata.aliases());
+
+    for (QString &term : terms)
+        term = term.toCaseFolded();
+
+    terms.removeAll(QString());
+    terms.removeDuplicates();
+    return terms;
+}
@@ -0,0 +1,45 @@
+#ifndef KEYWORDTRIE_H
+#define KEYWORDTRIE_H
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+namespace Zeal {
+
+class Docset;
+
+/**
+ * @short Looks up docsets by the keywords of filtered queries.
+ *
+ * A keyword selects the docsets whose prefix, Info.plist keyword or one of the aliases contains it,
+ * ignoring case, so that "py:" keeps selecting both Python and NumPy. All suffixes of these terms
+ * are stored, which makes a lookup take one step per keyword character, however many docsets
+ * are installed.
+ */
+class KeywordTrie
+{
+public:
+    KeywordTrie();
+
+    void insert(Docset *docset);
+    void clear();
+
+    /// Returns the docsets with a term containing \a keyword, in no particular order
+    QVector<Docset *> find(const QString &keyword) const;
+
+    /// Returns the case folded terms that select \a docset
+    static QStringList terms(const Docset *docset);
+
+private:
+    struct Node {
+        QHash<QChar, int> children; // Indexes into m_nodes
+        QVector<Docset *> docsets; // With a term containing the path to this node
+    };
+
+    QVector<Node> m_nodes; // The first node is the root
+};
+
+} // namespace Zeal
+
+#endif // KEYWORDTRIE_H
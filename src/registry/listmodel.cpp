@@ -2,9 +2,17 @@
 
 #include "docset.h"
 #include "docsetregistry.h"
+#include "iconcache.h"
+#include "symboltype.h"
+
+#include <algorithm>
 
 using namespace Zeal;
 
+namespace {
+const int SymbolPageSize = 1000;
+}
+
 /// TODO: Get rid of const_casts
 
 ListModel::ListModel(DocsetRegistry *docsetRegistry, QObject *parent) :
@@ -27,15 +35,14 @@ QVariant ListModel::data(const QModelIndex &index, int role) const
     case Qt::DecorationRole:
         switch (indexLevel(index)) {
         case Level::DocsetLevel:
-            return m_docsetRegistry->docset(index.row())->icon();
+            return docset(index.row())->icon();
         case Level::GroupLevel: {
             DocsetItem *docsetItem = reinterpret_cast<DocsetItem *>(index.internalPointer());
-            const QString symbolType = docsetItem->groups.at(index.row())->symbolType;
-            return QIcon(QString("typeIcon:%1.png").arg(symbolType));
+            return docsetItem->groups.at(index.row())->icon;
         }
         case Level::SymbolLevel: {
             GroupItem *groupItem = reinterpret_cast<GroupItem *>(index.internalPointer());
-            return QIcon(QString("typeIcon:%1.png").arg(groupItem->symbolType));
+            return groupItem->icon;
         }
         default:
             return QVariant();
@@ -44,29 +51,44 @@ QVariant ListModel::data(const QModelIndex &index, int role) const
         switch (indexLevel(index)) {
         case Level::DocsetLevel:
             if (!index.column())
-                return m_docsetRegistry->docset(index.row())->title();
+                return docset(index.row())->title();
             else
-                return m_docsetRegistry->docset(index.row())->indexFilePath();
+                return docset(index.row())->indexFilePath();
         case Level::GroupLevel: {
             DocsetItem *docsetItem = reinterpret_cast<DocsetItem *>(index.internalPointer());
-            const QString symbolType = docsetItem->groups.at(index.row())->symbolType;
-            return QString(QLatin1String("%1 (%2)")).arg(pluralize(symbolType),
-                                                         QString::number(docsetItem->docset->symbolCount(symbolType)));
+            const GroupItem *groupItem = docsetItem->groups.at(index.row());
+            return QString(QLatin1String("%1 (%2)")).arg(pluralize(groupItem->symbolType),
+                                                         QString::number(groupItem->symbolCount));
         }
         case Level::SymbolLevel: {
             GroupItem *groupItem = reinterpret_cast<GroupItem *>(index.internalPointer());
-            auto it = groupItem->docsetItem->docset->symbols(groupItem->symbolType).cbegin() + index.row();
+            const int page = index.row() / SymbolPageSize;
+            const QVector<Docset::Symbol> symbols = groupItem->docsetItem->docset->symbols(
+                        groupItem->symbolType, groupItem->pageStarts.at(page), SymbolPageSize);
+            const int offset = index.row() % SymbolPageSize;
+            if (offset >= symbols.size())
+                return QVariant();
+
+            const Docset::Symbol &symbol = symbols.at(offset);
             if (!index.column())
-                return it.key();
+                return symbol.name;
             else
-                return it.value();
+                return symbol.path;
         }
         default:
             return QVariant();
         }
     case DocsetNameRole:
-        if (!index.parent().isValid())
-            return m_docsetRegistry->docset(index.row())->name();
+        switch (indexLevel(index)) {
+        case Level::DocsetLevel:
+            return docset(index.row())->name();
+        case Level::GroupLevel:
+            return reinterpret_cast<DocsetItem *>(index.internalPointer())->docset->name();
+        case Level::SymbolLevel:
+            return reinterpret_cast<GroupItem *>(index.internalPointer())->docsetItem->docset->name();
+        default:
+            return QVariant();
+        }
     default:
         return QVariant();
     }
@@ -81,8 +103,7 @@ QModelIndex ListModel::index(int row, int column, const QModelIndex &parent) con
     case Level::RootLevel:
         return createIndex(row, column);
     case Level::DocsetLevel: {
-        auto it = m_docsetItems.begin() + parent.row();
-        return createIndex(row, column, reinterpret_cast<void *>(it.value()));
+        return createIndex(row, column, m_docsetItems.at(parent.row()));
     }
     case Level::GroupLevel: {
         DocsetItem *docsetItem = reinterpret_cast<DocsetItem *>(parent.internalPointer());
@@ -98,11 +119,11 @@ QModelIndex ListModel::parent(const QModelIndex &child) const
     switch (indexLevel(child)) {
     case Level::GroupLevel: {
         DocsetItem *item = reinterpret_cast<DocsetItem *>(child.internalPointer());
-        return createIndex(m_docsetItems.keys().indexOf(item->docset->name()), 0);
+        return createIndex(item->row, 0);
     }
     case SymbolLevel: {
         GroupItem *item = reinterpret_cast<GroupItem *>(child.internalPointer());
-        return createIndex(item->docsetItem->groups.indexOf(item), 0, item->docsetItem);
+        return createIndex(item->row, 0, item->docsetItem);
     }
     default:
         return QModelIndex();
@@ -124,44 +145,115 @@ int ListModel::rowCount(const QModelIndex &parent) const
 
     switch (indexLevel(parent)) {
     case Level::RootLevel:
-        return m_docsetRegistry->count();
+        return m_docsetItems.count();
     case Level::DocsetLevel:
-        return m_docsetRegistry->docset(parent.row())->symbolCounts().count();
+        return m_docsetItems.at(parent.row())->groups.size();
     case Level::GroupLevel: {
         DocsetItem *docsetItem = reinterpret_cast<DocsetItem *>(parent.internalPointer());
-        return docsetItem->docset->symbolCount(docsetItem->groups.at(parent.row())->symbolType);
+        return docsetItem->groups.at(parent.row())->fetchedCount;
     }
     default:
         return 0;
     }
 }
 
+bool ListModel::hasChildren(const QModelIndex &parent) const
+{
+    // Groups have children before their first page is fetched
+    if (indexLevel(parent) == Level::GroupLevel) {
+        if (parent.column() > 0)
+            return false;
+        DocsetItem *docsetItem = reinterpret_cast<DocsetItem *>(parent.internalPointer());
+        return docsetItem->groups.at(parent.row())->symbolCount > 0;
+    }
+
+    return QAbstractItemModel::hasChildren(parent);
+}
+
+bool ListModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (indexLevel(parent) != Level::GroupLevel || parent.column() > 0)
+        return false;
+
+    DocsetItem *docsetItem = reinterpret_cast<DocsetItem *>(parent.internalPointer());
+    return !docsetItem->groups.at(parent.row())->isComplete;
+}
+
+void ListModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+
+    DocsetItem *docsetItem = reinterpret_cast<DocsetItem *>(parent.internalPointer());
+    GroupItem *groupItem = docsetItem->groups.at(parent.row());
+
+    const QVector<Docset::Symbol> symbols = docsetItem->docset->symbols(
+                groupItem->symbolType, groupItem->lastSymbol, SymbolPageSize);
+
+    groupItem->isComplete = symbols.size() < SymbolPageSize;
+    if (symbols.isEmpty())
+        return;
+
+    const int row = groupItem->fetchedCount;
+    beginInsertRows(parent, row, row + symbols.size() - 1);
+    groupItem->pageStarts.append(groupItem->lastSymbol);
+    groupItem->lastSymbol = symbols.last();
+    groupItem->fetchedCount += symbols.size();
+    endInsertRows();
+}
+
 void ListModel::addDocset(const QString &name)
 {
-    const int index = m_docsetRegistry->names().indexOf(name);
-    beginInsertRows(QModelIndex(), index, index);
+    const QSharedPointer<Docset> docset = m_docsetRegistry->docset(name);
+    if (!docset)
+        return;
+
+    // Docsets arrive in any order while they are being loaded, and the registry may
+    // know about more of them than this model yet, so rows follow the model's own items.
+    const int row = docsetRow(name);
+    if (row < m_docsetItems.size() && m_docsetItems.at(row)->docset->name() == name)
+        return;
+
+    beginInsertRows(QModelIndex(), row, row);
 
     DocsetItem *docsetItem = new DocsetItem();
-    docsetItem->docset = m_docsetRegistry->docset(name);
+    docsetItem->docset = docset;
+    docsetItem->row = row;
 
-    for (const QString &symbolType : docsetItem->docset->symbolCounts().keys()) {
+    const QMap<QString, int> symbolCounts = docset->symbolCounts();
+    for (auto it = symbolCounts.cbegin(); it != symbolCounts.cend(); ++it) {
         GroupItem *groupItem = new GroupItem();
         groupItem->docsetItem = docsetItem;
-        groupItem->symbolType = symbolType;
+        groupItem->row = docsetItem->groups.size();
+        groupItem->symbolType = it.key();
+        groupItem->symbolCount = it.value();
+
+        // Types not known to SymbolType may still have an icon of their own
+        const SymbolType::Id type = SymbolType::fromString(it.key());
+        groupItem->icon = type == SymbolType::Other
+                ? IconCache::icon(QString("typeIcon:%1.png").arg(it.key())) : SymbolType::icon(type);
         docsetItem->groups.append(groupItem);
     }
 
-    m_docsetItems.insert(name, docsetItem);
+    m_docsetItems.insert(row, docsetItem);
+    for (int i = row + 1; i < m_docsetItems.size(); ++i)
+        m_docsetItems.at(i)->row = i;
 
     endInsertRows();
 }
 
 void ListModel::removeDocset(const QString &name)
 {
-    const int index = m_docsetItems.keys().indexOf(name);
-    beginRemoveRows(QModelIndex(), index, index);
+    const int row = docsetRow(name);
+    if (row == m_docsetItems.size() || m_docsetItems.at(row)->docset->name() != name)
+        return;
+
+    beginRemoveRows(QModelIndex(), row, row);
+
+    DocsetItem *docsetItem = m_docsetItems.takeAt(row);
+    for (int i = row; i < m_docsetItems.size(); ++i)
+        m_docsetItems.at(i)->row = i;
 
-    DocsetItem *docsetItem = m_docsetItems.take(name);
     qDeleteAll(docsetItem->groups);
     delete docsetItem;
 
@@ -187,3 +279,17 @@ ListModel::Level ListModel::indexLevel(const QModelIndex &index)
     else
         return Level::SymbolLevel;
 }
+
+Docset *ListModel::docset(int row) const
+{
+    return m_docsetItems.at(row)->docset.data();
+}
+
+int ListModel::docsetRow(const QString &name) const
+{
+    const auto it = std::lower_bound(m_docsetItems.cbegin(), m_docsetItems.cend(), name,
+                                     [](const DocsetItem *item, const QString &name) {
+        return item->docset->name() < name;
+    });
+    return it - m_docsetItems.cbegin();
+}
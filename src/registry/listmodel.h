@@ -1,12 +1,14 @@
 #ifndef LISTMODEL_H
 #define LISTMODEL_H
 
+#include "docset.h"
+
 #include <QAbstractListModel>
-#include <QMap>
+#include <QIcon>
+#include <QVector>
 
 namespace Zeal {
 
-class Docset;
 class DocsetRegistry;
 
 class ListModel : public QAbstractItemModel
@@ -24,6 +26,11 @@ public:
     QModelIndex parent(const QModelIndex &child) const override;
     int columnCount(const QModelIndex &parent) const override;
     int rowCount(const QModelIndex &parent) const override;
+    bool hasChildren(const QModelIndex &parent) const override;
+
+    // Symbols of a group are loaded page by page, as the group gets expanded and scrolled
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 
 private slots:
     void addDocset(const QString &name);
@@ -40,22 +47,36 @@ private:
     inline static QString pluralize(const QString &s);
     inline static Level indexLevel(const QModelIndex &index);
 
+    Docset *docset(int row) const;
+    /// Returns the position of the docset \a name in m_docsetItems, or where it belongs
+    int docsetRow(const QString &name) const;
+
     DocsetRegistry *m_docsetRegistry = nullptr;
 
+    // Items keep their own row, so that navigating the tree does not need any lookups
     struct DocsetItem;
     struct GroupItem {
         const Level level = Level::GroupLevel;
         DocsetItem *docsetItem = nullptr;
+        int row = 0;
         QString symbolType;
+        QIcon icon; // Resolved once, rows of the group share it
+        int symbolCount = 0;
+        // Symbols themselves are cached by Docset, pages are refetched once dropped
+        QVector<Docset::Symbol> pageStarts; // Symbol preceding each fetched page
+        Docset::Symbol lastSymbol;
+        int fetchedCount = 0;
+        bool isComplete = false;
     };
 
     struct DocsetItem {
         const Level level = Level::DocsetLevel;
-        Docset *docset = nullptr;
-        QList<GroupItem *> groups;
+        QSharedPointer<Docset> docset; // Kept alive until the row is removed
+        int row = 0;
+        QVector<GroupItem *> groups;
     };
 
-    QMap<QString, DocsetItem *> m_docsetItems;
+    QVector<DocsetItem *> m_docsetItems; // Ordered by docset name
 };
 
 } // namespace Zeal
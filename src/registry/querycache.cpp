@@ -0,0 +1,201 @@
+#include "querycache.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+#include <algorithm>
+
+using namespace Zeal;
+
+namespace {
+const char CacheMagic[8] = {'Z', 'E', 'A', 'L', 'Q', 'R', 'C', 'H'};
+/// Increase whenever the layout or the content of the file changes
+const quint32 CacheVersion = 1;
+
+// About 2 MiB of results, a few hundred queries in several docsets
+const int MaxCost = 1 << 18;
+}
+
+QueryCache QueryCache::fromFile(const QString &fileName)
+{
+    QueryCache cache;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return cache;
+
+    const QByteArray data = file.readAll();
+    if (!data.startsWith(QByteArray::fromRawData(CacheMagic, sizeof(CacheMagic))))
+        return cache;
+
+    QDataStream header(data.mid(sizeof(CacheMagic)));
+    quint32 version;
+    QByteArray compressedBody;
+    header >> version >> compressedBody;
+    if (header.status() != QDataStream::Ok || version != CacheVersion)
+        return cache;
+
+    QDataStream in(qUncompress(compressedBody));
+    QHash<QString, QString> stamps;
+    quint32 entryCount;
+    in >> stamps >> entryCount;
+
+    // Entries were saved least recently used first
+    for (quint32 i = 0; i < entryCount && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        QString query;
+        qint32 limit;
+        quint32 resultCount;
+        in >> name >> query >> limit >> resultCount;
+
+        QVector<Result> results;
+        results.reserve(static_cast<int>(qMin<quint32>(resultCount, MaxCost)));
+        for (quint32 j = 0; j < resultCount && in.status() == QDataStream::Ok; ++j) {
+            Result result;
+            in >> result.symbolId >> result.score;
+            results.append(result);
+        }
+
+        if (in.status() != QDataStream::Ok || !stamps.contains(name))
+            break;
+
+        Entry &entry = cache.m_entries[Key(name, query)];
+        entry.limit = limit;
+        entry.results = results;
+        entry.lastUsed = ++cache.m_useCounter;
+        cache.m_cost += results.size() + 1;
+    }
+
+    if (in.status() != QDataStream::Ok)
+        return QueryCache();
+
+    cache.m_stamps = stamps;
+    cache.evict();
+    return cache;
+}
+
+bool QueryCache::save(const QString &fileName) const
+{
+    QVector<QHash<Key, Entry>::const_iterator> entries;
+    entries.reserve(m_entries.size());
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+        entries.append(it);
+
+    std::sort(entries.begin(), entries.end(), [](QHash<Key, Entry>::const_iterator lhs,
+                                                 QHash<Key, Entry>::const_iterator rhs) {
+        return lhs.value().lastUsed < rhs.value().lastUsed;
+    });
+
+    QByteArray body;
+    QDataStream out(&body, QIODevice::WriteOnly);
+    out << m_stamps << static_cast<quint32>(entries.size());
+    for (QHash<Key, Entry>::const_iterator it : entries) {
+        out << it.key().first << it.key().second << static_cast<qint32>(it.value().limit)
+            << static_cast<quint32>(it.value().results.size());
+        for (const Result &result : it.value().results)
+            out << result.symbolId << result.score;
+    }
+
+    QByteArray data(CacheMagic, sizeof(CacheMagic));
+    QDataStream header(&data, QIODevice::WriteOnly | QIODevice::Append);
+    header << CacheVersion << qCompress(body);
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(data);
+    return file.commit();
+}
+
+void QueryCache::addDocset(const QString &name, const QString &stamp)
+{
+    const auto it = m_stamps.constFind(name);
+    if (it != m_stamps.constEnd() && it.value() != stamp)
+        removeDocset(name);
+
+    m_stamps.insert(name, stamp);
+    m_docsets.insert(name);
+}
+
+void QueryCache::removeDocset(const QString &name)
+{
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it.key().first == name) {
+            m_cost -= it.value().results.size() + 1;
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    m_stamps.remove(name);
+    m_docsets.remove(name);
+}
+
+void QueryCache::clear()
+{
+    m_entries.clear();
+    m_stamps.clear();
+    m_docsets.clear();
+    m_cost = 0;
+}
+
+bool QueryCache::find(const QString &name, const QString &query, int limit, QVector<Result> *results)
+{
+    if (!m_docsets.contains(name))
+        return false;
+
+    const auto it = m_entries.find(Key(name, query));
+    if (it == m_entries.end())
+        return false;
+
+    // A shorter list than asked for holds all matches, whatever the limit
+    Entry &entry = it.value();
+    if (entry.limit < limit && entry.results.size() >= entry.limit)
+        return false;
+
+    entry.lastUsed = ++m_useCounter;
+    *results = entry.results.mid(0, limit);
+    return true;
+}
+
+void QueryCache::insert(const QString &name, const QString &query, int limit,
+                        const QVector<Result> &results)
+{
+    if (!m_docsets.contains(name))
+        return;
+
+    Entry &entry = m_entries[Key(name, query)];
+    m_cost += results.size() - entry.results.size() + (entry.lastUsed ? 0 : 1);
+    entry.limit = limit;
+    entry.results = results;
+    entry.lastUsed = ++m_useCounter;
+
+    if (m_cost > MaxCost)
+        evict();
+}
+
+// Drops the least recently used entries, leaving room for a few more before the next time
+void QueryCache::evict()
+{
+    while (m_cost > MaxCost) {
+        QVector<quint64> useCounts;
+        useCounts.reserve(m_entries.size());
+        for (const Entry &entry : m_entries)
+            useCounts.append(entry.lastUsed);
+        std::sort(useCounts.begin(), useCounts.end());
+
+        // Entries cost about the same, a quarter of them usually makes the room
+        const quint64 threshold = useCounts.at(useCounts.size() / 4);
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            if (it.value().lastUsed <= threshold) {
+                m_cost -= it.value().results.size() + 1;
+                it = m_entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
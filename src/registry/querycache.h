@@ -0,0 +1,66 @@
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+namespace Zeal {
+
+/**
+ * @short Least recently used results of symbol searches, by docset and query.
+ *
+ * Results are kept as symbol ids into the SearchIndex of their docset, along with their
+ * scores, which is all it takes to rebuild them. Docset filters only choose what docsets
+ * get searched, so "std:vector" and "vector" share the entry of the std docset.
+ *
+ * Entries of a docset are only used after addDocset(), and if the docset has not changed
+ * since they were stored. The cache is saved in a compressed file, so that the first
+ * queries after a restart are answered from it too.
+ */
+class QueryCache
+{
+public:
+    struct Result {
+        quint32 symbolId;
+        qint32 score;
+    };
+
+    static QueryCache fromFile(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    /// Starts using entries of docset \a name, dropping them if they were stored for
+    /// another \a stamp, see DocsetManifest::stamp().
+    void addDocset(const QString &name, const QString &stamp);
+    void removeDocset(const QString &name);
+    void clear();
+
+    /// Sets \a results to the best \a limit results of \a query in docset \a name.
+    /// Returns false if they are not cached.
+    bool find(const QString &name, const QString &query, int limit, QVector<Result> *results);
+    /// Stores the best \a limit \a results of \a query in docset \a name
+    void insert(const QString &name, const QString &query, int limit, const QVector<Result> &results);
+
+private:
+    typedef QPair<QString, QString> Key; // (docset, query)
+
+    struct Entry {
+        int limit = 0;
+        QVector<Result> results;
+        quint64 lastUsed = 0;
+    };
+
+    void evict();
+
+    QHash<Key, Entry> m_entries;
+    QHash<QString, QString> m_stamps; // Of the docsets entries were stored for, by name
+    QSet<QString> m_docsets; // Added ones, which entries are up to date
+    quint64 m_useCounter = 0;
+    int m_cost = 0; // Number of cached results
+};
+
+} // namespace Zeal
+
+#endif // QUERYCACHE_H
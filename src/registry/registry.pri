@@ -3,3 +3,16 @@ HEADERS += \
 
 SOURCES += \
     $$files($$PWD/*.cpp)
+
+# sqlite3_interrupt() is used for stopping superseded searches, and search rows are read
+# with sqlite3_step() on the connections of QtSql. This requires QtSql being built against
+# the system SQLite library, which is the case for Linux distributions. It is checked at
+# runtime, see SqliteHandle.
+unix:!macx {
+    CONFIG += link_pkgconfig
+
+    packagesExist(sqlite3) {
+        PKGCONFIG += sqlite3
+        DEFINES += USE_SQLITE_INTERRUPT USE_SQLITE_API
+    }
+}
@@ -0,0 +1,136 @@
+#include "resultarena.h"
+
+#include <cstring>
+
+using namespace Zeal;
+
+namespace {
+const int AverageRowSize = 96;
+
+struct Separator {
+    const char *data;
+    int size;
+};
+
+// Returns the position of separator in name between from and end, or -1
+int indexOf(const char *name, int from, int end, const Separator &separator)
+{
+    for (int pos = from; pos <= end - separator.size; ++pos) {
+        if (!std::memcmp(name + pos, separator.data, separator.size))
+            return pos;
+    }
+    return -1;
+}
+}
+
+ResultArena::ResultArena(int rowCount)
+{
+    m_data.reserve(rowCount * AverageRowSize);
+    m_rows.reserve(rowCount);
+}
+
+int ResultArena::size() const
+{
+    return m_rows.size();
+}
+
+void ResultArena::append(const char *name, int nameSize, const char *type, int typeSize,
+                         const char *path, int pathSize, const char *anchor, int anchorSize)
+{
+    // Same as Docset::normalizeName(), the separators are ASCII and so never part of
+    // a longer UTF-8 sequence
+    int nameStart = 0;
+    int nameEnd = nameSize;
+    int parentStart = 0;
+    int parentEnd = 0;
+
+    const void *parenthesis = std::memchr(name, '(', nameSize);
+    if (parenthesis && parenthesis != name && name[nameSize - 1] == ')')
+        nameEnd = static_cast<const char *>(parenthesis) - name;
+
+    static const Separator separators[] = {{".", 1}, {"::", 2}, {"/", 1}};
+
+    for (const Separator &separator : separators) {
+        int pos = indexOf(name, nameStart, nameEnd, separator);
+        if (pos <= nameStart)
+            continue;
+
+        parentStart = nameStart;
+        nameStart = pos + separator.size;
+        while ((pos = indexOf(name, nameStart, nameEnd, separator)) != -1) {
+            parentStart = nameStart;
+            nameStart = pos + separator.size;
+        }
+        parentEnd = nameStart - separator.size;
+    }
+
+    Row row;
+    row.name = appendString(name + nameStart, nameEnd - nameStart);
+    row.parentName = appendString(name + parentStart, parentEnd - parentStart);
+    row.type = appendString(type, typeSize);
+
+    row.path.offset = m_data.size();
+    m_data.append(path, pathSize);
+    if (anchorSize >= 0) {
+        m_data.append('#');
+        m_data.append(anchor, anchorSize);
+    }
+    row.path.size = m_data.size() - row.path.offset;
+    m_data.append('\0');
+
+    m_rows.append(row);
+}
+
+QString ResultArena::name(int row) const
+{
+    return QString::fromUtf8(nameData(row), nameSize(row));
+}
+
+QString ResultArena::parentName(int row) const
+{
+    return QString::fromUtf8(parentNameData(row), parentNameSize(row));
+}
+
+QString ResultArena::path(int row) const
+{
+    const Span &path = m_rows.at(row).path;
+    return QString::fromUtf8(m_data.constData() + path.offset, path.size);
+}
+
+const char *ResultArena::nameData(int row) const
+{
+    return m_data.constData() + m_rows.at(row).name.offset;
+}
+
+const char *ResultArena::parentNameData(int row) const
+{
+    return m_data.constData() + m_rows.at(row).parentName.offset;
+}
+
+const char *ResultArena::typeData(int row) const
+{
+    return m_data.constData() + m_rows.at(row).type.offset;
+}
+
+int ResultArena::nameSize(int row) const
+{
+    return m_rows.at(row).name.size;
+}
+
+int ResultArena::parentNameSize(int row) const
+{
+    return m_rows.at(row).parentName.size;
+}
+
+int ResultArena::typeSize(int row) const
+{
+    return m_rows.at(row).type.size;
+}
+
+ResultArena::Span ResultArena::appendString(const char *data, int size)
+{
+    const Span span = {m_data.size(), size};
+    m_data.append(data, size);
+    m_data.append('\0');
+    return span;
+}
@@ -0,0 +1,68 @@
+#ifndef RESULTARENA_H
+#define RESULTARENA_H
+
+#include <QByteArray>
+#include <QSharedData>
+#include <QString>
+#include <QVector>
+
+namespace Zeal {
+
+/**
+ * @short Strings of search results found by one query in a docset database.
+ *
+ * Rows are copied straight from the database into a single buffer of zero terminated
+ * UTF-8 strings, the same as a SearchIndex holds them, and results refer to their row
+ * like indexed results refer to their symbol. A query fills a new arena, which goes away
+ * at once with the last result of that query, instead of string by string.
+ *
+ * Rows must not be appended once their data is referred to.
+ */
+class ResultArena : public QSharedData
+{
+public:
+    /// Reserves room for \a rowCount rows of average length
+    explicit ResultArena(int rowCount = 0);
+
+    int size() const;
+
+    /// Appends a symbol, with \a name normalized like Docset::normalizeName() does. The
+    /// \a anchor is appended to \a path after '#', unless \a anchorSize is negative.
+    void append(const char *name, int nameSize, const char *type, int typeSize,
+                const char *path, int pathSize, const char *anchor = nullptr, int anchorSize = -1);
+
+    QString name(int row) const;
+    QString parentName(int row) const;
+    QString path(int row) const;
+
+    /// Return zero terminated UTF-8 strings, which stay valid as long as the arena.
+    const char *nameData(int row) const;
+    const char *parentNameData(int row) const;
+    const char *typeData(int row) const;
+
+    int nameSize(int row) const;
+    int parentNameSize(int row) const;
+    int typeSize(int row) const;
+
+private:
+    struct Span {
+        int offset;
+        int size;
+    };
+
+    struct Row {
+        Span name;
+        Span parentName;
+        Span type;
+        Span path;
+    };
+
+    Span appendString(const char *data, int size);
+
+    QByteArray m_data;
+    QVector<Row> m_rows;
+};
+
+} // namespace Zeal
+
+#endif // RESULTARENA_H
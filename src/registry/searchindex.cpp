@@ -0,0 +1,536 @@
+#include "searchindex.h"
+
+#include "substringfinder.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace Zeal;
+
+namespace {
+const char IndexMagic[8] = {'Z', 'E', 'A', 'L', 'S', 'I', 'D', 'X'};
+/// Increase whenever the layout or the content of the index changes
+const quint32 IndexVersion = 3;
+const int SectionAlignment = 8;
+}
+
+struct SearchIndex::Header
+{
+    struct SectionInfo {
+        quint32 offset;
+        quint32 size;
+    };
+
+    char magic[8];
+    quint32 version;
+    quint32 docsetType;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    SectionInfo sections[SectionCount];
+};
+
+void SearchIndex::Builder::addSymbol(const QString &name, const QString &type, const QString &path)
+{
+    Symbol symbol;
+    symbol.length = name.length();
+    symbol.foldedName = fold(name.toUtf8());
+    symbol.path = path.toUtf8();
+
+    QString normalizedName = name;
+    QString parentName;
+    Docset::normalizeName(normalizedName, parentName);
+    symbol.name = normalizedName.toUtf8();
+    symbol.parentName = parentName.toUtf8();
+
+    if (!m_types.contains(type))
+        m_types.insert(type, m_types.size());
+    symbol.type = m_types.value(type);
+
+    m_symbols.append(symbol);
+}
+
+QByteArray SearchIndex::Builder::build(Docset::Type docsetType, const QFileInfo &source)
+{
+    // Same order as ORDER BY length(name), lower(name), path in the SQL search
+    std::sort(m_symbols.begin(), m_symbols.end(), [](const Symbol &lhs, const Symbol &rhs) {
+        if (lhs.length != rhs.length)
+            return lhs.length < rhs.length;
+        const int cmp = qstrcmp(lhs.foldedName, rhs.foldedName);
+        if (cmp)
+            return cmp < 0;
+        return qstrcmp(lhs.path, rhs.path) < 0;
+    });
+
+    QByteArray sections[SectionCount];
+
+    const auto appendString = [&sections](Section arena, Section offsets, const QByteArray &str) {
+        const quint32 offset = sections[arena].size();
+        sections[offsets].append(reinterpret_cast<const char *>(&offset), sizeof(offset));
+        // Zero terminators keep substring matches from spanning two symbols
+        sections[arena].append(str).append('\0');
+    };
+
+    const auto appendInt = [&sections](Section s, quint32 value) {
+        sections[s].append(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+
+    for (const Symbol &symbol : m_symbols) {
+        appendString(FoldedNames, FoldedNameOffsets, symbol.foldedName);
+        appendString(Names, NameOffsets, symbol.name);
+        appendString(ParentNames, ParentNameOffsets, symbol.parentName);
+        appendString(Paths, PathOffsets, symbol.path);
+        appendInt(SymbolTypes, symbol.type);
+    }
+
+    // Trailing offsets allow computing lengths without special cases
+    appendInt(FoldedNameOffsets, sections[FoldedNames].size());
+    appendInt(NameOffsets, sections[Names].size());
+    appendInt(ParentNameOffsets, sections[ParentNames].size());
+    appendInt(PathOffsets, sections[Paths].size());
+
+    QVector<QByteArray> typeNames(m_types.size());
+    QVector<quint32> typeCounts(m_types.size());
+    for (auto it = m_types.cbegin(); it != m_types.cend(); ++it)
+        typeNames[it.value()] = it.key().toUtf8();
+    for (const Symbol &symbol : m_symbols)
+        ++typeCounts[symbol.type];
+
+    for (int i = 0; i < typeNames.size(); ++i) {
+        appendString(TypeNames, TypeNameOffsets, typeNames.at(i));
+        appendInt(TypeCounts, typeCounts.at(i));
+    }
+    appendInt(TypeNameOffsets, sections[TypeNames].size());
+
+    QVector<quint32> pathOrder(m_symbols.size());
+    for (int i = 0; i < pathOrder.size(); ++i)
+        pathOrder[i] = i;
+    std::stable_sort(pathOrder.begin(), pathOrder.end(), [this](quint32 lhs, quint32 rhs) {
+        return qstrcmp(m_symbols.at(lhs).path, m_symbols.at(rhs).path) < 0;
+    });
+    sections[PathOrder] = QByteArray(reinterpret_cast<const char *>(pathOrder.constData()),
+                                     pathOrder.size() * sizeof(quint32));
+
+    const char *names = sections[FoldedNames].constData();
+    const quint32 *offsets = reinterpret_cast<const quint32 *>(sections[FoldedNameOffsets].constData());
+
+    QVector<quint32> suffixes;
+    for (int i = 0; i < m_symbols.size(); ++i) {
+        for (quint32 pos = offsets[i]; pos < offsets[i + 1] - 1; ++pos) {
+            if (pos == offsets[i] || isBoundary(names + offsets[i], names + pos))
+                suffixes.append(pos);
+        }
+    }
+
+    std::sort(suffixes.begin(), suffixes.end(), [names](quint32 lhs, quint32 rhs) {
+        return std::strcmp(names + lhs, names + rhs) < 0;
+    });
+    sections[Suffixes] = QByteArray(reinterpret_cast<const char *>(suffixes.constData()),
+                                    suffixes.size() * sizeof(quint32));
+
+    m_symbols.clear();
+    m_types.clear();
+
+    // Put everything together
+    Header header;
+    std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    header.version = IndexVersion;
+    header.docsetType = static_cast<quint32>(docsetType);
+    header.sourceSize = source.size();
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+
+    QByteArray data(reinterpret_cast<const char *>(&header), sizeof(Header));
+    for (int i = 0; i < SectionCount; ++i) {
+        data.append(QByteArray((SectionAlignment - data.size() % SectionAlignment) % SectionAlignment, '\0'));
+        header.sections[i].offset = data.size();
+        header.sections[i].size = sections[i].size();
+        data.append(sections[i]);
+    }
+
+    std::memcpy(data.data(), &header, sizeof(Header));
+    return data;
+}
+
+SearchIndex::SearchIndex(const uchar *data, qint64 size) :
+    m_data(data),
+    m_size(size)
+{
+}
+
+SearchIndex::~SearchIndex()
+{
+}
+
+SearchIndex *SearchIndex::fromData(const QByteArray &data)
+{
+    if (!isValid(reinterpret_cast<const uchar *>(data.constData()), data.size()))
+        return nullptr;
+
+    SearchIndex *index = new SearchIndex(reinterpret_cast<const uchar *>(data.constData()), data.size());
+    index->m_buffer = data;
+    return index;
+}
+
+SearchIndex *SearchIndex::fromFile(const QString &fileName, const QFileInfo &source)
+{
+    QScopedPointer<QFile> file(new QFile(fileName));
+    if (!file->open(QIODevice::ReadOnly))
+        return nullptr;
+
+    const qint64 size = file->size();
+    const uchar *data = file->map(0, size);
+    if (!data || !isValid(data, size))
+        return nullptr;
+
+    const Header *header = reinterpret_cast<const Header *>(data);
+    if (header->sourceSize != source.size()
+            || header->sourceModified != source.lastModified().toMSecsSinceEpoch()) {
+        return nullptr;
+    }
+
+    SearchIndex *index = new SearchIndex(data, size);
+    index->m_file.swap(file);
+    return index;
+}
+
+bool SearchIndex::save(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(reinterpret_cast<const char *>(m_data), m_size);
+    return file.commit();
+}
+
+Docset::Type SearchIndex::docsetType() const
+{
+    return static_cast<Docset::Type>(header()->docsetType);
+}
+
+bool SearchIndex::isEmpty() const
+{
+    return size() == 0;
+}
+
+int SearchIndex::size() const
+{
+    return sectionCount(SymbolTypes);
+}
+
+QString SearchIndex::name(int id) const
+{
+    return string(Names, NameOffsets, id);
+}
+
+QString SearchIndex::parentName(int id) const
+{
+    return string(ParentNames, ParentNameOffsets, id);
+}
+
+QString SearchIndex::path(int id) const
+{
+    return string(Paths, PathOffsets, id);
+}
+
+QString SearchIndex::type(int id) const
+{
+    return string(TypeNames, TypeNameOffsets, section<quint32>(SymbolTypes)[id]);
+}
+
+const char *SearchIndex::nameData(int id) const
+{
+    return section<char>(Names) + section<quint32>(NameOffsets)[id];
+}
+
+const char *SearchIndex::parentNameData(int id) const
+{
+    return section<char>(ParentNames) + section<quint32>(ParentNameOffsets)[id];
+}
+
+const char *SearchIndex::typeData(int id) const
+{
+    return section<char>(TypeNames) + section<quint32>(TypeNameOffsets)[section<quint32>(SymbolTypes)[id]];
+}
+
+QMap<QString, int> SearchIndex::typeCounts() const
+{
+    QMap<QString, int> counts;
+    const quint32 *typeCounts = section<quint32>(TypeCounts);
+    for (int i = 0; i < sectionCount(TypeCounts); ++i)
+        counts.insert(string(TypeNames, TypeNameOffsets, i), typeCounts[i]);
+    return counts;
+}
+
+QVector<int> SearchIndex::find(const QString &query, int limit, bool *complete) const
+{
+    const QByteArray needle = fold(query.toUtf8());
+
+    QVector<int> ids;
+    if (needle.isEmpty()) {
+        for (int i = 0; i < qMin(limit, size()); ++i)
+            ids.append(i);
+        if (complete)
+            *complete = size() <= limit;
+        return ids;
+    }
+
+    if (complete)
+        *complete = false;
+
+    const char *names = section<char>(FoldedNames);
+    const quint32 *offsets = section<quint32>(FoldedNameOffsets);
+    const quint32 *suffixes = section<quint32>(Suffixes);
+    const quint32 *suffixesEnd = suffixes + sectionCount(Suffixes);
+
+    // Name and sub-name prefix matches form a contiguous range in the suffix array
+    const quint32 *it = std::lower_bound(suffixes, suffixesEnd, needle,
+                                         [names](quint32 pos, const QByteArray &prefix) {
+        return std::strncmp(names + pos, prefix.constData(), prefix.size()) < 0;
+    });
+
+    for (; it != suffixesEnd && hasPrefix(*it, needle); ++it)
+        ids.append(symbolAt(*it));
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    if (ids.size() >= limit) {
+        ids.resize(limit);
+        return ids;
+    }
+
+    // Not enough sub-name matches, so look for the query anywhere in the name
+    const char *end = names + header()->sections[FoldedNames].size;
+    const char *cursor = names;
+    bool isScanned = false;
+
+    const SubstringFinder finder(needle);
+    const int prefixCount = ids.size();
+    while (ids.size() < limit) {
+        cursor = finder.find(cursor, end);
+        if (!cursor) {
+            isScanned = true;
+            break;
+        }
+
+        const int id = symbolAt(cursor - names);
+        if (!std::binary_search(ids.cbegin(), ids.cbegin() + prefixCount, id))
+            ids.append(id);
+
+        // Continue with the next symbol
+        cursor = names + offsets[id + 1];
+    }
+
+    if (!isScanned)
+        return ids;
+
+    // Still not enough, so fall back to names containing the query characters in order
+    QVector<int> found = ids;
+    std::sort(found.begin(), found.end());
+
+    cursor = names;
+    while (ids.size() < limit) {
+        cursor = static_cast<const char *>(std::memchr(cursor, needle.at(0), end - cursor));
+        if (!cursor) {
+            if (complete)
+                *complete = true;
+            break;
+        }
+
+        const int id = symbolAt(cursor - names);
+        const char *symbolEnd = names + offsets[id + 1] - 1;
+
+        if (containsSubsequence(cursor, symbolEnd, needle)
+                && !std::binary_search(found.cbegin(), found.cend(), id)) {
+            ids.append(id);
+        }
+
+        cursor = symbolEnd + 1;
+    }
+
+    return ids;
+}
+
+QVector<int> SearchIndex::refine(const QVector<int> &ids, const QString &query) const
+{
+    const QByteArray needle = fold(query.toUtf8());
+    const char *names = section<char>(FoldedNames);
+    const quint32 *offsets = section<quint32>(FoldedNameOffsets);
+
+    QVector<int> refined;
+    for (int id : ids) {
+        // Folded names are zero terminated
+        if (containsSubsequence(names + offsets[id], names + offsets[id + 1] - 1, needle))
+            refined.append(id);
+    }
+
+    return refined;
+}
+
+QVector<int> SearchIndex::findPath(const QString &prefix) const
+{
+    const QByteArray needle = prefix.toUtf8();
+    const char *paths = section<char>(Paths);
+    const quint32 *offsets = section<quint32>(PathOffsets);
+    const quint32 *order = section<quint32>(PathOrder);
+    const quint32 *orderEnd = order + size();
+
+    // Paths with the prefix form a contiguous range
+    const quint32 *it = std::lower_bound(order, orderEnd, needle,
+                                         [paths, offsets](quint32 id, const QByteArray &prefix) {
+        return std::strncmp(paths + offsets[id], prefix.constData(), prefix.size()) < 0;
+    });
+
+    QVector<int> ids;
+    for (; it != orderEnd && !std::strncmp(paths + offsets[*it], needle.constData(), needle.size()); ++it)
+        ids.append(*it);
+    return ids;
+}
+
+bool SearchIndex::narrows(const QString &query, const QString &previous)
+{
+    return fold(query.toUtf8()).contains(fold(previous.toUtf8()));
+}
+
+QByteArray SearchIndex::fold(const QByteArray &str)
+{
+    // Only ASCII is folded, matching the default behaviour of SQLite's LIKE
+    QByteArray folded(str);
+    for (char &c : folded) {
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+    }
+    return folded;
+}
+
+bool SearchIndex::containsSubsequence(const char *begin, const char *end, const QByteArray &needle)
+{
+    // memchr skips ahead to each next character, which beats a plain loop on long names
+    for (char c : needle) {
+        begin = static_cast<const char *>(std::memchr(begin, c, end - begin));
+        if (!begin)
+            return false;
+        ++begin;
+    }
+    return true;
+}
+
+bool SearchIndex::isBoundary(const char *name, const char *pos)
+{
+    return pos[-1] == '.' || pos[-1] == '/'
+            || (pos - name >= 2 && pos[-1] == ':' && pos[-2] == ':');
+}
+
+bool SearchIndex::isValid(const uchar *data, qint64 size)
+{
+    if (size < static_cast<qint64>(sizeof(Header)))
+        return false;
+
+    const Header *header = reinterpret_cast<const Header *>(data);
+    if (std::memcmp(header->magic, IndexMagic, sizeof(IndexMagic)) || header->version != IndexVersion)
+        return false;
+
+    for (int i = 0; i < SectionCount; ++i) {
+        const Header::SectionInfo &info = header->sections[i];
+        if (info.offset % SectionAlignment || info.offset + static_cast<qint64>(info.size) > size)
+            return false;
+    }
+
+    // Offset tables carry one trailing element
+    const quint32 symbolCount = header->sections[SymbolTypes].size / sizeof(quint32);
+    const quint32 typeCount = header->sections[TypeCounts].size / sizeof(quint32);
+    const Section symbolOffsets[] = {FoldedNameOffsets, NameOffsets, ParentNameOffsets, PathOffsets};
+    for (Section s : symbolOffsets) {
+        if (header->sections[s].size != (symbolCount + 1) * sizeof(quint32))
+            return false;
+    }
+
+    if (header->sections[PathOrder].size != symbolCount * sizeof(quint32)
+            || header->sections[TypeNameOffsets].size != (typeCount + 1) * sizeof(quint32)
+            || header->sections[SymbolTypes].size % sizeof(quint32)
+            || header->sections[TypeCounts].size % sizeof(quint32)
+            || header->sections[Suffixes].size % sizeof(quint32)) {
+        return false;
+    }
+
+    // Lookups trust the contents, so a damaged file must not get past here
+    const auto ints = [data, header](Section s) {
+        return reinterpret_cast<const quint32 *>(data + header->sections[s].offset);
+    };
+
+    // Every string starts within its arena and ends with a zero terminator
+    const auto isValidArena = [data, header, ints](Section arena, Section offsets, quint32 count) {
+        const char *strings = reinterpret_cast<const char *>(data + header->sections[arena].offset);
+        const quint32 *offsetTable = ints(offsets);
+        if (offsetTable[0] != 0 || offsetTable[count] != header->sections[arena].size)
+            return false;
+        for (quint32 i = 0; i < count; ++i) {
+            if (offsetTable[i] >= offsetTable[i + 1] || strings[offsetTable[i + 1] - 1] != '\0')
+                return false;
+        }
+        return true;
+    };
+
+    if (!isValidArena(FoldedNames, FoldedNameOffsets, symbolCount)
+            || !isValidArena(Names, NameOffsets, symbolCount)
+            || !isValidArena(ParentNames, ParentNameOffsets, symbolCount)
+            || !isValidArena(Paths, PathOffsets, symbolCount)
+            || !isValidArena(TypeNames, TypeNameOffsets, typeCount)) {
+        return false;
+    }
+
+    const quint32 *symbolTypes = ints(SymbolTypes);
+    const quint32 *pathOrder = ints(PathOrder);
+    for (quint32 i = 0; i < symbolCount; ++i) {
+        if (symbolTypes[i] >= typeCount || pathOrder[i] >= symbolCount)
+            return false;
+    }
+
+    const quint32 *suffixes = ints(Suffixes);
+    const quint32 suffixCount = header->sections[Suffixes].size / sizeof(quint32);
+    for (quint32 i = 0; i < suffixCount; ++i) {
+        if (suffixes[i] >= header->sections[FoldedNames].size)
+            return false;
+    }
+
+    return true;
+}
+
+const SearchIndex::Header *SearchIndex::header() const
+{
+    return reinterpret_cast<const Header *>(m_data);
+}
+
+template<typename T>
+const T *SearchIndex::section(Section s) const
+{
+    return reinterpret_cast<const T *>(m_data + header()->sections[s].offset);
+}
+
+int SearchIndex::sectionCount(Section s) const
+{
+    return header()->sections[s].size / sizeof(quint32);
+}
+
+QString SearchIndex::string(Section arena, Section offsets, int id) const
+{
+    const quint32 *offsetTable = section<quint32>(offsets);
+    return QString::fromUtf8(section<char>(arena) + offsetTable[id],
+                             offsetTable[id + 1] - offsetTable[id] - 1);
+}
+
+int SearchIndex::symbolAt(quint32 pos) const
+{
+    const quint32 *offsets = section<quint32>(FoldedNameOffsets);
+    return std::upper_bound(offsets, offsets + size() + 1, pos) - offsets - 1;
+}
+
+bool SearchIndex::hasPrefix(quint32 pos, const QByteArray &prefix) const
+{
+    return !std::strncmp(section<char>(FoldedNames) + pos, prefix.constData(), prefix.size());
+}
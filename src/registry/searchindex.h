@@ -0,0 +1,143 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include "docset.h"
+
+#include <QByteArray>
+#include <QMap>
+#include <QScopedPointer>
+#include <QString>
+#include <QVector>
+
+class QFile;
+class QFileInfo;
+
+namespace Zeal {
+
+/**
+ * @short Symbol name index of a single docset.
+ *
+ * The index is a single flat buffer, which is either built in memory or mapped
+ * directly from a file stored next to the docset database. It holds normalized
+ * symbol names, parent names, symbol types and paths, ordered the same way as the
+ * SQL search (by raw name length, then case-insensitively by name and path).
+ * Raw names are also stored with ASCII letters folded to lower case, which is what
+ * SQLite's LIKE matches.
+ *
+ * Sub-name lookups (name start, or right after '.', '::' or '/') are answered by
+ * binary search over a sparse suffix array containing only these boundary positions,
+ * while plain substring matches are found by scanning the folded names with a
+ * SubstringFinder. Symbol ids are also kept sorted by path, for finding all symbols
+ * of a page.
+ */
+class SearchIndex
+{
+public:
+    class Builder
+    {
+    public:
+        void addSymbol(const QString &name, const QString &type, const QString &path);
+        /// Returns index data for \a docsetType built from the database \a source.
+        QByteArray build(Docset::Type docsetType, const QFileInfo &source);
+
+    private:
+        struct Symbol {
+            int length;
+            QByteArray foldedName;
+            QByteArray name;
+            QByteArray parentName;
+            QByteArray path;
+            int type;
+        };
+
+        QVector<Symbol> m_symbols;
+        QMap<QString, int> m_types;
+    };
+
+    ~SearchIndex();
+
+    static SearchIndex *fromData(const QByteArray &data);
+    /// Maps index file \a fileName, returns null if it is invalid or outdated
+    /// compared to the database \a source.
+    static SearchIndex *fromFile(const QString &fileName, const QFileInfo &source);
+
+    bool save(const QString &fileName) const;
+
+    Docset::Type docsetType() const;
+
+    bool isEmpty() const;
+    int size() const;
+
+    QString name(int id) const;
+    QString parentName(int id) const;
+    QString path(int id) const;
+    QString type(int id) const;
+
+    /// Return zero terminated UTF-8 names, which stay valid as long as the index.
+    const char *nameData(int id) const;
+    const char *parentNameData(int id) const;
+    const char *typeData(int id) const;
+
+    /// Returns symbol counts by raw symbol type, like GROUP BY type does.
+    QMap<QString, int> typeCounts() const;
+
+    /// Returns ids of up to \a limit symbols with a name or a sub-name starting with
+    /// \a query, followed by other symbols containing \a query anywhere in the name,
+    /// and then by symbols containing the \a query characters in order.
+    /// Sets \a complete to whether no matching symbol was left out due to \a limit.
+    QVector<int> find(const QString &query, int limit, bool *complete = nullptr) const;
+    /// Returns \a ids of symbols, which names contain the \a query characters in order.
+    QVector<int> refine(const QVector<int> &ids, const QString &query) const;
+    /// Returns ids of symbols with a path starting with \a prefix, ordered by path.
+    QVector<int> findPath(const QString &prefix) const;
+
+    /// Returns true if every name matching \a query also matches \a previous.
+    static bool narrows(const QString &query, const QString &previous);
+
+private:
+    enum Section {
+        FoldedNames,
+        FoldedNameOffsets,
+        Names,
+        NameOffsets,
+        ParentNames,
+        ParentNameOffsets,
+        Paths,
+        PathOffsets,
+        PathOrder,
+        SymbolTypes,
+        TypeNames,
+        TypeNameOffsets,
+        TypeCounts,
+        Suffixes,
+        SectionCount
+    };
+
+    struct Header;
+
+    explicit SearchIndex(const uchar *data, qint64 size);
+
+    static QByteArray fold(const QByteArray &str);
+    static bool containsSubsequence(const char *begin, const char *end, const QByteArray &needle);
+    static bool isBoundary(const char *name, const char *pos);
+    static bool isValid(const uchar *data, qint64 size);
+
+    const Header *header() const;
+    template<typename T>
+    const T *section(Section s) const;
+    int sectionCount(Section s) const;
+    QString string(Section arena, Section offsets, int id) const;
+
+    int symbolAt(quint32 pos) const;
+    bool hasPrefix(quint32 pos, const QByteArray &prefix) const;
+
+    QByteArray m_buffer;
+    QScopedPointer<QFile> m_file;
+
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+};
+
+} // namespace Zeal
+
+#endif // SEARCHINDEX_H
@@ -1,12 +1,16 @@
 #include "searchmodel.h"
 
+#include "fuzzymatcher.h"
 #include "core/application.h"
+#include "core/tracer.h"
 #include "registry/docsetregistry.h"
 
-#include <QDir>
-
 using namespace Zeal;
 
+namespace {
+const int PageSize = 100;
+}
+
 SearchModel::SearchModel(QObject *parent) :
     QAbstractItemModel(parent)
 {
@@ -14,10 +18,36 @@ SearchModel::SearchModel(QObject *parent) :
 
 QVariant SearchModel::data(const QModelIndex &index, int role) const
 {
-    if ((role != Qt::DisplayRole && role != Qt::DecorationRole) || !index.isValid())
+    if (!index.isValid())
         return QVariant();
 
-    SearchResult *item = static_cast<SearchResult *>(index.internalPointer());
+    // Rows move as results are inserted, so items are looked up by row
+    const SearchResult *item = &m_dataList.at(index.row());
+
+    if (role == DocsetNameRole)
+        return item->docset()->name();
+
+    // Snippets need the page read, so they are only built when the user asks for them
+    if (role == Qt::ToolTipRole) {
+        const QStringList snippetTerms = item->snippetTerms();
+        if (index.column() != 0 || snippetTerms.isEmpty())
+            return QVariant();
+        return item->docset()->fullTextSnippet(item->path(), snippetTerms);
+    }
+
+    if (role == MatchRangesRole) {
+        if (index.column() != 0 || m_matchQuery.isEmpty())
+            return QVariant();
+
+        const QString text = data(index, Qt::DisplayRole).toString();
+        auto it = m_matchRanges.constFind(text);
+        if (it == m_matchRanges.constEnd())
+            it = m_matchRanges.insert(text, matchRanges(*item, text));
+        return QVariant::fromValue(it.value());
+    }
+
+    if (role != Qt::DisplayRole && role != Qt::DecorationRole)
+        return QVariant();
 
     if (role == Qt::DecorationRole) {
         if (index.column() == 0)
@@ -26,23 +56,25 @@ QVariant SearchModel::data(const QModelIndex &index, int role) const
     }
 
     if (index.column() == 0) {
-        if (!item->parentName().isEmpty())
-            return QString("%1 (%2)").arg(item->name(), item->parentName());
+        // Strings are only decoded here, for rows being displayed
+        const QString parentName = item->parentName();
+        if (!parentName.isEmpty())
+            return QString("%1 (%2)").arg(item->name(), parentName);
         else
             return item->name();
 
     } else if (index.column() == 1) {
-        return QDir(item->docset()->documentPath()).absoluteFilePath(item->path());
+        return item->path();
     }
     return QVariant();
 }
 
 QModelIndex SearchModel::index(int row, int column, const QModelIndex &parent) const
 {
-    if (parent.isValid() || m_dataList.count() <= row || column > 1)
+    if (parent.isValid() || m_rowCount <= row || column > 1)
         return QModelIndex();
 
-    return createIndex(row, column, (void *)&m_dataList.at(row));
+    return createIndex(row, column);
 }
 
 QModelIndex SearchModel::parent(const QModelIndex &child) const
@@ -54,7 +86,7 @@ QModelIndex SearchModel::parent(const QModelIndex &child) const
 int SearchModel::rowCount(const QModelIndex &parent) const
 {
     if (!parent.isValid())
-        return m_dataList.count();
+        return m_rowCount;
     return 0;
 }
 
@@ -64,10 +96,130 @@ int SearchModel::columnCount(const QModelIndex &parent) const
     return 2;
 }
 
-void SearchModel::setResults(const QList<SearchResult> &results)
+bool SearchModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && m_rowCount < m_dataList.size();
+}
+
+void SearchModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+
+    const int rowCount = qMin(m_rowCount + PageSize, m_dataList.size());
+    beginInsertRows(QModelIndex(), m_rowCount, rowCount - 1);
+    m_rowCount = rowCount;
+    endInsertRows();
+}
+
+void SearchModel::setResultLimit(int limit)
+{
+    m_resultLimit = qMax(limit, 1);
+    trimResults();
+}
+
+void SearchModel::setMatchQuery(const QString &query)
+{
+    if (query == m_matchQuery)
+        return;
+
+    m_matchQuery = query;
+    m_matchRanges.clear();
+}
+
+void SearchModel::setResults(const QVector<SearchResult> &results)
 {
+    ZEAL_TRACE_SCOPE("ui", QStringLiteral("model reset"));
     beginResetModel();
     m_dataList = results;
+    m_rowCount = qMin(m_dataList.size(), PageSize);
     endResetModel();
+    trimResults();
     emit queryCompleted();
 }
+
+void SearchModel::addResults(const QVector<SearchResult> &results)
+{
+    // Both lists are sorted, so each run of new results goes in front of the
+    // first current result, which is not less than the run.
+    int row = 0;
+    int first = 0;
+    while (first < results.size()) {
+        while (row < m_dataList.size() && !(results.at(first) < m_dataList.at(row)))
+            ++row;
+
+        // Results past the exposed rows are kept for fetchMore()
+        if (row >= m_rowCount) {
+            for (int i = first; i < results.size(); ++i) {
+                while (row < m_dataList.size() && !(results.at(i) < m_dataList.at(row)))
+                    ++row;
+                m_dataList.insert(row++, results.at(i));
+            }
+            break;
+        }
+
+        int last = first + 1;
+        while (last < results.size() && results.at(last) < m_dataList.at(row))
+            ++last;
+
+        beginInsertRows(QModelIndex(), row, row + last - first - 1);
+        for (int i = first; i < last; ++i)
+            m_dataList.insert(row++, results.at(i));
+        m_rowCount += last - first;
+        endInsertRows();
+
+        first = last;
+    }
+
+    trimResults();
+
+    // Keep at least a page exposed, views only fetch more when scrolled to the end
+    const int rowCount = qMin(m_dataList.size(), PageSize);
+    if (m_rowCount < rowCount) {
+        beginInsertRows(QModelIndex(), m_rowCount, rowCount - 1);
+        m_rowCount = rowCount;
+        endInsertRows();
+    }
+}
+
+void SearchModel::trimResults()
+{
+    if (m_dataList.size() <= m_resultLimit)
+        return;
+
+    if (m_rowCount > m_resultLimit) {
+        beginRemoveRows(QModelIndex(), m_resultLimit, m_rowCount - 1);
+        m_rowCount = m_resultLimit;
+        m_dataList.erase(m_dataList.begin() + m_resultLimit, m_dataList.end());
+        endRemoveRows();
+    } else {
+        m_dataList.erase(m_dataList.begin() + m_resultLimit, m_dataList.end());
+    }
+}
+
+QVector<int> SearchModel::matchRanges(const SearchResult &item, const QString &text) const
+{
+    const QString name = item.name();
+    QVector<int> positions = FuzzyMatcher(m_matchQuery).matchPositions(name, item.parentName(),
+                                                                        name.size() + 2);
+
+    // Results of SQL searches may only contain the query deeper in the qualified name
+    if (positions.isEmpty()) {
+        const int start = text.indexOf(m_matchQuery, 0, Qt::CaseInsensitive);
+        if (start == -1)
+            return QVector<int>();
+        return {start, m_matchQuery.size()};
+    }
+
+    QVector<int> ranges;
+    for (int position : positions) {
+        if (!ranges.isEmpty() && ranges.at(ranges.size() - 2) + ranges.last() == position) {
+            ++ranges.last();
+        } else {
+            ranges.append(position);
+            ranges.append(1);
+        }
+    }
+
+    return ranges;
+}
@@ -4,6 +4,8 @@
 #include "searchresult.h"
 
 #include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
 
 namespace Zeal {
 
@@ -11,6 +13,13 @@ class SearchModel : public QAbstractItemModel
 {
     Q_OBJECT
 public:
+    enum {
+        DocsetNameRole = Qt::UserRole, // Same as ListModel::DocsetNameRole
+        /// Characters of the display text matched by the query, as QVector<int> of start and
+        /// length pairs
+        MatchRangesRole
+    };
+
     explicit SearchModel(QObject *parent = nullptr);
 
     QVariant data(const QModelIndex &index, int role) const override;
@@ -19,14 +28,33 @@ public:
     int rowCount(const QModelIndex &parent) const override;
     int columnCount(const QModelIndex &parent) const override;
 
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    /// Sets the maximum number of kept results, worse ones are dropped.
+    void setResultLimit(int limit);
+    /// Sets the query whose matches MatchRangesRole returns, without the docset filter
+    void setMatchQuery(const QString &query);
+
 public slots:
-    void setResults(const QList<SearchResult> &results = QList<SearchResult>());
+    void setResults(const QVector<SearchResult> &results = QVector<SearchResult>());
+    /// Merges sorted \a results into the current ones, inserting rows in place.
+    void addResults(const QVector<SearchResult> &results);
 
 signals:
     void queryCompleted();
 
 private:
-    QList<SearchResult> m_dataList;
+    void trimResults();
+    QVector<int> matchRanges(const SearchResult &item, const QString &text) const;
+
+    QVector<SearchResult> m_dataList;
+    // Results are exposed to views a page at a time, as they scroll down
+    int m_rowCount = 0;
+    int m_resultLimit = 500;
+
+    QString m_matchQuery;
+    mutable QHash<QString, QVector<int>> m_matchRanges; // By display text
 };
 
 } // namespace Zeal
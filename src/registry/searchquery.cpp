@@ -5,6 +5,7 @@ using namespace Zeal;
 namespace {
 const char prefixSeparator = ':';
 const char keywordSeparator = ',';
+const char fullTextPrefix = '?';
 }
 
 SearchQuery::SearchQuery()
@@ -34,15 +35,22 @@ SearchQuery SearchQuery::fromString(const QString &str)
         query = str.trimmed();
     }
 
-    return SearchQuery(query, keywords);
+    SearchQuery searchQuery(query, keywords);
+    if (query.startsWith(fullTextPrefix)) {
+        searchQuery.setQuery(query.mid(1).trimmed());
+        searchQuery.setFullText(true);
+    }
+
+    return searchQuery;
 }
 
 QString SearchQuery::toString() const
 {
+    const QString query = m_isFullText ? fullTextPrefix + m_query : m_query;
     if (m_keywords.isEmpty())
-        return m_query;
+        return query;
     else
-        return m_keywords.join(keywordSeparator) + prefixSeparator + m_query;
+        return m_keywords.join(keywordSeparator) + prefixSeparator + query;
 }
 
 bool SearchQuery::isEmpty() const
@@ -90,13 +98,22 @@ void SearchQuery::setQuery(const QString &str)
     m_query = str;
 }
 
+bool SearchQuery::isFullText() const
+{
+    return m_isFullText;
+}
+
+void SearchQuery::setFullText(bool fullText)
+{
+    m_isFullText = fullText;
+}
+
 QString SearchQuery::sanitizedQuery() const
 {
     QString q = m_query;
     q.replace(QStringLiteral("\\"), QStringLiteral("\\\\"));
     q.replace(QStringLiteral("_"), QStringLiteral("\\_"));
     q.replace(QStringLiteral("%"), QStringLiteral("\\%"));
-    q.replace(QStringLiteral("'"), QStringLiteral("''"));
     return q;
 }
 
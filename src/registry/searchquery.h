@@ -29,6 +29,10 @@ public:
     ///
     /// Multiple docsets are supported using the ',' character:
     ///   "java,android:setTypeFa #=> docsetFilters = ["java", "android"], coreQuery = "setTypeFa"
+    ///
+    /// A core query starting with '?' searches the text of pages instead of symbols:
+    ///   "python:?context manager" #=> docsetFilters = ["python"], coreQuery = "context manager",
+    ///                                 isFullText = true
 
     static SearchQuery fromString(const QString &str);
 
@@ -51,13 +55,19 @@ public:
     QString query() const;
     void setQuery(const QString &str);
 
-    /// Returns the core query, sanitized for use in SQL queries
+    /// Returns true if pages are searched for the words of the query, see FullTextIndex
+    bool isFullText() const;
+    void setFullText(bool fullText);
+
+    /// Returns the core query with LIKE wildcards escaped by '\\', for binding
+    /// into patterns of SQL queries
     QString sanitizedQuery() const;
 
 private:
     QString m_query;
     QStringList m_keywords;
     QString m_keywordPrefix;
+    bool m_isFullText = false;
 };
 
 QDataStream &operator<<(QDataStream &out, const SearchQuery &query);
@@ -1,48 +1,181 @@
 #include "searchresult.h"
 
+#include "docset.h"
+#include "resultarena.h"
+#include "searchindex.h"
+
+#include <QUrl>
+
 using namespace Zeal;
 
-SearchResult::SearchResult(const QString &name, const QString &parentName, Docset *docset,
-                           const QString &path, const QString &query) :
-    m_name(name),
-    m_parentName(parentName),
+struct SearchResult::Data : public QSharedData
+{
+    QString name;
+    QString parentName;
+    QString path;
+    QStringList snippetTerms;
+};
+
+SearchResult::SearchResult()
+{
+}
+
+SearchResult::SearchResult(const QString &name, const QString &parentName,
+                           const QSharedPointer<Docset> &docset, const QString &path, int score) :
+    m_docset(docset),
+    m_score(score),
+    d(new Data)
+{
+    d->name = name;
+    d->parentName = parentName;
+    d->path = path;
+}
+
+SearchResult::SearchResult(const QSharedPointer<const SearchIndex> &index, int symbolId,
+                           const QSharedPointer<Docset> &docset, int score) :
+    m_index(index),
+    m_docset(docset),
+    m_symbolId(symbolId),
+    m_score(score)
+{
+}
+
+SearchResult::SearchResult(const QExplicitlySharedDataPointer<const ResultArena> &arena, int row,
+                           const QSharedPointer<Docset> &docset, int score) :
+    m_arena(arena),
     m_docset(docset),
-    m_path(path),
-    m_query(query)
+    m_symbolId(row),
+    m_score(score)
+{
+}
+
+SearchResult::SearchResult(const SearchResult &other) :
+    m_index(other.m_index),
+    m_arena(other.m_arena),
+    m_docset(other.m_docset),
+    m_symbolId(other.m_symbolId),
+    m_score(other.m_score),
+    d(other.d)
+{
+}
+
+SearchResult::~SearchResult()
+{
+}
+
+SearchResult &SearchResult::operator=(const SearchResult &other)
 {
+    m_index = other.m_index;
+    m_arena = other.m_arena;
+    m_docset = other.m_docset;
+    m_symbolId = other.m_symbolId;
+    m_score = other.m_score;
+    d = other.d;
+    return *this;
 }
 
 QString SearchResult::name() const
 {
-    return m_name;
+    if (m_index)
+        return m_index->name(m_symbolId);
+    if (m_arena)
+        return m_arena->name(m_symbolId);
+    return d ? d->name : QString();
 }
 
 QString SearchResult::parentName() const
 {
-    return m_parentName;
+    if (m_index)
+        return m_index->parentName(m_symbolId);
+    if (m_arena)
+        return m_arena->parentName(m_symbolId);
+    return d ? d->parentName : QString();
 }
 
 QString SearchResult::path() const
 {
-    return m_path;
+    if (m_index)
+        return m_index->path(m_symbolId);
+    if (m_arena)
+        return m_arena->path(m_symbolId);
+    return d ? d->path : QString();
+}
+
+int SearchResult::symbolId() const
+{
+    return m_index ? m_symbolId : -1;
+}
+
+QStringList SearchResult::snippetTerms() const
+{
+    return d ? d->snippetTerms : QStringList();
+}
+
+void SearchResult::setSnippetTerms(const QStringList &terms)
+{
+    if (!d)
+        d = new Data;
+    d->snippetTerms = terms;
 }
 
 Docset *SearchResult::docset() const
 {
-    return m_docset;
+    return m_docset.data();
+}
+
+int SearchResult::score() const
+{
+    return m_score;
+}
+
+QJsonObject SearchResult::toJson() const
+{
+    const QString path = this->path();
+
+    /// TODO: [Qt 5.4] Use an initializer list
+    QJsonObject object;
+    object.insert(QStringLiteral("name"), name());
+    object.insert(QStringLiteral("parentName"), parentName());
+    object.insert(QStringLiteral("docset"), m_docset->name());
+    object.insert(QStringLiteral("path"), path);
+    object.insert(QStringLiteral("url"), m_docset->documentUrl(path).toString());
+    object.insert(QStringLiteral("score"), m_score);
+    return object;
 }
 
 bool SearchResult::operator<(const SearchResult &r) const
 {
-    const bool lhsStartsWithQuery = m_name.startsWith(m_query, Qt::CaseInsensitive);
-    const bool rhsStartsWithQuery = r.m_name.startsWith(m_query, Qt::CaseInsensitive);
+    if (m_score != r.m_score)
+        return m_score > r.m_score;
+
+    // Names of indexed and queried results are compared in place, without decoding them
+    const char *nameData = this->nameData();
+    const char *otherNameData = r.nameData();
+    if (nameData && otherNameData) {
+        const int namesCmp = qstricmp(nameData, otherNameData);
+        if (namesCmp)
+            return namesCmp < 0;
 
-    if (lhsStartsWithQuery != rhsStartsWithQuery)
-        return lhsStartsWithQuery > rhsStartsWithQuery;
+        return qstricmp(parentNameData(), r.parentNameData()) < 0;
+    }
 
-    const int namesCmp = QString::compare(m_name, r.m_name, Qt::CaseInsensitive);
+    const int namesCmp = QString::compare(name(), r.name(), Qt::CaseInsensitive);
     if (namesCmp)
         return namesCmp < 0;
 
-    return QString::compare(m_parentName, r.m_parentName, Qt::CaseInsensitive) < 0;
+    return QString::compare(parentName(), r.parentName(), Qt::CaseInsensitive) < 0;
+}
+
+const char *SearchResult::nameData() const
+{
+    if (m_index)
+        return m_index->nameData(m_symbolId);
+    return m_arena ? m_arena->nameData(m_symbolId) : nullptr;
+}
+
+const char *SearchResult::parentNameData() const
+{
+    if (m_index)
+        return m_index->parentNameData(m_symbolId);
+    return m_arena ? m_arena->parentNameData(m_symbolId) : nullptr;
 }
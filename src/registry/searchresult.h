@@ -1,17 +1,44 @@
 #ifndef SEARCHRESULT_H
 #define SEARCHRESULT_H
 
+#include <QJsonObject>
+#include <QMetaType>
+#include <QSharedDataPointer>
+#include <QSharedPointer>
 #include <QString>
+#include <QStringList>
 
 namespace Zeal {
 
 class Docset;
+class ResultArena;
+class SearchIndex;
 
+/**
+ * @short A single search result.
+ *
+ * Results found through a SearchIndex only refer to their symbol in it, and strings
+ * are decoded on access, so a result costs no allocations until it is displayed. They
+ * share the index, which stays valid after the docset replaces it with a rebuilt one.
+ * Results of database queries likewise refer to their row in a shared ResultArena.
+ * Other results carry their own strings.
+ *
+ * Results share their docset, which stays valid after it is removed from the registry.
+ */
 class SearchResult
 {
 public:
-    SearchResult(const QString &name, const QString &parentName, Docset *docset,
-                 const QString &path, const QString &query);
+    SearchResult();
+    SearchResult(const QString &name, const QString &parentName,
+                 const QSharedPointer<Docset> &docset, const QString &path, int score = 0);
+    SearchResult(const QSharedPointer<const SearchIndex> &index, int symbolId,
+                 const QSharedPointer<Docset> &docset, int score = 0);
+    SearchResult(const QExplicitlySharedDataPointer<const ResultArena> &arena, int row,
+                 const QSharedPointer<Docset> &docset, int score = 0);
+    SearchResult(const SearchResult &other);
+    ~SearchResult();
+
+    SearchResult &operator=(const SearchResult &other);
 
     QString name() const;
     QString parentName() const;
@@ -19,17 +46,39 @@ public:
     Docset *docset() const;
 
     QString path() const;
+    /// Returns the id of the symbol in the search index of the docset, or -1 if the result
+    /// is not from the index
+    int symbolId() const;
+
+    /// Words of a full-text search, which a snippet of the page gets built around on demand
+    QStringList snippetTerms() const;
+    void setSnippetTerms(const QStringList &terms);
+
+    /// Returns the match score, higher scores are shown first.
+    int score() const;
+
+    /// Returns the result as shared with other processes, with the URL of its page
+    QJsonObject toJson() const;
 
     bool operator<(const SearchResult &r) const;
 
 private:
-    QString m_name;
-    QString m_parentName;
-    Docset *m_docset = nullptr;
-    QString m_path;
-    QString m_query;
+    struct Data;
+
+    const char *nameData() const;
+    const char *parentNameData() const;
+
+    QSharedPointer<const SearchIndex> m_index;
+    QExplicitlySharedDataPointer<const ResultArena> m_arena;
+    QSharedPointer<Docset> m_docset;
+    int m_symbolId = -1; // Or row of m_arena
+    int m_score = 0;
+    QSharedDataPointer<Data> d;
 };
 
 } // namespace Zeal
 
+Q_DECLARE_TYPEINFO(Zeal::SearchResult, Q_MOVABLE_TYPE);
+Q_DECLARE_METATYPE(Zeal::SearchResult)
+
 #endif // SEARCHRESULT_H
@@ -0,0 +1,130 @@
+#include "sharedstore.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+#include <QUrl>
+
+using namespace Zeal;
+
+namespace {
+const char StampFileName[] = "stamp";
+const char FilesDirName[] = "files";
+
+struct Paths
+{
+    QMutex mutex;
+    QString storePath; // With a trailing slash
+    QString cachePath;
+};
+
+Q_GLOBAL_STATIC(Paths, paths)
+
+// Splits \a filePath into the docset directory and the path inside it
+bool splitPath(const QString &filePath, QString *docsetPath, QString *relativePath)
+{
+    const QString suffix = QStringLiteral(".docset/");
+    const int pos = filePath.indexOf(suffix);
+    if (pos == -1)
+        return false;
+
+    *docsetPath = filePath.left(pos + suffix.size() - 1);
+    *relativePath = filePath.mid(pos + suffix.size());
+    return !relativePath->isEmpty();
+}
+}
+
+void SharedStore::setPaths(const QString &storePath, const QString &cachePath)
+{
+    QMutexLocker locker(&paths->mutex);
+    paths->storePath = storePath.isEmpty() ? QString() : QDir(storePath).absolutePath() + QLatin1Char('/');
+    paths->cachePath = QDir(cachePath).absolutePath();
+}
+
+bool SharedStore::contains(const QString &path)
+{
+    QMutexLocker locker(&paths->mutex);
+    return !paths->storePath.isEmpty() && QDir::fromNativeSeparators(path).startsWith(paths->storePath);
+}
+
+QString SharedStore::cachePath()
+{
+    QMutexLocker locker(&paths->mutex);
+    QDir().mkpath(paths->cachePath);
+    return paths->cachePath;
+}
+
+QString SharedStore::docsetCachePath(const QString &docsetPath)
+{
+    // Readable, and unique for docsets of the same name in different directories
+    const QString absolutePath = QDir(docsetPath).absolutePath();
+    const QByteArray hash = QCryptographicHash::hash(absolutePath.toUtf8(), QCryptographicHash::Sha1);
+    const QString dirName = QStringLiteral("%1-%2").arg(QFileInfo(absolutePath).completeBaseName(),
+                                                        QString::fromLatin1(hash.toHex().left(16)));
+
+    const QString path = QDir(cachePath()).absoluteFilePath(dirName);
+    QDir().mkpath(path);
+    return path;
+}
+
+void SharedStore::validate(const QString &docsetPath, const QString &stamp)
+{
+    const QDir dir(docsetCachePath(docsetPath));
+
+    QFile stampFile(dir.absoluteFilePath(QLatin1String(StampFileName)));
+    if (stampFile.open(QIODevice::ReadOnly) && QString::fromUtf8(stampFile.readAll()) == stamp)
+        return;
+    stampFile.close();
+
+    // Pages of the previous version must not be served with the new one
+    QDir filesDir(dir.absoluteFilePath(QLatin1String(FilesDirName)));
+    if (filesDir.exists() && !filesDir.removeRecursively())
+        qWarning("Cannot remove outdated pages: %s", qPrintable(filesDir.absolutePath()));
+
+    if (!stampFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+    stampFile.write(stamp.toUtf8());
+}
+
+QByteArray SharedStore::read(const QString &filePath)
+{
+    QString docsetPath;
+    QString relativePath;
+    if (!splitPath(QDir::fromNativeSeparators(filePath), &docsetPath, &relativePath))
+        return QByteArray();
+
+    const QString localPath = QDir(docsetCachePath(docsetPath))
+            .absoluteFilePath(QLatin1String(FilesDirName) + QLatin1Char('/') + relativePath);
+
+    // Copies are only made whole, so whatever is there can be used
+    QFile localFile(localPath);
+    if (localFile.open(QIODevice::ReadOnly))
+        return localFile.readAll();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    const QByteArray data = file.readAll();
+    if (file.error() != QFile::NoError)
+        return QByteArray();
+
+    // Without a copy the page is read from the store again next time, which still works
+    QDir().mkpath(QFileInfo(localPath).absolutePath());
+    QSaveFile copy(localPath);
+    if (!copy.open(QIODevice::WriteOnly) || copy.write(data) != data.size() || !copy.commit())
+        qWarning("Cannot cache page: %s", qPrintable(localPath));
+
+    return data;
+}
+
+QString SharedStore::databaseUri(const QString &fileName)
+{
+    QUrl url = QUrl::fromLocalFile(QFileInfo(fileName).absoluteFilePath());
+    // The store is not written to while it is in use, so SQLite can do without locks
+    url.setQuery(QStringLiteral("immutable=1"));
+    return url.toString(QUrl::FullyEncoded);
+}
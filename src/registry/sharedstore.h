@@ -0,0 +1,46 @@
+#ifndef SHAREDSTORE_H
+#define SHAREDSTORE_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace Zeal {
+
+/**
+ * @short Local cache for docsets read from a store shared by many machines.
+ *
+ * A docset directory on a network filesystem is never written to in this mode. Databases are
+ * opened immutable, which spares SQLite the locking that is slow and unreliable over NFS. The
+ * docset manifest, query cache and search indexes live in a local directory instead, along
+ * with copies of the pages read so far, so that warm starts and browsing do not wait on the
+ * network. Copied pages of a docset are dropped once it gets updated in the store.
+ */
+class SharedStore
+{
+public:
+    /// Treats the docsets in \a storePath as shared, keeping their local files in \a cachePath.
+    /// An empty \a storePath turns it off. Applies to docsets loaded from now on.
+    static void setPaths(const QString &storePath, const QString &cachePath);
+    /// Returns true if \a path is in the shared store
+    static bool contains(const QString &path);
+
+    /// Returns the local directory for files shared by all docsets of the store
+    static QString cachePath();
+    /// Returns the local directory for files of the docset at \a docsetPath, which is created
+    static QString docsetCachePath(const QString &docsetPath);
+    /// Drops the copied pages of the docset at \a docsetPath, unless they were copied from the
+    /// version identified by \a stamp, see DocsetManifest::stamp()
+    static void validate(const QString &docsetPath, const QString &stamp);
+
+    /// Returns the contents of \a filePath from its local copy, which the first read makes.
+    /// Returns a null array if the file cannot be read.
+    static QByteArray read(const QString &filePath);
+
+    /// Returns the URI for opening the database \a fileName without locking, which needs the
+    /// QSQLITE_OPEN_URI option
+    static QString databaseUri(const QString &fileName);
+};
+
+} // namespace Zeal
+
+#endif // SHAREDSTORE_H
@@ -0,0 +1,64 @@
+#include "sqlitehandle.h"
+
+#include <QAtomicInt>
+#include <QSqlDatabase>
+#include <QSqlDriver>
+#include <QSqlQuery>
+#include <QVariant>
+
+#ifdef USE_SQLITE_INTERRUPT
+#include <sqlite3.h>
+#endif
+
+using namespace Zeal;
+
+namespace {
+enum LibraryMatch {
+    Unknown,
+    Same,
+    Different
+};
+
+QAtomicInt libraryMatch(Unknown);
+
+#ifdef USE_SQLITE_INTERRUPT
+// Asks the driver's library through the driver, which is safe whichever copy it is
+bool usesLinkedLibrary(const QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec(QStringLiteral("SELECT sqlite_source_id()")) || !query.next())
+        return false;
+
+    return query.value(0).toString() == QLatin1String(sqlite3_sourceid());
+}
+#endif
+}
+
+void *SqliteHandle::get(const QSqlDatabase &db)
+{
+#ifdef USE_SQLITE_INTERRUPT
+    if (!db.isOpen())
+        return nullptr;
+
+    const QVariant handle = db.driver()->handle();
+    if (!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*"))
+        return nullptr;
+
+    void *sqlite = *static_cast<void * const *>(handle.data());
+    if (!sqlite)
+        return nullptr;
+
+    // Concurrent first checks come to the same result
+    if (libraryMatch.load() == Unknown) {
+        const bool isSame = usesLinkedLibrary(db);
+        if (!isSame)
+            qWarning("QtSql does not use the linked SQLite library, statements go through QSqlQuery");
+        libraryMatch.store(isSame ? Same : Different);
+    }
+
+    return libraryMatch.load() == Same ? sqlite : nullptr;
+#else
+    Q_UNUSED(db)
+    return nullptr;
+#endif
+}
@@ -0,0 +1,25 @@
+#ifndef SQLITEHANDLE_H
+#define SQLITEHANDLE_H
+
+class QSqlDatabase;
+
+namespace Zeal {
+
+/**
+ * @short Access to the SQLite connection behind a QSQLITE database.
+ *
+ * The SQLite library linked to Zeal may only be handed connections it opened itself. QtSql
+ * built with its bundled copy of SQLite opens them with that one instead, so the driver is
+ * checked once for running on the same library as the linked one.
+ */
+class SqliteHandle
+{
+public:
+    /// Returns the sqlite3 connection of \a db, or null if it is not open, the driver is not
+    /// SQLite, or the driver does not use the linked library. Always null without one.
+    static void *get(const QSqlDatabase &db);
+};
+
+} // namespace Zeal
+
+#endif // SQLITEHANDLE_H
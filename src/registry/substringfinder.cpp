@@ -0,0 +1,127 @@
+#include "substringfinder.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ZEAL_SUBSTRINGFINDER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ZEAL_SUBSTRINGFINDER_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace Zeal;
+
+namespace {
+const int BlockSize = 16;
+
+#if defined(ZEAL_SUBSTRINGFINDER_SSE2) || defined(ZEAL_SUBSTRINGFINDER_NEON)
+inline int countTrailingZeros(quint64 mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+#ifdef _M_X64
+    _BitScanForward64(&index, mask);
+#else
+    if (!_BitScanForward(&index, static_cast<unsigned long>(mask))) {
+        _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+        index += 32;
+    }
+#endif
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+#endif
+
+#ifdef ZEAL_SUBSTRINGFINDER_SSE2
+// One bit per position where the first and the last needle byte match
+inline quint64 candidates(const char *block, int lastOffset, __m128i first, __m128i last)
+{
+    const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+    const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + lastOffset));
+    const __m128i matches = _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last));
+    return static_cast<quint32>(_mm_movemask_epi8(matches));
+}
+
+const int BitsPerPosition = 1;
+#endif
+
+#ifdef ZEAL_SUBSTRINGFINDER_NEON
+// Four bits per position, NEON has no movemask but can narrow each byte to a nibble
+inline quint64 candidates(const char *block, int lastOffset, uint8x16_t first, uint8x16_t last)
+{
+    const uint8x16_t head = vld1q_u8(reinterpret_cast<const uint8_t *>(block));
+    const uint8x16_t tail = vld1q_u8(reinterpret_cast<const uint8_t *>(block + lastOffset));
+    const uint8x16_t matches = vandq_u8(vceqq_u8(head, first), vceqq_u8(tail, last));
+    const uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+
+const int BitsPerPosition = 4;
+#endif
+}
+
+SubstringFinder::SubstringFinder(const QByteArray &needle) :
+    m_needle(needle)
+{
+}
+
+const char *SubstringFinder::find(const char *begin, const char *end) const
+{
+    const int size = m_needle.size();
+    if (size == 0)
+        return begin;
+    // memchr() is vectorized already
+    if (size == 1 || end - begin < size)
+        return findScalar(begin, end);
+
+#if defined(ZEAL_SUBSTRINGFINDER_SSE2) || defined(ZEAL_SUBSTRINGFINDER_NEON)
+    const char *needle = m_needle.constData();
+    const int lastOffset = size - 1;
+#ifdef ZEAL_SUBSTRINGFINDER_SSE2
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[lastOffset]);
+#else
+    const uint8x16_t first = vdupq_n_u8(static_cast<uint8_t>(needle[0]));
+    const uint8x16_t last = vdupq_n_u8(static_cast<uint8_t>(needle[lastOffset]));
+#endif
+
+    // Blocks are loaded at the candidate and at its last byte, both must stay in range
+    const char *block = begin;
+    for (; end - block >= lastOffset + BlockSize; block += BlockSize) {
+        quint64 mask = candidates(block, lastOffset, first, last);
+        while (mask) {
+            const char *candidate = block + countTrailingZeros(mask) / BitsPerPosition;
+            if (!std::memcmp(candidate + 1, needle + 1, size - 2))
+                return candidate;
+            const quint64 positionMask = (Q_UINT64_C(1) << BitsPerPosition) - 1;
+            mask &= ~(positionMask << (candidate - block) * BitsPerPosition);
+        }
+    }
+
+    return findScalar(block, end);
+#else
+    return findScalar(begin, end);
+#endif
+}
+
+const char *SubstringFinder::findScalar(const char *begin, const char *end) const
+{
+    const int size = m_needle.size();
+    const char first = m_needle.at(0);
+    while (end - begin >= size) {
+        begin = static_cast<const char *>(std::memchr(begin, first, end - begin - size + 1));
+        if (!begin)
+            return nullptr;
+        if (!std::memcmp(begin + 1, m_needle.constData() + 1, size - 1))
+            return begin;
+        ++begin;
+    }
+    return nullptr;
+}
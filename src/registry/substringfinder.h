@@ -0,0 +1,33 @@
+#ifndef SUBSTRINGFINDER_H
+#define SUBSTRINGFINDER_H
+
+#include <QByteArray>
+
+namespace Zeal {
+
+/**
+ * @short Finds a byte string in large buffers, like the folded names of a SearchIndex.
+ *
+ * Compares the first and the last byte of the needle at 16 positions at once with SSE2 or
+ * NEON, and only compares the rest where both match, so that scanning does not slow down on
+ * names sharing the first character with the query. Bytes are compared exactly, so needle
+ * and buffer must be folded the same way. Other CPUs get a scalar loop over memchr().
+ */
+class SubstringFinder
+{
+public:
+    explicit SubstringFinder(const QByteArray &needle);
+
+    /// Returns the first occurrence of the needle in [\a begin, \a end), or null if there is
+    /// none. Nothing outside of the range is read.
+    const char *find(const char *begin, const char *end) const;
+
+private:
+    const char *findScalar(const char *begin, const char *end) const;
+
+    QByteArray m_needle;
+};
+
+} // namespace Zeal
+
+#endif // SUBSTRINGFINDER_H
@@ -0,0 +1,370 @@
+#include "symboltype.h"
+
+#include "iconcache.h"
+
+#include <QStringList>
+
+using namespace Zeal;
+
+namespace {
+const quint32 HashOffsetBasis = 2166136261u;
+const quint32 HashPrime = 16777619u;
+
+// FNV-1a over the bytes of a type string, evaluated at compile time for the known ones
+constexpr quint32 typeHash(const char *str, quint32 hash = HashOffsetBasis)
+{
+    return *str ? typeHash(str + 1, (hash ^ static_cast<unsigned char>(*str)) * HashPrime) : hash;
+}
+
+// Same as typeHash() for ASCII strings, which all known type strings are
+quint32 hashTypeString(const QString &str)
+{
+    quint32 hash = HashOffsetBasis;
+    for (const QChar &ch : str) {
+        if (ch.unicode() > 0x7f)
+            return 0;
+        hash = (hash ^ ch.unicode()) * HashPrime;
+    }
+
+    return hash;
+}
+}
+
+SymbolType::Id SymbolType::fromString(const QString &str)
+{
+    // Duplicate case labels do not compile, so no two known strings share a hash,
+    // and a single comparison tells whether an unknown string happened to hit one.
+#define SYMBOL_TYPE(key, id) \
+    case typeHash(key): \
+        return str == QLatin1String(key) ? id : Other;
+
+    switch (hashTypeString(str)) {
+    SYMBOL_TYPE("Abbreviation", Abbreviation)
+    SYMBOL_TYPE("Alias", Alias)
+    SYMBOL_TYPE("Annotation", Annotation)
+    SYMBOL_TYPE("Attribute", Attribute)
+    SYMBOL_TYPE("Axiom", Axiom)
+    SYMBOL_TYPE("Binding", Binding)
+    SYMBOL_TYPE("Bookmark", Bookmark)
+    SYMBOL_TYPE("Builtin", Builtin)
+    SYMBOL_TYPE("Callback", Callback)
+    SYMBOL_TYPE("Category", Category)
+    SYMBOL_TYPE("Class", Class)
+    SYMBOL_TYPE("Column", Column)
+    SYMBOL_TYPE("Command", Command)
+    SYMBOL_TYPE("Component", Component)
+    SYMBOL_TYPE("Constant", Constant)
+    SYMBOL_TYPE("Constructor", Constructor)
+    SYMBOL_TYPE("Conversion", Conversion)
+    SYMBOL_TYPE("Database", Database)
+    SYMBOL_TYPE("Define", Define)
+    SYMBOL_TYPE("Delegate", Delegate)
+    SYMBOL_TYPE("DeletedSnippet", DeletedSnippet)
+    SYMBOL_TYPE("Diagram", Diagram)
+    SYMBOL_TYPE("Directive", Directive)
+    SYMBOL_TYPE("Element", Element)
+    SYMBOL_TYPE("Entry", Entry)
+    SYMBOL_TYPE("Enumeration", Enumeration)
+    SYMBOL_TYPE("Environment", Environment)
+    SYMBOL_TYPE("Error", Error)
+    SYMBOL_TYPE("Event", Event)
+    SYMBOL_TYPE("Exception", Exception)
+    SYMBOL_TYPE("Extension", Extension)
+    SYMBOL_TYPE("Field", Field)
+    SYMBOL_TYPE("File", File)
+    SYMBOL_TYPE("Filter", Filter)
+    SYMBOL_TYPE("Foreign Key", ForeignKey)
+    SYMBOL_TYPE("Framework", Framework)
+    SYMBOL_TYPE("Function", Function)
+    SYMBOL_TYPE("Global", Global)
+    SYMBOL_TYPE("Guide", Guide)
+    SYMBOL_TYPE("Hook", Hook)
+    SYMBOL_TYPE("Index", Index)
+    SYMBOL_TYPE("Indirection", Indirection)
+    SYMBOL_TYPE("Inductive", Inductive)
+    SYMBOL_TYPE("Instance", Instance)
+    SYMBOL_TYPE("Instruction", Instruction)
+    SYMBOL_TYPE("Interface", Interface)
+    SYMBOL_TYPE("Keyword", Keyword)
+    SYMBOL_TYPE("Lemma", Lemma)
+    SYMBOL_TYPE("Library", Library)
+    SYMBOL_TYPE("Literal", Literal)
+    SYMBOL_TYPE("Macro", Macro)
+    SYMBOL_TYPE("Method", Method)
+    SYMBOL_TYPE("Mixin", Mixin)
+    SYMBOL_TYPE("Modifier", Modifier)
+    SYMBOL_TYPE("Module", Module)
+    SYMBOL_TYPE("Namespace", Namespace)
+    SYMBOL_TYPE("NewSnippet", NewSnippet)
+    SYMBOL_TYPE("Notation", Notation)
+    SYMBOL_TYPE("Object", Object)
+    SYMBOL_TYPE("Operator", Operator)
+    SYMBOL_TYPE("Option", Option)
+    SYMBOL_TYPE("Package", Package)
+    SYMBOL_TYPE("Parameter", Parameter)
+    SYMBOL_TYPE("Plugin", Plugin)
+    SYMBOL_TYPE("Procedure", Procedure)
+    SYMBOL_TYPE("Projection", Projection)
+    SYMBOL_TYPE("Property", Property)
+    SYMBOL_TYPE("Protocol", Protocol)
+    SYMBOL_TYPE("Provider", Provider)
+    SYMBOL_TYPE("Provisioner", Provisioner)
+    SYMBOL_TYPE("Query", Query)
+    SYMBOL_TYPE("Record", Record)
+    SYMBOL_TYPE("Relationship", Relationship)
+    SYMBOL_TYPE("Report", Report)
+    SYMBOL_TYPE("Resource", Resource)
+    SYMBOL_TYPE("Sample", Sample)
+    SYMBOL_TYPE("Schema", Schema)
+    SYMBOL_TYPE("Script", Script)
+    SYMBOL_TYPE("Section", Section)
+    SYMBOL_TYPE("Service", Service)
+    SYMBOL_TYPE("Setting", Setting)
+    SYMBOL_TYPE("Shortcut", Shortcut)
+    SYMBOL_TYPE("Snippet", Snippet)
+    SYMBOL_TYPE("Statement", Statement)
+    SYMBOL_TYPE("Structure", Structure)
+    SYMBOL_TYPE("Style", Style)
+    SYMBOL_TYPE("Subroutine", Subroutine)
+    SYMBOL_TYPE("Table", Table)
+    SYMBOL_TYPE("Tactic", Tactic)
+    SYMBOL_TYPE("Tag", Tag)
+    SYMBOL_TYPE("Test", Test)
+    SYMBOL_TYPE("Trait", Trait)
+    SYMBOL_TYPE("Trigger", Trigger)
+    SYMBOL_TYPE("Type", Type)
+    SYMBOL_TYPE("Union", Union)
+    SYMBOL_TYPE("Unknown", Unknown)
+    SYMBOL_TYPE("Value", Value)
+    SYMBOL_TYPE("Variable", Variable)
+    SYMBOL_TYPE("Variant", Variant)
+    SYMBOL_TYPE("Web", Web)
+    SYMBOL_TYPE("Word", Word)
+    // Dash aliases
+    // Attribute
+    SYMBOL_TYPE("Package Attributes", Attribute)
+    SYMBOL_TYPE("Private Attributes", Attribute)
+    SYMBOL_TYPE("Protected Attributes", Attribute)
+    SYMBOL_TYPE("Public Attributes", Attribute)
+    SYMBOL_TYPE("Static Package Attributes", Attribute)
+    SYMBOL_TYPE("Static Private Attributes", Attribute)
+    SYMBOL_TYPE("Static Protected Attributes", Attribute)
+    SYMBOL_TYPE("Static Public Attributes", Attribute)
+    SYMBOL_TYPE("XML Attributes", Attribute)
+    // Binding
+    SYMBOL_TYPE("binding", Binding)
+    // Category
+    SYMBOL_TYPE("cat", Category)
+    SYMBOL_TYPE("Groups", Category)
+    SYMBOL_TYPE("Pages", Category)
+    // Class
+    SYMBOL_TYPE("cl", Class)
+    SYMBOL_TYPE("specialization", Class)
+    SYMBOL_TYPE("tmplt", Class)
+    // Constant
+    SYMBOL_TYPE("data", Constant)
+    SYMBOL_TYPE("econst", Constant)
+    SYMBOL_TYPE("enumelt", Constant)
+    SYMBOL_TYPE("clconst", Constant)
+    SYMBOL_TYPE("structdata", Constant)
+    SYMBOL_TYPE("Notifications", Constant)
+    // Constructor
+    SYMBOL_TYPE("Public Constructors", Constructor)
+    // Enumeration
+    SYMBOL_TYPE("enum", Enumeration)
+    SYMBOL_TYPE("Enum", Enumeration)
+    SYMBOL_TYPE("Enumerations", Enumeration)
+    // Event
+    SYMBOL_TYPE("event", Event)
+    SYMBOL_TYPE("Public Events", Event)
+    SYMBOL_TYPE("Inherited Events", Event)
+    SYMBOL_TYPE("Private Events", Event)
+    // Field
+    SYMBOL_TYPE("Data Fields", Field)
+    // Function
+    SYMBOL_TYPE("dcop", Function)
+    SYMBOL_TYPE("func", Function)
+    SYMBOL_TYPE("ffunc", Function)
+    SYMBOL_TYPE("signal", Function)
+    SYMBOL_TYPE("slot", Function)
+    SYMBOL_TYPE("grammar", Function)
+    SYMBOL_TYPE("Function Prototypes", Function)
+    SYMBOL_TYPE("Functions/Subroutines", Function)
+    SYMBOL_TYPE("Members", Function)
+    SYMBOL_TYPE("Package Functions", Function)
+    SYMBOL_TYPE("Private Member Functions", Function)
+    SYMBOL_TYPE("Private Slots", Function)
+    SYMBOL_TYPE("Protected Member Functions", Function)
+    SYMBOL_TYPE("Protected Slots", Function)
+    SYMBOL_TYPE("Public Member Functions", Function)
+    SYMBOL_TYPE("Public Slots", Function)
+    SYMBOL_TYPE("Signals", Function)
+    SYMBOL_TYPE("Static Package Functions", Function)
+    SYMBOL_TYPE("Static Private Member Functions", Function)
+    SYMBOL_TYPE("Static Protected Member Functions", Function)
+    SYMBOL_TYPE("Static Public Member Functions", Function)
+    // Guide
+    SYMBOL_TYPE("doc", Guide)
+    // Namespace
+    SYMBOL_TYPE("ns", Namespace)
+    // Macro
+    SYMBOL_TYPE("macro", Macro)
+    // Method
+    SYMBOL_TYPE("clm", Method)
+    SYMBOL_TYPE("intfctr", Method)
+    SYMBOL_TYPE("intfcm", Method)
+    SYMBOL_TYPE("intfm", Method)
+    SYMBOL_TYPE("instctr", Method)
+    SYMBOL_TYPE("instm", Method)
+    SYMBOL_TYPE("Class Methods", Method)
+    SYMBOL_TYPE("Inherited Methods", Method)
+    SYMBOL_TYPE("Instance Methods", Method)
+    SYMBOL_TYPE("Private Methods", Method)
+    SYMBOL_TYPE("Protected Methods", Method)
+    SYMBOL_TYPE("Public Methods", Method)
+    // Property
+    SYMBOL_TYPE("intfp", Property)
+    SYMBOL_TYPE("instp", Property)
+    SYMBOL_TYPE("Inherited Properties", Property)
+    SYMBOL_TYPE("Private Properties", Property)
+    SYMBOL_TYPE("Protected Properties", Property)
+    SYMBOL_TYPE("Public Properties", Property)
+    // Protocol
+    SYMBOL_TYPE("intf", Protocol)
+    // Structure
+    SYMBOL_TYPE("struct", Structure)
+    SYMBOL_TYPE("Data Structures", Structure)
+    SYMBOL_TYPE("Struct", Structure)
+    // Type
+    SYMBOL_TYPE("tag", Type)
+    SYMBOL_TYPE("tdef", Type)
+    SYMBOL_TYPE("Data Types", Type)
+    SYMBOL_TYPE("Package Types", Type)
+    SYMBOL_TYPE("Private Types", Type)
+    SYMBOL_TYPE("Protected Types", Type)
+    SYMBOL_TYPE("Public Types", Type)
+    SYMBOL_TYPE("Typedefs", Type)
+    // Variable
+    SYMBOL_TYPE("var", Variable)
+    default:
+        return Other;
+    }
+
+#undef SYMBOL_TYPE
+}
+
+QString SymbolType::name(Id id)
+{
+    static const QStringList names = {
+        QStringLiteral("Abbreviation"),
+        QStringLiteral("Alias"),
+        QStringLiteral("Annotation"),
+        QStringLiteral("Attribute"),
+        QStringLiteral("Axiom"),
+        QStringLiteral("Binding"),
+        QStringLiteral("Bookmark"),
+        QStringLiteral("Builtin"),
+        QStringLiteral("Callback"),
+        QStringLiteral("Category"),
+        QStringLiteral("Class"),
+        QStringLiteral("Column"),
+        QStringLiteral("Command"),
+        QStringLiteral("Component"),
+        QStringLiteral("Constant"),
+        QStringLiteral("Constructor"),
+        QStringLiteral("Conversion"),
+        QStringLiteral("Database"),
+        QStringLiteral("Define"),
+        QStringLiteral("Delegate"),
+        QStringLiteral("DeletedSnippet"),
+        QStringLiteral("Diagram"),
+        QStringLiteral("Directive"),
+        QStringLiteral("Element"),
+        QStringLiteral("Entry"),
+        QStringLiteral("Enumeration"),
+        QStringLiteral("Environment"),
+        QStringLiteral("Error"),
+        QStringLiteral("Event"),
+        QStringLiteral("Exception"),
+        QStringLiteral("Extension"),
+        QStringLiteral("Field"),
+        QStringLiteral("File"),
+        QStringLiteral("Filter"),
+        QStringLiteral("Foreign Key"),
+        QStringLiteral("Framework"),
+        QStringLiteral("Function"),
+        QStringLiteral("Global"),
+        QStringLiteral("Guide"),
+        QStringLiteral("Hook"),
+        QStringLiteral("Index"),
+        QStringLiteral("Indirection"),
+        QStringLiteral("Inductive"),
+        QStringLiteral("Instance"),
+        QStringLiteral("Instruction"),
+        QStringLiteral("Interface"),
+        QStringLiteral("Keyword"),
+        QStringLiteral("Lemma"),
+        QStringLiteral("Library"),
+        QStringLiteral("Literal"),
+        QStringLiteral("Macro"),
+        QStringLiteral("Method"),
+        QStringLiteral("Mixin"),
+        QStringLiteral("Modifier"),
+        QStringLiteral("Module"),
+        QStringLiteral("Namespace"),
+        QStringLiteral("NewSnippet"),
+        QStringLiteral("Notation"),
+        QStringLiteral("Object"),
+        QStringLiteral("Operator"),
+        QStringLiteral("Option"),
+        QStringLiteral("Package"),
+        QStringLiteral("Parameter"),
+        QStringLiteral("Plugin"),
+        QStringLiteral("Procedure"),
+        QStringLiteral("Projection"),
+        QStringLiteral("Property"),
+        QStringLiteral("Protocol"),
+        QStringLiteral("Provider"),
+        QStringLiteral("Provisioner"),
+        QStringLiteral("Query"),
+        QStringLiteral("Record"),
+        QStringLiteral("Relationship"),
+        QStringLiteral("Report"),
+        QStringLiteral("Resource"),
+        QStringLiteral("Sample"),
+        QStringLiteral("Schema"),
+        QStringLiteral("Script"),
+        QStringLiteral("Section"),
+        QStringLiteral("Service"),
+        QStringLiteral("Setting"),
+        QStringLiteral("Shortcut"),
+        QStringLiteral("Snippet"),
+        QStringLiteral("Statement"),
+        QStringLiteral("Structure"),
+        QStringLiteral("Style"),
+        QStringLiteral("Subroutine"),
+        QStringLiteral("Table"),
+        QStringLiteral("Tactic"),
+        QStringLiteral("Tag"),
+        QStringLiteral("Test"),
+        QStringLiteral("Trait"),
+        QStringLiteral("Trigger"),
+        QStringLiteral("Type"),
+        QStringLiteral("Union"),
+        QStringLiteral("Unknown"),
+        QStringLiteral("Value"),
+        QStringLiteral("Variable"),
+        QStringLiteral("Variant"),
+        QStringLiteral("Web"),
+        QStringLiteral("Word")
+    };
+
+    return names.value(id);
+}
+
+QIcon SymbolType::icon(Id id)
+{
+    if (id == Other)
+        return QIcon();
+    return IconCache::icon(QStringLiteral("typeIcon:%1.png").arg(name(id)));
+}
@@ -0,0 +1,135 @@
+#ifndef SYMBOLTYPE_H
+#define SYMBOLTYPE_H
+
+#include <QIcon>
+#include <QString>
+
+namespace Zeal {
+
+/**
+ * @short Canonical types of docset symbols.
+ *
+ * Dash type strings come in many aliases, like "clm" and "Class Methods" for Method. They are
+ * mapped to the types with a perfect hash of the known strings, which is computed at compile time.
+ * Type strings that are none of them are kept as they are.
+ */
+class SymbolType
+{
+public:
+    enum Id : quint8 {
+        Abbreviation,
+        Alias,
+        Annotation,
+        Attribute,
+        Axiom,
+        Binding,
+        Bookmark,
+        Builtin,
+        Callback,
+        Category,
+        Class,
+        Column,
+        Command,
+        Component,
+        Constant,
+        Constructor,
+        Conversion,
+        Database,
+        Define,
+        Delegate,
+        DeletedSnippet,
+        Diagram,
+        Directive,
+        Element,
+        Entry,
+        Enumeration,
+        Environment,
+        Error,
+        Event,
+        Exception,
+        Extension,
+        Field,
+        File,
+        Filter,
+        ForeignKey,
+        Framework,
+        Function,
+        Global,
+        Guide,
+        Hook,
+        Index,
+        Indirection,
+        Inductive,
+        Instance,
+        Instruction,
+        Interface,
+        Keyword,
+        Lemma,
+        Library,
+        Literal,
+        Macro,
+        Method,
+        Mixin,
+        Modifier,
+        Module,
+        Namespace,
+        NewSnippet,
+        Notation,
+        Object,
+        Operator,
+        Option,
+        Package,
+        Parameter,
+        Plugin,
+        Procedure,
+        Projection,
+        Property,
+        Protocol,
+        Provider,
+        Provisioner,
+        Query,
+        Record,
+        Relationship,
+        Report,
+        Resource,
+        Sample,
+        Schema,
+        Script,
+        Section,
+        Service,
+        Setting,
+        Shortcut,
+        Snippet,
+        Statement,
+        Structure,
+        Style,
+        Subroutine,
+        Table,
+        Tactic,
+        Tag,
+        Test,
+        Trait,
+        Trigger,
+        Type,
+        Union,
+        Unknown,
+        Value,
+        Variable,
+        Variant,
+        Web,
+        Word,
+        Other, // Any type string not known here
+        Count = Other
+    };
+
+    /// Returns the type of the Dash type string \a str, or Other for an unknown one
+    static Id fromString(const QString &str);
+    /// Returns the name of the type \a id, or an empty string for Other
+    static QString name(Id id);
+    /// Returns the icon of the type \a id, shared through IconCache
+    static QIcon icon(Id id);
+};
+
+} // namespace Zeal
+
+#endif // SYMBOLTYPE_H
@@ -1,6 +1,6 @@
 TEMPLATE = app
 
-QT += gui gui-private widgets sql
+QT += concurrent gui gui-private widgets sql
 CONFIG += c++11
 
 # Build features
@@ -15,6 +15,10 @@ portable {
     DEFINES += PORTABLE_BUILD
 }
 
+tracing {
+    DEFINES += USE_TRACING
+}
+
 # TODO: Obtain version number from Git tags
 VERSION = $$(ZEAL_VERSION)
 isEmpty(VERSION) {
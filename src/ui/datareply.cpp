@@ -0,0 +1,65 @@
+#include "datareply.h"
+
+#include <QNetworkAccessManager>
+
+#include <cstring>
+
+using namespace Zeal;
+
+DataReply::DataReply(const QNetworkRequest &request, const QByteArray &data,
+                     const QString &contentType, QObject *parent) :
+    QNetworkReply(parent),
+    m_data(data)
+{
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(QNetworkAccessManager::GetOperation);
+    setHeader(QNetworkRequest::ContentTypeHeader, contentType);
+    setHeader(QNetworkRequest::ContentLengthHeader, m_data.size());
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+    // Like other replies, signals come after the caller had a chance to connect
+    QMetaObject::invokeMethod(this, "emitSignals", Qt::QueuedConnection);
+}
+
+void DataReply::abort()
+{
+    m_offset = m_data.size();
+}
+
+qint64 DataReply::bytesAvailable() const
+{
+    return m_data.size() - m_offset + QNetworkReply::bytesAvailable();
+}
+
+bool DataReply::isSequential() const
+{
+    return true;
+}
+
+qint64 DataReply::size() const
+{
+    return m_data.size();
+}
+
+qint64 DataReply::readData(char *data, qint64 maxSize)
+{
+    if (m_offset >= m_data.size())
+        return -1;
+
+    const int size = static_cast<int>(qMin<qint64>(maxSize, m_data.size() - m_offset));
+    std::memcpy(data, m_data.constData() + m_offset, size);
+    m_offset += size;
+    return size;
+}
+
+void DataReply::emitSignals()
+{
+    emit metaDataChanged();
+    emit downloadProgress(m_data.size(), m_data.size());
+    if (!m_data.isEmpty())
+        emit readyRead();
+
+    setFinished(true);
+    emit finished();
+}
@@ -0,0 +1,35 @@
+#ifndef DATAREPLY_H
+#define DATAREPLY_H
+
+#include <QByteArray>
+#include <QNetworkReply>
+
+namespace Zeal {
+
+/// Network reply for data that is already in memory
+class DataReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    explicit DataReply(const QNetworkRequest &request, const QByteArray &data,
+                       const QString &contentType, QObject *parent = nullptr);
+
+    void abort() override;
+    qint64 bytesAvailable() const override;
+    bool isSequential() const override;
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+
+private slots:
+    void emitSignals();
+
+private:
+    QByteArray m_data;
+    int m_offset = 0;
+};
+
+} // namespace Zeal
+
+#endif // DATAREPLY_H
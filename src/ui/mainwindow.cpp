@@ -3,21 +3,27 @@
 
 #include "aboutdialog.h"
 #include "networkaccessmanager.h"
+#include "prefetcher.h"
 #include "searchitemdelegate.h"
 #include "settingsdialog.h"
 #include "core/application.h"
 #include "core/settings.h"
+#include "core/tracer.h"
 #include "registry/docsetregistry.h"
+#include "registry/iconcache.h"
 #include "registry/listmodel.h"
 #include "registry/searchmodel.h"
+#include "registry/searchquery.h"
 
 #include <QAbstractEventDispatcher>
 #include <QCloseEvent>
+#include <QDataStream>
 #include <QDesktopServices>
 #include <QKeyEvent>
 #include <QMenu>
 #include <QMessageBox>
 #include <QScrollBar>
+#include <QSharedPointer>
 #include <QShortcut>
 #include <QSystemTrayIcon>
 #include <QTabBar>
@@ -31,6 +37,8 @@
 
 #include <qxtglobalshortcut.h>
 
+#include <algorithm>
+
 #ifdef USE_LIBAPPINDICATOR
 #include <gtk/gtk.h>
 #endif
@@ -39,19 +47,18 @@ using namespace Zeal;
 
 namespace {
 const char indexPageUrl[] = "qrc:///webpage/Welcome.html";
+const int PrefetchCount = 3; // Top results read ahead
+const int TabSuspendInterval = 60000; // ms
 }
 
 MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow),
     m_application(app),
     m_settings(app->settings()),
     m_zealListModel(new ListModel(app->docsetRegistry(), this)),
     m_settingsDialog(new SettingsDialog(app, m_zealListModel, this)),
     m_globalShortcut(new QxtGlobalShortcut(m_settings->showShortcut, this))
 {
-    m_tabBar = new QTabBar(this);
-
     setWindowIcon(QIcon::fromTheme(QStringLiteral("zeal"), QIcon(QStringLiteral(":/zeal.ico"))));
 
     if (m_settings->showSystrayIcon)
@@ -74,10 +81,26 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
         }
     });
 
+    // Docsets load in the background, so that they are ready when the window is first shown
     m_application->docsetRegistry()->init(m_settings->docsetPath);
+}
+
+MainWindow::~MainWindow()
+{
+    delete ui;
+}
+
+void MainWindow::setupContent()
+{
+    if (ui)
+        return;
+
+    ZEAL_TRACE_SCOPE("ui", QStringLiteral("main window setup"));
 
     // initialise ui
+    ui = new Ui::MainWindow();
     ui->setupUi(this);
+    m_tabBar = new QTabBar(this);
 
     setupShortcuts();
 
@@ -88,6 +111,7 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     });
 
     m_zealNetworkManager = new NetworkAccessManager();
+    m_prefetcher = new Prefetcher(this);
 #ifdef USE_WEBENGINE
     // FIXME AngularJS workaround (zealnetworkaccessmanager.cpp)
 #else
@@ -115,6 +139,10 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
         if (m_settingsDialog->exec()) {
             m_globalShortcut->setShortcut(m_settings->showShortcut);
 
+            // Results of open tabs get trimmed to a lowered limit right away
+            for (SearchState *tab : m_tabs)
+                tab->zealSearch->setResultLimit(m_settings->searchResultLimit);
+
             if (m_settings->showSystrayIcon) {
                 createTrayIcon();
             } else if (m_trayIcon) {
@@ -158,10 +186,10 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     // treeView and lineEdit
     ui->lineEdit->setTreeView(ui->treeView);
     ui->lineEdit->setFocus();
-    setupSearchBoxCompletions();
+    ui->lineEdit->setDocsetRegistry(m_application->docsetRegistry());
     ui->treeView->setModel(m_zealListModel);
     ui->treeView->setColumnHidden(1, true);
-    ui->treeView->setItemDelegate(new SearchItemDelegate(ui->lineEdit, ui->treeView));
+    ui->treeView->setItemDelegate(new SearchItemDelegate(ui->treeView));
 
     createTab();
 
@@ -201,11 +229,26 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     ui->sections->hide();
     ui->sections_lab->hide();
     ui->sections->setModel(m_searchState->sectionsList);
-    connect(m_application->docsetRegistry(), &DocsetRegistry::queryCompleted, this, &MainWindow::onSearchComplete);
+    connect(m_application->docsetRegistry(), &DocsetRegistry::queryResultsReset,
+            this, &MainWindow::onSearchResultsReset);
+    connect(m_application->docsetRegistry(), &DocsetRegistry::queryResultsAdded,
+            this, &MainWindow::onSearchResultsAdded);
+    connect(m_application->docsetRegistry(), &DocsetRegistry::queryCompleted,
+            this, &MainWindow::queryCompleted);
+    connect(m_application->docsetRegistry(), &DocsetRegistry::relatedLinksReady,
+            this, &MainWindow::onRelatedLinksReady);
 
     connect(m_application->docsetRegistry(), &DocsetRegistry::docsetRemoved,
-            [this](const QString &name) {
+            this, [this](const QString &name) {
         for (SearchState *searchState : m_tabs) {
+            if (!searchState->page) {
+                if (docsetName(searchState->suspendedUrl) == name) {
+                    searchState->suspendedHistory.clear();
+                    searchState->suspendedUrl = QUrl(indexPageUrl);
+                }
+                continue;
+            }
+
             if (docsetName(searchState->page->mainFrame()->url()) != name)
                 continue;
 
@@ -214,17 +257,10 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
         }
     });
 
-    connect(ui->lineEdit, &QLineEdit::textChanged, [this](const QString &text) {
-        if (text == m_searchState->searchQuery)
-            return;
-
-        m_searchState->searchQuery = text;
-        m_application->docsetRegistry()->search(text);
-        if (text.isEmpty()) {
-            m_searchState->sectionsList->setResults();
-            ui->treeView->setModel(m_zealListModel);
-        }
-    });
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    connect(m_searchTimer, &QTimer::timeout, this, &MainWindow::runSearch);
+    connect(ui->lineEdit, &QLineEdit::textChanged, this, &MainWindow::search);
 
     ui->action_NewTab->setShortcut(QKeySequence::AddTab);
     addAction(ui->action_NewTab);
@@ -259,6 +295,12 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     connect(m_tabBar, &QTabBar::currentChanged, this, &MainWindow::goToTab);
     connect(m_tabBar, &QTabBar::tabCloseRequested, this, &MainWindow::closeTab);
 
+    // Pages of tabs left in the background are unloaded, see suspendTabs()
+    m_tabSuspendTimer = new QTimer(this);
+    m_tabSuspendTimer->setInterval(TabSuspendInterval);
+    connect(m_tabSuspendTimer, &QTimer::timeout, this, &MainWindow::suspendTabs);
+    m_tabSuspendTimer->start();
+
     ((QHBoxLayout *)ui->tabBarFrame->layout())->insertWidget(2, m_tabBar, 0, Qt::AlignBottom);
 
     connect(ui->openUrlButton, &QPushButton::clicked, [this]() {
@@ -280,25 +322,20 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     });
 }
 
-MainWindow::~MainWindow()
-{
-    delete ui;
-}
-
 void MainWindow::openDocset(const QModelIndex &index)
 {
-    const QVariant urlStr = index.sibling(index.row(), 1).data();
-    if (urlStr.isNull())
+    // Models only keep paths relative to the docset documents
+    const QVariant path = index.sibling(index.row(), 1).data();
+    if (path.isNull())
         return;
 
-    /// TODO: Keep anchor separately from file address
-    QStringList urlParts = urlStr.toString().split(QLatin1Char('#'));
-    QUrl url = QUrl::fromLocalFile(urlParts[0]);
-    if (urlParts.count() > 1)
-        /// NOTE: QUrl::DecodedMode is a fix for #121. Let's hope it doesn't break anything.
-        url.setFragment(urlParts[1], QUrl::DecodedMode);
+    const QString name = index.data(ListModel::DocsetNameRole).toString();
+    const QSharedPointer<const Docset> docset = m_application->docsetRegistry()->docset(name);
+    if (!docset)
+        return;
 
-    ui->webView->load(url);
+    m_application->docsetRegistry()->recordUsage(name);
+    ui->webView->load(docset->documentUrl(path.toString()));
 
     if (!m_treeViewClicked)
         ui->webView->focus();
@@ -314,18 +351,62 @@ QString MainWindow::docsetName(const QUrl &url) const
 
 QIcon MainWindow::docsetIcon(const QString &docsetName) const
 {
-    const Docset * const docset = m_application->docsetRegistry()->docset(docsetName);
+    const QSharedPointer<const Docset> docset = m_application->docsetRegistry()->docset(docsetName);
     if (!docset)
-        return QIcon(QStringLiteral(":/icons/logo/icon.png"));
+        return IconCache::icon(QStringLiteral(":/icons/logo/icon.png"));
     return docset->icon();
 }
 
+void MainWindow::search(const QString &text)
+{
+    if (text == m_searchState->searchQuery)
+        return;
+
+    m_searchState->searchQuery = text;
+
+    // Clearing is immediate, and so is the first keystroke after a pause. Keystrokes
+    // following it are answered together, once the previous query could have finished.
+    if (text.isEmpty() || (!m_searchTimer->isActive()
+                           && (!m_searchClock.isValid() || m_searchClock.elapsed() >= searchDelay()))) {
+        m_searchTimer->stop();
+        runSearch();
+    } else if (!m_searchTimer->isActive()) {
+        m_searchTimer->start(searchDelay());
+    }
+}
+
+void MainWindow::runSearch()
+{
+    const QString &text = m_searchState->searchQuery;
+
+    m_searchClock.start();
+    m_application->docsetRegistry()->search(text);
+    if (text.isEmpty()) {
+        m_searchState->sectionsList->setResults();
+        ui->treeView->setModel(m_zealListModel);
+    }
+}
+
+int MainWindow::searchDelay() const
+{
+    // Follows how long queries take, within bounds that still feel instant
+    static const int MinimumDelay = 10;
+    static const int MaximumDelay = 200;
+    return qBound(MinimumDelay, m_searchLatency, MaximumDelay);
+}
+
 void MainWindow::queryCompleted()
 {
+    // Only the last query completes, the ones replaced meanwhile are canceled
+    m_searchLatency = (3 * m_searchLatency + m_searchClock.elapsed()) / 4;
+
+    // Results of a query, which has been cleared meanwhile
+    if (m_searchState->searchQuery.isEmpty())
+        return;
+
     m_treeViewClicked = true;
 
-    ui->treeView->setModel(m_searchState->zealSearch);
-    ui->treeView->setColumnHidden(1, true);
+    // Only open the top result once all docsets are done, it may still change before that
     ui->treeView->setCurrentIndex(m_searchState->zealSearch->index(0, 0, QModelIndex()));
     ui->treeView->activated(ui->treeView->currentIndex());
 }
@@ -334,7 +415,12 @@ void MainWindow::goToTab(int index)
 {
     saveTabState();
     m_searchState = m_tabs.at(index);
+    if (!m_searchState->page)
+        resumeTab(m_searchState);
     reloadTabState();
+
+    // Keeps the number of loaded pages within the limit
+    suspendTabs();
 }
 
 void MainWindow::closeTab(int index)
@@ -357,10 +443,9 @@ void MainWindow::createTab()
 {
     SearchState *newTab = new SearchState();
     newTab->zealSearch = new Zeal::SearchModel();
+    newTab->zealSearch->setResultLimit(m_settings->searchResultLimit);
     newTab->sectionsList = new Zeal::SearchModel();
 
-    connect(newTab->zealSearch, &SearchModel::queryCompleted, this,
-            &MainWindow::queryCompleted);
     connect(newTab->sectionsList, &SearchModel::queryCompleted, [=]() {
         int resultCount = newTab->sectionsList->rowCount(QModelIndex());
         ui->sections->setVisible(resultCount > 1);
@@ -369,11 +454,8 @@ void MainWindow::createTab()
 
     ui->lineEdit->clear();
 
-    newTab->page = new QWebPage(ui->webView);
-#ifndef USE_WEBENGINE
-    newTab->page->setLinkDelegationPolicy(QWebPage::DelegateExternalLinks);
-    newTab->page->setNetworkAccessManager(m_zealNetworkManager);
-#endif
+    newTab->page = createPage();
+    newTab->lastActive.start();
 
     ui->treeView->setModel(NULL);
     ui->treeView->setModel(m_zealListModel);
@@ -393,6 +475,104 @@ void MainWindow::createTab()
 #endif
 }
 
+void MainWindow::suspendTabs()
+{
+    QList<SearchState *> liveTabs;
+    for (SearchState *state : m_tabs) {
+        if (state == m_searchState || !state->page)
+            continue;
+
+        if (m_settings->tabSuspendTimeout > 0
+                && state->lastActive.hasExpired(m_settings->tabSuspendTimeout * 1000LL)) {
+            suspendTab(state);
+            continue;
+        }
+
+        liveTabs.append(state);
+    }
+
+    // The current tab counts against the limit as well
+    const int maxBackgroundTabs = qMax(0, m_settings->maxLiveTabs - 1);
+    if (liveTabs.size() <= maxBackgroundTabs)
+        return;
+
+    // Least recently used first
+    std::sort(liveTabs.begin(), liveTabs.end(), [](const SearchState *a, const SearchState *b) {
+        return a->lastActive.elapsed() > b->lastActive.elapsed();
+    });
+
+    for (int i = 0; i < liveTabs.size() - maxBackgroundTabs; ++i)
+        suspendTab(liveTabs.at(i));
+}
+
+QWebPage *MainWindow::createPage()
+{
+    QWebPage *page = new QWebPage(ui->webView);
+#ifndef USE_WEBENGINE
+    page->setLinkDelegationPolicy(QWebPage::DelegateExternalLinks);
+    page->setNetworkAccessManager(m_zealNetworkManager);
+#endif
+#ifdef USE_TRACING
+    connect(page, &QWebPage::loadStarted, page, [page]() {
+        ZEAL_TRACE_BEGIN("ui", QStringLiteral("page load"), page);
+    });
+    connect(page, &QWebPage::loadFinished, page, [page]() {
+        ZEAL_TRACE_END("ui", QStringLiteral("page load"), page);
+    });
+#endif
+    return page;
+}
+
+void MainWindow::suspendTab(SearchState *state)
+{
+    // The history brings back the current page as well as the way back and forward
+    state->suspendedHistory.clear();
+    QDataStream out(&state->suspendedHistory, QIODevice::WriteOnly);
+    out << *state->page->history();
+
+#ifdef USE_WEBENGINE
+    state->suspendedUrl = state->page->url();
+    state->suspendedTitle = state->page->title();
+#else
+    state->suspendedUrl = state->page->mainFrame()->url();
+    state->suspendedTitle = state->page->history()->currentItem().title();
+    state->suspendedScrollPosition = state->page->mainFrame()->scrollPosition();
+#endif
+
+    delete state->page;
+    state->page = nullptr;
+}
+
+void MainWindow::resumeTab(SearchState *state)
+{
+    QWebPage *page = createPage();
+    state->page = page;
+
+    if (!state->suspendedHistory.isEmpty()) {
+        QDataStream in(state->suspendedHistory);
+        in >> *page->history();
+    } else {
+#ifdef USE_WEBENGINE
+        page->load(state->suspendedUrl);
+#else
+        page->mainFrame()->load(state->suspendedUrl);
+#endif
+    }
+
+#ifndef USE_WEBENGINE
+    // Scrolling has to wait for the page to be laid out
+    const QPoint scrollPosition = state->suspendedScrollPosition;
+    QSharedPointer<QMetaObject::Connection> connection(new QMetaObject::Connection());
+    *connection = connect(page, &QWebPage::loadFinished, [page, scrollPosition, connection]() {
+        page->mainFrame()->setScrollPosition(scrollPosition);
+        QObject::disconnect(*connection);
+    });
+#endif
+
+    state->suspendedHistory.clear();
+    state->suspendedTitle.clear();
+}
+
 void MainWindow::displayTabs()
 {
     ui->menu_Tabs->clear();
@@ -409,9 +589,10 @@ void MainWindow::displayTabs()
     for (int i = 0; i < m_tabs.count(); i++) {
         SearchState *state = m_tabs.at(i);
 #ifdef USE_WEBENGINE
-        QString title = state->page->title();
+        QString title = state->page ? state->page->title() : state->suspendedTitle;
 #else
-        QString title = state->page->history()->currentItem().title();
+        QString title = state->page ? state->page->history()->currentItem().title()
+                                    : state->suspendedTitle;
 #endif
         QAction *action = ui->menu_Tabs->addAction(title);
         action->setCheckable(true);
@@ -482,6 +663,7 @@ void MainWindow::scrollSearch()
 
 void MainWindow::saveTabState()
 {
+    m_searchState->lastActive.start();
     m_searchState->searchQuery = ui->lineEdit->text();
     m_searchState->selections = ui->treeView->selectionModel()->selectedIndexes();
     m_searchState->scrollPosition = ui->treeView->verticalScrollBar()->value();
@@ -489,27 +671,64 @@ void MainWindow::saveTabState()
     m_searchState->zoomFactor = ui->webView->zealZoomFactor();
 }
 
-void MainWindow::onSearchComplete()
+void MainWindow::onSearchResultsReset(const QVector<SearchResult> &results)
+{
+    if (m_searchState->searchQuery.isEmpty())
+        return;
+
+    // Results are of the last query, later ones cancel those before
+    const SearchQuery query = SearchQuery::fromString(m_searchState->searchQuery);
+    m_searchState->zealSearch->setMatchQuery(query.query());
+    m_searchState->zealSearch->setResults(results);
+
+    if (ui->treeView->model() != m_searchState->zealSearch) {
+        ui->treeView->setModel(m_searchState->zealSearch);
+        ui->treeView->setColumnHidden(1, true);
+    }
+
+    prefetchTopResults();
+}
+
+void MainWindow::onSearchResultsAdded(const QVector<SearchResult> &results)
 {
-    m_searchState->zealSearch->setResults(m_application->docsetRegistry()->queryResults());
+    if (m_searchState->searchQuery.isEmpty())
+        return;
+
+    m_searchState->zealSearch->addResults(results);
+    prefetchTopResults();
 }
 
 void MainWindow::loadSections(const QString &docsetName, const QUrl &url)
 {
-    Docset *docset = m_application->docsetRegistry()->docset(docsetName);
-    if (!docset)
-        return;
+    // Sections are looked up by the registry thread, see onRelatedLinksReady()
+    m_searchState->sectionsUrl = url;
+    m_application->docsetRegistry()->findRelatedLinks(docsetName, url);
+}
 
-    m_searchState->sectionsList->setResults(docset->relatedLinks(url));
+void MainWindow::prefetchTopResults()
+{
+    // The top result is opened once the query completes, by then its page is in memory
+    QList<QUrl> urls;
+    const SearchModel * const model = m_searchState->zealSearch;
+    for (int row = 0; row < qMin(PrefetchCount, model->rowCount(QModelIndex())); ++row) {
+        const QModelIndex index = model->index(row, 0, QModelIndex());
+        const QVariant path = index.sibling(row, 1).data();
+        const QSharedPointer<const Docset> docset
+                = m_application->docsetRegistry()->docset(index.data(ListModel::DocsetNameRole).toString());
+        if (docset && !path.isNull())
+            urls.append(docset->documentUrl(path.toString()));
+    }
+
+    m_prefetcher->prefetch(urls);
 }
 
-// Sets up the search box autocompletions.
-void MainWindow::setupSearchBoxCompletions()
+void MainWindow::onRelatedLinksReady(const QUrl &url, const QVector<SearchResult> &results)
 {
-    QStringList completions;
-    for (const Docset * const docset: m_application->docsetRegistry()->docsets())
-        completions << QString("%1:").arg(docset->prefix);
-    ui->lineEdit->setCompletions(completions);
+    // Tabs may have moved on to other pages meanwhile
+    for (SearchState *searchState : m_tabs) {
+        if (searchState->sectionsUrl == url)
+            searchState->sectionsList->setResults(results);
+    }
 }
 
 void MainWindow::displayViewActions()
@@ -636,6 +855,8 @@ void MainWindow::createTrayIcon()
 
 void MainWindow::bringToFront(const Zeal::SearchQuery &query)
 {
+    setupContent();
+
     show();
     setWindowState((windowState() & ~Qt::WindowMinimized) | Qt::WindowActive);
     raise();
@@ -2,10 +2,15 @@
 #define MAINWINDOW_H
 
 #include "registry/searchquery.h"
+#include "registry/searchresult.h"
 
 #include <QDialog>
+#include <QElapsedTimer>
 #include <QMainWindow>
 #include <QModelIndex>
+#include <QPoint>
+#include <QUrl>
+#include <QVector>
 
 #ifdef USE_LIBAPPINDICATOR
 #undef signals
@@ -25,6 +30,7 @@
 class QxtGlobalShortcut;
 
 class QSystemTrayIcon;
+class QTimer;
 class QTabBar;
 
 namespace Ui {
@@ -40,6 +46,7 @@ class Settings;
 
 class ListModel;
 class NetworkAccessManager;
+class Prefetcher;
 class SearchModel;
 class SettingsDialog;
 
@@ -49,9 +56,19 @@ class SettingsDialog;
 // needs to contain [search input, search model, section model, url]
 struct SearchState
 {
+    // null while the tab is suspended
     QWebPage *page;
+    // what is left of a suspended page
+    QByteArray suspendedHistory;
+    QUrl suspendedUrl;
+    QString suspendedTitle;
+    QPoint suspendedScrollPosition;
+    // since the tab was last shown
+    QElapsedTimer lastActive;
     // model representing sections
     Zeal::SearchModel *sectionsList;
+    // page the sections are looked up for
+    QUrl sectionsUrl;
     // model representing searched for items
     Zeal::SearchModel *zealSearch;
     // query being searched for
@@ -74,6 +91,7 @@ public:
     explicit MainWindow(Zeal::Core::Application *app, QWidget *parent = nullptr);
     ~MainWindow() override;
 
+    /// Shows the window, which builds its widgets and web pages the first time
     void bringToFront(const Zeal::SearchQuery &query = Zeal::SearchQuery());
     void createTab();
 
@@ -85,20 +103,30 @@ protected:
 private slots:
     void back();
     void forward();
-    void onSearchComplete();
+    void onSearchResultsReset(const QVector<Zeal::SearchResult> &results);
+    void onSearchResultsAdded(const QVector<Zeal::SearchResult> &results);
+    void onRelatedLinksReady(const QUrl &url, const QVector<Zeal::SearchResult> &results);
     void openDocset(const QModelIndex &index);
     void queryCompleted();
     void scrollSearch();
     void saveTabState();
     void goToTab(int index);
     void closeTab(int index = -1);
+    void suspendTabs();
 
 private:
+    void setupContent();
+    void search(const QString &text);
+    void runSearch();
+    int searchDelay() const;
     void displayViewActions();
     void loadSections(const QString &docsetName, const QUrl &url);
-    void setupSearchBoxCompletions();
+    void prefetchTopResults();
     void reloadTabState();
     void displayTabs();
+    QWebPage *createPage();
+    void suspendTab(SearchState *state);
+    void resumeTab(SearchState *state);
     QString docsetName(const QUrl &url) const;
     QIcon docsetIcon(const QString &docsetName) const;
     QAction *addHistoryAction(QWebHistory *history, QWebHistoryItem item);
@@ -108,6 +136,7 @@ private:
 
     SearchState *m_searchState = nullptr;
     Zeal::NetworkAccessManager *m_zealNetworkManager = nullptr;
+    Zeal::Prefetcher *m_prefetcher = nullptr;
 
     Ui::MainWindow *ui = nullptr;
     Zeal::Core::Application *m_application = nullptr;
@@ -120,9 +149,15 @@ private:
 
     bool m_treeViewClicked = false;
 
+    // Queries typed faster than they are answered get coalesced
+    QTimer *m_searchTimer = nullptr;
+    QElapsedTimer m_searchClock; // Since the last query was run
+    int m_searchLatency = 0; // Moving average, in ms
+
     QxtGlobalShortcut *m_globalShortcut = nullptr;
 
     QTabBar *m_tabBar = nullptr;
+    QTimer *m_tabSuspendTimer = nullptr;
 
     QSystemTrayIcon *m_trayIcon = nullptr;
 
@@ -1,9 +1,22 @@
 #include "networkaccessmanager.h"
 
+#include "datareply.h"
+#include "resourcecache.h"
+#include "registry/documentarchive.h"
+#include "registry/sharedstore.h"
+
+#include <QMimeDatabase>
 #include <QNetworkRequest>
 
 using namespace Zeal;
 
+namespace {
+QString contentType(const QString &filePath)
+{
+    return QMimeDatabase().mimeTypeForFile(filePath, QMimeDatabase::MatchExtension).name();
+}
+}
+
 NetworkAccessManager::NetworkAccessManager(QObject *parent) :
     QNetworkAccessManager(parent)
 {
@@ -26,6 +39,31 @@ QNetworkReply *NetworkAccessManager::createRequest(QNetworkAccessManager::Operat
         return QNetworkAccessManager::createRequest(QNetworkAccessManager::GetOperation,
                                                     QNetworkRequest());
     }
+
+    if (op == QNetworkAccessManager::GetOperation) {
+        const QString filePath = req.url().toLocalFile();
+
+        // Documents of packed docsets never touch the disk
+        QString path;
+        const QSharedPointer<const DocumentArchive> archive = DocumentArchive::find(filePath, &path);
+        if (archive)
+            return new DataReply(req, archive->read(path), contentType(path), this);
+
+        // Pages of a shared store are read over the network only once per machine
+        if (SharedStore::contains(filePath)) {
+            const QByteArray data = SharedStore::read(filePath);
+            if (!data.isNull())
+                return new DataReply(req, data, contentType(filePath), this);
+        }
+
+        // Assets shared between pages are read once
+        if (ResourceCache::isCacheable(filePath)) {
+            const QByteArray data = ResourceCache::read(filePath);
+            if (!data.isNull())
+                return new DataReply(req, data, contentType(filePath), this);
+        }
+    }
+
 #ifdef Q_OS_WIN32
     // Fix for AngularJS docset - Windows doesn't allow ':'s in filenames,
     // and bsdtar.exe replaces them with '_'s, so replace all ':'s in requests
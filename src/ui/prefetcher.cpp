@@ -0,0 +1,136 @@
+#include "prefetcher.h"
+
+#include "registry/documentarchive.h"
+
+#include <QFile>
+#include <QRegularExpression>
+#include <QRunnable>
+
+#include <functional>
+
+using namespace Zeal;
+
+namespace {
+const int MaxResourceCount = 16; // Per document
+const int MaxRememberedResources = 1024;
+const int MaxHeadSize = 64 * 1024; // Parsed when the end of the head is not found
+
+class PrefetchJob : public QRunnable
+{
+public:
+    explicit PrefetchJob(const std::function<void()> &function) :
+        m_function(function)
+    {
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
+}
+
+Prefetcher::Prefetcher(QObject *parent) :
+    QObject(parent)
+{
+    // Speculative work must not hold up searches, which share the global pool
+    m_threadPool.setMaxThreadCount(1);
+}
+
+Prefetcher::~Prefetcher()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_threadPool.waitForDone();
+}
+
+void Prefetcher::prefetch(const QList<QUrl> &urls)
+{
+    // Results arrive in batches, which mostly keep the top ones
+    if (urls == m_urls)
+        return;
+
+    m_urls = urls;
+
+    const int generation = m_generation.fetchAndAddOrdered(1) + 1;
+    m_threadPool.start(new PrefetchJob([this, urls, generation] {
+        run(urls, generation);
+    }));
+}
+
+void Prefetcher::run(const QList<QUrl> &urls, int generation)
+{
+    for (const QUrl &url : urls) {
+        if (isCanceled(generation))
+            return;
+
+        if (!url.isLocalFile())
+            continue;
+
+        const QByteArray document = read(url.toLocalFile());
+
+        int resourceCount = 0;
+        for (const QString &link : linkedResources(document)) {
+            if (isCanceled(generation) || resourceCount == MaxResourceCount)
+                break;
+
+            const QUrl resourceUrl = url.resolved(QUrl(link));
+            if (!resourceUrl.isLocalFile())
+                continue;
+
+            const QString filePath = resourceUrl.toLocalFile();
+            {
+                QMutexLocker locker(&m_mutex);
+                if (m_resources.contains(filePath))
+                    continue;
+                if (m_resources.size() >= MaxRememberedResources)
+                    m_resources.clear();
+                m_resources.insert(filePath);
+            }
+
+            read(filePath);
+            ++resourceCount;
+        }
+    }
+}
+
+bool Prefetcher::isCanceled(int generation) const
+{
+    return m_generation.load() != generation;
+}
+
+QByteArray Prefetcher::read(const QString &filePath)
+{
+    // Packed documents are decompressed into the page cache of their archive
+    QString path;
+    const QSharedPointer<const DocumentArchive> archive = DocumentArchive::find(filePath, &path);
+    if (archive)
+        return archive->read(path);
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    return file.readAll();
+}
+
+QStringList Prefetcher::linkedResources(const QByteArray &document)
+{
+    static const QRegularExpression linkRegex(
+                QStringLiteral("<(?:link|script)\\b[^>]*?\\b(?:href|src)\\s*=\\s*[\"']([^\"'#?]+)"),
+                QRegularExpression::CaseInsensitiveOption);
+
+    QStringList links;
+
+    // Style sheets and scripts are linked from the head, which is all that needs to be parsed
+    const int headEnd = document.indexOf("</head>");
+    const QString head = QString::fromUtf8(document.left(headEnd == -1 ? MaxHeadSize : headEnd));
+
+    QRegularExpressionMatchIterator it = linkRegex.globalMatch(head);
+    while (it.hasNext())
+        links.append(it.next().captured(1));
+
+    return links;
+}
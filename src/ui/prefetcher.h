@@ -0,0 +1,49 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QThreadPool>
+#include <QUrl>
+
+namespace Zeal {
+
+/**
+ * @short Reads documents ahead of their display.
+ *
+ * Pages likely to be opened next are read in the background, together with the style sheets
+ * and scripts they link, so that the page cache of packed docsets and the one of the operating
+ * system already hold them when the web view asks. Only one prefetch runs at a time, a new one
+ * cancels the previous.
+ */
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Prefetcher(QObject *parent = nullptr);
+    ~Prefetcher() override;
+
+    /// Reads the local documents at \a urls, in order of their likelihood
+    void prefetch(const QList<QUrl> &urls);
+
+private:
+    void run(const QList<QUrl> &urls, int generation);
+    bool isCanceled(int generation) const;
+
+    static QByteArray read(const QString &filePath);
+    static QStringList linkedResources(const QByteArray &document);
+
+    QThreadPool m_threadPool;
+    QAtomicInt m_generation;
+    QList<QUrl> m_urls;
+
+    QMutex m_mutex;
+    QSet<QString> m_resources; // Already read, documents of a docset share most of them
+};
+
+} // namespace Zeal
+
+#endif // PREFETCHER_H
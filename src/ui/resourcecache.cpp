@@ -0,0 +1,93 @@
+#include "resourcecache.h"
+
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+
+using namespace Zeal;
+
+namespace {
+const int CacheSize = 32 * 1024 * 1024;
+const qint64 MaxFileSize = 2 * 1024 * 1024;
+const int MaxFileCount = 8192; // Paths remembered, their contents are bounded by CacheSize
+
+const char *const CacheableSuffixes[] = {
+    "css", "js", "woff", "woff2", "ttf", "otf", "eot", "svg", "png", "jpg", "jpeg", "gif", "ico"
+};
+
+struct FileEntry
+{
+    QByteArray digest;
+    qint64 size;
+    QDateTime lastModified;
+};
+
+struct Cache
+{
+    QMutex mutex;
+    QHash<QString, FileEntry> files;
+    QCache<QByteArray, QByteArray> contents{CacheSize}; // By digest
+};
+
+Q_GLOBAL_STATIC(Cache, cache)
+}
+
+bool ResourceCache::isCacheable(const QString &filePath)
+{
+    const int dotIndex = filePath.lastIndexOf(QLatin1Char('.'));
+    if (dotIndex == -1)
+        return false;
+
+    const QString suffix = filePath.mid(dotIndex + 1).toLower();
+    for (const char *cacheableSuffix : CacheableSuffixes) {
+        if (suffix == QLatin1String(cacheableSuffix))
+            return true;
+    }
+
+    return false;
+}
+
+QByteArray ResourceCache::read(const QString &filePath)
+{
+    const QFileInfo fileInfo(filePath);
+    if (!fileInfo.isFile())
+        return QByteArray();
+
+    const qint64 size = fileInfo.size();
+    const QDateTime lastModified = fileInfo.lastModified();
+
+    {
+        QMutexLocker locker(&cache->mutex);
+        const auto it = cache->files.constFind(filePath);
+        if (it != cache->files.cend() && it->size == size && it->lastModified == lastModified) {
+            if (const QByteArray *data = cache->contents.object(it->digest))
+                return *data;
+        }
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    const QByteArray data = file.readAll();
+    if (data.size() != size || size > MaxFileSize)
+        return data;
+
+    const QByteArray digest = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+
+    QMutexLocker locker(&cache->mutex);
+    if (cache->files.size() >= MaxFileCount)
+        cache->files.clear();
+    cache->files.insert(filePath, {digest, size, lastModified});
+
+    // Another file with the same contents may have been cached already
+    if (const QByteArray *cachedData = cache->contents.object(digest))
+        return *cachedData;
+
+    cache->contents.insert(digest, new QByteArray(data), qMax(data.size(), 1));
+    return data;
+}
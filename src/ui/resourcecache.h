@@ -0,0 +1,27 @@
+#ifndef RESOURCECACHE_H
+#define RESOURCECACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace Zeal {
+
+/**
+ * @short Process-wide cache of docset assets.
+ *
+ * Style sheets, scripts, fonts and images are shared by most pages of a docset, and often by
+ * several docsets. They are kept in memory by their content, so identical files are stored
+ * once. A file is read again only when its size or modification time changes.
+ */
+class ResourceCache
+{
+public:
+    /// Returns true for the kinds of files worth caching
+    static bool isCacheable(const QString &filePath);
+    /// Returns the contents of \a filePath, or a null array if it cannot be read
+    static QByteArray read(const QString &filePath);
+};
+
+} // namespace Zeal
+
+#endif // RESOURCECACHE_H
@@ -1,15 +1,13 @@
 #include "searchitemdelegate.h"
 
-#include "searchitemstyle.h"
-#include "registry/searchquery.h"
+#include "registry/searchmodel.h"
 
 #include <QApplication>
 #include <QFontMetrics>
 #include <QPainter>
 
-SearchItemDelegate::SearchItemDelegate(QLineEdit *lineEdit, QWidget *view) :
+SearchItemDelegate::SearchItemDelegate(QWidget *view) :
     QStyledItemDelegate(view),
-    m_lineEdit(lineEdit),
     m_view(view)
 {
 }
@@ -23,13 +21,13 @@ void SearchItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &op
     option.text = index.data().toString();
     option.features |= QStyleOptionViewItem::HasDisplay;
 
-    if (!index.data(Qt::DecorationRole).isNull()) {
+    const QVariant decoration = index.data(Qt::DecorationRole);
+    if (!decoration.isNull()) {
         option.features |= QStyleOptionViewItem::HasDecoration;
-        option.icon = index.data(Qt::DecorationRole).value<QIcon>();
+        option.icon = decoration.value<QIcon>();
     }
 
-    ZealSearchItemStyle style;
-    style.drawControl(QStyle::CE_ItemViewItem, &option, painter, m_view);
+    m_style.drawControl(QStyle::CE_ItemViewItem, &option, painter, m_view);
 
     if (option.state & QStyle::State_Selected) {
 #ifdef Q_OS_WIN32
@@ -40,38 +38,66 @@ void SearchItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &op
     }
 
     QRect rect = qApp->style()->subElementRect(QStyle::SE_ItemViewItemText, &option, m_view);
-    const int margin = style.pixelMetric(QStyle::PM_FocusFrameHMargin, 0, m_view);
+    const int margin = m_style.pixelMetric(QStyle::PM_FocusFrameHMargin, 0, m_view);
     rect.adjust(margin, 0, 2, 0); // +2px for bold text
 
-    QFont bold(painter->font());
-    bold.setBold(true);
-    const QFontMetrics metricsBold(bold);
-
-    const QFontMetrics metrics(painter->font());
-    QString elided = metrics.elidedText(index.data().toString(), option.textElideMode, rect.width());
-
-    QString highlight;
-    if (m_lineEdit)
-        highlight = Zeal::SearchQuery::fromString(m_lineEdit->text()).query();
-
-    int from = 0;
-    while (from < elided.size()) {
-        const int until = highlight.isEmpty() ? -1 : elided.toLower().indexOf(highlight.toLower(), from);
-
-        if (until == -1) {
-            painter->drawText(rect, elided.mid(from));
-            from = elided.size();
-        } else {
-            painter->drawText(rect, elided.mid(from, until - from));
-            rect.setLeft(rect.left() + metrics.width(elided.mid(from, until - from)));
-            QFont old(painter->font());
-            painter->setFont(bold);
-            painter->drawText(rect, elided.mid(until, highlight.size()));
-            painter->setFont(old);
-            rect.setLeft(rect.left() + metricsBold.width(elided.mid(until, highlight.size())));
-            from = until + highlight.size();
-        }
-    }
+    const QVector<int> matchRanges = index.data(Zeal::SearchModel::MatchRangesRole).value<QVector<int>>();
+    textLayout(index.row(), option.text, matchRanges, painter->font(), rect.width(),
+               option.textElideMode)->layout.draw(painter, rect.topLeft());
 
     painter->restore();
 }
+
+const SearchItemDelegate::TextLayout *SearchItemDelegate::textLayout(int row, const QString &text,
+                                                                     const QVector<int> &matchRanges,
+                                                                     const QFont &font, int width,
+                                                                     Qt::TextElideMode elideMode) const
+{
+    const quint64 key = (static_cast<quint64>(row) << 32) | static_cast<quint32>(width);
+    TextLayout *textLayout = m_textLayouts.object(key);
+    if (textLayout && textLayout->text == text && textLayout->matchRanges == matchRanges
+            && textLayout->font == font) {
+        return textLayout;
+    }
+
+    textLayout = new TextLayout();
+    textLayout->text = text;
+    textLayout->matchRanges = matchRanges;
+    textLayout->font = font;
+
+    const QString elided = QFontMetrics(font).elidedText(text, elideMode, width);
+    // Matches hidden behind the ellipsis are dropped
+    const int visibleSize = elided == text ? text.size() : elided.size() - 1;
+
+    QList<QTextLayout::FormatRange> formats;
+    for (int i = 0; i + 1 < matchRanges.size(); i += 2) {
+        QTextLayout::FormatRange format;
+        format.start = matchRanges.at(i);
+        format.length = qMin(matchRanges.at(i + 1), visibleSize - format.start);
+        if (format.length <= 0)
+            continue;
+
+        format.format.setFontWeight(QFont::Bold);
+        formats.append(format);
+    }
+
+    QTextLayout &layout = textLayout->layout;
+    layout.setText(elided);
+    layout.setFont(font);
+    /// TODO: [Qt 5.6] Use QTextLayout::setFormats()
+    layout.setAdditionalFormats(formats);
+    layout.setCacheEnabled(true);
+
+    QTextOption textOption;
+    textOption.setWrapMode(QTextOption::NoWrap);
+    layout.setTextOption(textOption);
+
+    layout.beginLayout();
+    QTextLine line = layout.createLine();
+    if (line.isValid())
+        line.setLineWidth(width);
+    layout.endLayout();
+
+    m_textLayouts.insert(key, textLayout);
+    return textLayout;
+}
@@ -1,21 +1,39 @@
 #ifndef SEARCHITEMDELEGATE_H
 #define SEARCHITEMDELEGATE_H
 
-#include <QLineEdit>
+#include "searchitemstyle.h"
+
+#include <QCache>
+#include <QFont>
 #include <QStyledItemDelegate>
+#include <QTextLayout>
+#include <QVector>
 
 class SearchItemDelegate : public QStyledItemDelegate
 {
     Q_OBJECT
 public:
-    explicit SearchItemDelegate(QLineEdit *lineEdit_ = nullptr, QWidget *view = nullptr);
+    explicit SearchItemDelegate(QWidget *view = nullptr);
 
     void paint(QPainter *painter, const QStyleOptionViewItem &option,
                const QModelIndex &index) const override;
 
 private:
-    QLineEdit *m_lineEdit = nullptr;
+    // Elided text with the matched characters in bold, laid out for a row
+    struct TextLayout {
+        QString text;
+        QVector<int> matchRanges;
+        QFont font;
+        QTextLayout layout;
+    };
+
+    const TextLayout *textLayout(int row, const QString &text, const QVector<int> &matchRanges,
+                                 const QFont &font, int width, Qt::TextElideMode elideMode) const;
+
     QWidget *m_view = nullptr;
+    ZealSearchItemStyle m_style;
+    // Keyed by row and width, an entry is laid out again when its row shows other text
+    mutable QCache<quint64, TextLayout> m_textLayouts{256};
 };
 
 #endif // SEARCHITEMDELEGATE_H
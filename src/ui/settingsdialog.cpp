@@ -4,23 +4,34 @@
 #include "ui_settingsdialog.h"
 #include "core/application.h"
 #include "core/settings.h"
+#include "core/tracer.h"
 #include "registry/docsetregistry.h"
+#include "registry/documentarchive.h"
+#include "registry/iconcache.h"
 #include "registry/listmodel.h"
 
 #include <QClipboard>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QFutureWatcher>
+#include <QHBoxLayout>
 #include <QInputDialog>
+#include <QLabel>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QMessageBox>
-#include <QTemporaryFile>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
 #include <QWebSettings>
 #include <QUrl>
 
 #include <QtConcurrent/QtConcurrent>
 
+#include <algorithm>
+
 using namespace Zeal;
 
 namespace {
@@ -29,8 +40,83 @@ const char *ApiUrl = "http://api.zealdocs.org";
 // QNetworkReply properties
 const char *DocsetMetadataProperty = "docsetMetadata";
 const char *DownloadTypeProperty = "downloadType";
-const char *DownloadPreviousReceived = "downloadPreviousReceived";
 const char *ListItemIndexProperty = "listItem";
+
+const int ProgressInterval = 100; // ms
+
+// Queued downloads wait this long for their sizes, before they start in any order
+const int SizeProbeTimeout = 3000; // ms
+
+// Docset list of the last session, in the cache directory
+const char *DocsetListFileName = "docsets.json";
+
+// Manifest of a delta package, in the docset directory
+const char *DeltaManifestFileName = "delta.json";
+
+// Full archives are extracted next to the docset, hidden from the registry like the trash,
+// and swapped in once complete. Delta packages patch the docset in place.
+QString stagingDirName(const QString &docsetName)
+{
+    return QLatin1Char('.') + docsetName + QLatin1String(".docset.part");
+}
+
+/*!
+  \internal
+  Applies the manifest of an extracted delta package, which looks like this:
+  {"removed": ["<path>", ...], "sha1": {"<path>": "<hash>", ...}}
+  Files in "removed" are deleted, and files in "sha1" must match their hashes afterwards.
+  Paths are relative to the docset directory.
+*/
+bool applyDeltaManifest(const QString &docsetPath)
+{
+    const QDir docsetDir(docsetPath);
+
+    QFile file(docsetDir.absoluteFilePath(QLatin1String(DeltaManifestFileName)));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QJsonObject manifest = QJsonDocument::fromJson(file.readAll()).object();
+    file.remove();
+
+    // Paths must not lead outside of the docset
+    auto resolve = [&docsetDir](const QString &path) -> QString {
+        const QString cleanPath = QDir::cleanPath(path);
+        if (cleanPath.isEmpty() || QDir::isAbsolutePath(cleanPath)
+                || cleanPath.startsWith(QLatin1String(".."))) {
+            return QString();
+        }
+        return docsetDir.absoluteFilePath(cleanPath);
+    };
+
+    for (const QJsonValue &value : manifest[QStringLiteral("removed")].toArray()) {
+        const QString filePath = resolve(value.toString());
+        if (!filePath.isEmpty())
+            QFile::remove(filePath);
+    }
+
+    // Mismatches mean the installed docset was not the one the delta is based on
+    const QJsonObject hashes = manifest[QStringLiteral("sha1")].toObject();
+    for (auto it = hashes.constBegin(); it != hashes.constEnd(); ++it) {
+        QFile updatedFile(resolve(it.key()));
+        if (updatedFile.fileName().isEmpty() || !updatedFile.open(QIODevice::ReadOnly))
+            return false;
+
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(&updatedFile);
+        if (hash.result().toHex() != it.value().toString().toLatin1().toLower())
+            return false;
+    }
+
+    return true;
+}
+
+QString formatSize(qint64 bytes)
+{
+    if (bytes < 1024 * 1024)
+        return QStringLiteral("%1 KiB").arg(bytes / 1024);
+
+    return QStringLiteral("%1 MiB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
 }
 
 SettingsDialog::SettingsDialog(Core::Application *app, ListModel *listModel, QWidget *parent) :
@@ -48,6 +134,17 @@ SettingsDialog::SettingsDialog(Core::Application *app, ListModel *listModel, QWi
 
     ui->availableDocsetList->setItemDelegate(new ProgressItemDelegate(this));
 
+    setupPerformanceTab();
+
+    m_sizeProbeTimer = new QTimer(this);
+    m_sizeProbeTimer->setSingleShot(true);
+    m_sizeProbeTimer->setInterval(SizeProbeTimeout);
+    connect(m_sizeProbeTimer, &QTimer::timeout, this, &SettingsDialog::startQueuedDownloads);
+
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setInterval(ProgressInterval);
+    connect(m_progressTimer, &QTimer::timeout, this, &SettingsDialog::updateDownloadProgress);
+
     // Setup signals & slots
     connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &SettingsDialog::saveSettings);
     connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &SettingsDialog::loadSettings);
@@ -82,19 +179,52 @@ SettingsDialog::~SettingsDialog()
 
 void SettingsDialog::extractionCompleted(const QString &filePath)
 {
-    QString docsetName;
+    const QString docsetName = m_extractions.take(filePath);
+    if (docsetName.isEmpty())
+        return;
 
-    /// FIXME: Come up with a better approach
-    for (const QString &key : m_tmpFiles.keys()) {
-        if (m_tmpFiles[key]->fileName() == filePath) {
-            docsetName = key;
-            break;
+    // The download failed after the archive was read, it has been reported already
+    if (m_failedDownloads.remove(filePath)) {
+        removeStagedDocset(docsetName);
+        resetDocsetListItem(docsetName);
+        return;
+    }
+
+    if (!m_deltaFallbacks.contains(docsetName)) {
+        if (!installStagedDocset(docsetName)) {
+            QMessageBox::warning(this, tr("Installation Error"),
+                                 QString(tr("Cannot replace docset <b>%1</b>.")).arg(docsetName));
+            removeStagedDocset(docsetName);
+            resetDocsetListItem(docsetName);
+            return;
         }
+
+        completeInstallation(docsetName);
+        return;
     }
 
     const QDir dataDir(m_application->settings()->docsetPath);
     const QString docsetPath = dataDir.absoluteFilePath(docsetName + QLatin1String(".docset"));
 
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>();
+    watcher->setFuture(QtConcurrent::run(&applyDeltaManifest, docsetPath));
+    connect(watcher, &QFutureWatcher<bool>::finished, [=] {
+        if (watcher->result()) {
+            m_deltaFallbacks.remove(docsetName);
+            completeInstallation(docsetName);
+        } else {
+            fallBackToFullDownload(docsetName);
+        }
+
+        watcher->deleteLater();
+    });
+}
+
+void SettingsDialog::completeInstallation(const QString &docsetName)
+{
+    const QDir dataDir(m_application->settings()->docsetPath);
+    const QString docsetPath = dataDir.absoluteFilePath(docsetName + QLatin1String(".docset"));
+
     // Write metadata about docset
     DocsetMetadata metadata = m_availableDocsets.contains(docsetName)
             ? m_availableDocsets[docsetName]
@@ -109,29 +239,95 @@ void SettingsDialog::extractionCompleted(const QString &filePath)
         listItem->setCheckState(Qt::Unchecked);
         listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
     }
-    resetProgress();
-    delete m_tmpFiles.take(docsetName);
+
+    if (replies.isEmpty() && m_queuedDownloads.isEmpty())
+        resetProgress();
 }
 
 void SettingsDialog::extractionError(const QString &filePath, const QString &errorString)
 {
-    const QString docsetName = QFileInfo(filePath).baseName() + QLatin1String(".docset");
+    const QString docsetName = m_extractions.take(filePath);
+    if (docsetName.isEmpty())
+        return;
+
+    // Partially extracted files go, the installed docset is left as it was
+    removeStagedDocset(docsetName);
+
+    // Failed downloads are reported on their own
+    if (m_failedDownloads.remove(filePath)) {
+        resetDocsetListItem(docsetName);
+        return;
+    }
+
+    if (fallBackToFullDownload(docsetName))
+        return;
+
     QMessageBox::warning(this, tr("Extraction Error"),
                          QString(tr("Cannot extract docset <b>%1</b>: %2")).arg(docsetName, errorString));
-    /// TODO: Update list item state (hide progress bar)
-    delete m_tmpFiles.take(docsetName);
+    resetDocsetListItem(docsetName);
+}
+
+/*!
+  \internal
+  Replaces the installed docset \a docsetName with its staged extraction, if there is one.
+*/
+bool SettingsDialog::installStagedDocset(const QString &docsetName)
+{
+    const QDir dataDir(m_application->settings()->docsetPath);
+    const QString docsetPath = dataDir.absoluteFilePath(docsetName + QLatin1String(".docset"));
+    const QString stagingPath = dataDir.absoluteFilePath(stagingDirName(docsetName));
+    if (!QFileInfo::exists(stagingPath))
+        return true;
+
+    // The registry keeps files of the old docset open
+    if (m_docsetRegistry->contains(docsetName))
+        m_docsetRegistry->remove(docsetName);
+
+    if (QFileInfo::exists(docsetPath) && !m_application->removeDirectory(docsetPath)
+            && !QDir(docsetPath).removeRecursively()) {
+        return false;
+    }
+
+    return QDir().rename(stagingPath, docsetPath);
+}
+
+void SettingsDialog::removeStagedDocset(const QString &docsetName)
+{
+    // A newer extraction of the same docset has staged its own files already
+    if (m_extractions.values().contains(docsetName))
+        return;
+
+    const QDir dataDir(m_application->settings()->docsetPath);
+    const QString stagingPath = dataDir.absoluteFilePath(stagingDirName(docsetName));
+    if (QFileInfo::exists(stagingPath) && !m_application->removeDirectory(stagingPath))
+        QDir(stagingPath).removeRecursively();
+}
+
+void SettingsDialog::resetDocsetListItem(const QString &docsetName)
+{
+    const DocsetMetadata metadata = m_availableDocsets.contains(docsetName)
+            ? m_availableDocsets[docsetName]
+              : m_userFeeds[docsetName];
+    QListWidgetItem *listItem = findDocsetListItem(metadata.title());
+    if (listItem) {
+        listItem->setHidden(m_docsetRegistry->contains(docsetName));
+        listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
+    }
+
+    if (replies.isEmpty() && m_queuedDownloads.isEmpty())
+        resetProgress();
 }
 
 void SettingsDialog::extractionProgress(const QString &filePath, qint64 extracted, qint64 total)
 {
-    QString docsetName;
+    const QString docsetName = m_extractions.value(filePath);
+    if (docsetName.isEmpty())
+        return;
 
-    /// FIXME: Come up with a better approach
-    for (const QString &key : m_tmpFiles.keys()) {
-        if (m_tmpFiles[key]->fileName() == filePath) {
-            docsetName = key;
-            break;
-        }
+    // Download progress is shown until the archive is received
+    for (const QNetworkReply *reply : replies) {
+        if (reply->url().toString() == filePath)
+            return;
     }
 
     DocsetMetadata metadata = m_availableDocsets.contains(docsetName)
@@ -154,11 +350,31 @@ void SettingsDialog::downloadCompleted()
                 qobject_cast<QNetworkReply *>(sender()));
 
     replies.removeOne(reply.data());
+    m_downloadProgress.remove(reply.data());
 
     if (reply->error() != QNetworkReply::NoError) {
-        if (reply->error() != QNetworkReply::OperationCanceledError)
+        // A missing delta package is no reason to bother the user
+        const DocsetMetadata metadata = reply->property(DocsetMetadataProperty).value<DocsetMetadata>();
+        const bool fallingBack = reply->error() != QNetworkReply::OperationCanceledError
+                && fallBackToFullDownload(metadata.name());
+        if (reply->error() != QNetworkReply::OperationCanceledError && !fallingBack)
             QMessageBox::warning(this, tr("Network Error"), reply->errorString());
 
+        // The extraction ends on its own once the stream is closed, and cleans up then.
+        // A patched docset is left to the full download, which replaces it.
+        const QString source = reply->url().toString();
+        if (fallingBack)
+            m_extractions.remove(source);
+        else if (m_extractions.contains(source))
+            m_failedDownloads.insert(source);
+
+        // Without the docset list there is nothing to redownload from
+        if (reply->property(DownloadTypeProperty).toUInt() == DownloadDocsetList)
+            m_redownloadPending = false;
+
+        applyPendingDocsetList();
+        redownloadDocsets();
+        startQueuedDownloads();
         return;
     }
 
@@ -171,7 +387,10 @@ void SettingsDialog::downloadCompleted()
         if (redirectUrl.scheme().isEmpty())
             redirectUrl.setScheme(reply->request().url().scheme());
 
-        QNetworkReply *newReply = startDownload(redirectUrl);
+        // Docset archives stay out of the HTTP cache
+        QNetworkReply *newReply
+                = reply->property(DownloadTypeProperty).toUInt() == DownloadDocset
+                ? startDownload(QList<QUrl>() << redirectUrl) : startDownload(redirectUrl);
 
         // Copy properties
         newReply->setProperty(DocsetMetadataProperty, reply->property(DocsetMetadataProperty));
@@ -184,24 +403,10 @@ void SettingsDialog::downloadCompleted()
     }
 
     switch (static_cast<DownloadType>(reply->property(DownloadTypeProperty).toUInt())) {
-    case DownloadDocsetList: {
-        QJsonParseError jsonError;
-        const QJsonDocument jsonDoc = QJsonDocument::fromJson(reply->readAll(), &jsonError);
-
-        if (jsonError.error != QJsonParseError::NoError) {
-            QMessageBox::warning(this, tr("Error"),
-                                 tr("Corrupted docset list: ") + jsonError.errorString());
-            break;
-        }
-
-        processDocsetList(jsonDoc.array());
-
-        if (!m_availableDocsets.isEmpty())
-            ui->downloadableGroup->show();
-
-        resetProgress();
+    case DownloadDocsetList:
+        // Applied below, or once running docset downloads are done
+        m_pendingDocsetList = reply->readAll();
         break;
-    }
 
     case DownloadDashFeed: {
         DocsetMetadata metadata = DocsetMetadata::fromDashFeed(reply->request().url(), reply->readAll());
@@ -219,38 +424,28 @@ void SettingsDialog::downloadCompleted()
         /// TODO: Check revision
         if (metadata.version().isEmpty() || oldMetadata.version() != metadata.version()) {
             m_userFeeds[metadata.name()] = metadata;
-            QNetworkReply *newReply = startDownload(metadata.url());
-            newReply->setProperty(DocsetMetadataProperty, QVariant::fromValue(metadata));
-            newReply->setProperty(DownloadTypeProperty, DownloadDocset);
-            connect(newReply, &QNetworkReply::finished, this, &SettingsDialog::downloadCompleted);
+            enqueueDownload(metadata, metadata.urls());
         }
         break;
     }
 
     case DownloadDocset: {
+        // The archive has been extracted while downloading, see startExtraction()
         const DocsetMetadata metadata = reply->property(DocsetMetadataProperty).value<DocsetMetadata>();
 
-        QTemporaryFile *tmpFile = new QTemporaryFile();
-        tmpFile->open();
-        while (reply->bytesAvailable())
-            tmpFile->write(reply->read(1024 * 1024)); // Use small chunks
-        tmpFile->close();
-
         QListWidgetItem *item = findDocsetListItem(metadata.title());
-        if (item) {
-            item->setData(ProgressItemDelegate::ValueRole, 0);
+        if (item)
             item->setData(ProgressItemDelegate::FormatRole, tr("Installing: %p%"));
-        }
-
-        m_tmpFiles.insert(metadata.name(), tmpFile);
-        m_application->extract(tmpFile->fileName(), m_application->settings()->docsetPath,
-                               metadata.name() + QLatin1String(".docset"));
         break;
     }
     }
 
+    applyPendingDocsetList();
+    redownloadDocsets();
+    startQueuedDownloads();
+
     // If all enqueued downloads have finished executing
-    if (replies.isEmpty())
+    if (replies.isEmpty() && m_queuedDownloads.isEmpty())
         resetProgress();
 }
 
@@ -300,22 +495,33 @@ void SettingsDialog::on_downloadProgress(qint64 received, qint64 total)
     if (!reply)
         return;
 
-    // Try to get the item associated to the request
-    QListWidgetItem *item = ui->availableDocsetList->item(reply->property(ListItemIndexProperty).toInt());
-    if (item)
-        item->setData(ProgressItemDelegate::ValueRole, percent(received, total));
-
-    qint64 previousReceived = 0;
-    const QVariant previousReceivedVariant = reply->property(DownloadPreviousReceived);
-    if (!previousReceivedVariant.isValid())
+    // Only recorded here, updateDownloadProgress() shows it at a fixed rate
+    DownloadProgress &progress = m_downloadProgress[reply];
+    if (progress.total == -1)
         m_combinedTotal += total;
-    else
-        previousReceived = previousReceivedVariant.toLongLong();
 
-    m_combinedReceived += received - previousReceived;
-    reply->setProperty(DownloadPreviousReceived, received);
+    m_combinedReceived += received - progress.received;
+    progress.received = received;
+    progress.total = total;
+
+    if (!m_progressTimer->isActive())
+        m_progressTimer->start();
+}
+
+void SettingsDialog::updateDownloadProgress()
+{
+    for (auto it = m_downloadProgress.cbegin(); it != m_downloadProgress.cend(); ++it) {
+        // Try to get the item associated to the request
+        const int row = it.key()->property(ListItemIndexProperty).toInt();
+        QListWidgetItem *item = ui->availableDocsetList->item(row);
+        if (item)
+            item->setData(ProgressItemDelegate::ValueRole, percent(it->received, it->total));
+    }
 
     displayProgress();
+
+    if (m_downloadProgress.isEmpty())
+        m_progressTimer->stop();
 }
 
 void SettingsDialog::displayProgress()
@@ -323,12 +529,22 @@ void SettingsDialog::displayProgress()
     ui->docsetsProgress->setValue(percent(m_combinedReceived, m_combinedTotal));
     ui->docsetsProgress->setMaximum(100);
     ui->docsetsProgress->setVisible(!replies.isEmpty());
+
+    // Combined speed of all downloads since the first one started
+    const qint64 elapsed = m_downloadClock.isValid() ? m_downloadClock.elapsed() : 0;
+    if (elapsed > 0 && m_combinedReceived > 0) {
+        ui->docsetsProgress->setFormat(tr("%p% (%1/s)")
+                                       .arg(formatSize(m_combinedReceived * 1000 / elapsed)));
+    } else {
+        ui->docsetsProgress->setFormat(QStringLiteral("%p%"));
+    }
 }
 
 void SettingsDialog::resetProgress()
 {
     m_combinedReceived = 0;
     m_combinedTotal = 0;
+    m_downloadClock.invalidate();
     displayProgress();
 
     ui->downloadButton->setVisible(m_availableDocsets.isEmpty());
@@ -344,7 +560,7 @@ void SettingsDialog::updateFeedDocsets()
     ui->downloadableGroup->show();
     bool missingMetadata = false;
 
-    for (const Docset * const docset : m_docsetRegistry->docsets()) {
+    for (const QSharedPointer<Docset> &docset : m_docsetRegistry->docsets()) {
         if (!docset->hasMetadata()) {
             missingMetadata = true;
             continue;
@@ -375,27 +591,74 @@ void SettingsDialog::updateFeedDocsets()
     if (r == QMessageBox::No)
         return;
 
+    // Continues in redownloadDocsets() once the docset list and all feeds have arrived
+    m_redownloadPending = true;
     if (m_availableDocsets.isEmpty())
         downloadDocsetList();
 
-    // There must be a better way to do this.
-    QFuture<void> future = QtConcurrent::run([=] {
-        while (m_availableDocsets.isEmpty() || replies.size())
-            QThread::yieldCurrentThread();
-    });
+    redownloadDocsets();
+}
 
-    QFutureWatcher<void> *watcher = new QFutureWatcher<void>;
-    watcher->setFuture(future);
-    connect(watcher, &QFutureWatcher<void>::finished, [=] {
-        for (const Docset * const docset : m_docsetRegistry->docsets()) {
-            if (!docset->metadata.source().isEmpty() && m_availableDocsets.contains(docset->name()))
-                downloadDashDocset(docset->name());
-        }
-    });
+void SettingsDialog::redownloadDocsets()
+{
+    // Feeds waiting for a download slot or their size are not done either
+    if (!m_redownloadPending || m_availableDocsets.isEmpty() || !replies.isEmpty()
+            || !m_queuedDownloads.isEmpty() || !m_sizeProbes.isEmpty()) {
+        return;
+    }
+
+    m_redownloadPending = false;
+
+    for (const QSharedPointer<Docset> &docset : m_docsetRegistry->docsets()) {
+        if (!docset->metadata.source().isEmpty() && m_availableDocsets.contains(docset->name()))
+            downloadDashDocset(docset->name());
+    }
+}
+
+/*!
+  \internal
+  Replaces the list of available docsets with the one downloaded last. Running and queued
+  docset downloads refer to list items by row, so it waits until they are done.
+*/
+void SettingsDialog::applyPendingDocsetList()
+{
+    if (m_pendingDocsetList.isNull() || activeDocsetDownloads() > 0 || !m_queuedDownloads.isEmpty())
+        return;
+
+    const QByteArray data = m_pendingDocsetList;
+    m_pendingDocsetList.clear();
+
+    if (data == m_docsetListData) {
+        resetProgress();
+        return;
+    }
+
+    QJsonParseError jsonError;
+    const QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &jsonError);
+
+    if (jsonError.error != QJsonParseError::NoError) {
+        QMessageBox::warning(this, tr("Error"),
+                             tr("Corrupted docset list: ") + jsonError.errorString());
+        m_redownloadPending = false;
+        return;
+    }
+
+    processDocsetList(jsonDoc.array());
+    saveDocsetList(data);
+
+    if (!m_availableDocsets.isEmpty())
+        ui->downloadableGroup->show();
+    else
+        m_redownloadPending = false;
+
+    resetProgress();
 }
 
 void SettingsDialog::processDocsetList(const QJsonArray &list)
 {
+    ui->availableDocsetList->clear();
+    m_availableDocsets.clear();
+
     for (const QJsonValue &v : list) {
         QJsonObject docsetJson = v.toObject();
         QString source = QStringLiteral("source");
@@ -407,7 +670,7 @@ void SettingsDialog::processDocsetList(const QJsonArray &list)
 
     /// TODO: Move into a dedicated method
     for (const DocsetMetadata &metadata : m_availableDocsets) {
-        const QIcon icon(QString("docsetIcon:%1.png").arg(metadata.icon()));
+        const QIcon icon = IconCache::icon(QString("docsetIcon:%1.png").arg(metadata.icon()));
 
         QListWidgetItem *listItem = new QListWidgetItem(icon, metadata.title(), ui->availableDocsetList);
         listItem->setData(ListModel::DocsetNameRole, metadata.name());
@@ -420,7 +683,6 @@ void SettingsDialog::processDocsetList(const QJsonArray &list)
 
 void SettingsDialog::downloadDashDocset(const QString &name)
 {
-    /// TODO: Select fastest mirror
     static const QStringList kapeliUrls = {
         QStringLiteral("http://sanfrancisco.kapeli.com"),
         QStringLiteral("http://sanfrancisco2.kapeli.com"),
@@ -437,25 +699,134 @@ void SettingsDialog::downloadDashDocset(const QString &name)
     if (!m_availableDocsets.contains(name))
         return;
 
-    const QUrl url = QString("%1/feeds/%2.tgz")
-            .arg(kapeliUrls.at(qrand() % kapeliUrls.size()))
-            .arg(name);
+    QList<QUrl> urls;
+    for (const QString &kapeliUrl : kapeliUrls)
+        urls.append(QString("%1/feeds/%2.tgz").arg(kapeliUrl, name));
 
-    QNetworkReply *reply = startDownload(url);
-    reply->setProperty(DocsetMetadataProperty, QVariant::fromValue(m_availableDocsets[name]));
-    reply->setProperty(DownloadTypeProperty, DownloadDocset);
-    reply->setProperty(ListItemIndexProperty,
-                       ui->availableDocsetList->row(findDocsetListItem(m_availableDocsets[name].title())));
+    enqueueDownload(m_availableDocsets[name], urls,
+                    ui->availableDocsetList->row(findDocsetListItem(m_availableDocsets[name].title())));
+}
 
-    connect(reply, &QNetworkReply::finished, this, &SettingsDialog::downloadCompleted);
+/*!
+  \internal
+  Queues a docset download, which starts once fewer than the configured number of docset
+  downloads are running. The size of the archive is requested meanwhile, so that smaller
+  docsets can go first.
+*/
+void SettingsDialog::enqueueDownload(const DocsetMetadata &metadata, const QList<QUrl> &urls,
+                                     int listItemIndex)
+{
+    if (urls.isEmpty())
+        return;
+
+    QueuedDownload download;
+    download.metadata = metadata;
+    download.urls = urls;
+    download.listItemIndex = listItemIndex;
+    download.size = -1;
+
+    // Updates go for a delta package if there is one, the full archive is kept as a fallback
+    const QList<QUrl> deltaUrls = this->deltaUrls(metadata);
+    if (!deltaUrls.isEmpty()) {
+        m_deltaFallbacks.insert(metadata.name(), download);
+        download.urls = deltaUrls;
+    }
+
+    m_queuedDownloads.append(download);
+
+    const QString name = metadata.name();
+    QNetworkReply *probe = m_application->requestHeaders(download.urls.first());
+    m_sizeProbes.append(probe);
+    connect(probe, &QNetworkReply::finished, this, [this, probe, name]() {
+        m_sizeProbes.removeOne(probe);
+        probe->deleteLater();
+
+        const QVariant contentLength = probe->header(QNetworkRequest::ContentLengthHeader);
+        if (probe->error() == QNetworkReply::NoError && contentLength.isValid()) {
+            for (QueuedDownload &download : m_queuedDownloads) {
+                if (download.metadata.name() == name)
+                    download.size = contentLength.toLongLong();
+            }
+        }
+
+        startQueuedDownloads();
+    });
+
+    if (!m_sizeProbeTimer->isActive())
+        m_sizeProbeTimer->start();
+
+    ui->downloadDocsetButton->setText(tr("Stop downloads"));
+}
+
+void SettingsDialog::startQueuedDownloads()
+{
+    if (!m_sizeProbes.isEmpty() && m_sizeProbeTimer->isActive())
+        return;
+
+    // Small docsets first, so that they are ready to use soon
+    std::stable_sort(m_queuedDownloads.begin(), m_queuedDownloads.end(),
+                     [](const QueuedDownload &a, const QueuedDownload &b) {
+        if (a.size < 0 || b.size < 0)
+            return b.size < 0 && a.size >= 0;
+        return a.size < b.size;
+    });
+
+    const int maxDownloads = qMax(1, m_application->settings()->maxConcurrentDownloads);
+    while (!m_queuedDownloads.isEmpty() && activeDocsetDownloads() < maxDownloads) {
+        const QueuedDownload download = m_queuedDownloads.takeFirst();
+
+        QNetworkReply *reply = startDownload(download.urls);
+        reply->setProperty(DocsetMetadataProperty, QVariant::fromValue(download.metadata));
+        reply->setProperty(DownloadTypeProperty, DownloadDocset);
+        if (download.listItemIndex >= 0)
+            reply->setProperty(ListItemIndexProperty, download.listItemIndex);
+
+        connect(reply, &QNetworkReply::finished, this, &SettingsDialog::downloadCompleted);
+    }
+}
+
+QList<QUrl> SettingsDialog::deltaUrls(const DocsetMetadata &metadata) const
+{
+    const QSharedPointer<const Docset> docset = m_docsetRegistry->docset(metadata.name());
+    if (!docset || !docset->hasMetadata())
+        return QList<QUrl>();
+
+    // Deltas patch files in place, which packed documents do not allow
+    if (m_application->settings()->packDocuments
+            || QFile::exists(QDir(docset->path()).absoluteFilePath(
+                                 QStringLiteral("Contents/Resources/")
+                                 + QLatin1String(DocumentArchive::FileName)))) {
+        return QList<QUrl>();
+    }
+
+    return metadata.deltaUrls(docset->metadata);
+}
+
+bool SettingsDialog::fallBackToFullDownload(const QString &docsetName)
+{
+    if (!m_deltaFallbacks.contains(docsetName))
+        return false;
+
+    m_queuedDownloads.append(m_deltaFallbacks.take(docsetName));
+    startQueuedDownloads();
+    return true;
+}
+
+int SettingsDialog::activeDocsetDownloads() const
+{
+    int count = 0;
+    for (const QNetworkReply *reply : replies) {
+        if (reply->property(DownloadTypeProperty).toUInt() == DownloadDocset)
+            ++count;
+    }
+    return count;
 }
 
 void SettingsDialog::downloadDocsetList()
 {
     ui->downloadButton->hide();
-    ui->availableDocsetList->clear();
-    m_availableDocsets.clear();
 
+    // The current list stays until a different one arrives
     QNetworkReply *reply = startDownload(QUrl(ApiUrl + QLatin1String("/docsets")));
     reply->setProperty(DownloadTypeProperty, DownloadDocsetList);
     connect(reply, &QNetworkReply::finished, this, &SettingsDialog::downloadCompleted);
@@ -468,7 +839,7 @@ void SettingsDialog::on_availableDocsetList_itemSelectionChanged()
 
 void SettingsDialog::on_downloadDocsetButton_clicked()
 {
-    if (!replies.isEmpty()) {
+    if (!replies.isEmpty() || !m_queuedDownloads.isEmpty()) {
         stopDownloads();
         return;
     }
@@ -486,7 +857,7 @@ void SettingsDialog::on_downloadDocsetButton_clicked()
         downloadDashDocset(item->data(ListModel::DocsetNameRole).toString());
     }
 
-    if (replies.count() > 0)
+    if (replies.count() > 0 || !m_queuedDownloads.isEmpty())
         ui->downloadDocsetButton->setText(tr("Stop downloads"));
 }
 
@@ -511,6 +882,16 @@ void SettingsDialog::on_deleteButton_clicked()
     const QDir dataDir(m_application->settings()->docsetPath);
     const QString docsetName = ui->installedDocsetList->currentIndex().data(ListModel::DocsetNameRole).toString();
     m_docsetRegistry->remove(docsetName);
+
+    // Moving the docset aside is instant, its files are deleted in the background
+    if (m_application->removeDirectory(dataDir.absoluteFilePath(docsetName + QLatin1String(".docset")))) {
+        QListWidgetItem *listItem = findDocsetListItem(docsetTitle);
+        if (listItem)
+            listItem->setHidden(false);
+        return;
+    }
+
+    // Fall back to deleting in place, e.g. while another process keeps files open
     if (dataDir.exists()) {
         ui->docsetsProgress->show();
         ui->deleteButton->hide();
@@ -546,12 +927,56 @@ void SettingsDialog::on_installedDocsetList_clicked(const QModelIndex &index)
     ui->deleteButton->setEnabled(true);
 }
 
+/*!
+  \internal
+  Starts extracting docset archives as soon as their download turns out not to be a redirect.
+*/
+void SettingsDialog::startExtraction()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply || reply->property(DownloadTypeProperty).toUInt() != DownloadDocset)
+        return;
+
+    const QString source = reply->url().toString();
+    if (m_extractions.contains(source)
+            || reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid()) {
+        return;
+    }
+
+    const QVariant statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+    if (statusCode.isValid() && statusCode.toInt() / 100 != 2)
+        return;
+
+    const DocsetMetadata metadata = reply->property(DocsetMetadataProperty).value<DocsetMetadata>();
+
+    // Left by an interrupted session
+    removeStagedDocset(metadata.name());
+    m_extractions.insert(source, metadata.name());
+
+    const bool isDelta = m_deltaFallbacks.contains(metadata.name());
+    m_application->extract(reply, m_application->settings()->docsetPath,
+                           isDelta ? metadata.name() + QLatin1String(".docset")
+                                   : stagingDirName(metadata.name()));
+}
+
 QNetworkReply *SettingsDialog::startDownload(const QUrl &url)
 {
+    return trackDownload(m_application->download(url));
+}
+
+QNetworkReply *SettingsDialog::startDownload(const QList<QUrl> &urls)
+{
+    return trackDownload(m_application->download(urls));
+}
+
+QNetworkReply *SettingsDialog::trackDownload(QNetworkReply *reply)
+{
+    if (replies.isEmpty())
+        m_downloadClock.start();
     displayProgress();
 
-    QNetworkReply *reply = m_application->download(url);
     connect(reply, &QNetworkReply::downloadProgress, this, &SettingsDialog::on_downloadProgress);
+    connect(reply, &QNetworkReply::metaDataChanged, this, &SettingsDialog::startExtraction);
     replies.append(reply);
 
     ui->downloadDocsetButton->setText(tr("Stop downloads"));
@@ -564,6 +989,20 @@ QNetworkReply *SettingsDialog::startDownload(const QUrl &url)
 
 void SettingsDialog::stopDownloads()
 {
+    for (const QueuedDownload &download : m_queuedDownloads) {
+        QListWidgetItem *listItem = ui->availableDocsetList->item(download.listItemIndex);
+        if (listItem)
+            listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
+    }
+    m_queuedDownloads.clear();
+    m_deltaFallbacks.clear();
+    m_redownloadPending = false;
+
+    // Aborted probes remove themselves from the list
+    const QList<QNetworkReply *> sizeProbes = m_sizeProbes;
+    for (QNetworkReply *probe : sizeProbes)
+        probe->abort();
+
     for (QNetworkReply *reply : replies) {
         // Hide progress bar
         QListWidgetItem *listItem = ui->availableDocsetList->item(reply->property(ListItemIndexProperty).toInt());
@@ -624,12 +1063,127 @@ int SettingsDialog::percent(qint64 fraction, qint64 total)
 
 void SettingsDialog::on_tabWidget_currentChanged(int current)
 {
+    if (ui->tabWidget->widget(current) == m_performanceTab) {
+        updatePerformanceTab();
+        return;
+    }
+
     if (ui->tabWidget->widget(current) != ui->docsetsTab || ui->availableDocsetList->count())
         return;
 
+    // The list from the last session shows up right away, and gets refreshed meanwhile
+    loadDocsetList();
     downloadDocsetList();
 }
 
+void SettingsDialog::setupPerformanceTab()
+{
+    m_performanceTab = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(m_performanceTab);
+
+    QLabel *label = new QLabel(tr("Time spent searching each docset since Zeal was started. "
+                                  "Every search waits for the slowest docset."));
+    label->setWordWrap(true);
+    layout->addWidget(label);
+
+    m_performanceTree = new QTreeWidget();
+    m_performanceTree->setRootIsDecorated(false);
+    m_performanceTree->setHeaderLabels({tr("Docset"), tr("Searches"), tr("Median (ms)"),
+                                        tr("99th Percentile (ms)"), tr("Missing Indexes")});
+    m_performanceTree->setSortingEnabled(true);
+    m_performanceTree->sortByColumn(3, Qt::DescendingOrder);
+    layout->addWidget(m_performanceTree);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    buttonLayout->addStretch();
+    if (Core::Tracer::isEnabled()) {
+        QPushButton *saveButton = new QPushButton(tr("Save Trace..."));
+        connect(saveButton, &QPushButton::clicked, this, &SettingsDialog::saveTrace);
+        buttonLayout->addWidget(saveButton);
+    }
+    QPushButton *refreshButton = new QPushButton(tr("Refresh"));
+    connect(refreshButton, &QPushButton::clicked, this, &SettingsDialog::updatePerformanceTab);
+    buttonLayout->addWidget(refreshButton);
+    layout->addLayout(buttonLayout);
+
+    ui->tabWidget->addTab(m_performanceTab, tr("Performance"));
+}
+
+void SettingsDialog::updatePerformanceTab()
+{
+    m_performanceTree->clear();
+
+    const QMap<QString, Core::LatencyHistogram> latencies = Core::Tracer::latencies();
+    for (auto it = latencies.cbegin(); it != latencies.cend(); ++it) {
+        const QSharedPointer<const Docset> docset = m_docsetRegistry->docset(it.key());
+
+        // Numbers are set as such, so that they sort as numbers
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_performanceTree);
+        item->setText(0, docset ? docset->title() : it.key());
+        item->setData(1, Qt::DisplayRole, it->count());
+        item->setData(2, Qt::DisplayRole, qRound(it->percentile(0.5) / 100.0) / 10.0);
+        item->setData(3, Qt::DisplayRole, qRound(it->percentile(0.99) / 100.0) / 10.0);
+        if (docset)
+            item->setText(4, docset->slowQueries().join(QStringLiteral(", ")));
+    }
+
+    // Docsets with slow queries are listed even before they are searched
+    for (const QSharedPointer<Docset> &docset : m_docsetRegistry->docsets()) {
+        if (docset->slowQueries().isEmpty() || latencies.contains(docset->name()))
+            continue;
+
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_performanceTree);
+        item->setText(0, docset->title());
+        item->setData(1, Qt::DisplayRole, 0);
+        item->setText(4, docset->slowQueries().join(QStringLiteral(", ")));
+    }
+
+    m_performanceTree->resizeColumnToContents(0);
+}
+
+void SettingsDialog::saveTrace()
+{
+    const QString fileName = QFileDialog::getSaveFileName(
+                this, tr("Save Trace"), QDir::home().absoluteFilePath(QStringLiteral("zeal-trace.json")),
+                tr("Trace Files (*.json)"));
+    if (fileName.isEmpty())
+        return;
+
+    if (!Core::Tracer::save(fileName))
+        QMessageBox::warning(this, tr("Error"), tr("Cannot save the trace to %1.").arg(fileName));
+}
+
+void SettingsDialog::loadDocsetList()
+{
+    QFile file(QDir(Core::Application::cacheLocation()).absoluteFilePath(QLatin1String(DocsetListFileName)));
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    const QByteArray data = file.readAll();
+    const QJsonDocument jsonDoc = QJsonDocument::fromJson(data);
+    if (!jsonDoc.isArray())
+        return;
+
+    m_docsetListData = data;
+    processDocsetList(jsonDoc.array());
+
+    if (!m_availableDocsets.isEmpty())
+        ui->downloadableGroup->show();
+}
+
+void SettingsDialog::saveDocsetList(const QByteArray &data)
+{
+    m_docsetListData = data;
+
+    const QDir cacheDir(Core::Application::cacheLocation());
+    if (!cacheDir.exists() && !QDir().mkpath(cacheDir.path()))
+        return;
+
+    QFile file(cacheDir.absoluteFilePath(QLatin1String(DocsetListFileName)));
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        file.write(data);
+}
+
 void SettingsDialog::addDashFeed()
 {
     QString txt = QApplication::clipboard()->text();
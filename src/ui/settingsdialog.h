@@ -4,13 +4,16 @@
 #include "registry/docsetmetadata.h"
 
 #include <QDialog>
+#include <QElapsedTimer>
 #include <QHash>
 #include <QMap>
+#include <QSet>
 
 class QAbstractButton;
 class QListWidgetItem;
 class QNetworkReply;
-class QTemporaryFile;
+class QTimer;
+class QTreeWidget;
 class QUrl;
 
 namespace Ui {
@@ -39,8 +42,10 @@ private slots:
     void extractionProgress(const QString &filePath, qint64 extracted, qint64 total);
 
     void downloadCompleted();
+    void startExtraction();
 
     void on_downloadProgress(qint64 received, qint64 total);
+    void updateDownloadProgress();
     void on_downloadDocsetButton_clicked();
     void on_storageButton_clicked();
     void on_deleteButton_clicked();
@@ -48,6 +53,8 @@ private slots:
     void on_tabWidget_currentChanged(int current);
     void on_availableDocsetList_itemSelectionChanged();
     void addDashFeed();
+    void updatePerformanceTab();
+    void saveTrace();
 
 private:
     enum DownloadType {
@@ -56,33 +63,79 @@ private:
         DownloadDocsetList
     };
 
+    struct DownloadProgress {
+        qint64 received = 0;
+        qint64 total = -1;
+    };
+
+    struct QueuedDownload {
+        DocsetMetadata metadata;
+        QList<QUrl> urls;
+        int listItemIndex;
+        qint64 size; // -1 if unknown
+    };
+
     QListWidgetItem *findDocsetListItem(const QString &title) const;
 
     /// TODO: Create a special model
     QMap<QString, DocsetMetadata> m_availableDocsets;
     QMap<QString, DocsetMetadata> m_userFeeds;
+    QByteArray m_docsetListData;
+    QByteArray m_pendingDocsetList; // Downloaded while docsets were, see applyPendingDocsetList()
 
-    QHash<QString, QTemporaryFile *> m_tmpFiles;
+    // Docset names by the URL of the archive being extracted
+    QHash<QString, QString> m_extractions;
+    QSet<QString> m_failedDownloads; // URLs of extractions whose download failed
 
     void downloadDocsetList();
+    void loadDocsetList();
+    void saveDocsetList(const QByteArray &data);
+    void applyPendingDocsetList();
     void processDocsetList(const QJsonArray &list);
     void downloadDashDocset(const QString &name);
+    void completeInstallation(const QString &docsetName);
+    bool installStagedDocset(const QString &docsetName);
+    void removeStagedDocset(const QString &docsetName);
+    void resetDocsetListItem(const QString &docsetName);
+    void enqueueDownload(const DocsetMetadata &metadata, const QList<QUrl> &urls,
+                         int listItemIndex = -1);
+    void startQueuedDownloads();
+    QList<QUrl> deltaUrls(const DocsetMetadata &metadata) const;
+    bool fallBackToFullDownload(const QString &docsetName);
+    int activeDocsetDownloads() const;
 
     void displayProgress();
     void resetProgress();
 
+    void setupPerformanceTab();
+
     void loadSettings();
     void updateFeedDocsets();
+    /// Redownloads docsets missing metadata, once nothing else is being downloaded
+    void redownloadDocsets();
     QNetworkReply *startDownload(const QUrl &url);
+    QNetworkReply *startDownload(const QList<QUrl> &urls);
+    QNetworkReply *trackDownload(QNetworkReply *reply);
     void stopDownloads();
     void saveSettings();
     static inline int percent(qint64 fraction, qint64 total);
 
     Ui::SettingsDialog *ui = nullptr;
+    QWidget *m_performanceTab = nullptr;
+    QTreeWidget *m_performanceTree = nullptr;
     Core::Application *m_application = nullptr;
     DocsetRegistry *m_docsetRegistry = nullptr;
 
     QList<QNetworkReply *> replies;
+    QList<QueuedDownload> m_queuedDownloads;
+    // Full downloads of docsets being updated with a delta package
+    QHash<QString, QueuedDownload> m_deltaFallbacks;
+    bool m_redownloadPending = false;
+    QList<QNetworkReply *> m_sizeProbes;
+    QTimer *m_sizeProbeTimer = nullptr;
+    QHash<QNetworkReply *, DownloadProgress> m_downloadProgress;
+    QTimer *m_progressTimer = nullptr;
+    QElapsedTimer m_downloadClock;
     qint64 m_combinedTotal = 0;
     qint64 m_combinedReceived = 0;
 };
@@ -1,5 +1,6 @@
 #include "zealsearchedit.h"
 
+#include "registry/docsetregistry.h"
 #include "registry/searchquery.h"
 
 #include <QKeyEvent>
@@ -23,13 +24,17 @@ void ZealSearchEdit::setTreeView(QTreeView *view)
     focusing = false;
 }
 
-// Makes the line edit use autocompletions.
-void ZealSearchEdit::setCompletions(const QStringList &completions)
+// Makes the line edit use autocompletions, which follow docsets being added and removed.
+void ZealSearchEdit::setDocsetRegistry(Zeal::DocsetRegistry *registry)
 {
-    prefixCompleter = new QCompleter(completions, this);
-    prefixCompleter->setCompletionMode(QCompleter::InlineCompletion);
-    prefixCompleter->setCaseSensitivity(Qt::CaseInsensitive);
-    prefixCompleter->setWidget(this);
+    docsetRegistry = registry;
+    connect(registry, &Zeal::DocsetRegistry::docsetAdded, this, [this]() {
+        showCompletions(text());
+    });
+    connect(registry, &Zeal::DocsetRegistry::docsetRemoved, this, [this]() {
+        showCompletions(text());
+    });
+    showCompletions(text());
 }
 
 bool ZealSearchEdit::event(QEvent *event)
@@ -128,10 +133,10 @@ void ZealSearchEdit::mousePressEvent(QMouseEvent *ev)
 
 QString ZealSearchEdit::currentCompletion(const QString &text)
 {
-    if (text.isEmpty())
+    if (text.isEmpty() || !docsetRegistry)
         return QString();
     else
-        return prefixCompleter->currentCompletion();
+        return docsetRegistry->completion(text);
 }
 
 void ZealSearchEdit::showCompletions(const QString &newValue)
@@ -139,8 +144,6 @@ void ZealSearchEdit::showCompletions(const QString &newValue)
     int frameWidth = style()->pixelMetric(QStyle::PM_DefaultFrameWidth);
     int textWidth = fontMetrics().width(newValue);
 
-    prefixCompleter->setCompletionPrefix(text());
-
     QString completed = currentCompletion(newValue).mid(newValue.size());
     QSize labelSize(fontMetrics().width(completed), size().height());
 
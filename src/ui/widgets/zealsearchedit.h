@@ -3,10 +3,13 @@
 
 #include <QEvent>
 #include <QTreeView>
-#include <QCompleter>
 #include <QLabel>
 #include <QLineEdit>
 
+namespace Zeal {
+class DocsetRegistry;
+}
+
 class ZealSearchEdit : public QLineEdit
 {
     Q_OBJECT
@@ -16,7 +19,8 @@ public:
     void setTreeView(QTreeView *view);
     void clearQuery();
     void selectQuery();
-    void setCompletions(const QStringList &completions);
+    /// Completes queries inline with keywords and symbol names of docsets in \a registry
+    void setDocsetRegistry(Zeal::DocsetRegistry *registry);
 
 protected:
     bool event(QEvent *event) override;
@@ -32,7 +36,7 @@ public slots:
 private:
     int queryStart() const;
 
-    QCompleter *prefixCompleter;
+    Zeal::DocsetRegistry *docsetRegistry = nullptr;
     QTreeView *treeView;
     QLabel *completionLabel;
     bool focusing;
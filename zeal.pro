@@ -12,7 +12,8 @@ TEMPLATE = subdirs
 CONFIG += ordered
 
 SUBDIRS += \
-    src
+    src \
+    src/cli
 
 # Ease access to these files from Qt Creator
 OTHER_FILES += \